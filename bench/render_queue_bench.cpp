@@ -0,0 +1,92 @@
+#include <mc/logger.hpp>
+#include <mc/renderer/backend/render_queue.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Times radixSort against std::stable_sort on a frame's worth of render queue keys, averaged over a number
+// of iterations: `render_queue_bench [key count] [iterations]`
+auto main(int argc, char** argv) -> int
+{
+    using namespace renderer::backend;
+    using Clock = std::chrono::steady_clock;
+
+    logger::Logger::init();
+
+    size_t const keyCount     = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+    uint32_t const iterations = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 100;
+
+    // Keys shaped like a scene's, few pipelines, a few hundred materials and arbitrary distances
+    std::mt19937 generator { 42 };
+    std::uniform_int_distribution<uint32_t> pipelines(0, 1);
+    std::uniform_int_distribution<uint32_t> materials(0, 255);
+    std::uniform_real_distribution<float> distances(0.f, 1000.f * 1000.f);
+    std::bernoulli_distribution blended(0.05);
+
+    std::vector<RenderQueueEntry> input(keyCount);
+
+    for (uint32_t i = 0; i < keyCount; ++i)
+    {
+        DrawPass const pass = blended(generator) ? DrawPass::Blended : DrawPass::Opaque;
+
+        uint32_t const pipeline = pipelines(generator);
+        uint32_t const material = materials(generator);
+
+        input[i] = {
+            .key       = DrawKey::make(pass, pipeline, material, distances(generator)),
+            .drawIndex = i,
+        };
+    }
+
+    std::vector<RenderQueueEntry> entries(keyCount);
+    std::vector<RenderQueueEntry> scratch(keyCount);
+
+    auto measure = [&](auto&& sort) -> double
+    {
+        Clock::duration total {};
+
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            std::ranges::copy(input, entries.begin());
+
+            Clock::time_point const start = Clock::now();
+            sort();
+            total += Clock::now() - start;
+        }
+
+        return std::chrono::duration<double, std::milli>(total).count() / iterations;
+    };
+
+    double const radixMs = measure([&] { radixSort(entries, scratch); });
+
+    if (!std::ranges::is_sorted(entries, {}, &RenderQueueEntry::key))
+    {
+        logger::error("radixSort left the keys unsorted");
+
+        return 1;
+    }
+
+    std::vector<RenderQueueEntry> const radixSorted = entries;
+
+    double const stdSortMs = measure([&] { std::ranges::stable_sort(entries, {}, &RenderQueueEntry::key); });
+
+    // Both sorts are stable, so they have to agree on the payloads as well
+    auto const drawIndex = &RenderQueueEntry::drawIndex;
+
+    if (!std::ranges::equal(radixSorted, entries, {}, drawIndex, drawIndex))
+    {
+        logger::error("radixSort and std::stable_sort disagree");
+
+        return 1;
+    }
+
+    logger::info("{} keys, {} iterations", keyCount, iterations);
+    logger::info("radixSort        {:8.3f} ms", radixMs);
+    logger::info("std::stable_sort {:8.3f} ms", stdSortMs);
+
+    return 0;
+}
@@ -78,6 +78,10 @@ public:
     void pitch(float angle);
     void yaw(float angle);
 
+    // Absolute angles in degrees, what onUpdate aims the camera by. lookAt doesn't touch them.
+    void setPitch(float angle);
+    void setYaw(float angle);
+
     void onUpdate(AppUpdateEvent const& event);
     void onFramebufferResize(WindowFramebufferResizeEvent const& event);
 
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+    // Reports files written in a directory without blocking the caller. Backed by inotify on Linux, on other
+    // platforms nothing is ever reported.
+    class FileWatcher
+    {
+    public:
+        FileWatcher() = default;
+
+        explicit FileWatcher(std::filesystem::path directory);
+
+        ~FileWatcher();
+
+        FileWatcher(FileWatcher const&)                    = delete;
+        auto operator=(FileWatcher const&) -> FileWatcher& = delete;
+
+        FileWatcher(FileWatcher&& other) noexcept
+            : m_directory { std::move(other.m_directory) }, m_handle { std::exchange(other.m_handle, -1) }
+        {
+        }
+
+        auto operator=(FileWatcher&& other) noexcept -> FileWatcher&
+        {
+            if (this == &other)
+            {
+                return *this;
+            }
+
+            close();
+
+            m_directory = std::move(other.m_directory);
+            m_handle    = std::exchange(other.m_handle, -1);
+
+            return *this;
+        }
+
+        // Files written or moved into the directory since the last call, each reported once
+        [[nodiscard]] auto poll() -> std::vector<std::filesystem::path>;
+
+    private:
+        void close();
+
+        std::filesystem::path m_directory;
+
+        int m_handle { -1 };
+    };
+}  // namespace utils
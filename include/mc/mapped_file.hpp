@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <utility>
+
+namespace utils
+{
+    // Read-only view of a whole file mapped into the address space.
+    //
+    // `padding` zero-filled bytes are guaranteed to be readable past the end of the file, which is what
+    // parsers that overread with SIMD loads (simdjson, and therefore fastgltf) require. An empty file without
+    // padding gives an empty mapping. Files that can't be opened or mapped throw an AssetError.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+
+        explicit MappedFile(std::filesystem::path const& path, size_t padding = 0);
+
+        ~MappedFile();
+
+        MappedFile(MappedFile const&)                    = delete;
+        auto operator=(MappedFile const&) -> MappedFile& = delete;
+
+        MappedFile(MappedFile&& other) noexcept
+            : m_data { std::exchange(other.m_data, nullptr) },
+              m_size { std::exchange(other.m_size, 0) },
+              m_mappingSize { std::exchange(other.m_mappingSize, 0) },
+              m_ownsHeapCopy { std::exchange(other.m_ownsHeapCopy, false) }
+        {
+        }
+
+        auto operator=(MappedFile&& other) noexcept -> MappedFile&
+        {
+            if (this == &other)
+            {
+                return *this;
+            }
+
+            unmap();
+
+            m_data         = std::exchange(other.m_data, nullptr);
+            m_size         = std::exchange(other.m_size, 0);
+            m_mappingSize  = std::exchange(other.m_mappingSize, 0);
+            m_ownsHeapCopy = std::exchange(other.m_ownsHeapCopy, false);
+
+            return *this;
+        }
+
+        [[nodiscard]] operator bool() const { return m_data != nullptr; }
+
+        [[nodiscard]] auto data() const -> std::byte const* { return m_data; }
+
+        // Some C APIs take non-const pointers even though they never write through them
+        [[nodiscard]] auto mutableData() const -> std::byte* { return m_data; }
+
+        [[nodiscard]] auto size() const -> size_t { return m_size; }
+
+        // Size of the file plus the readable padding behind it
+        [[nodiscard]] auto capacity() const -> size_t { return m_mappingSize; }
+
+        [[nodiscard]] auto getBytes() const -> std::span<std::byte const> { return { m_data, m_size }; }
+
+    private:
+        void unmap();
+
+#ifndef __linux__
+        static auto getFileSize(std::filesystem::path const& path) -> size_t;
+
+        // Reads the file into zeroed heap memory of the mapping's size
+        void readHeapCopy(std::filesystem::path const& path);
+#endif
+
+        std::byte* m_data { nullptr };
+        size_t m_size { 0 };
+        size_t m_mappingSize { 0 };
+
+        // Set when the platform cannot provide the requested padding and the file had to be read instead
+        bool m_ownsHeapCopy { false };
+    };
+}  // namespace utils
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "constants.hpp"
+#include "device.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    // Upper bound of the texture array, lowered to the device's update-after-bind limits
+    constexpr uint32_t kMaxBindlessTextures = 16384;
+
+    // One array of combined image samplers that every textured draw indexes with the slots stored in its
+    // Material, so a whole scene draws with a single descriptor bind.
+    //
+    // Each frame in flight gets its own copy of the set. Writes are queued for all of them and only applied
+    // by flush() once the frame's previous submission has retired, so slots can be repointed, e.g. from the
+    // dummy texture to a streamed in one, without waiting on the GPU. The binding is partially bound, slots
+    // nothing samples don't have to be written. Update-after-bind pools come with much higher descriptor
+    // limits than regular ones on most drivers.
+    class BindlessTextures
+    {
+    public:
+        BindlessTextures() = default;
+
+        explicit BindlessTextures(Device const& device);
+
+        ~BindlessTextures() = default;
+
+        BindlessTextures(BindlessTextures const&)                    = delete;
+        auto operator=(BindlessTextures const&) -> BindlessTextures& = delete;
+
+        BindlessTextures(BindlessTextures&&)                    = default;
+        auto operator=(BindlessTextures&&) -> BindlessTextures& = default;
+
+        // Takes the next free slot and points it at `imageView`, which has to be in eShaderReadOnlyOptimal
+        [[nodiscard]] auto add(vk::ImageView imageView, vk::Sampler sampler) -> uint32_t;
+
+        // Repoints `slot`, frames that are already in flight keep sampling what it pointed at before
+        void set(uint32_t slot, vk::ImageView imageView, vk::Sampler sampler);
+
+        // Applies the writes queued since the last flush of `frameIndex`, whose previous submission has to
+        // have completed
+        void flush(uint32_t frameIndex);
+
+        [[nodiscard]] auto getLayout() const -> vk::raii::DescriptorSetLayout const& { return m_layout; }
+
+        [[nodiscard]] auto getSet(uint32_t frameIndex) const -> vk::DescriptorSet
+        {
+            return m_sets[frameIndex];
+        }
+
+        [[nodiscard]] auto getCapacity() const -> uint32_t { return m_capacity; }
+
+        [[nodiscard]] auto getSlotCount() const -> uint32_t { return m_slotCount; }
+
+    private:
+        struct Write
+        {
+            uint32_t slot;
+            vk::DescriptorImageInfo imageInfo;
+        };
+
+        Device const* m_device { nullptr };
+
+        vk::raii::DescriptorSetLayout m_layout { nullptr };
+        vk::raii::DescriptorPool m_pool { nullptr };
+        std::array<vk::DescriptorSet, kMaxFramesInFlight> m_sets {};
+
+        std::array<std::vector<Write>, kMaxFramesInFlight> m_pendingWrites;
+
+        uint32_t m_capacity { 0 };
+        uint32_t m_slotCount { 0 };
+    };
+}  // namespace renderer::backend
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string_view>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    // How hard the block encoder searches for endpoints. None keeps textures uncompressed.
+    //  - Fast: bounding box endpoints, opaque color textures go to BC1 instead of BC7
+    //  - Normal: principal axis endpoints refined once with a least squares fit
+    //  - High: several refinement rounds, every BC7 p-bit combination is tried
+    enum class BlockEncoderEffort : uint8_t
+    {
+        None,
+        Fast,
+        Normal,
+        High,
+    };
+
+    [[nodiscard]] auto getBlockEncoderEffortName(BlockEncoderEffort effort) -> std::string_view;
+
+    // Target of one texture: BC1 and BC7 keep RGB(A), BC4 keeps `channels[0]` and BC5 `channels[0]` and
+    // `channels[1]` of the source, in its red and green channels
+    struct BlockEncoding
+    {
+        vk::Format format { vk::Format::eBc7UnormBlock };
+        std::array<uint8_t, 2> channels { 0, 1 };
+    };
+
+    // Filled by decoding the blocks again and comparing them with the source, only over the kept channels
+    struct BlockEncoderStats
+    {
+        uint64_t pixelCount { 0 };
+        double seconds { 0.0 };
+
+        double squaredError { 0.0 };
+        uint64_t sampleCount { 0 };
+
+        [[nodiscard]] auto getPsnr() const -> double
+        {
+            if (sampleCount == 0 || squaredError == 0.0)
+            {
+                return std::numeric_limits<double>::infinity();
+            }
+
+            return 10.0 * std::log10(255.0 * 255.0 * static_cast<double>(sampleCount) / squaredError);
+        }
+
+        // Per encoding thread
+        [[nodiscard]] auto getMegapixelsPerSecond() const -> double
+        {
+            return seconds > 0.0 ? static_cast<double>(pixelCount) / seconds / 1'000'000.0 : 0.0;
+        }
+
+        auto operator+=(BlockEncoderStats const& other) -> BlockEncoderStats&
+        {
+            pixelCount += other.pixelCount;
+            seconds += other.seconds;
+            squaredError += other.squaredError;
+            sampleCount += other.sampleCount;
+
+            return *this;
+        }
+    };
+
+    // Compresses one tightly packed RGBA8 level into `blocks`, which has to hold getImageLevelSize(format,
+    // dimensions) bytes. Edge blocks of levels that aren't a multiple of 4 repeat the last row and column.
+    //
+    // BC7 only uses mode 6 (one subset, 7-bit RGBA endpoints with p-bits, 4-bit indices), the index search
+    // of BC1 and BC7 runs on AVX2. Safe to call from worker threads.
+    auto encodeBlocks(std::span<std::byte const> rgba,
+                      vk::Extent2D dimensions,
+                      BlockEncoding const& encoding,
+                      BlockEncoderEffort effort,
+                      std::span<std::byte> blocks) -> BlockEncoderStats;
+
+    // The other way around, for devices without BC support: decodes one level of `format` blocks into
+    // tightly packed RGBA8 `rgba`, which has to hold width * height * 4 bytes. Handles the unsigned BC1-BC5
+    // formats and BC7 mode 6, the only mode the encoder writes. Returns false on any other block.
+    [[nodiscard]] auto decodeBlocks(std::span<std::byte const> blocks,
+                                    vk::Extent2D dimensions,
+                                    vk::Format format,
+                                    std::span<std::byte> rgba) -> bool;
+}  // namespace renderer::backend
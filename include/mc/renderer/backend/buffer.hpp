@@ -58,6 +58,14 @@ namespace renderer::backend
 
         [[nodiscard]] auto getSize() const -> size_t { return m_allocInfo.size; }
 
+        // Makes what the device wrote visible to the host, needed before reading mapped memory that isn't
+        // host coherent
+        void invalidate() const;
+
+        // Makes what the host wrote visible to the device, needed after writing mapped memory that isn't
+        // host coherent
+        void flush() const;
+
     private:
         Allocator* m_allocator { nullptr };
 
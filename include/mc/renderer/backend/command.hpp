@@ -1,8 +1,12 @@
 #pragma once
 
+#include "constants.hpp"
 #include "device.hpp"
 
+#include <array>
 #include <utility>
+#include <vector>
+
 #include <vulkan/vulkan_raii.hpp>
 #include <vulkan/vulkan_shared.hpp>
 
@@ -74,6 +78,7 @@ namespace renderer::backend
             m_graphicsCommandPool    = std::exchange(other.m_graphicsCommandPool, nullptr);
             m_transferCommandPool    = std::exchange(other.m_transferCommandPool, nullptr);
             m_graphicsCommandBuffers = std::exchange(other.m_graphicsCommandBuffers, {});
+            m_recordingPools         = std::exchange(other.m_recordingPools, {});
 
             return *this;
         };
@@ -81,8 +86,26 @@ namespace renderer::backend
         CommandManager(CommandManager&& other) noexcept
             : m_graphicsCommandPool { std::exchange(other.m_graphicsCommandPool, nullptr) },
               m_transferCommandPool { std::exchange(other.m_transferCommandPool, nullptr) },
-              m_graphicsCommandBuffers { std::exchange(other.m_graphicsCommandBuffers, {}) }
+              m_graphicsCommandBuffers { std::exchange(other.m_graphicsCommandBuffers, {}) },
+              m_recordingPools { std::exchange(other.m_recordingPools, {}) }
+        {
+        }
+
+        // One graphics pool per recording thread and frame in flight, secondary command buffers come out of
+        // them. Command pools aren't thread safe, so every thread only ever records from its own pool.
+        void createRecordingPools(Device const& device, uint32_t threadCount);
+
+        // A secondary command buffer of `thread`'s pool for the frame, valid until the pool is reset. Only to
+        // be called from the thread recording with that pool, others may call it concurrently for theirs.
+        [[nodiscard]] auto acquireSecondaryCmdBuffer(Device const& device, size_t frameIndex, uint32_t thread)
+            -> vk::CommandBuffer;
+
+        // Recycles every secondary buffer of the frame, once it has completed
+        void resetRecordingPools(size_t frameIndex);
+
+        [[nodiscard]] auto getRecordingThreadCount() const -> uint32_t
         {
+            return static_cast<uint32_t>(m_recordingPools[0].size());
         }
 
         [[nodiscard]] auto getGraphicsCmdBuffer(size_t index) const -> vk::raii::CommandBuffer const&
@@ -105,5 +128,16 @@ namespace renderer::backend
         vk::raii::CommandPool m_transferCommandPool { nullptr };
 
         std::vector<vk::raii::CommandBuffer> m_graphicsCommandBuffers {};
+
+        struct RecordingPool
+        {
+            vk::raii::CommandPool pool { nullptr };
+
+            // Allocated on demand and kept across resets, the first `usedCount` are handed out this frame
+            std::vector<vk::raii::CommandBuffer> buffers;
+            size_t usedCount { 0 };
+        };
+
+        std::array<std::vector<RecordingPool>, kMaxFramesInFlight> m_recordingPools {};
     };
 }  // namespace renderer::backend
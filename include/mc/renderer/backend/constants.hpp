@@ -6,7 +6,14 @@
 
 namespace renderer::backend
 {
-    constexpr uint32_t kNumFramesInFlight         = 2;
+    // Frame slots every per-frame resource is allocated for, how many of them are in use is set at runtime
+    constexpr uint32_t kMaxFramesInFlight     = 4;
+    constexpr uint32_t kDefaultFramesInFlight = 2;
+
+    constexpr vk::Format kDrawImageFormat         = vk::Format::eR16G16B16A16Sfloat;
     constexpr vk::Format kDepthStencilFormat      = vk::Format::eD32Sfloat;
     constexpr vk::SampleCountFlagBits kMaxSamples = vk::SampleCountFlagBits::e4;
+
+    // Per frame in flight, of RendererBackend's uniform ring
+    constexpr vk::DeviceSize kUniformRingFrameCapacity = 64 * 1024;
 }  // namespace renderer::backend
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "timeline.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace renderer::backend
+{
+    // Keeps resources replaced at runtime alive until the GPU is done with them, instead of waiting for the
+    // device to go idle before replacing them.
+    //
+    // A retired resource is tagged with the latest value submitted on the timeline and destroyed by the
+    // first collect() after that value has been reached. Anything movable can be retired, e.g. a GPUBuffer,
+    // an Image, a pipeline, a descriptor pool or a swapchain.
+    class DeletionQueue
+    {
+    public:
+        DeletionQueue() = default;
+
+        explicit DeletionQueue(Timeline const& timeline) : m_timeline { &timeline } {}
+
+        DeletionQueue(DeletionQueue const&)                    = delete;
+        auto operator=(DeletionQueue const&) -> DeletionQueue& = delete;
+
+        DeletionQueue(DeletionQueue&&)                    = default;
+        auto operator=(DeletionQueue&&) -> DeletionQueue& = default;
+
+        // Only for resources the commands still being recorded don't reference, every submission that may
+        // use them has to have been made already
+        template <typename T>
+        void retire(T&& resource)
+        {
+            using Resource = std::remove_cvref_t<T>;
+
+            m_entries.push_back({
+                .value    = m_timeline->getSubmittedValue(),
+                .resource = { new Resource(std::forward<T>(resource)),
+                              [](void* retired) { delete static_cast<Resource*>(retired); } },
+            });
+        }
+
+        // Destroys every resource whose submissions have completed
+        void collect();
+
+        [[nodiscard]] auto size() const -> size_t { return m_entries.size(); }
+
+    private:
+        struct Entry
+        {
+            uint64_t value;
+            std::unique_ptr<void, void (*)(void*)> resource;
+        };
+
+        Timeline const* m_timeline { nullptr };
+
+        // Ordered by value, the timeline only ever advances
+        std::deque<Entry> m_entries;
+    };
+}  // namespace renderer::backend
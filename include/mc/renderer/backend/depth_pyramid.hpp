@@ -0,0 +1,86 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "deletion_queue.hpp"
+#include "descriptor.hpp"
+#include "device.hpp"
+#include "image.hpp"
+#include "pipeline.hpp"
+
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    // Mip chain of the resolved depth buffer in which every texel holds the farthest depth under it, for
+    // occlusion culling. With reverse Z the far plane is at 0, so farthest means smallest.
+    //
+    // Level 0 is the depth buffer's extent rounded down to powers of two. Each level is reduced from the one
+    // above by depth_reduce.comp through a min reduction sampler, one bilinear fetch covers 2x2 texels. The
+    // culling pass samples the pyramid through the same sampler.
+    class DepthPyramid
+    {
+    public:
+        DepthPyramid() = default;
+
+        // The levels are created by the first resize
+        DepthPyramid(Device const& device, Allocator const& allocator);
+
+        DepthPyramid(DepthPyramid const&)                    = delete;
+        auto operator=(DepthPyramid const&) -> DepthPyramid& = delete;
+
+        DepthPyramid(DepthPyramid&&)                    = default;
+        auto operator=(DepthPyramid&&) -> DepthPyramid& = default;
+
+        // Follows a new depth image, single sampled and the min resolve of the depth attachment. The current
+        // levels and their descriptor sets are retired, frames in flight may still build or sample them.
+        void resize(vk::ImageView depthView, vk::Extent2D depthExtent, DeletionQueue& deletionQueue);
+
+        // Moves a newly created pyramid out of eUndefined, culling passes that don't sample it still bind it.
+        // Does nothing once that happened.
+        void recordInitialLayout(vk::CommandBuffer commandBuffer);
+
+        // Reduces the depth image, which has to be in eShaderReadOnlyOptimal, into every level. Leaves the
+        // pyramid in eGeneral, ready to be sampled by compute shaders.
+        void recordBuild(vk::CommandBuffer commandBuffer) const;
+
+        [[nodiscard]] auto getExtent() const -> vk::Extent2D { return m_image.getDimensions(); }
+
+        // Binding 0 holds the whole pyramid as a combined image sampler, visible to compute shaders
+        [[nodiscard]] auto getSamplingLayout() const -> vk::DescriptorSetLayout { return m_samplingLayout; }
+
+        [[nodiscard]] auto getSamplingSet() const -> vk::DescriptorSet { return m_samplingSet; }
+
+        // Rebuilt in place by RendererBackend when depth_reduce.comp changes
+        [[nodiscard]] auto getReducePipeline() -> ComputePipeline& { return m_reducePipeline; }
+
+    private:
+        void createLevels(vk::ImageView depthView, vk::Extent2D depthExtent);
+
+        void recordLayoutBarrier(vk::CommandBuffer commandBuffer) const;
+
+        Device const* m_device { nullptr };
+        Allocator const* m_allocator { nullptr };
+
+        vk::raii::Sampler m_sampler { nullptr };
+
+        vk::raii::DescriptorSetLayout m_reduceLayout { nullptr };
+        vk::raii::DescriptorSetLayout m_samplingLayout { nullptr };
+
+        PipelineLayout m_reducePipelineLayout;
+        ComputePipeline m_reducePipeline;
+
+        Image m_image;
+
+        // Single level views, written as storage images
+        std::vector<vk::raii::ImageView> m_levelViews;
+
+        bool m_initialLayoutPending { true };
+
+        // Sets point at the level views and the depth image, they are recreated with them
+        DescriptorAllocator m_descriptorAllocator;
+        std::vector<vk::DescriptorSet> m_reduceSets;
+        vk::DescriptorSet m_samplingSet { nullptr };
+    };
+}  // namespace renderer::backend
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "instance.hpp"
+#include "pipeline_cache.hpp"
+#include "shader_manager.hpp"
 
 #include <cstdint>
+#include <vector>
 
 #include <vulkan/vulkan_raii.hpp>
 
@@ -23,7 +26,9 @@ namespace renderer::backend
         Device()  = default;
         ~Device() = default;
 
-        explicit Device(Instance& instance, Surface& surface);
+        // Without a surface nothing is presented, the swapchain extension isn't required and the present
+        // queue is the graphics queue
+        explicit Device(Instance& instance, Surface* surface);
 
         Device(Device const&)                    = delete;
         auto operator=(Device const&) -> Device& = delete;
@@ -71,19 +76,55 @@ namespace renderer::backend
             return m_sampleCount;
         };
 
+        // Optional in Vulkan 1.2, without it indirect draws go over the whole command range
+        [[nodiscard]] auto isDrawIndirectCountSupported() const -> bool
+        {
+            return m_drawIndirectCountSupported;
+        }
+
+        // Common on desktop GPUs but not on many mobile ones, without it block-compressed textures are
+        // uploaded as decoded RGBA8
+        [[nodiscard]] auto isTextureCompressionBCSupported() const -> bool
+        {
+            return m_textureCompressionBCSupported;
+        }
+
+        // Min reduction samplers and min depth resolves, which the depth pyramid is built with. Without them
+        // meshlets are only culled against the frustum and their normal cones.
+        [[nodiscard]] auto isOcclusionCullingSupported() const -> bool
+        {
+            return m_occlusionCullingSupported;
+        }
+
+        // Shared by every pipeline, saved by RendererBackend once the device is idle at shutdown
+        [[nodiscard]] auto getPipelineCache() const -> PipelineCache const& { return m_pipelineCache; }
+
+        // Compiles the shaders every pipeline is built from, thread safe
+        [[nodiscard]] auto getShaderManager() const -> ShaderManager const& { return m_shaderManager; }
+
     private:
-        void selectPhysicalDevice(Instance& instance, Surface& surface);
+        void selectPhysicalDevice(Instance& instance, Surface* surface);
         void selectLogicalDevice();
 
         vk::raii::Device m_logicalHandle { nullptr };
         vk::raii::PhysicalDevice m_physicalHandle { nullptr };
 
+        std::vector<char const*> m_extensions;
+
         vk::SampleCountFlagBits m_sampleCount { vk::SampleCountFlagBits::e1 };
 
+        bool m_drawIndirectCountSupported { false };
+        bool m_textureCompressionBCSupported { false };
+        bool m_occlusionCullingSupported { false };
+
         QueueFamilyIndices m_queueFamilyIndices {};
 
         vk::raii::Queue m_graphicsQueue { nullptr };
         vk::raii::Queue m_presentQueue { nullptr };
         vk::raii::Queue m_transferQueue { nullptr };
+
+        PipelineCache m_pipelineCache;
+
+        ShaderManager m_shaderManager;
     };
 }  // namespace renderer::backend
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/ext/vector_float4.hpp>
+
+namespace renderer::backend
+{
+    class SceneGraph;
+    struct SceneDraw;
+
+    // Culls a scene's draws against the view frustum on the CPU, before meshlet_cull.comp looks at their
+    // meshlets.
+    //
+    // World space bounding spheres are kept as a structure of arrays and tested eight at a time with AVX2.
+    // The arrays are padded to whole visibility words with spheres that never pass.
+    class FrustumCuller
+    {
+    public:
+        FrustumCuller() = default;
+
+        FrustumCuller(std::span<SceneDraw const> draws, SceneGraph const& sceneGraph);
+
+        // Moves the spheres along with their nodes, whenever the scene graph changed a world matrix
+        void updateBounds(std::span<SceneDraw const> draws, SceneGraph const& sceneGraph);
+
+        // Writes one bit per draw into `visibility`, which holds getVisibilityWordCount() words. Planes are
+        // world space with normals pointing inwards, see GPUCullData. Returns the number of visible draws.
+        auto cull(std::array<glm::vec4, 6> const& planes, std::span<uint32_t> visibility) const -> uint32_t;
+
+        [[nodiscard]] auto getDrawCount() const -> uint32_t { return m_drawCount; }
+
+        [[nodiscard]] auto getVisibilityWordCount() const -> uint32_t
+        {
+            return static_cast<uint32_t>(m_radii.size() / 32);
+        }
+
+    private:
+        uint32_t m_drawCount { 0 };
+
+        std::vector<float> m_centersX;
+        std::vector<float> m_centersY;
+        std::vector<float> m_centersZ;
+        std::vector<float> m_radii;
+    };
+}  // namespace renderer::backend
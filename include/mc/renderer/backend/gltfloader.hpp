@@ -1,12 +1,29 @@
 #pragma once
 
 #include "buffer.hpp"
-#include "descriptor.hpp"
+#include "constants.hpp"
+#include "frustum_culler.hpp"
 #include "image.hpp"
+#include "render_queue.hpp"
+#include "scene_graph.hpp"
+#include "texture_loader.hpp"
+#include "upload_manager.hpp"
 
+#include <mc/mapped_file.hpp>
+
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <limits>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fastgltf/parser.hpp>
+#include <fastgltf/types.hpp>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <glm/ext/vector_float4.hpp>
-#include <tiny_gltf.h>
 
 namespace renderer::backend
 {
@@ -19,8 +36,30 @@ namespace renderer::backend
         EmissiveTexture         = 1 << 4,
         TangentVertexAttribute  = 1 << 5,
         TexcoordVertexAttribute = 1 << 6,
+        DoubleSided             = 1 << 7,
+        AlphaBlend              = 1 << 8,
     };
 
+    // The MaterialFeatures fs.frag is specialized on, one pipeline per combination a scene uses. Features the
+    // shader doesn't read stay out, they would only multiply identical permutations.
+    constexpr uint32_t kSpecializedMaterialFeatures = std::to_underlying(MaterialFeatures::ColorTexture);
+
+    // Specialization of the uber-shader, which branches on Material::flags instead
+    constexpr uint32_t kUberMaterialFeatures = std::numeric_limits<uint32_t>::max();
+
+    // Every permutation with both index types in both draw passes, mirrored in meshlet_cull.comp
+    constexpr uint32_t kMaxCommandRanges = 8;
+
+    static_assert((4u << std::popcount(kSpecializedMaterialFeatures)) <= kMaxCommandRanges);
+
+    constexpr uint32_t kMaterialTextureCount = 5;
+    constexpr uint32_t kNoImage              = std::numeric_limits<uint32_t>::max();
+
+    // Image index per material texture (color, roughness, occlusion, emissive, normal), kNoImage for the
+    // unused ones
+    using MaterialTextures = std::array<uint32_t, kMaterialTextureCount>;
+
+    // Mirrored by the Material struct in shaders/draw.glsl
     struct alignas(16) Material
     {
         glm::vec4 baseColorFactor;
@@ -31,18 +70,20 @@ namespace renderer::backend
         float roughnessFactor;
         float occlusionFactor;
         uint32_t flags;
-        uint32_t pad;
+
+        // BindlessTextures slot per MaterialTextures entry, filled in by uploadScene. Unused ones point at
+        // the dummy texture.
+        std::array<uint32_t, kMaterialTextureCount> textures;
     };
 
-    struct MaterialRenderInfo
-    {
-        uint32_t baseColorTextureIndex;
-        uint32_t normalTextureIndex;
-        uint32_t roughnessTextureIndex;
-        uint32_t occlusionTextureIndex;
-        uint32_t emissiveTextureIndex;
+    static_assert(sizeof(Material) == 64);
 
-        vk::DescriptorSet descriptorSet;
+    // Layout of a scene's vertex buffer, picked at import time and selected in vs.vert with a
+    // specialization constant
+    enum class VertexFormat : uint32_t
+    {
+        Float,
+        Quantized,
     };
 
     struct alignas(16) Vertex
@@ -54,72 +95,276 @@ namespace renderer::backend
         glm::vec4 tangent;
     };
 
+    // 20 byte counterpart of Vertex, decoded in vs.vert:
+    //  - position as unorm16 relative to the owning primitive's bounds
+    //  - normal and tangent octahedral-encoded as snorm16x2, the bitangent sign shares a word with position.z
+    //  - uv as half floats
+    struct QuantizedVertex
+    {
+        uint32_t positionXY;
+        uint32_t positionZTangentSign;
+        uint32_t normal;
+        uint32_t tangent;
+        uint32_t uv;
+    };
+
+    static_assert(sizeof(QuantizedVertex) == 20);
+
+    constexpr uint32_t kMeshletMaxVertices  = 64;
+    constexpr uint32_t kMeshletMaxTriangles = 124;
+
+    // Contiguous run of a primitive's triangles, the unit meshlet_cull.comp culls at
+    struct alignas(16) Meshlet
+    {
+        // Object space bounding sphere
+        glm::vec3 center;
+        float radius;
+
+        // Every triangle faces away from any eye for which
+        // dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius.
+        // A cutoff of 1 disables the test.
+        glm::vec3 coneAxis;
+        float coneCutoff;
+
+        // Relative to the owning primitive's first index
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t pad[2];
+    };
+
     struct Primitive
     {
+        // Into the index pool matching `indexType`
         uint32_t firstIndex;
         uint32_t indexCount;
         uint32_t materialIndex;
+
+        // Indices are relative to `firstVertex`, which is passed as the draw's vertexOffset. Quantization is
+        // relative to this range as well.
+        uint32_t firstVertex;
+        uint32_t vertexCount;
+
+        // eUint16 whenever the vertex range fits
+        vk::IndexType indexType;
+
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+
+        // Object space. The sphere is centered on the box and encloses every vertex, which is usually
+        // tighter than the box's own bounding sphere.
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        glm::vec3 sphereCenter;
+        float sphereRadius;
     };
 
-    struct Mesh
+    struct GltfImage
     {
+        // Null until the texture loader has streamed it in
+        Texture texture;
+
+        // Points at the dummy texture until the texture has landed
+        uint32_t bindlessSlot { 0 };
+    };
+
+    struct SceneNode
+    {
+        glm::mat4 transform;
+
+        // Parents always come before their children, roots have -1
+        int32_t parent;
+
+        uint32_t firstPrimitive;
+        uint32_t primitiveCount;
+        uint32_t pad;
+    };
+
+    // Where an image's encoded bytes live, either a file on disk or a copy of the embedded data
+    struct SceneImageSource
+    {
+        std::string name;
+
+        std::filesystem::path path;
+        size_t offset { 0 };
+
+        std::vector<std::byte> encoded;
+    };
+
+    // Read-only view of a scene, shared by freshly imported scenes and mapped scene caches
+    struct SceneView
+    {
+        // Only the span matching the format is populated
+        VertexFormat vertexFormat;
+        std::span<Vertex const> vertices;
+        std::span<QuantizedVertex const> quantizedVertices;
+
+        // Index pools, see Primitive::indexType
+        std::span<uint16_t const> shortIndices;
+        std::span<uint32_t const> indices;
+        std::span<Primitive const> primitives;
+        std::span<Meshlet const> meshlets;
+        std::span<SceneNode const> nodes;
+        std::span<Material const> materials;
+        std::span<MaterialTextures const> materialTextures;
+
+        size_t imageCount;
+    };
+
+    // CPU side of an imported glTF scene, everything but the image pixels is already in its GPU layout
+    struct SceneData
+    {
+        VertexFormat vertexFormat { VertexFormat::Float };
+        std::vector<Vertex> vertices;
+        std::vector<QuantizedVertex> quantizedVertices;
+
+        std::vector<uint16_t> shortIndices;
+        std::vector<uint32_t> indices;
         std::vector<Primitive> primitives;
+        std::vector<Meshlet> meshlets;
+        std::vector<SceneNode> nodes;
+        std::vector<Material> materials;
+        std::vector<MaterialTextures> materialTextures;
+        std::vector<SceneImageSource> images;
+
+        // External files the scene was built from, relative to the glTF file's directory
+        std::vector<std::filesystem::path> dependencies;
+
+        [[nodiscard]] auto getView() const -> SceneView
+        {
+            return {
+                .vertexFormat      = vertexFormat,
+                .vertices          = vertices,
+                .quantizedVertices = quantizedVertices,
+                .shortIndices      = shortIndices,
+                .indices           = indices,
+                .primitives        = primitives,
+                .meshlets          = meshlets,
+                .nodes             = nodes,
+                .materials         = materials,
+                .materialTextures  = materialTextures,
+                .imageCount        = images.size(),
+            };
+        }
     };
 
-    struct GltfNode
+    // Parses a .gltf/.glb into GPU-ready geometry, nodes and materials. Images are only located, not decoded.
+    auto importGltf(std::filesystem::path const& path, VertexFormat vertexFormat) -> SceneData;
+
+    // Decodes to RGBA8, mip 0 only. Safe to call from worker threads.
+    auto decodeImage(SceneImageSource const& source) -> DecodedImage;
+
+    // Resolves every buffer of a glTF asset to bytes that can be read in place: external .bin files are
+    // memory-mapped, the GLB binary chunk is used straight out of the mapped .glb and base64 data URIs point
+    // at fastgltf's decoded copy. Also serves as the buffer data adapter for fastgltf's accessor tools, so
+    // accessors are read directly out of the mappings without an intermediate std::vector.
+    class GltfBufferMappings
     {
-        GltfNode* parent;
-        std::vector<GltfNode*> children;
-        Mesh mesh;
-        glm::mat4 transformation;
+    public:
+        GltfBufferMappings(fastgltf::Asset const& asset, std::filesystem::path const& directory);
 
-        ~GltfNode()
+        [[nodiscard]] auto getBytes(size_t bufferIndex) const -> std::span<std::byte const>
         {
-            for (auto& child : children)
-            {
-                delete child;
-            }
+            return m_buffers[bufferIndex];
         }
+
+        [[nodiscard]] auto getBufferViewBytes(size_t bufferViewIndex) const -> std::span<std::byte const>;
+
+        // Total amount of buffer data backing the asset
+        [[nodiscard]] auto getMappedSize() const -> size_t;
+
+        auto operator()(fastgltf::Buffer const& buffer) const -> std::byte const*;
+
+    private:
+        fastgltf::Asset const* m_asset { nullptr };
+
+        std::vector<utils::MappedFile> m_files;
+        std::vector<std::span<std::byte const>> m_buffers;
     };
 
-    struct GltfImage
+    // CPU side copy of a scene's draw table, the GPU only sees its MeshletDraws
+    struct SceneDraw
     {
-        Texture texture;
+        // Into SceneResources::sceneGraph
+        uint32_t nodeIndex;
+        Primitive primitive;
+
+        // The draw's meshlet instances are contiguous, one per meshlet of the primitive
+        uint32_t firstMeshletInstance;
+
+        // From the material's alpha mode
+        DrawPass pass;
+
+        // Into SceneResources::commandRanges
+        uint32_t commandRange;
     };
 
-    struct GltfTexture
+    // Part of the indirect command buffers holding the meshlet draws of one pipeline permutation, index type
+    // and draw pass, drawn with a single multi-draw
+    struct CommandRange
     {
-        uint32_t imageIndex;
+        // Specialization of the range's pipeline, a subset of kSpecializedMaterialFeatures
+        uint32_t materialFeatures;
+        vk::IndexType indexType;
+
+        // Blended ranges come after all opaque ones and are drawn with blending on and depth writes off
+        DrawPass pass;
+
+        uint32_t firstCommand;
+
+        // Meshlet instances of the range's draws, the most commands it can receive
+        uint32_t commandCount;
     };
 
     struct SceneResources
     {
+        VertexFormat vertexFormat { VertexFormat::Float };
         GPUBuffer vertexBuffer;
+
+        // 16-bit pool first, the 32-bit one starts at wideIndexOffset
         GPUBuffer indexBuffer;
+        vk::DeviceSize wideIndexOffset { 0 };
 
-        // materialBuffer is a dedicated buffer on the GPU
-        // hostMaterialBuffer is the staging buffer that gets copied to the one on the GPU whenever a change is requested
+        // materialBuffer is a dedicated buffer on the GPU, changes would go through the upload manager
         // TODO(aether) this is, for the moment, immutable
         GPUBuffer materialBuffer;
-        GPUBuffer hostMaterialBuffer;
-        bool materialBufferDirty = false;
 
         size_t indexCount;
 
         std::vector<GltfImage> images;
-        std::vector<GltfTexture> textures;
-        std::vector<MaterialRenderInfo> materialRenderInfos;
 
-        std::vector<GltfNode*> nodes;
+        SceneGraph sceneGraph;
+        std::vector<SceneDraw> draws;
 
-        DescriptorAllocator descriptorAllocator;
+        // Bounding spheres of draws, culled on the CPU first into one visibility bit per draw
+        FrustumCuller frustumCuller;
+        std::vector<uint32_t> drawVisibility;
 
-        ~SceneResources()
-        {
-            for (auto node : nodes)
-            {
-                delete node;
-            }
-        };
+        // Visible draws sorted by DrawKey. Their meshlet instances go to the GPU in that order, as the list
+        // of instances meshlet_cull.comp looks at. Opaque commands are compacted by atomics and only loosely
+        // keep it, blended instances are grouped by command range and keep their slot, so each blended range
+        // is drawn back to front. Host visible, one per frame in flight.
+        RenderQueue renderQueue;
+        std::array<GPUBuffer, kMaxFramesInFlight> instanceOrderBuffers;
+        uint32_t queuedInstanceCount { 0 };
+
+        // Where each blended range's instances start in the instance order buffer
+        std::array<uint32_t, kMaxCommandRanges> firstQueuedInstances {};
+
+        // Inputs and output of meshlet_cull.comp, one instance per meshlet per draw. Visible instances are
+        // compacted into the indirect commands of their cull phase, into the command range of their draw.
+        GPUBuffer meshletBuffer;
+        GPUBuffer meshletDrawBuffer;
+        GPUBuffer meshletInstanceBuffer;
+        std::array<GPUBuffer, 2> indirectCommandBuffers;
+
+        // One flag per meshlet instance, whether the late phase found it visible in the previous frame
+        GPUBuffer meshletVisibilityBuffer;
+        uint32_t meshletInstanceCount { 0 };
+
+        // Ordered by draw pass, then material features, then index type
+        std::vector<CommandRange> commandRanges;
+
+        // Nothing above may be drawn with before the upload manager reports this ready
+        UploadTicket uploadTicket {};
     };
 }  // namespace renderer::backend
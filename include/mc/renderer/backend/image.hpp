@@ -5,6 +5,7 @@
 #include "device.hpp"
 #include "mc/asserts.hpp"
 
+#include <span>
 #include <string>
 #include <string_view>
 
@@ -14,6 +15,16 @@
 
 namespace renderer::backend
 {
+    // Levels of a full mip chain down to 1x1
+    [[nodiscard]] auto getMipLevelCount(vk::Extent2D dimensions) -> uint32_t;
+
+    // BCn formats store 4x4 texel blocks
+    [[nodiscard]] auto isBlockCompressed(vk::Format format) -> bool;
+
+    // Tightly packed size of one layer of one mip level, `dimensions` being the level's own extent. Only
+    // defined for the formats textures can be loaded in: RGBA8/BGRA8 and BC1-BC5, BC7.
+    [[nodiscard]] auto getImageLevelSize(vk::Format format, vk::Extent2D dimensions) -> vk::DeviceSize;
+
     class StbiImage
     {
     public:
@@ -73,7 +84,9 @@ namespace renderer::backend
               vk::SampleCountFlagBits sampleCount,
               vk::ImageUsageFlags usageFlags,
               vk::ImageAspectFlags aspectFlags,
-              uint32_t mipLevels = 1);
+              uint32_t mipLevels              = 1,
+              uint32_t arrayLayers            = 1,
+              vk::ComponentMapping components = {});
 
         ~Image();
 
@@ -91,6 +104,8 @@ namespace renderer::backend
             std::swap(m_usageFlags, other.m_usageFlags);
             std::swap(m_aspectFlags, other.m_aspectFlags);
             std::swap(m_mipLevels, other.m_mipLevels);
+            std::swap(m_arrayLayers, other.m_arrayLayers);
+            std::swap(m_components, other.m_components);
             std::swap(m_dimensions, other.m_dimensions);
 
             m_imageView = std::move(other.m_imageView);
@@ -113,6 +128,8 @@ namespace renderer::backend
             m_usageFlags  = std::exchange(other.m_usageFlags, {});
             m_aspectFlags = std::exchange(other.m_aspectFlags, {});
             m_mipLevels   = std::exchange(other.m_mipLevels, {});
+            m_arrayLayers = std::exchange(other.m_arrayLayers, {});
+            m_components  = std::exchange(other.m_components, {});
             m_dimensions  = std::exchange(other.m_dimensions, {});
 
             m_imageView = std::move(other.m_imageView);
@@ -143,22 +160,39 @@ namespace renderer::backend
 
         [[nodiscard]] auto getMipLevels() const -> uint32_t { return m_mipLevels; }
 
+        [[nodiscard]] auto getArrayLayers() const -> uint32_t { return m_arrayLayers; }
+
         [[nodiscard]] auto getFormat() const -> vk::Format { return m_format; }
 
         void copyTo(vk::CommandBuffer cmdBuf, vk::Image dst, vk::Extent2D dstSize, vk::Extent2D offset);
         void resolveTo(vk::CommandBuffer cmdBuf, vk::Image dst, vk::Extent2D dstSize, vk::Extent2D offset);
 
+        // Scales all of `src`, in eTransferSrcOptimal, onto all of `dst`, in eTransferDstOptimal
+        static void blit(vk::CommandBuffer cmdBuf,
+                         vk::Image src,
+                         vk::Extent2D srcSize,
+                         vk::Image dst,
+                         vk::Extent2D dstSize);
+
         static void transition(vk::CommandBuffer cmdBuf,
                                vk::Image image,
                                vk::ImageLayout currentLayout,
                                vk::ImageLayout newLayout);
 
-        void resize(VkExtent2D dimensions)
+        // A new image like this one at another size. This one stays valid, frames in flight may still use
+        // it, so it has to be retired rather than destroyed.
+        [[nodiscard]] auto resized(vk::Extent2D dimensions) const -> Image
         {
-            m_dimensions = dimensions;
-
-            destroy();
-            create();
+            return { *m_device,
+                     *m_allocator,
+                     dimensions,
+                     m_format,
+                     m_sampleCount,
+                     m_usageFlags,
+                     m_aspectFlags,
+                     m_mipLevels,
+                     m_arrayLayers,
+                     m_components };
         }
 
     private:
@@ -167,9 +201,15 @@ namespace renderer::backend
                          vk::ImageUsageFlags usage,
                          vk::MemoryPropertyFlags properties,
                          uint32_t mipLevels,
+                         uint32_t arrayLayers,
                          vk::SampleCountFlagBits numSamples);
 
-        void createImageView(vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels);
+        // Images with more than one layer get a 2D array view
+        void createImageView(vk::Format format,
+                             vk::ImageAspectFlags aspectFlags,
+                             uint32_t mipLevels,
+                             uint32_t arrayLayers,
+                             vk::ComponentMapping components);
 
         void create();
         void destroy();
@@ -187,6 +227,10 @@ namespace renderer::backend
         vk::ImageAspectFlags m_aspectFlags;
 
         uint32_t m_mipLevels;
+        uint32_t m_arrayLayers { 1 };
+
+        // Swizzle of the view, e.g. to put channels packed into BC5 back where the shaders read them
+        vk::ComponentMapping m_components {};
 
         vk::Extent2D m_dimensions;
     };
@@ -197,17 +241,19 @@ namespace renderer::backend
         Texture()  = default;
         ~Texture() = default;
 
-        Texture(Device& device,
-                Allocator& allocator,
-                CommandManager& commandManager,
-                StbiImage const& stbiImage);
+        // Creates the RGBA8 image and its full mip chain without any contents, fill it with
+        // UploadManager::uploadTexture()
+        Texture(Device& device, Allocator& allocator, vk::Extent2D dimensions);
 
+        // Same for any format and an explicit level and layer count, e.g. the BCn mip chains of DDS and
+        // KTX2 files or baked scene textures
         Texture(Device& device,
                 Allocator& allocator,
-                CommandManager& commandManager,
                 vk::Extent2D dimensions,
-                void* data,
-                size_t dataSize);
+                vk::Format format,
+                uint32_t mipLevels,
+                uint32_t arrayLayers,
+                vk::ComponentMapping components = {});
 
         Texture(Texture const&)                    = delete;
         auto operator=(Texture const&) -> Texture& = delete;
@@ -225,16 +271,30 @@ namespace renderer::backend
 
         [[nodiscard]] auto getImage() const -> Image const& { return m_image; }
 
+        // Copies either mip 0 or, when `providedMipLevels` covers the whole chain, every level from
+        // `staging`. Levels are tightly packed one after another with every layer of a level back to back,
+        // unless `subresourceOffsets` gives each (level, layer) its own offset relative to `stagingOffset`,
+        // indexed by level * layers + layer. Block-compressed images can't be blitted and have to come with
+        // every level. Only uses transfer commands and leaves the whole image in eTransferDstOptimal.
+        void recordCopy(vk::CommandBuffer commandBuffer,
+                        vk::Buffer staging,
+                        vk::DeviceSize stagingOffset,
+                        uint32_t providedMipLevels                        = 1,
+                        std::span<vk::DeviceSize const> subresourceOffsets = {}) const;
+
+        // Blits the chain down from mip 0, which has to be in eTransferDstOptimal like the other levels.
+        // Needs a graphics queue, every level ends up in eShaderReadOnlyOptimal.
+        static void generateMipmaps(Device const& device,
+                                    vk::CommandBuffer commandBuffer,
+                                    vk::Image image,
+                                    vk::Extent2D dimensions,
+                                    vk::Format imageFormat,
+                                    uint32_t mipLevels,
+                                    uint32_t arrayLayers);
+
     private:
         Device* m_device { nullptr };
         Allocator* m_allocator { nullptr };
-        CommandManager* m_commandManager { nullptr };
-
-        void generateMipmaps(ScopedCommandBuffer& commandBuffer,
-                             vk::Image image,
-                             vk::Extent2D dimensions,
-                             vk::Format imageFormat,
-                             uint32_t mipLevels);
 
         std::string m_path;
 
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    // All take RGBA half floats in linear color, rows top to bottom and tightly packed like the readback of
+    // a kDrawImageFormat image. Failures are logged, a frame that can't be written isn't worth stopping for.
+
+    // 8 bit sRGB, values outside [0, 1] are clamped
+    void writePng(std::filesystem::path const& path, vk::Extent2D extent, std::span<uint16_t const> pixels);
+
+    // Uncompressed scanline OpenEXR, keeps the values as they are
+    void writeExr(std::filesystem::path const& path, vk::Extent2D extent, std::span<uint16_t const> pixels);
+
+    struct ImageDifference
+    {
+        uint64_t pixelCount { 0 };
+
+        // Pixels with a channel further off than the tolerance
+        uint64_t differingPixelCount { 0 };
+
+        // Largest difference of any channel
+        uint8_t maxDifference { 0 };
+    };
+
+    // Compares the pixels, stored the way writePng would, with a PNG written by it. Channels up to
+    // `tolerance` apart count as equal. Logs and returns nothing when the reference can't be read or has a
+    // different size.
+    [[nodiscard]] auto compareWithPng(std::filesystem::path const& reference,
+                                      vk::Extent2D extent,
+                                      std::span<uint16_t const> pixels,
+                                      uint8_t tolerance) -> std::optional<ImageDifference>;
+}  // namespace renderer::backend
@@ -7,7 +7,9 @@ namespace renderer::backend
     class Instance
     {
     public:
-        Instance();
+        // Without `presenting` the surface extensions GLFW asks for are left out, nothing can be presented
+        // and GLFW doesn't have to be initialized
+        explicit Instance(bool presenting = true);
         ~Instance() = default;
 
         Instance(Instance const&) = delete;
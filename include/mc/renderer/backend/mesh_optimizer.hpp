@@ -0,0 +1,66 @@
+#pragma once
+
+#include "gltfloader.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace renderer::backend
+{
+    // FIFO post-transform cache size the optimizer targets and statistics are simulated with. Small enough to
+    // not thrash on hardware with bigger (or LRU-like) caches.
+    constexpr uint32_t kVertexCacheSize = 16;
+
+    struct VertexCacheStats
+    {
+        uint32_t triangleCount { 0 };
+        uint32_t vertexCount { 0 };
+
+        // Cache misses, i.e. vertex shader invocations
+        uint32_t transformCount { 0 };
+
+        // Average cache miss ratio, transforms per triangle. 0.5 is the lower bound for large meshes, 3 the
+        // upper one.
+        [[nodiscard]] auto getAcmr() const -> double
+        {
+            return triangleCount > 0 ? static_cast<double>(transformCount) / triangleCount : 0.0;
+        }
+
+        // Average transform to vertex ratio, 1 means every vertex is transformed exactly once
+        [[nodiscard]] auto getAtvr() const -> double
+        {
+            return vertexCount > 0 ? static_cast<double>(transformCount) / vertexCount : 0.0;
+        }
+
+        auto operator+=(VertexCacheStats const& other) -> VertexCacheStats&
+        {
+            triangleCount += other.triangleCount;
+            vertexCount += other.vertexCount;
+            transformCount += other.transformCount;
+
+            return *this;
+        }
+    };
+
+    // Simulates a FIFO cache of `cacheSize` entries over a triangle list. `vertexCount` only counts vertices
+    // that are actually referenced.
+    auto analyzeVertexCache(std::span<uint32_t const> indices,
+                            size_t vertexCount,
+                            uint32_t cacheSize = kVertexCacheSize) -> VertexCacheStats;
+
+    // Optimizes a single triangle list in place, `indices` are relative to `vertices`:
+    //  1. bitwise identical vertices are merged
+    //  2. triangles are reordered for the post-transform cache with Tipsify
+    //  3. the resulting clusters are sorted so that outward facing ones on the mesh's hull are drawn first,
+    //     which reduces overdraw from any viewpoint
+    //  4. vertices are reordered by first use for fetch locality, unreferenced ones are dropped
+    void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+    // Greedily splits a triangle list into runs of at most kMeshletMaxVertices unique vertices and
+    // kMeshletMaxTriangles triangles, keeping the triangle order. Normal cones are disabled for double sided
+    // geometry, which has no back faces to cull.
+    auto buildMeshlets(std::span<Vertex const> vertices,
+                       std::span<uint32_t const> indices,
+                       bool doubleSided) -> std::vector<Meshlet>;
+}  // namespace renderer::backend
@@ -14,6 +14,7 @@ namespace renderer::backend
 {
     struct ShaderInfo
     {
+        // Source name relative to the shader directory, see ShaderManager
         std::filesystem::path path;
         vk::ShaderStageFlagBits stage;
         std::string entryPoint;
@@ -23,7 +24,7 @@ namespace renderer::backend
     {
     public:
         auto setPushConstantSettings(uint32_t size,
-                                     vk::ShaderStageFlagBits shaderStage) -> PipelineLayoutConfig&;
+                                     vk::ShaderStageFlags shaderStages) -> PipelineLayoutConfig&;
 
         auto
         setDescriptorSetLayouts(std::vector<vk::DescriptorSetLayout> const& layout) -> PipelineLayoutConfig&;
@@ -89,9 +90,15 @@ namespace renderer::backend
 
         auto setDepthAttachmentFormat(vk::Format format) -> GraphicsPipelineConfig&;
 
+        // Applied to every stage, stages that don't declare `constantId` ignore it
+        auto setSpecializationConstant(uint32_t constantId, uint32_t value) -> GraphicsPipelineConfig&;
+
     private:
         std::vector<ShaderInfo> shaders {};
 
+        std::vector<vk::SpecializationMapEntry> specializationEntries {};
+        std::vector<uint32_t> specializationData {};
+
         // Defaults
         // ********
         // Depth testing
@@ -132,6 +139,8 @@ namespace renderer::backend
             vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB |
             vk::ColorComponentFlagBits::eA;
         vk::BlendFactor srcColorBlendFactor = vk::BlendFactor::eOne;  // Additive blending by default
+        vk::BlendFactor dstColorBlendFactor = vk::BlendFactor::eDstAlpha;
+        vk::BlendFactor dstAlphaBlendFactor = vk::BlendFactor::eZero;
 
         // Dynamic rendering
         std::optional<vk::Format> colorAttachmentFormat;
@@ -197,8 +206,21 @@ namespace renderer::backend
 
         [[nodiscard]] auto get() const -> vk::Pipeline { return m_pipeline; }
 
+        // Builds a new pipeline from the current shader sources, empty if they don't compile. Doesn't touch
+        // the pipeline in use, so it can run on a worker thread.
+        [[nodiscard]] auto recreate() const -> std::optional<vk::raii::Pipeline>;
+
+        // Swaps in a recreated pipeline and returns the previous one, which the GPU may still be using
+        auto replace(vk::raii::Pipeline pipeline) -> vk::raii::Pipeline;
+
+        [[nodiscard]] auto getShaderNames() const -> std::vector<std::filesystem::path>;
+
     private:
         vk::raii::Pipeline m_pipeline { nullptr };
+
+        Device const* m_device { nullptr };
+        vk::PipelineLayout m_layout { nullptr };
+        GraphicsPipelineConfig m_config;
     };
 
     class ComputePipeline
@@ -209,7 +231,7 @@ namespace renderer::backend
 
         explicit ComputePipeline(Device const& device,
                                  PipelineLayout const& layout,
-                                 std::filesystem::path const& path,
+                                 std::filesystem::path const& name,
                                  std::string_view entryPoint);
 
         ComputePipeline(ComputePipeline const&)                    = delete;
@@ -225,7 +247,18 @@ namespace renderer::backend
 
         [[nodiscard]] auto get() const -> vk::Pipeline { return m_pipeline; }
 
+        // Same as GraphicsPipeline::recreate
+        [[nodiscard]] auto recreate() const -> std::optional<vk::raii::Pipeline>;
+
+        auto replace(vk::raii::Pipeline pipeline) -> vk::raii::Pipeline;
+
+        [[nodiscard]] auto getShaderNames() const -> std::vector<std::filesystem::path>;
+
     private:
         vk::raii::Pipeline m_pipeline { nullptr };
+
+        Device const* m_device { nullptr };
+        vk::PipelineLayout m_layout { nullptr };
+        ShaderInfo m_shader;
     };
 }  // namespace renderer::backend
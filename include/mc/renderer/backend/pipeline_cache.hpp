@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    // Driver pipeline cache persisted between runs, every pipeline is created through it.
+    //
+    // The file name encodes vendor and device ID, driver version and pipelineCacheUUID, so another GPU or a
+    // driver update starts out cold instead of handing the driver foreign data. The header of a loaded file
+    // is checked against the device as well, drivers aren't required to reject mismatching data gracefully.
+    class PipelineCache
+    {
+    public:
+        PipelineCache() = default;
+
+        PipelineCache(vk::raii::Device const& device,
+                      vk::PhysicalDeviceProperties const& properties,
+                      std::filesystem::path const& directory);
+
+        PipelineCache(PipelineCache const&)                    = delete;
+        auto operator=(PipelineCache const&) -> PipelineCache& = delete;
+
+        PipelineCache(PipelineCache&&)                    = default;
+        auto operator=(PipelineCache&&) -> PipelineCache& = default;
+
+        // Written next to the cache file first and renamed over it, a crash mid-write leaves the previous
+        // cache intact
+        void save() const;
+
+        // Whether the cache was loaded from disk
+        [[nodiscard]] auto isWarm() const -> bool { return m_warm; }
+
+        [[nodiscard]] operator vk::PipelineCache() const { return m_cache; }
+
+        [[nodiscard]] auto get() const -> vk::raii::PipelineCache const& { return m_cache; }
+
+    private:
+        vk::raii::PipelineCache m_cache { nullptr };
+
+        std::filesystem::path m_path;
+
+        bool m_warm { false };
+    };
+}  // namespace renderer::backend
@@ -0,0 +1,323 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "deletion_queue.hpp"
+#include "device.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    // How a pass uses an image. The stages and accesses go into the barriers around the pass, the usage
+    // into the images the graph creates.
+    struct ImageAccess
+    {
+        vk::PipelineStageFlags2 stages;
+        vk::AccessFlags2 access;
+        vk::ImageLayout layout;
+        vk::ImageUsageFlags usage;
+    };
+
+    namespace image_access
+    {
+        inline constexpr ImageAccess kColorAttachment {
+            .stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            .access = vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+            .layout = vk::ImageLayout::eColorAttachmentOptimal,
+            .usage  = vk::ImageUsageFlagBits::eColorAttachment,
+        };
+
+        inline constexpr ImageAccess kDepthAttachment {
+            .stages = vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+                      vk::PipelineStageFlagBits2::eLateFragmentTests,
+            .access = vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+                      vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+            .layout = vk::ImageLayout::eDepthAttachmentOptimal,
+            .usage  = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+        };
+
+        // Depth resolves happen in the color attachment output stage
+        inline constexpr ImageAccess kDepthResolve {
+            .stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput |
+                      vk::PipelineStageFlagBits2::eLateFragmentTests,
+            .access = vk::AccessFlagBits2::eColorAttachmentWrite |
+                      vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+            .layout = vk::ImageLayout::eDepthAttachmentOptimal,
+            .usage  = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+        };
+
+        inline constexpr ImageAccess kTransferRead {
+            .stages = vk::PipelineStageFlagBits2::eTransfer,
+            .access = vk::AccessFlagBits2::eTransferRead,
+            .layout = vk::ImageLayout::eTransferSrcOptimal,
+            .usage  = vk::ImageUsageFlagBits::eTransferSrc,
+        };
+
+        // Copies, blits and clears
+        inline constexpr ImageAccess kTransferWrite {
+            .stages = vk::PipelineStageFlagBits2::eTransfer,
+            .access = vk::AccessFlagBits2::eTransferWrite,
+            .layout = vk::ImageLayout::eTransferDstOptimal,
+            .usage  = vk::ImageUsageFlagBits::eTransferDst,
+        };
+
+        inline constexpr ImageAccess kComputeSampled {
+            .stages = vk::PipelineStageFlagBits2::eComputeShader,
+            .access = vk::AccessFlagBits2::eShaderSampledRead,
+            .layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .usage  = vk::ImageUsageFlagBits::eSampled,
+        };
+
+        inline constexpr ImageAccess kPresent {
+            .stages = vk::PipelineStageFlagBits2::eNone,
+            .access = vk::AccessFlagBits2::eNone,
+            .layout = vk::ImageLayout::ePresentSrcKHR,
+            .usage  = {},
+        };
+    }  // namespace image_access
+
+    // Handle of an image declared in a RenderGraph, valid until the graph is reset
+    struct GraphImage
+    {
+        uint32_t index { ~0u };
+    };
+
+    // The frame's passes and the images they read and write, rebuilt every frame.
+    //
+    // compile() culls the passes whose results nobody uses and works out the barriers between the rest from
+    // their declared accesses, batched into one pipelineBarrier2 per pass. The images the graph creates only
+    // live between their first and last use, images whose lifetimes don't overlap share memory. They're
+    // realized once and kept while the declarations stay the same, the first use in a frame starts from
+    // eUndefined as nothing is carried over from one frame to the next.
+    //
+    // Buffers aren't tracked, passes keep synchronizing their own.
+    class RenderGraph
+    {
+    public:
+        struct TransientImageInfo
+        {
+            vk::Extent2D extent;
+            vk::Format format;
+            vk::SampleCountFlagBits samples { vk::SampleCountFlagBits::e1 };
+            vk::ImageAspectFlags aspect { vk::ImageAspectFlagBits::eColor };
+        };
+
+        struct ImportedImageInfo
+        {
+            vk::Image image;
+            vk::ImageView view;
+            vk::Extent2D extent;
+            vk::ImageAspectFlags aspect { vk::ImageAspectFlagBits::eColor };
+
+            // The last use before the graph, its layout is the one the image is in
+            ImageAccess initial;
+
+            // Exported images are left in this state at the end, passes writing them are never culled
+            std::optional<ImageAccess> final;
+        };
+
+        class PassBuilder
+        {
+        public:
+            // The pass uses the image's current contents
+            auto read(GraphImage image, ImageAccess const& access) -> PassBuilder&;
+
+            // The pass replaces the image's contents
+            auto write(GraphImage image, ImageAccess const& access) -> PassBuilder&;
+
+            // Draws on top of the image's contents, e.g. attachments loaded with eLoad
+            auto readWrite(GraphImage image, ImageAccess const& access) -> PassBuilder&;
+
+            // The pass writes something the graph doesn't track, it's never culled
+            auto setSideEffects() -> PassBuilder&;
+
+        private:
+            friend class RenderGraph;
+
+            PassBuilder(RenderGraph& graph, uint32_t pass) : m_graph { &graph }, m_pass { pass } {}
+
+            auto use(GraphImage image, ImageAccess const& access, bool read, bool write) -> PassBuilder&;
+
+            RenderGraph* m_graph;
+            uint32_t m_pass;
+        };
+
+        RenderGraph() = default;
+
+        RenderGraph(Device const& device, Allocator const& allocator);
+
+        RenderGraph(RenderGraph const&)                    = delete;
+        auto operator=(RenderGraph const&) -> RenderGraph& = delete;
+
+        RenderGraph(RenderGraph&&)                    = default;
+        auto operator=(RenderGraph&&) -> RenderGraph& = default;
+
+        // Drops the passes and images of the previous frame, the realized ones stay for the next compile
+        void reset();
+
+        // Usage comes from the declared accesses
+        auto createImage(std::string name, TransientImageInfo const& info) -> GraphImage;
+
+        auto importImage(std::string name, ImportedImageInfo const& info) -> GraphImage;
+
+        // Passes run in the order they're added
+        auto addPass(std::string name, std::function<void(vk::CommandBuffer)> execute) -> PassBuilder;
+
+        // Returns whether the images the graph creates were realized anew, views handed out before are then
+        // retired into `deletionQueue`
+        auto compile(DeletionQueue& deletionQueue) -> bool;
+
+        // Records the compiled passes and their barriers. Every compiled graph has to be executed, the next
+        // compile picks up the transients' memory where this one left it.
+        void execute(vk::CommandBuffer commandBuffer) const;
+
+        // Only valid after compile
+        [[nodiscard]] auto getImage(GraphImage image) const -> vk::Image;
+        [[nodiscard]] auto getImageView(GraphImage image) const -> vk::ImageView;
+
+        [[nodiscard]] auto getExtent(GraphImage image) const -> vk::Extent2D
+        {
+            return m_images[image.index].extent;
+        }
+
+        [[nodiscard]] auto getPassCount() const -> uint32_t { return static_cast<uint32_t>(m_passes.size()); }
+
+        [[nodiscard]] auto getCulledPassCount() const -> uint32_t { return m_culledPassCount; }
+
+        // What the created images would take up on their own, and what they take up sharing memory
+        [[nodiscard]] auto getTransientSize() const -> vk::DeviceSize { return m_transientSize; }
+
+        [[nodiscard]] auto getAllocatedSize() const -> vk::DeviceSize { return m_allocatedSize; }
+
+    private:
+        struct Use
+        {
+            uint32_t image;
+            ImageAccess access;
+            bool read;
+            bool write;
+        };
+
+        struct Pass
+        {
+            std::string name;
+            std::function<void(vk::CommandBuffer)> execute;
+            std::vector<Use> uses;
+            bool sideEffects { false };
+
+            // Written by compile
+            bool culled { false };
+            std::vector<vk::ImageMemoryBarrier2> barriers;
+        };
+
+        struct ImageNode
+        {
+            std::string name;
+            vk::Extent2D extent;
+            vk::ImageAspectFlags aspect;
+
+            // Created by the graph
+            bool transient { false };
+            vk::Format format { vk::Format::eUndefined };
+            vk::SampleCountFlagBits samples { vk::SampleCountFlagBits::e1 };
+            vk::ImageUsageFlags usage;
+
+            // Imported
+            vk::Image image { nullptr };
+            vk::ImageView view { nullptr };
+            ImageAccess initial {};
+            std::optional<ImageAccess> final;
+
+            // First and last compiled pass using the image, and the physical image of a transient
+            uint32_t firstPass { ~0u };
+            uint32_t lastPass { 0 };
+            uint32_t physical { ~0u };
+        };
+
+        // Synchronization state of an image, or of a memory block between its aliases
+        struct ImageState
+        {
+            vk::ImageLayout layout { vk::ImageLayout::eUndefined };
+            vk::PipelineStageFlags2 writeStages;
+            vk::AccessFlags2 writeAccess;
+
+            // Since the last write
+            vk::PipelineStageFlags2 readStages;
+            vk::PipelineStageFlags2 visibleStages;
+            vk::AccessFlags2 visibleAccess;
+        };
+
+        struct PhysicalImageKey
+        {
+            vk::Extent2D extent;
+            vk::Format format;
+            vk::SampleCountFlagBits samples;
+            vk::ImageUsageFlags usage;
+            vk::ImageAspectFlags aspect;
+            uint32_t firstPass;
+            uint32_t lastPass;
+
+            auto operator==(PhysicalImageKey const&) const -> bool = default;
+        };
+
+        struct MemoryDeleter
+        {
+            VmaAllocator allocator;
+
+            void operator()(VmaAllocation allocation) const { vmaFreeMemory(allocator, allocation); }
+        };
+
+        using Memory = std::unique_ptr<std::remove_pointer_t<VmaAllocation>, MemoryDeleter>;
+
+        // Retired as a whole, the images go before the memory they're bound to
+        struct Realization
+        {
+            std::vector<Memory> blocks;
+            std::vector<vk::raii::Image> images;
+            std::vector<vk::raii::ImageView> views;
+
+            // Block of every image
+            std::vector<uint32_t> imageBlocks;
+        };
+
+        void cullPasses();
+
+        // Creates the transients' images and the memory they share, unless the last ones still fit
+        auto realize(DeletionQueue& deletionQueue) -> bool;
+
+        void buildBarriers();
+
+        static auto makeBarrier(ImageState const& state,
+                                ImageAccess const& access,
+                                vk::Image image,
+                                vk::ImageAspectFlags aspect) -> vk::ImageMemoryBarrier2;
+
+        Device const* m_device { nullptr };
+        Allocator const* m_allocator { nullptr };
+
+        std::vector<Pass> m_passes;
+        std::vector<ImageNode> m_images;
+
+        // At the end of the graph, exported images
+        std::vector<vk::ImageMemoryBarrier2> m_finalBarriers;
+
+        std::vector<PhysicalImageKey> m_physicalKeys;
+        Realization m_realization;
+
+        // How the last image in every block was left by the previous graph
+        std::vector<ImageState> m_blockStates;
+
+        uint32_t m_culledPassCount { 0 };
+        vk::DeviceSize m_transientSize { 0 };
+        vk::DeviceSize m_allocatedSize { 0 };
+    };
+}  // namespace renderer::backend
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace renderer::backend
+{
+    // Passes are drawn in this order, the pass sits in the top bits of every DrawKey
+    enum class DrawPass : uint8_t
+    {
+        Opaque,
+        Blended,
+    };
+
+    // Packed 64-bit sort key of a queued draw. Its fields are ordered differently per pass:
+    //  - opaque:  pass | pipeline | material | depth, state changes first and front to back within a state
+    //  - blended: pass | ~depth | pipeline | material, back to front as blending requires
+    // The depth bucket is the top bits of a non-negative float distance, whose bit patterns sort like the
+    // floats themselves.
+    class DrawKey
+    {
+    public:
+        static constexpr uint32_t kPipelineBits = 8;
+        static constexpr uint32_t kMaterialBits = 24;
+        static constexpr uint32_t kDepthBits    = 24;
+
+        static auto make(DrawPass pass, uint32_t pipeline, uint32_t material, float distance) -> uint64_t;
+
+        [[nodiscard]] static auto getPass(uint64_t key) -> DrawPass
+        {
+            return static_cast<DrawPass>(key >> 62);
+        }
+    };
+
+    struct RenderQueueEntry
+    {
+        uint64_t key;
+        uint32_t drawIndex;
+    };
+
+    // Sorts a frame's draws by their DrawKey. State changes follow the command ranges the draws are
+    // compacted into, the order only decides which commands come first within a range, exactly for blended
+    // ranges and loosely for opaque ones. Storage is kept between frames, so a steady queue doesn't allocate.
+    class RenderQueue
+    {
+    public:
+        void clear();
+
+        void push(uint64_t key, uint32_t drawIndex) { m_entries.push_back({ key, drawIndex }); }
+
+        void sort();
+
+        [[nodiscard]] auto getEntries() const -> std::span<RenderQueueEntry const> { return m_entries; }
+
+    private:
+        std::vector<RenderQueueEntry> m_entries;
+        std::vector<RenderQueueEntry> m_scratch;
+    };
+
+    // Stable LSD radix sort by key, one byte per pass. Passes in which every key has the same byte are
+    // skipped. `scratch` has to be as large as `entries`, the result ends up in `entries`.
+    void radixSort(std::span<RenderQueueEntry> entries, std::span<RenderQueueEntry> scratch);
+}  // namespace renderer::backend
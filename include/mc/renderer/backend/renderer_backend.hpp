@@ -1,17 +1,38 @@
 #pragma once
 
 #include "allocator.hpp"
+#include "bindless.hpp"
 #include "buffer.hpp"
 #include "command.hpp"
 #include "constants.hpp"
+#include "deletion_queue.hpp"
+#include "depth_pyramid.hpp"
 #include "descriptor.hpp"
 #include "device.hpp"
 #include "image.hpp"
 #include "instance.hpp"
 #include "mc/renderer/backend/gltfloader.hpp"
 #include "pipeline.hpp"
+#include "render_graph.hpp"
 #include "surface.hpp"
 #include "swapchain.hpp"
+#include "texture_loader.hpp"
+#include "timeline.hpp"
+#include "uniform_ring.hpp"
+#include "upload_manager.hpp"
+
+#include <mc/file_watcher.hpp>
+#include <mc/thread_pool.hpp>
+
+#include <array>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "vk_mem_alloc.h"
 #include <GLFW/glfw3.h>
@@ -24,14 +45,81 @@
 
 namespace renderer::backend
 {
-    struct GPUDrawPushConstants
+    // Meshlets visible in the previous frame are culled and drawn first, the depth pyramid is built from
+    // what they left in the depth buffer and the remaining meshlets are tested against it in the late phase
+    enum class CullPhase : uint32_t
     {
-        glm::mat4 model { glm::identity<glm::mat4>() };
+        Early,
+        Late,
+    };
 
+    // Everything else a draw needs comes out of its MeshletDraw, found through gl_InstanceIndex
+    struct GPUDrawPushConstants
+    {
         vk::DeviceAddress vertexBuffer {};
         vk::DeviceAddress materialBuffer {};
+        vk::DeviceAddress drawBuffer {};
+        vk::DeviceAddress nodeBuffer {};
+    };
+
+    // The minimum maxPushConstantsSize every implementation supports
+    static_assert(sizeof(GPUDrawPushConstants) <= 128);
 
-        uint32_t materialIndex;
+    struct MeshletCullPushConstants
+    {
+        vk::DeviceAddress meshletBuffer {};
+        vk::DeviceAddress drawBuffer {};
+        vk::DeviceAddress nodeBuffer {};
+        vk::DeviceAddress instanceBuffer {};
+        vk::DeviceAddress commandBuffer {};
+        vk::DeviceAddress drawCountBuffer {};
+        vk::DeviceAddress cullDataBuffer {};
+        vk::DeviceAddress instanceOrderBuffer {};
+        vk::DeviceAddress meshletVisibilityBuffer {};
+
+        // Entries of the instance order buffer
+        uint32_t instanceCount {};
+
+        // CommandRange::firstCommand of every command range. Blended ranges subtract the position of their
+        // first queued instance, their commands are indexed by invocation.
+        std::array<uint32_t, kMaxCommandRanges> firstCommands {};
+
+        CullPhase phase {};
+
+        // Command ranges from this one on are DrawPass::Blended, their meshlets are only drawn by the late
+        // phase
+        uint32_t firstBlendedRange {};
+    };
+
+    static_assert(sizeof(MeshletCullPushConstants) <= 128);
+
+    // Per frame inputs of meshlet_cull.comp
+    struct alignas(16) GPUCullData
+    {
+        // World space, normals point inwards. Left, right, bottom, top, then the two depth planes.
+        std::array<glm::vec4, 6> frustumPlanes;
+        glm::vec4 cameraPosition;
+
+        // Occlusion culling projects bounding spheres in view space. Holds P00, P11, P22 and P32 of the
+        // projection matrix.
+        glm::mat4 view;
+        glm::vec4 projection;
+        float nearPlane;
+
+        uint32_t pyramidWidth;
+        uint32_t pyramidHeight;
+        uint32_t occlusionEnabled;
+    };
+
+    // Filled by meshlet_cull.comp, the draw counts of drawGltf's indirect draws
+    struct GPUDrawCounts
+    {
+        // Indexed by cull phase * kMaxCommandRanges + command range
+        std::array<uint32_t, 2 * kMaxCommandRanges> drawCounts;
+        uint32_t triangleCount;
+
+        // Meshlets the late phase rejected against the depth pyramid
+        uint32_t occludedCount;
     };
 
     struct alignas(16) GPUSceneData
@@ -45,11 +133,39 @@ namespace renderer::backend
         glm::vec3 sunlightDirection;
     };
 
+    // Timestamp queries of a frame slot, the depth pyramid build's pair first. Then a pair around every
+    // command range's draw in each cull phase, see RendererBackend::getRangeTimestampQuery.
+    constexpr uint32_t kPyramidTimestampQueries = 2;
+    constexpr uint32_t kTimestampQueryCount     = kPyramidTimestampQueries + 2 * 2 * kMaxCommandRanges;
+
     struct FrameResources
     {
         vk::raii::Semaphore imageAvailableSemaphore { nullptr };
         vk::raii::Semaphore renderFinishedSemaphore { nullptr };
-        vk::raii::Fence inFlightFence { nullptr };
+
+        // What the slot's last submission signals on the frame timeline, everything below is free for reuse
+        // once it has been reached
+        uint64_t timelineValue { 0 };
+
+        // This frame's allocations out of the uniform ring, the dynamic offsets of the scene data set and
+        // meshlet_cull.comp's GPUCullData
+        uint32_t sceneDataOffset {};
+        uint32_t lightDataOffset {};
+        vk::DeviceAddress cullDataAddress {};
+
+        // Host visible as well, read back for the stats and cleared once the frame has completed
+        GPUBuffer drawCountBuffer;
+
+        // Around the depth pyramid build and the command ranges' draws, read back for the stats like the draw
+        // counts
+        vk::raii::QueryPool timestampQueryPool { nullptr };
+        bool timestampsWritten { false };
+        bool rangeTimestampsWritten { false };
+
+        // Headless only, the resolved draw image copied out by the frame. Written to disk as frame
+        // `readbackFrame` once the frame has completed, if it's set.
+        GPUBuffer readbackBuffer;
+        std::optional<uint64_t> readbackFrame;
 
 #if PROFILED
         TracyVkCtx tracyContext { nullptr };
@@ -70,11 +186,27 @@ namespace renderer::backend
         } attenuation;
     };
 
+    // Rendering without a window, for benchmarks and image comparisons in CI. Frames go into the draw images
+    // only, nothing is presented and there's no ImGui overlay.
+    struct HeadlessSettings
+    {
+        vk::Extent2D extent { 1280, 720 };
+
+        // Every frame is read back and written here, named after its number. Frames are still copied out
+        // when it's empty, so that the timings don't depend on it.
+        std::filesystem::path outputDirectory;
+
+        // OpenEXR keeps the draw image's values as they are, PNG clamps them to 8 bit sRGB
+        bool exr { false };
+    };
+
     class RendererBackend
     {
     public:
         explicit RendererBackend(window::Window& window);
 
+        explicit RendererBackend(HeadlessSettings const& settings);
+
         RendererBackend(RendererBackend const&)                    = delete;
         RendererBackend(RendererBackend&&)                         = delete;
         auto operator=(RendererBackend const&) -> RendererBackend& = delete;
@@ -90,10 +222,17 @@ namespace renderer::backend
 
         [[nodiscard]] auto getFramebufferSize() const -> glm::uvec2
         {
-            vk::Extent2D extent = m_swapchain.getImageExtent();
+            vk::Extent2D extent = m_headless ? m_headless->extent : m_swapchain.getImageExtent();
             return { extent.width, extent.height };
         }
 
+        // Waits for every submitted frame, then for the readbacks of headless frames to be written
+        void finishFrames();
+
+        // Headless only, the resolved draw image of the last frame as RGBA half floats, see writePng. The
+        // frame has to have completed, e.g. through finishFrames.
+        [[nodiscard]] auto readLastFrame() const -> std::vector<uint16_t>;
+
         void toggleVsync()
         {
             m_surface.scheduleVsyncChange(!m_surface.getVsync());
@@ -102,37 +241,131 @@ namespace renderer::backend
 
         void toggleLightRevolution() { m_timer.isPaused() ? m_timer.unpause() : m_timer.pause(); }
 
+        // Between 1 and kMaxFramesInFlight. Fewer frames lower the latency, more let the CPU run further
+        // ahead of the GPU.
+        void setFramesInFlight(uint32_t count);
+
+        [[nodiscard]] auto getFramesInFlight() const -> uint32_t { return m_framesInFlight; }
+
+        // Switches every draw between its specialized material pipeline and the uber-shader
+        void toggleUberMaterialShader() { m_uberMaterialShader = !m_uberMaterialShader; }
+
+        // Replaces the scene, from the scene cache when it has been baked. The frames keep drawing without
+        // it until its upload has landed.
+        void processGltf(std::filesystem::path const& path, VertexFormat vertexFormat);
+
     private:
+        // A null window renders headless
+        RendererBackend(window::Window* window, std::optional<HeadlessSettings> headless);
+
+        // Declares the frame's passes and render targets, presenting to swapchain image `imageIndex`.
+        // Headless frames copy the resolved draw image into their readback buffer instead.
+        void buildRenderGraph(uint32_t imageIndex);
+
+        [[nodiscard]] auto getRenderExtent() const -> vk::Extent2D
+        {
+            return m_headless ? m_headless->extent : m_surface.getFramebufferExtent();
+        }
+
+        // The pixels of a completed headless frame
+        [[nodiscard]] auto copyReadback(FrameResources const& frame) const -> std::vector<uint16_t>;
+
+        // Hands the completed frame's readback to m_threadPool to be written to disk
+        void writeReadback(FrameResources& frame);
+
         void initImgui(GLFWwindow* window);
         void renderImgui(vk::CommandBuffer cmdBuf, vk::ImageView targetImage);
 
-        void drawGeometry(vk::CommandBuffer cmdBuf);
+        // The early phase clears the depth buffer and resolves it for the depth pyramid, the late phase
+        // draws on top and resolves the color. The draws are recorded in chunks into secondary command
+        // buffers, spread over the recording threads.
+        void drawGeometry(vk::CommandBuffer cmdBuf, CullPhase phase);
+
+        // Reads back the previous stats of the frame slot, then moves nodes, frustum culls and sorts draws on
+        // the CPU
+        void prepareCulling(vk::CommandBuffer cmdBuf);
+
+        // Sorts the frustum culled draws through the render queue and writes their meshlet instances, in
+        // that order, for this frame's culling passes
+        void queueVisibleDraws();
+
+        // Culls every meshlet instance against the frustum and its normal cone, in the late phase against
+        // the depth pyramid as well, and writes the indirect commands drawGltf consumes for `phase`. Has to
+        // be recorded outside of a render pass.
+        void cullMeshlets(vk::CommandBuffer cmdBuf, CullPhase phase);
+
+        // From the depth the early phase drew, between the two culling phases
+        void buildDepthPyramid(vk::CommandBuffer cmdBuf);
+
+        [[nodiscard]] auto isSceneReady() const -> bool;
 
         void initDescriptors();
 
-        void processGltf();
+        // Uploads geometry, materials and meshlet draws and builds the node hierarchy, textures are streamed
+        // separately
+        void uploadScene(SceneView const& scene);
+
+        void onTexturesLoaded(std::span<LoadedTexture> textures);
+
+        // Records `chunk` out of `chunkCount` parts of the phase's indirect draws, see getGeometryChunkCount
+        void drawGltf(vk::CommandBuffer commandBuffer,
+                      vk::PipelineLayout pipelineLayout,
+                      CullPhase phase,
+                      uint32_t chunk,
+                      uint32_t chunkCount);
+
+        // One chunk per few command ranges, up to one per recording thread. Draws with a count can't be
+        // split, the ranges are dealt out to the chunks then. Otherwise every chunk gets a share of each
+        // range's commands.
+        [[nodiscard]] auto getGeometryChunkCount() const -> uint32_t;
 
-        void loadImages(tinygltf::Model& input);
+        // Records the phase's draws into one secondary command buffer per chunk, chunk 0 on the calling
+        // thread and the rest on m_recordingThreads. Returns them in execution order.
+        auto recordGeometryChunks(CullPhase phase) -> std::vector<vk::CommandBuffer>;
 
-        void loadTextures(tinygltf::Model& input);
+        // fs.frag specialized on `features`, kUberMaterialFeatures for the uber-shader. Blended pipelines
+        // blend over what's drawn and test depth without writing it. Built and watched for shader changes on
+        // first use, which has to happen on the main thread.
+        auto getMaterialPipeline(VertexFormat format, uint32_t features, DrawPass pass) -> GraphicsPipeline&;
 
-        void loadMaterials(tinygltf::Model& input);
+        [[nodiscard]] static auto getMaterialPipelineKey(VertexFormat format,
+                                                         uint32_t features,
+                                                         DrawPass pass) -> uint64_t
+        {
+            return (uint64_t { std::to_underlying(pass) } << 33) |
+                   (uint64_t { std::to_underlying(format) } << 32) | features;
+        }
 
-        void loadNode(tinygltf::Node const& inputNode,
-                      tinygltf::Model const& input,
-                      GltfNode* parent,
-                      std::vector<uint32_t>& indexBuffer,
-                      std::vector<Vertex>& vertexBuffer);
+        // First of the pair of timestamps written around a command range's draw
+        [[nodiscard]] static auto getRangeTimestampQuery(CullPhase phase, uint32_t range) -> uint32_t
+        {
+            return kPyramidTimestampQueries + (std::to_underlying(phase) * kMaxCommandRanges + range) * 2;
+        }
 
-        void drawNode(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, GltfNode* node);
+        // Rebuilds the pipelines whose shader sources changed on disk on m_threadPool, and swaps in the ones
+        // that finished, retiring the old ones into m_deletionQueue. A source that fails to compile keeps its
+        // pipeline as it is.
+        void reloadChangedPipelines();
 
-        void drawGltf(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout);
+        template<typename PipelineType>
+        void watchPipeline(PipelineType& pipeline)
+        {
+            m_watchedPipelines.push_back({
+                .shaders  = pipeline.getShaderNames(),
+                .recreate = [&pipeline] { return pipeline.recreate(); },
+                .replace  = [&pipeline](vk::raii::Pipeline replacement)
+                { return pipeline.replace(std::move(replacement)); },
+            });
+        }
 
         void handleSurfaceResize();
         void createSyncObjects();
         void destroySyncObjects();
         void updateDescriptors(glm::vec3 cameraPos, glm::mat4 model, glm::mat4 view, glm::mat4 projection);
 
+        // Set when rendering without a window, which leaves the surface and swapchain empty
+        std::optional<HeadlessSettings> m_headless;
+
         Instance m_instance;
         Surface m_surface;
         Device m_device;
@@ -140,26 +373,97 @@ namespace renderer::backend
         Allocator m_allocator;
         DescriptorAllocator m_descriptorAllocator;
         CommandManager m_commandManager;
+        UploadManager m_uploadManager;
+
+        // Rebuilt every frame, the render targets are its transient images
+        RenderGraph m_renderGraph;
+
+        struct RenderTargets
+        {
+            GraphImage draw, drawResolve, depth;
 
-        Image m_drawImage, m_drawImageResolve, m_depthImage;
+            // Min resolve of the early phase's depth, the depth pyramid's source
+            GraphImage depthResolve;
+        } m_renderTargets;
+
+        DepthPyramid m_depthPyramid;
+
+        // Nanoseconds per timestamp tick, 0 when graphics and compute queues can't write timestamps
+        float m_timestampPeriod { 0.f };
         vk::DescriptorSet m_sceneDataDescriptors { nullptr };
-        vk::raii::DescriptorSetLayout m_sceneDataDescriptorLayout { nullptr },
-            m_materialDescriptorLayout { nullptr };
+        vk::raii::DescriptorSetLayout m_sceneDataDescriptorLayout { nullptr };
+
+        BindlessTextures m_bindlessTextures;
 
         vk::raii::DescriptorPool m_imGuiPool { nullptr };
 
         PipelineLayout m_texturedPipelineLayout, m_texturelessPipelineLayout;
-        GraphicsPipeline m_texturedPipeline, m_texturelessPipeline;
+        GraphicsPipeline m_texturelessPipeline;
+
+        // Permutations of the textured pipeline by vertex format, material features and draw pass, see
+        // getMaterialPipelineKey. Nodes stay put, the reload callbacks hold references into the map.
+        GraphicsPipelineConfig m_materialPipelineConfig;
+        std::unordered_map<uint64_t, GraphicsPipeline> m_materialPipelines;
+
+        // Draws every command range with the uber-shader, to compare against the specialized pipelines
+        bool m_uberMaterialShader { false };
+
+        PipelineLayout m_meshletCullPipelineLayout;
+        ComputePipeline m_meshletCullPipeline;
+
+        struct WatchedPipeline
+        {
+            std::vector<std::filesystem::path> shaders;
+            std::function<std::optional<vk::raii::Pipeline>()> recreate;
+            std::function<vk::raii::Pipeline(vk::raii::Pipeline)> replace;
+        };
+
+        struct PipelineRebuild
+        {
+            size_t pipelineIndex;
+            std::future<std::optional<vk::raii::Pipeline>> result;
 
+            // A source changed again while building, it has to run once more
+            bool stale;
+        };
+
+        // Every pipeline built from shader sources, rebuilt when one of them changes
+        std::vector<WatchedPipeline> m_watchedPipelines;
+        std::vector<PipelineRebuild> m_pipelineRebuilds;
+
+        utils::FileWatcher m_shaderWatcher;
+
+        // Written by update, copied into the uniform ring once the frame slot they go to has retired
         GPUSceneData m_sceneData {};
-        GPUBuffer m_gpuSceneDataBuffer, m_lightDataBuffer;
+        GPUCullData m_cullData {};
+
+        UniformRing m_uniformRing;
 
         SceneResources m_sceneResources {};
 
-        std::array<FrameResources, kNumFramesInFlight> m_frameResources {};
+        utils::ThreadPool m_threadPool;
+
+        // Records secondary command buffers together with the main thread. Separate from m_threadPool so
+        // that recording never waits behind texture decoding.
+        utils::ThreadPool m_recordingThreads;
+
+        TextureLoader m_textureLoader;
+
+        // Headless frames being written to disk on m_threadPool
+        std::vector<std::future<void>> m_readbackWrites;
+
+        std::array<FrameResources, kMaxFramesInFlight> m_frameResources {};
+
+        // Signalled by every graphics submission with the frame's number, see FrameResources::timelineValue
+        Timeline m_frameTimeline;
+        uint32_t m_framesInFlight { kDefaultFramesInFlight };
+
+        // Resources replaced at runtime, freed once the frames that may use them have completed
+        DeletionQueue m_deletionQueue;
 
         vk::raii::Sampler m_dummySampler { nullptr };
         Texture m_dummyTexture {};
+        uint32_t m_dummyTextureSlot { 0 };
 
         Timer m_timer;
 
@@ -169,6 +473,18 @@ namespace renderer::backend
         {
             uint64_t triangle_count;
             uint64_t drawcall_count;
+            uint64_t visible_count;
+            uint64_t culled_count;
+            uint64_t occluded_count;
+            double pyramid_build_ms;
+
+            // CPU time of recordGeometryChunks, both cull phases together
+            double geometry_record_ms;
+            uint32_t geometry_chunk_count;
+
+            // GPU time of each command range's draws, both cull phases together
+            std::array<double, kMaxCommandRanges> range_ms;
+            bool range_ms_valid;
         } m_stats {};
 
         uint32_t m_currentFrame { 0 };
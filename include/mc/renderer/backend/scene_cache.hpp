@@ -0,0 +1,54 @@
+#pragma once
+
+#include "block_encoder.hpp"
+#include "gltfloader.hpp"
+#include "texture_loader.hpp"
+
+#include <mc/mapped_file.hpp>
+#include <mc/thread_pool.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+namespace renderer::backend
+{
+    struct SceneCacheHeader;
+
+    // Baked, GPU-ready copy of an imported glTF scene.
+    //
+    // The file is a header followed by 16-byte aligned sections that map directly onto the in-memory
+    // structs, so opening one is a single mmap and its sections are copied into staging buffers as they are.
+    // Textures are stored with their whole mip chain, block-compressed unless baked with
+    // BlockEncoderEffort::None. A cache is only used when it was written by the same
+    // format version, the source glTF still hashes to the same value and none of the external buffers and
+    // images it references changed size or modification time.
+    class SceneCache
+    {
+    public:
+        // Next to the source, e.g. Sponza.gltf -> Sponza.gltf.mcscene
+        static auto getPath(std::filesystem::path const& source) -> std::filesystem::path;
+
+        // Empty when there is no cache for `source`, it is stale or was baked with another vertex format
+        static auto open(std::filesystem::path const& source,
+                         VertexFormat vertexFormat) -> std::optional<SceneCache>;
+
+        [[nodiscard]] auto getView() const -> SceneView;
+
+        // Points into the mapping, which the returned image keeps alive
+        [[nodiscard]] auto getImage(size_t index) const -> DecodedImage;
+
+    private:
+        explicit SceneCache(std::shared_ptr<utils::MappedFile> file);
+
+        std::shared_ptr<utils::MappedFile> m_file;
+        SceneCacheHeader const* m_header { nullptr };
+    };
+
+    // Imports `source`, decodes, mips and compresses every image on `threadPool` and writes the result to
+    // SceneCache::getPath(source). The quality and throughput of the block encoder are logged per format.
+    void bakeSceneCache(std::filesystem::path const& source,
+                        VertexFormat vertexFormat,
+                        BlockEncoderEffort encoderEffort,
+                        utils::ThreadPool& threadPool);
+}  // namespace renderer::backend
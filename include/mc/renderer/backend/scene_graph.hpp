@@ -0,0 +1,104 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "buffer.hpp"
+#include "constants.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/quaternion_float.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    struct SceneNode;
+
+    // A scene's nodes as one structure of arrays in a single allocation, in the topological order of the
+    // SceneNode table: parents always come before their children.
+    //
+    // Local transforms are kept as TRS. update() only recomputes the world matrices of nodes that were
+    // moved and of their descendants, in one forward pass that starts at the first dirty node. The world
+    // matrices are mirrored in a device local buffer, indexed by node, which the culling pass and vs.vert
+    // read through MeshletDraw::nodeIndex.
+    class SceneGraph
+    {
+    public:
+        SceneGraph() = default;
+
+        // The initial world matrices are uploaded with the scene, see getWorldTransforms()
+        SceneGraph(Allocator& allocator, std::span<SceneNode const> nodes);
+
+        ~SceneGraph() = default;
+
+        SceneGraph(SceneGraph const&)                    = delete;
+        auto operator=(SceneGraph const&) -> SceneGraph& = delete;
+
+        SceneGraph(SceneGraph&&)                    = default;
+        auto operator=(SceneGraph&&) -> SceneGraph& = default;
+
+        [[nodiscard]] auto getNodeCount() const -> uint32_t { return m_nodeCount; }
+
+        // -1 for roots
+        [[nodiscard]] auto getParent(uint32_t node) const -> int32_t { return m_parents[node]; }
+
+        [[nodiscard]] auto getTranslation(uint32_t node) const -> glm::vec3 { return m_translations[node]; }
+
+        [[nodiscard]] auto getRotation(uint32_t node) const -> glm::quat { return m_rotations[node]; }
+
+        [[nodiscard]] auto getScale(uint32_t node) const -> glm::vec3 { return m_scales[node]; }
+
+        void setTranslation(uint32_t node, glm::vec3 translation);
+        void setRotation(uint32_t node, glm::quat rotation);
+        void setScale(uint32_t node, glm::vec3 scale);
+
+        // As of the last update()
+        [[nodiscard]] auto getWorldTransforms() const -> std::span<glm::mat4 const>
+        {
+            return m_worldTransforms;
+        }
+
+        // Recomputes the world matrices of dirty nodes and their descendants, returns whether any changed
+        auto update() -> bool;
+
+        // Copies the world matrices update() changed since the last call into the node buffer, through the
+        // staging buffer of `frameIndex`. Leaves the buffer ready for compute and vertex shader reads.
+        void recordUpload(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+
+        [[nodiscard]] auto getBuffer() const -> GPUBuffer const& { return m_buffer; }
+
+    private:
+        void markDirty(uint32_t node);
+
+        uint32_t m_nodeCount { 0 };
+
+        // Backs every span below
+        std::unique_ptr<std::byte[]> m_storage;
+
+        std::span<glm::mat4> m_worldTransforms;
+        std::span<glm::quat> m_rotations;
+        std::span<glm::vec3> m_translations;
+        std::span<glm::vec3> m_scales;
+        std::span<int32_t> m_parents;
+
+        // Set by the setters, cleared by update()
+        std::span<uint8_t> m_dirty;
+
+        // No node before it is dirty, m_nodeCount when none is
+        uint32_t m_firstDirty { 0 };
+
+        // World matrices [m_uploadBegin, m_uploadEnd) still have to go out to the node buffer
+        uint32_t m_uploadBegin { 0 };
+        uint32_t m_uploadEnd { 0 };
+
+        GPUBuffer m_buffer;
+
+        // Host visible, each only rewritten once its frame's previous submission has completed
+        std::array<GPUBuffer, kMaxFramesInFlight> m_stagingBuffers;
+    };
+}  // namespace renderer::backend
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace renderer::backend
+{
+    // Compiles the GLSL sources in `shaders/` to SPIR-V at runtime with glslang.
+    //
+    // Every request is preprocessed first, `#include "..."` resolving against the source directory. The
+    // preprocessed text, the defines, the stage and the compiler versions and options are hashed and the
+    // SPIR-V is cached on disk under that hash, so only sources that actually changed are compiled again.
+    // Release builds run the SPIRV-Tools performance passes, debug builds keep the debug info instead.
+    // Thread safe, pipelines are rebuilt on worker threads when their sources change.
+    class ShaderManager
+    {
+    public:
+        ShaderManager() = default;
+
+        ShaderManager(std::filesystem::path sourceDirectory, std::filesystem::path cacheDirectory);
+
+        ~ShaderManager();
+
+        ShaderManager(ShaderManager const&)                    = delete;
+        auto operator=(ShaderManager const&) -> ShaderManager& = delete;
+
+        ShaderManager(ShaderManager&&)                    = default;
+        auto operator=(ShaderManager&&) -> ShaderManager& = default;
+
+        // `name` is relative to the source directory, its extension selects the stage. Each define is either
+        // `NAME` or `NAME=VALUE`. Compile errors are logged and yield empty code.
+        [[nodiscard]] auto getSpirv(std::filesystem::path const& name,
+                                    std::span<std::string const> defines = {}) const -> std::vector<uint32_t>;
+
+        // Whether `file` is the source `name` or one of the files it included when last compiled
+        [[nodiscard]] auto dependsOn(std::filesystem::path const& name,
+                                     std::filesystem::path const& file) const -> bool;
+
+        [[nodiscard]] auto getSourceDirectory() const -> std::filesystem::path const&
+        {
+            return m_sourceDirectory;
+        }
+
+    private:
+        struct State
+        {
+            std::mutex mutex;
+
+            // Source name to the absolute paths it was built from
+            std::unordered_map<std::string, std::vector<std::filesystem::path>> dependencies;
+        };
+
+        std::filesystem::path m_sourceDirectory;
+        std::filesystem::path m_cacheDirectory;
+
+        // Behind a pointer to keep the manager movable
+        std::unique_ptr<State> m_state;
+    };
+}  // namespace renderer::backend
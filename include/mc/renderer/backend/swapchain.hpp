@@ -11,10 +11,15 @@ namespace renderer::backend
     class Swapchain
     {
     public:
-        Swapchain();
+        Swapchain()  = default;
         ~Swapchain() = default;
 
-        Swapchain(Device const& device, Surface& surface, bool refreshSurface = true);
+        // Passing the swapchain being replaced as `oldSwapchain` lets the presentation engine hand over its
+        // resources, the old one has to be kept alive until the frames presenting to it have completed
+        Swapchain(Device const& device,
+                  Surface& surface,
+                  bool refreshSurface           = true,
+                  vk::SwapchainKHR oldSwapchain = nullptr);
 
         Swapchain(Swapchain const&)                    = delete;
         auto operator=(Swapchain const&) -> Swapchain& = delete;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "texture_loader.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace renderer::backend
+{
+    // Checks for the DDS or KTX2 magic
+    [[nodiscard]] auto isTextureContainer(std::span<std::byte const> bytes) -> bool;
+
+    // Parses a DDS (legacy or DX10 header) or KTX2 file holding a 2D texture of BC1-BC5, BC7 or 8-bit
+    // RGBA/BGRA data. The result points straight into `bytes`: every stored mip level is uploaded as-is,
+    // without any decoding or mip generation. `owner` has to keep `bytes` alive.
+    //
+    // Throws an AssetError for anything else, including arrays, cubemaps, volume textures and supercompressed
+    // (Basis Universal, zstd) KTX2 files.
+    [[nodiscard]] auto parseTextureContainer(std::span<std::byte const> bytes,
+                                             std::shared_ptr<void const> owner,
+                                             std::string_view name) -> DecodedImage;
+}  // namespace renderer::backend
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "device.hpp"
+#include "image.hpp"
+#include "upload_manager.hpp"
+
+#include <mc/thread_pool.hpp>
+#include <mc/timer.hpp>
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    // Pixels ready for upload, either just mip 0 or the whole chain. Decoded images are RGBA8, DDS and KTX2
+    // files keep their stored (usually BCn) format and levels and baked scene textures come block-compressed
+    // by the bake step.
+    struct DecodedImage
+    {
+        vk::Extent2D dimensions {};
+        uint32_t mipLevels { 1 };
+        uint32_t arrayLayers { 1 };
+        vk::Format format { vk::Format::eR8G8B8A8Unorm };
+
+        // Applied to the texture's view, baked two-channel BC5 textures move their channels back with it
+        vk::ComponentMapping components {};
+
+        std::span<std::byte const> data;
+
+        // Where each (level, layer) starts in `data`, see Texture::recordCopy. Empty when tightly packed.
+        std::vector<vk::DeviceSize> subresourceOffsets;
+
+        // Keeps `data` alive, e.g. the stb allocation or the mapped scene cache
+        std::shared_ptr<void const> owner;
+    };
+
+    struct LoadedTexture
+    {
+        uint32_t id;
+        Texture texture;
+    };
+
+    // Streams textures in while the frame loop keeps running.
+    //
+    // Images are decoded on the thread pool. Every pump() hands the images that finished decoding to the
+    // upload manager as one batch, which goes out with the frame's upload submit, and polls the tickets of
+    // earlier batches instead of waiting on them. Images that come with their whole mip chain, or are
+    // block-compressed, are only copied, the others get their chain blitted once acquired. On devices
+    // without BC support block-compressed images are decoded to RGBA8 on the thread pool first.
+    class TextureLoader
+    {
+    public:
+        using DecodeFn = std::function<DecodedImage()>;
+        using LoadedFn = std::function<void(std::span<LoadedTexture>)>;
+
+        TextureLoader() = default;
+
+        TextureLoader(Device& device,
+                      Allocator& allocator,
+                      UploadManager& uploadManager,
+                      utils::ThreadPool& threadPool);
+
+        ~TextureLoader();
+
+        TextureLoader(TextureLoader const&)                    = delete;
+        auto operator=(TextureLoader const&) -> TextureLoader& = delete;
+
+        TextureLoader(TextureLoader&&)                    = delete;
+        auto operator=(TextureLoader&&) -> TextureLoader& = delete;
+
+        // `decode` runs on a worker thread, so it must own (or outlive) everything it reads
+        void enqueue(uint32_t id, DecodeFn decode);
+
+        // For images that are already in memory, they go out with the next batch
+        void enqueue(uint32_t id, DecodedImage image);
+
+        // Retires the batches the graphics queue has acquired, handing their textures to `onLoaded`, and
+        // records a new batch out of the images that are done decoding. Never blocks.
+        void pump(LoadedFn const& onLoaded);
+
+        // Blocks until every enqueued texture has been copied, their acquires go out with the next frame
+        void flush(LoadedFn const& onLoaded);
+
+        [[nodiscard]] auto isIdle() const -> bool { return m_pending.empty() && m_batches.empty(); }
+
+    private:
+        struct PendingImage
+        {
+            uint32_t id;
+            std::future<DecodedImage> decoded;
+        };
+
+        struct Batch
+        {
+            UploadTicket ticket;
+
+            std::vector<LoadedTexture> textures;
+        };
+
+        void recordBatch(std::vector<std::pair<uint32_t, DecodedImage>>& images);
+        void retireBatches(LoadedFn const& onLoaded, bool wait);
+
+        Device* m_device { nullptr };
+        Allocator* m_allocator { nullptr };
+        UploadManager* m_uploadManager { nullptr };
+        utils::ThreadPool* m_threadPool { nullptr };
+
+        std::vector<PendingImage> m_pending;
+        std::vector<Batch> m_batches;
+
+        // Bookkeeping for the summary logged once the queue drains
+        Timer::Clock::time_point m_startTime {};
+        size_t m_loadedCount { 0 };
+        size_t m_batchCount { 0 };
+    };
+}  // namespace renderer::backend
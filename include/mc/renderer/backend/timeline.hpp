@@ -0,0 +1,58 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <cstdint>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    // Timeline semaphore of one queue. Every submission to the queue signals the next value of a monotonic
+    // counter, so "submission N has completed" is a single integer comparison and anything tied to a
+    // submission is reclaimed by waiting for its value instead of a fence of its own.
+    //
+    // Each queue gets a timeline of its own, submissions of different queues complete out of order and
+    // timeline values may only ever increase.
+    class Timeline
+    {
+    public:
+        Timeline() = default;
+
+        explicit Timeline(Device const& device);
+
+        Timeline(Timeline const&)                    = delete;
+        auto operator=(Timeline const&) -> Timeline& = delete;
+
+        Timeline(Timeline&&)                    = default;
+        auto operator=(Timeline&&) -> Timeline& = default;
+
+        // Advances the counter, the returned info goes into the signal semaphores of the submission it
+        // belongs to
+        [[nodiscard]] auto signal(vk::PipelineStageFlags2 stage = vk::PipelineStageFlagBits2::eAllCommands)
+            -> vk::SemaphoreSubmitInfo;
+
+        // For a submission of another queue that has to wait for `value`
+        [[nodiscard]] auto getWaitInfo(uint64_t value, vk::PipelineStageFlags2 stage) const
+            -> vk::SemaphoreSubmitInfo;
+
+        // Blocks until the submission that signalled `value` has completed
+        void wait(uint64_t value) const;
+
+        [[nodiscard]] auto isComplete(uint64_t value) const -> bool { return value <= getCompletedValue(); }
+
+        // Queries the semaphore
+        [[nodiscard]] auto getCompletedValue() const -> uint64_t;
+
+        // Value of the latest signal()
+        [[nodiscard]] auto getSubmittedValue() const -> uint64_t { return m_submittedValue; }
+
+        [[nodiscard]] explicit operator bool() const { return *m_semaphore; }
+
+    private:
+        Device const* m_device { nullptr };
+
+        vk::raii::Semaphore m_semaphore { nullptr };
+        uint64_t m_submittedValue { 0 };
+    };
+}  // namespace renderer::backend
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "buffer.hpp"
+#include "device.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    // One persistently mapped buffer split into a region per frame in flight, each frame bump allocates its
+    // uniforms and per-pass constants out of its own region.
+    //
+    // A region is only rewritten once the frame slot that last used it has retired, so the CPU never writes
+    // what the GPU may still be reading. Allocations are bound through dynamic offsets or buffer device
+    // addresses, no buffers or descriptor sets are created per frame.
+    class UniformRing
+    {
+    public:
+        struct Allocation
+        {
+            // From the start of the buffer, the dynamic offset of the allocation
+            uint32_t offset;
+
+            void* data;
+            vk::DeviceAddress address;
+        };
+
+        UniformRing() = default;
+
+        // `frameCapacity` bytes per frame in flight
+        UniformRing(Device const& device, Allocator& allocator, vk::DeviceSize frameCapacity);
+
+        // Starts over at the beginning of the frame slot's region, its previous frame must have retired
+        void beginFrame(uint32_t frameIndex);
+
+        // Aligned for both dynamic uniform buffer offsets and buffer references. Throws once the frame's
+        // region is exhausted.
+        [[nodiscard]] auto allocate(vk::DeviceSize size) -> Allocation;
+
+        template <typename T>
+        auto push(T const& value) -> Allocation
+        {
+            Allocation const allocation = allocate(sizeof(T));
+
+            std::memcpy(allocation.data, &value, sizeof(T));
+
+            return allocation;
+        }
+
+        [[nodiscard]] operator vk::Buffer() const { return m_buffer; }
+
+        // Bytes allocated so far this frame
+        [[nodiscard]] auto getFrameUsage() const -> vk::DeviceSize { return m_offset - m_frameBegin; }
+
+        [[nodiscard]] auto getFrameCapacity() const -> vk::DeviceSize { return m_frameCapacity; }
+
+    private:
+        GPUBuffer m_buffer;
+        vk::DeviceAddress m_address {};
+
+        vk::DeviceSize m_alignment {};
+        vk::DeviceSize m_frameCapacity {};
+
+        vk::DeviceSize m_frameBegin {};
+        vk::DeviceSize m_offset {};
+    };
+}  // namespace renderer::backend
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "buffer.hpp"
+#include "device.hpp"
+#include "image.hpp"
+#include "timeline.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer::backend
+{
+    // Staging memory every upload is copied through before it goes out
+    constexpr vk::DeviceSize kUploadRingSize = 64ull * 1024 * 1024;
+
+    // Timeline value of the batch an upload went out with, later batches always have larger values
+    struct UploadTicket
+    {
+        uint64_t value { 0 };
+    };
+
+    // Streams data to device local buffers and images over the transfer queue.
+    //
+    // Uploads are memcpy'd into a persistently mapped staging ring and their copies recorded into the open
+    // batch, which submit() sends off once per frame, signalling a timeline semaphore. When the transfer
+    // queue lives in another family than the graphics queue, every resource is released at the end of its
+    // batch and acquired again by recordAcquires() on the graphics queue, which is also where the mip chains
+    // of images that come with mip 0 only are blitted.
+    //
+    // Ring space is reclaimed as batches complete, the CPU only blocks when the ring runs out. Uploads
+    // larger than the whole ring get a staging buffer of their own.
+    class UploadManager
+    {
+    public:
+        UploadManager() = default;
+
+        UploadManager(Device& device, Allocator& allocator, vk::DeviceSize ringSize = kUploadRingSize);
+
+        ~UploadManager();
+
+        UploadManager(UploadManager const&)                    = delete;
+        auto operator=(UploadManager const&) -> UploadManager& = delete;
+
+        UploadManager(UploadManager&&)                    = delete;
+        auto operator=(UploadManager&&) -> UploadManager& = delete;
+
+        // `dstStage` and `dstAccess` describe the first use of `dst` on the graphics queue
+        void uploadBuffer(std::span<std::byte const> data,
+                          vk::Buffer dst,
+                          vk::DeviceSize dstOffset,
+                          vk::PipelineStageFlags2 dstStage,
+                          vk::AccessFlags2 dstAccess);
+
+        // `data` is laid out as described at Texture::recordCopy. The texture ends up in
+        // eShaderReadOnlyOptimal, its handle has to stay alive until the upload is ready.
+        void uploadTexture(Texture const& texture,
+                           std::span<std::byte const> data,
+                           uint32_t providedMipLevels                        = 1,
+                           std::span<vk::DeviceSize const> subresourceOffsets = {});
+
+        // Submits the open batch, if anything was recorded. The ticket covers every upload made so far.
+        auto submit() -> UploadTicket;
+
+        // What the next submit() is going to return
+        [[nodiscard]] auto getRecordingTicket() const -> UploadTicket
+        {
+            return { m_timeline.getSubmittedValue() + 1 };
+        }
+
+        // Records the acquire barriers and mip blits of every batch the transfer queue has finished, at the
+        // start of a frame's command buffer. That submission has to wait on getWaitInfo().
+        void recordAcquires(vk::CommandBuffer commandBuffer);
+
+        [[nodiscard]] auto getWaitInfo() const -> vk::SemaphoreSubmitInfo;
+
+        // The upload has been acquired by a graphics command buffer, commands recorded after that
+        // recordAcquires() may use it
+        [[nodiscard]] auto isReady(UploadTicket ticket) const -> bool
+        {
+            return ticket.value <= m_acquiredValue;
+        }
+
+        // Blocks until the transfer queue is done with `ticket`, submitting the open batch if the ticket
+        // belongs to it. The acquires still go out with the next recordAcquires().
+        void wait(UploadTicket ticket);
+
+    private:
+        struct MipChain
+        {
+            vk::Image image;
+            vk::Extent2D dimensions;
+            vk::Format format;
+            uint32_t mipLevels;
+            uint32_t arrayLayers;
+        };
+
+        struct Acquires
+        {
+            std::vector<vk::BufferMemoryBarrier2> buffers;
+            std::vector<vk::ImageMemoryBarrier2> images;
+            std::vector<MipChain> mipChains;
+        };
+
+        struct Batch
+        {
+            uint64_t value { 0 };
+            vk::raii::CommandBuffer commandBuffer { nullptr };
+
+            // Ring position past the batch's last upload, everything before it is free once it completes
+            vk::DeviceSize ringEnd { 0 };
+            std::vector<GPUBuffer> dedicatedStaging;
+
+            Acquires acquires;
+        };
+
+        struct Staging
+        {
+            vk::Buffer buffer;
+            vk::DeviceSize offset;
+        };
+
+        // Copies `data` into the ring or a dedicated buffer and makes sure the open batch is recording
+        auto stage(std::span<std::byte const> data) -> Staging;
+
+        // Returns the ring offset of `size` free bytes, waiting for batches to complete if there aren't any
+        auto allocateRing(vk::DeviceSize size) -> vk::DeviceSize;
+
+        // Retires the batches the transfer queue has finished
+        void reclaim();
+
+        [[nodiscard]] auto isOwnershipTransferred() const -> bool;
+
+        Device* m_device { nullptr };
+        Allocator* m_allocator { nullptr };
+
+        vk::raii::CommandPool m_commandPool { nullptr };
+        std::vector<vk::raii::CommandBuffer> m_freeCommandBuffers;
+
+        Timeline m_timeline;
+        uint64_t m_completedValue { 0 };
+        uint64_t m_acquiredValue { 0 };
+
+        GPUBuffer m_ring;
+        vk::DeviceSize m_ringSize { 0 };
+
+        // Monotonic byte positions, wrapped into the ring on use
+        vk::DeviceSize m_ringHead { 0 };
+        vk::DeviceSize m_ringTail { 0 };
+
+        Batch m_recording;
+        std::deque<Batch> m_inFlight;
+
+        // Of completed batches, waiting for the next recordAcquires()
+        Acquires m_completed;
+    };
+}  // namespace renderer::backend
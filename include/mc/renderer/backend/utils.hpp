@@ -9,8 +9,7 @@
 #include "mc/renderer/backend/vk_checker.hpp"
 #include "mc/utils.hpp"
 
-#include <filesystem>
-#include <vector>
+#include <span>
 
 #include <vulkan/vulkan_raii.hpp>
 #include <vulkan/vulkan_structs.hpp>
@@ -26,13 +25,11 @@ namespace renderer::backend
                              void* data) -> GPUBuffer;
 
     inline auto createShaderModule(vk::raii::Device const& device,
-                                   std::filesystem::path const& shaderPath) -> vk::raii::ShaderModule
+                                   std::span<uint32_t const> code) -> vk::raii::ShaderModule
     {
-        std::vector<char> shaderCode = utils::readBytes(shaderPath);
-
         return device.createShaderModule({
-                   .codeSize = shaderCode.size(),
-                   .pCode    = reinterpret_cast<uint32_t const*>(shaderCode.data()),
+                   .codeSize = code.size_bytes(),
+                   .pCode    = code.data(),
                }) >>
                ResultChecker();
     };
@@ -7,6 +7,8 @@
 
 #include "mc/events.hpp"
 
+#include <filesystem>
+
 namespace renderer
 {
     class Renderer
@@ -19,6 +21,8 @@ namespace renderer
         void onKeyPress(KeyPressEvent const& event);
         void onFramebufferResize(WindowFramebufferResizeEvent const& event);
 
+        void loadScene(std::filesystem::path const& path, backend::VertexFormat vertexFormat);
+
     private:
         Camera& m_camera;
 
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace utils
+{
+    // Fixed set of worker threads draining a FIFO job queue. Jobs must not touch Vulkan handles that the main
+    // thread is recording with; they're meant for CPU work like decoding and encoding.
+    class ThreadPool
+    {
+    public:
+        // Leaves one hardware thread for the main/render thread
+        explicit ThreadPool(size_t threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1);
+
+        ~ThreadPool();
+
+        ThreadPool(ThreadPool const&)                    = delete;
+        auto operator=(ThreadPool const&) -> ThreadPool& = delete;
+
+        ThreadPool(ThreadPool&&)                    = delete;
+        auto operator=(ThreadPool&&) -> ThreadPool& = delete;
+
+        template<typename Fn>
+        auto submit(Fn&& fn) -> std::future<std::invoke_result_t<Fn>>
+        {
+            using Result = std::invoke_result_t<Fn>;
+
+            // std::function needs a copyable target, so the move-only task lives behind a shared_ptr
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+
+            std::future<Result> future = task->get_future();
+
+            push([task] { (*task)(); });
+
+            return future;
+        }
+
+        [[nodiscard]] auto getThreadCount() const -> size_t { return m_workers.size(); }
+
+    private:
+        void push(std::function<void()> job);
+
+        void workerLoop(std::stop_token stopToken);
+
+        std::mutex m_mutex;
+        std::condition_variable_any m_condition;
+        std::deque<std::function<void()>> m_jobs;
+
+        std::vector<std::jthread> m_workers;
+    };
+}  // namespace utils
@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <span>
 #include <vector>
 
 #include "asserts.hpp"
@@ -28,6 +29,12 @@ namespace utils
         return buffer;
     }
 
+    // Highest resident set size the process has reached so far, in bytes. Returns 0 on unsupported platforms.
+    auto getPeakResidentMemory() -> size_t;
+
+    // Fast non-cryptographic 64-bit hash, stable across runs and platforms. Good enough for cache keys.
+    auto hashBytes(std::span<std::byte const> bytes, uint64_t seed = 0) -> uint64_t;
+
     template<typename Class, typename Ret, typename... Args>
     auto captureThis(Ret (Class::*func)(Args...), Class* instance) -> std::function<Ret(Args...)>
     {
@@ -0,0 +1,90 @@
+// Shared by vs.vert and fs.frag, which have to enable GL_EXT_buffer_reference and GL_EXT_scalar_block_layout
+
+// Constants, so checks against specialized features fold away
+const uint MaterialFeatures_ColorTexture     = 1 << 0;
+const uint MaterialFeatures_NormalTexture    = 1 << 1;
+const uint MaterialFeatures_RoughnessTexture = 1 << 2;
+const uint MaterialFeatures_OcclusionTexture = 1 << 3;
+const uint MaterialFeatures_EmissiveTexture =  1 << 4;
+const uint MaterialFeatures_TangentVertexAttribute = 1 << 5;
+const uint MaterialFeatures_TexcoordVertexAttribute = 1 << 6;
+const uint MaterialFeatures_DoubleSided = 1 << 7;
+const uint MaterialFeatures_AlphaBlend = 1 << 8;
+
+// Indices into Material.textures, in MaterialTextures order
+const uint MaterialTexture_Color     = 0;
+const uint MaterialTexture_Roughness = 1;
+const uint MaterialTexture_Occlusion = 2;
+const uint MaterialTexture_Emissive  = 3;
+const uint MaterialTexture_Normal    = 4;
+
+struct Vertex {
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 tangent;
+};
+
+struct QuantizedVertex {
+    uint positionXY;
+    uint positionZTangentSign;
+    uint normal;
+    uint tangent;
+    uint uv;
+};
+
+struct Material {
+    vec4 baseColorFactor;
+
+    vec3 emissiveFactor;
+    float metallicFactor;
+
+    float roughnessFactor;
+    float occlusionFactor;
+    uint flags;
+
+    // Slots in the bindless texture array
+    uint textures[5];
+};
+
+// MeshletDraw in meshlet_cull.comp
+struct Draw {
+    uint firstIndex;
+    int vertexOffset;
+    uint nodeIndex;
+    uint commandRange;
+
+    vec3 positionOffset;
+    uint materialIndex;
+    vec4 positionScale;
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer {
+	Vertex vertices[];
+};
+
+layout(buffer_reference, std430) readonly buffer QuantizedVertexBuffer {
+	QuantizedVertex vertices[];
+};
+
+layout(buffer_reference, std430) readonly buffer MaterialBuffer {
+	Material materials[];
+};
+
+layout(buffer_reference, std430) readonly buffer DrawBuffer {
+	Draw draws[];
+};
+
+// World matrix per scene graph node
+layout(buffer_reference, std430) readonly buffer NodeBuffer {
+	mat4 worldTransforms[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+    VertexBuffer vertexBuffer;
+    MaterialBuffer materialBuffer;
+    DrawBuffer drawBuffer;
+    NodeBuffer nodeBuffer;
+};
@@ -1,16 +1,12 @@
 #version 460
 
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_nonuniform_qualifier : require
 #extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_scalar_block_layout : require
 
 #include "uniforms.glsl"
-
-uint MaterialFeatures_ColorTexture     = 1 << 0;
-uint MaterialFeatures_NormalTexture    = 1 << 1;
-uint MaterialFeatures_RoughnessTexture = 1 << 2;
-uint MaterialFeatures_OcclusionTexture = 1 << 3;
-uint MaterialFeatures_EmissiveTexture =  1 << 4;
-uint MaterialFeatures_TangentVertexAttribute = 1 << 5;
-uint MaterialFeatures_TexcoordVertexAttribute = 1 << 6;
+#include "draw.glsl"
 
 // layout(std140, binding = 0) uniform LocalConstants {
 //     mat4 m;
@@ -19,32 +15,32 @@ uint MaterialFeatures_TexcoordVertexAttribute = 1 << 6;
 //     vec4 light;
 // };
 
-layout (set = 1, binding = 0) uniform sampler2D diffuseTexture;
-layout (set = 1, binding = 1) uniform sampler2D roughnessMetalnessTexture;
-layout (set = 1, binding = 2) uniform sampler2D occlusionTexture;
-layout (set = 1, binding = 3) uniform sampler2D emissiveTexture;
-layout (set = 1, binding = 4) uniform sampler2D normalTexture;
-
-layout(std140, set = 1, binding = 5) uniform MaterialConstant {
-    vec4 base_color_factor;
-    mat4 model;
-    mat4 model_inv;
-
-    vec3  emissive_factor;
-    float metallic_factor;
-
-    float roughness_factor;
-    float occlusion_factor;
-    uint  flags;
-};
+// Indexed with Material.textures, see BindlessTextures
+layout (set = 1, binding = 0) uniform sampler2D textures[];
 
 layout (location = 0) in vec2 vTexcoord0;
 layout (location = 1) in vec3 vNormal;
 layout (location = 2) in vec4 vTangent;
 layout (location = 3) in vec4 vPosition;
+layout (location = 4) flat in uint vMaterialIndex;
 
 layout (location = 0) out vec4 frag_color;
 
+// kUberMaterialFeatures, the uber-shader reads the features from Material.flags
+const uint kUberMaterialFeatures = 0xffffffff;
+
+// The MaterialFeatures of every material drawn with this pipeline, out of kSpecializedMaterialFeatures
+layout(constant_id = 1) const uint kMaterialFeatures = kUberMaterialFeatures;
+
+// DrawPass::Blended, the pipeline blends with the material's alpha. Opaque pipelines write 1.
+layout(constant_id = 2) const bool kAlphaBlend = false;
+
+bool hasFeature( Material material, uint feature ) {
+    uint features = kMaterialFeatures == kUberMaterialFeatures ? material.flags : kMaterialFeatures;
+
+    return ( features & feature ) != 0;
+}
+
 #define PI 3.1415926538
 
 vec3 decode_srgb( vec3 c ) {
@@ -93,17 +89,29 @@ vec3 encode_srgb( vec3 c ) {
     return clamp( result, 0.0, 1.0 );
 }
 
+vec4 sampleMaterialTexture( Material material, uint index, vec2 uv ) {
+    return texture( textures[nonuniformEXT( material.textures[index] )], uv );
+}
+
 float heaviside( float v ) {
     if ( v > 0.0 ) return 1.0;
     else return 0.0;
 }
 
 void main() {
-    frag_color = vec4(texture(diffuseTexture, vTexcoord0).rgb, 1.0);
+    Material material = materialBuffer.materials[vMaterialIndex];
+
+    vec4 color = material.baseColorFactor;
+
+    if ( hasFeature( material, MaterialFeatures_ColorTexture ) ) {
+        color *= sampleMaterialTexture(material, MaterialTexture_Color, vTexcoord0);
+    }
+
+    frag_color = vec4(color.rgb, kAlphaBlend ? color.a : 1.0);
     //
     // mat3 TBN = mat3( 1.0 );
     //
-    // if ( ( flags & MaterialFeatures_TangentVertexAttribute ) != 0 ) {
+    // if ( ( material.flags & MaterialFeatures_TangentVertexAttribute ) != 0 ) {
     //     vec3 tangent = normalize( vTangent.xyz );
     //     vec3 bitangent = cross( normalize( vNormal ), tangent ) * vTangent.w;
     //
@@ -140,44 +148,46 @@ void main() {
     // vec3 L = normalize( pointLight.position.xyz - vPosition.xyz );
     // // NOTE(marco): normal textures are encoded to [0, 1] but need to be mapped to [-1, 1] value
     // vec3 N = normalize( vNormal );
-    // if ( ( flags & MaterialFeatures_NormalTexture ) != 0 ) {
-    //     N = normalize( texture(normalTexture, vTexcoord0).rgb * 2.0 - 1.0 );
+    // if ( ( material.flags & MaterialFeatures_NormalTexture ) != 0 ) {
+    //     // Baked normal maps are BC5, only x and y are stored
+    //     vec2 xy = sampleMaterialTexture(material, MaterialTexture_Normal, vTexcoord0).rg * 2.0 - 1.0;
+    //     N = normalize( vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0))) );
     //     N = normalize( TBN * N );
     // }
     // vec3 H = normalize( L + V );
     //
-    // float roughness = roughness_factor;
-    // float metalness = metallic_factor;
+    // float roughness = material.roughnessFactor;
+    // float metalness = material.metallicFactor;
     //
-    // if ( ( flags & MaterialFeatures_RoughnessTexture ) != 0 ) {
+    // if ( ( material.flags & MaterialFeatures_RoughnessTexture ) != 0 ) {
     //     // Red channel for occlusion value
     //     // Green channel contains roughness values
     //     // Blue channel contains metalness
-    //     vec4 rm = texture(roughnessMetalnessTexture, vTexcoord0);
+    //     vec4 rm = sampleMaterialTexture(material, MaterialTexture_Roughness, vTexcoord0);
     //
     //     roughness *= rm.g;
     //     metalness *= rm.b;
     // }
     //
     // float ao = 1.0f;
-    // if ( ( flags & MaterialFeatures_OcclusionTexture ) != 0 ) {
-    //     ao = texture(occlusionTexture, vTexcoord0).r;
+    // if ( ( material.flags & MaterialFeatures_OcclusionTexture ) != 0 ) {
+    //     ao = sampleMaterialTexture(material, MaterialTexture_Occlusion, vTexcoord0).r;
     // }
     //
     // float alpha = pow(roughness, 2.0);
     //
-    // vec4 base_colour = base_color_factor;
-    // if ( ( flags & MaterialFeatures_ColorTexture ) != 0 ) {
-    //     vec4 albedo = texture( diffuseTexture, vTexcoord0 );
+    // vec4 base_colour = material.baseColorFactor;
+    // if ( ( material.flags & MaterialFeatures_ColorTexture ) != 0 ) {
+    //     vec4 albedo = sampleMaterialTexture( material, MaterialTexture_Color, vTexcoord0 );
     //     base_colour.rgb *= decode_srgb( albedo.rgb );
     //     base_colour.a *= albedo.a;
     // }
     //
     // vec3 emissive = vec3( 0 );
-    // if ( ( flags & MaterialFeatures_EmissiveTexture ) != 0 ) {
-    //     vec4 e = texture(emissiveTexture, vTexcoord0);
+    // if ( ( material.flags & MaterialFeatures_EmissiveTexture ) != 0 ) {
+    //     vec4 e = sampleMaterialTexture(material, MaterialTexture_Emissive, vTexcoord0);
     //
-    //     emissive += decode_srgb( e.rgb ) * emissive_factor;
+    //     emissive += decode_srgb( e.rgb ) * material.emissiveFactor;
     // }
     //
     // // https://www.khronos.org/registry/glTF/specs/2.0/glTF-2.0.html#specular-brdf
@@ -209,7 +219,7 @@ void main() {
     //
     //     vec3 material_colour = mix( fresnel_mix, conductor_fresnel, metalness );
     //
-    //     material_colour = emissive + mix( material_colour, material_colour * ao, occlusion_factor);
+    //     material_colour = emissive + mix( material_colour, material_colour * ao, material.occlusionFactor);
     //
     //     frag_color = vec4( encode_srgb( material_colour ), base_colour.a );
     // } else {
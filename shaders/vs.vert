@@ -5,63 +5,56 @@
 #extension GL_EXT_scalar_block_layout : require
 
 #include "uniforms.glsl"
+#include "draw.glsl"
 
-uint MaterialFeatures_ColorTexture     = 1 << 0;
-uint MaterialFeatures_NormalTexture    = 1 << 1;
-uint MaterialFeatures_RoughnessTexture = 1 << 2;
-uint MaterialFeatures_OcclusionTexture = 1 << 3;
-uint MaterialFeatures_EmissiveTexture =  1 << 4;
-uint MaterialFeatures_TangentVertexAttribute = 1 << 5;
-uint MaterialFeatures_TexcoordVertexAttribute = 1 << 6;
+// Matches the scene's VertexFormat
+layout(constant_id = 0) const bool kQuantizedVertices = false;
 
-struct Vertex {
-    vec3 position;
-    float uv_x;
-    vec3 normal;
-    float uv_y;
-    vec4 tangent;
-};
-
-struct Material {
-    vec4 baseColorFactor;
-
-    vec3 emissiveFactor;
-    float metallicFactor;
+layout (location = 0) out vec2 vTexcoord0;
+layout (location = 1) out vec3 vNormal;
+layout (location = 2) out vec4 vTangent;
+layout (location = 3) out vec4 vPosition;
+layout (location = 4) flat out uint vMaterialIndex;
 
-    float roughnessFactor;
-    float occlusionFactor;
-    uint flags;
-    uint pad;
-};
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
 
-layout(buffer_reference, std430) readonly buffer VertexBuffer {
-	Vertex vertices[];
-};
+    return normalize(n);
+}
 
-layout(buffer_reference, std430) readonly buffer MaterialBuffer {
-	Material materials[];
-};
+Vertex loadVertex(int index, Draw draw) {
+    if (!kQuantizedVertices) {
+        return vertexBuffer.vertices[index];
+    }
 
-layout(push_constant) uniform PushConstants
-{
-    mat4 model;
+    QuantizedVertex quantized = QuantizedVertexBuffer(vertexBuffer).vertices[index];
 
-    VertexBuffer vertexBuffer;
-    MaterialBuffer materialBuffer;
+    vec2 positionZTangentSign = unpackUnorm2x16(quantized.positionZTangentSign);
+    vec3 position = vec3(unpackUnorm2x16(quantized.positionXY), positionZTangentSign.x);
+    vec2 uv = unpackHalf2x16(quantized.uv);
 
-    uint materialIndex;
-};
+    Vertex vertex;
+    vertex.position = draw.positionOffset + position * draw.positionScale.xyz;
+    vertex.normal = decodeOctahedral(unpackSnorm2x16(quantized.normal));
+    vertex.tangent = vec4(decodeOctahedral(unpackSnorm2x16(quantized.tangent)),
+                          positionZTangentSign.y > 0.5 ? 1.0 : -1.0);
+    vertex.uv_x = uv.x;
+    vertex.uv_y = uv.y;
 
-layout (location = 0) out vec2 vTexcoord0;
-layout (location = 1) out vec3 vNormal;
-layout (location = 2) out vec4 vTangent;
-layout (location = 3) out vec4 vPosition;
+    return vertex;
+}
 
 void main() {
-    Vertex vertex = vertexBuffer.vertices[gl_VertexIndex];
+    // Every indirect command carries its draw's index as firstInstance
+    Draw draw = drawBuffer.draws[gl_InstanceIndex];
+    Vertex vertex = loadVertex(gl_VertexIndex, draw);
+    mat4 model = nodeBuffer.worldTransforms[draw.nodeIndex];
 
     gl_Position = sceneData.viewProj * model * vec4(vertex.position, 1.0);
     vPosition = model * vec4(vertex.position, 1.0);
+    vMaterialIndex = draw.materialIndex;
 
     vTexcoord0 = vec2(vertex.uv_x, vertex.uv_y);
     // if ( ( flags & MaterialFeatures_TexcoordVertexAttribute ) != 0 ) {
@@ -68,6 +68,20 @@ void Camera::pitch(float angle)
     m_viewDirty = true;
 }
 
+void Camera::setYaw(float angle)
+{
+    m_yaw = angle;
+
+    m_viewDirty = true;
+}
+
+void Camera::setPitch(float angle)
+{
+    m_pitch = std::clamp(angle, -89.f, 89.f);
+
+    m_viewDirty = true;
+}
+
 void Camera::onUpdate(AppUpdateEvent const& event)
 {
     if (!m_viewDirty)
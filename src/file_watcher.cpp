@@ -0,0 +1,100 @@
+#include <mc/file_watcher.hpp>
+#include <mc/logger.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#    include <sys/inotify.h>
+#    include <unistd.h>
+#endif
+
+namespace utils
+{
+#ifdef __linux__
+    FileWatcher::FileWatcher(std::filesystem::path directory) : m_directory { std::move(directory) }
+    {
+        m_handle = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+        if (m_handle == -1)
+        {
+            logger::warn("Failed to create an inotify instance: {}", std::strerror(errno));
+
+            return;
+        }
+
+        // Editors either rewrite the file in place or write a temporary and rename it over the original
+        if (::inotify_add_watch(m_handle, m_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+        {
+            logger::warn("Failed to watch '{}': {}", m_directory.string(), std::strerror(errno));
+
+            close();
+        }
+    }
+
+    auto FileWatcher::poll() -> std::vector<std::filesystem::path>
+    {
+        std::vector<std::filesystem::path> changed;
+
+        if (m_handle == -1)
+        {
+            return changed;
+        }
+
+        alignas(inotify_event) char buffer[4096];
+
+        while (true)
+        {
+            ssize_t const length = ::read(m_handle, buffer, sizeof(buffer));
+
+            // EAGAIN once the queue is drained
+            if (length <= 0)
+            {
+                break;
+            }
+
+            for (ssize_t offset = 0; offset < length;)
+            {
+                auto const* event = reinterpret_cast<inotify_event const*>(buffer + offset);
+
+                if (event->len > 0)
+                {
+                    std::filesystem::path path = m_directory / event->name;
+
+                    if (std::ranges::find(changed, path) == changed.end())
+                    {
+                        changed.push_back(std::move(path));
+                    }
+                }
+
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+
+        return changed;
+    }
+
+    void FileWatcher::close()
+    {
+        if (m_handle != -1)
+        {
+            ::close(std::exchange(m_handle, -1));
+        }
+    }
+#else
+    FileWatcher::FileWatcher(std::filesystem::path directory) : m_directory { std::move(directory) } {}
+
+    auto FileWatcher::poll() -> std::vector<std::filesystem::path>
+    {
+        return {};
+    }
+
+    void FileWatcher::close() {}
+#endif
+
+    FileWatcher::~FileWatcher()
+    {
+        close();
+    }
+}  // namespace utils
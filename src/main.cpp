@@ -1,13 +1,25 @@
+#include <mc/camera.hpp>
 #include <mc/events.hpp>
 #include <mc/exceptions.hpp>
 #include <mc/game/game.hpp>
 #include <mc/logger.hpp>
+#include <mc/renderer/backend/image_writer.hpp>
+#include <mc/renderer/backend/scene_cache.hpp>
 #include <mc/renderer/renderer.hpp>
+#include <mc/thread_pool.hpp>
 #include <mc/timer.hpp>
 
 #include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
 #include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
 
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
 #include <tracy/Tracy.hpp>
 
 #ifdef __linux__
@@ -18,15 +30,145 @@
 
 void switchCwd();
 
-auto main() -> int
+// What the last headless frame is checked against. Up to `maxDifferingFraction` of its pixels may have a
+// channel more than `tolerance` off the reference, which leaves room for rasterizer differences on edges.
+struct ReferenceImage
 {
+    std::filesystem::path path;
+    uint8_t tolerance { 8 };
+    double maxDifferingFraction { 0.01 };
+};
+
+auto runHeadless(renderer::backend::HeadlessSettings const& settings,
+                 uint64_t frameCount,
+                 std::filesystem::path const& scenePath,
+                 renderer::backend::VertexFormat vertexFormat,
+                 ReferenceImage const& reference) -> int;
+
+// Leaves `value` as it is when `text` isn't a number
+template<typename T>
+void parseNumber(std::string_view text, T& value)
+{
+    std::from_chars(text.data(), text.data() + text.size(), value);
+}
+
+auto main(int argc, char** argv) -> int
+{
+    std::span<char*> args { argv, static_cast<size_t>(argc) };
+
+    // `--bake <scene.gltf>` writes the scene cache and exits without opening a window. The path is resolved
+    // before switching to the executable's directory so that it is relative to where the command was run.
+    // `--float-vertices` bakes the uncompressed vertex layout instead of the quantized one and
+    // `--encoder-effort <none|fast|normal|high>` picks how hard textures are block-compressed.
+    std::filesystem::path bakePath;
+    auto vertexFormat  = renderer::backend::VertexFormat::Quantized;
+    auto encoderEffort = renderer::backend::BlockEncoderEffort::Normal;
+
+    // `--scene <scene.gltf>` loads a scene to draw, with the vertex layout `--float-vertices` picks.
+    // res/scenes/occlusion_test/occlusion_test.gltf exercises the culling passes.
+    std::filesystem::path scenePath;
+
+    // `--headless <frames>` renders that many frames without a window and exits, for benchmarks on software
+    // Vulkan in CI. `--size <width>x<height>` sets the frame size, `--output <directory>` writes every frame
+    // there as PNG, or as OpenEXR with `--exr`.
+    uint64_t headlessFrames = 0;
+    renderer::backend::HeadlessSettings headlessSettings;
+
+    // `--compare <reference.png>` fails the headless run when its last frame doesn't match the reference,
+    // `--tolerance <0-255>` sets how far a channel may be off. A new reference is one of the PNGs `--output`
+    // writes, rendered on the same driver as the runs it's compared with.
+    ReferenceImage reference;
+
+    for (size_t i = 1; i < args.size(); ++i)
+    {
+        std::string_view arg = args[i];
+
+        if (arg == "--bake" && i + 1 < args.size())
+        {
+            bakePath = std::filesystem::absolute(args[++i]);
+        }
+        else if (arg == "--scene" && i + 1 < args.size())
+        {
+            scenePath = std::filesystem::absolute(args[++i]);
+        }
+        else if (arg == "--headless" && i + 1 < args.size())
+        {
+            parseNumber(args[++i], headlessFrames);
+        }
+        else if (arg == "--size" && i + 1 < args.size())
+        {
+            std::string_view size = args[++i];
+
+            if (size_t separator = size.find('x'); separator != std::string_view::npos)
+            {
+                parseNumber(size.substr(0, separator), headlessSettings.extent.width);
+                parseNumber(size.substr(separator + 1), headlessSettings.extent.height);
+            }
+        }
+        else if (arg == "--output" && i + 1 < args.size())
+        {
+            headlessSettings.outputDirectory = std::filesystem::absolute(args[++i]);
+        }
+        else if (arg == "--compare" && i + 1 < args.size())
+        {
+            reference.path = std::filesystem::absolute(args[++i]);
+        }
+        else if (arg == "--tolerance" && i + 1 < args.size())
+        {
+            parseNumber(args[++i], reference.tolerance);
+        }
+        else if (arg == "--exr")
+        {
+            headlessSettings.exr = true;
+        }
+        else if (arg == "--float-vertices")
+        {
+            vertexFormat = renderer::backend::VertexFormat::Float;
+        }
+        else if (arg == "--encoder-effort" && i + 1 < args.size())
+        {
+            std::string_view name = args[++i];
+
+            for (auto effort : { renderer::backend::BlockEncoderEffort::None,
+                                 renderer::backend::BlockEncoderEffort::Fast,
+                                 renderer::backend::BlockEncoderEffort::Normal,
+                                 renderer::backend::BlockEncoderEffort::High })
+            {
+                if (name == renderer::backend::getBlockEncoderEffortName(effort))
+                {
+                    encoderEffort = effort;
+                }
+            }
+        }
+    }
+
     switchCwd();
 
     logger::Logger::init();
 
+    if (!bakePath.empty())
+    {
+        MC_TRY
+        {
+            utils::ThreadPool threadPool;
+            renderer::backend::bakeSceneCache(bakePath, vertexFormat, encoderEffort, threadPool);
+        }
+        MC_CATCH(...)
+        {
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
     [[maybe_unused]] std::string_view appName = "Minecraft Clone Game";
     TracyAppInfo(appName.data(), appName.size());
 
+    if (headlessFrames > 0)
+    {
+        return runHeadless(headlessSettings, headlessFrames, scenePath, vertexFormat, reference);
+    }
+
     EventManager eventManager {};
     window::Window window { eventManager };
     Camera camera;
@@ -34,6 +176,11 @@ auto main() -> int
 
     game::Game game { eventManager, window, camera };
 
+    if (!scenePath.empty())
+    {
+        m_renderer.loadScene(scenePath, vertexFormat);
+    }
+
     eventManager.subscribe(&camera, &Camera::onUpdate, &Camera::onFramebufferResize);
 
     MC_TRY
@@ -60,6 +207,106 @@ auto main() -> int
     return EXIT_SUCCESS;
 }
 
+auto runHeadless(renderer::backend::HeadlessSettings const& settings,
+                 uint64_t frameCount,
+                 std::filesystem::path const& scenePath,
+                 renderer::backend::VertexFormat vertexFormat,
+                 ReferenceImage const& reference) -> int
+{
+    MC_TRY
+    {
+        renderer::backend::RendererBackend renderer { settings };
+
+        Camera camera;
+        camera.setLens(glm::radians(45.0f), renderer.getFramebufferSize(), 1000.f, 0.1f);
+
+        if (scenePath.empty())
+        {
+            // Where the game starts out
+            camera.lookAt(glm::vec3 { 1.25f, 1.4f, -1.25f }, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
+            camera.pitch(40.f);
+            camera.yaw(-50.0f);
+        }
+        else
+        {
+            renderer.processGltf(scenePath, vertexFormat);
+
+            // Scenes are viewed from the same spot every run, looking down at the origin. onUpdate aims the
+            // camera by its pitch and yaw, which are derived from the direction it looks in.
+            glm::vec3 const scenePosition { 0.f, 3.f, 10.f };
+            glm::vec3 const sceneLook = glm::normalize(-scenePosition);
+
+            camera.setPosition(scenePosition);
+            camera.setPitch(glm::degrees(std::asin(sceneLook.y)));
+            camera.setYaw(glm::degrees(std::atan2(sceneLook.z, sceneLook.x)));
+        }
+
+        Timer timer;
+
+        auto const startTime = Timer::Clock::now();
+
+        for (uint64_t frame = 0; frame < frameCount; ++frame)
+        {
+            camera.onUpdate(AppUpdateEvent { timer });
+
+            renderer.update(camera.getPosition(), camera.getView(), camera.getProj());
+            renderer.render();
+
+            timer.tick();
+
+            FrameMark;
+        }
+
+        renderer.finishFrames();
+
+        double const elapsed = Timer::Milliseconds(Timer::Clock::now() - startTime).count();
+
+        logger::info("Rendered {} frames at {}x{} in {:.2f} ms, {:.3f} ms per frame",
+                     frameCount,
+                     settings.extent.width,
+                     settings.extent.height,
+                     elapsed,
+                     elapsed / static_cast<double>(frameCount));
+
+        if (!reference.path.empty())
+        {
+            std::vector<uint16_t> const pixels = renderer.readLastFrame();
+            uint8_t const tolerance            = reference.tolerance;
+
+            auto const difference =
+                renderer::backend::compareWithPng(reference.path, settings.extent, pixels, tolerance);
+
+            if (!difference)
+            {
+                return EXIT_FAILURE;
+            }
+
+            double const differingFraction = static_cast<double>(difference->differingPixelCount) /
+                                             static_cast<double>(difference->pixelCount);
+
+            logger::info("{:.3f}% of the last frame's pixels are more than {} off '{}', by up to {}",
+                         differingFraction * 100.0,
+                         static_cast<uint32_t>(tolerance),
+                         reference.path.filename().string(),
+                         static_cast<uint32_t>(difference->maxDifference));
+
+            if (differingFraction > reference.maxDifferingFraction)
+            {
+                logger::error("The last frame doesn't match the reference, more than {:.3f}% of it differs",
+                              reference.maxDifferingFraction * 100.0);
+
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    MC_CATCH(...)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
 void switchCwd()
 {
 #ifdef __linux__
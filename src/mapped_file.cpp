@@ -0,0 +1,228 @@
+#include <mc/exceptions.hpp>
+#include <mc/mapped_file.hpp>
+
+#include <fstream>
+#include <system_error>
+
+#ifdef __linux__
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#elif defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#endif
+
+namespace utils
+{
+#ifdef __linux__
+    MappedFile::MappedFile(std::filesystem::path const& path, size_t padding)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd == -1)
+        {
+            MC_THROW Error(AssetError, std::format("Failed to open '{}' for mapping", path.string()));
+        }
+
+        struct stat fileStat {};
+
+        if (::fstat(fd, &fileStat) == -1)
+        {
+            ::close(fd);
+
+            MC_THROW Error(AssetError, std::format("Failed to stat '{}'", path.string()));
+        }
+
+        auto const pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+
+        m_size        = static_cast<size_t>(fileStat.st_size);
+        m_mappingSize = (m_size + padding + pageSize - 1) / pageSize * pageSize;
+
+        // Nothing to map, mmap rejects empty mappings
+        if (m_mappingSize == 0)
+        {
+            ::close(fd);
+
+            return;
+        }
+
+        // Reserve room for the file and the padding with zeroed anonymous memory first, then map the file on
+        // top of it. The tail of the last file page is zero-filled by the kernel and everything after it is
+        // backed by the anonymous mapping, so overreading into the padding can never fault.
+        void* base =
+            ::mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (base == MAP_FAILED)
+        {
+            ::close(fd);
+
+            MC_THROW Error(AssetError,
+                           std::format("Failed to reserve {} bytes for '{}'", m_mappingSize, path.string()));
+        }
+
+        if (m_size > 0)
+        {
+            void* file = ::mmap(base, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+
+            if (file == MAP_FAILED)
+            {
+                ::munmap(base, m_mappingSize);
+                ::close(fd);
+
+                MC_THROW Error(AssetError, std::format("Failed to map '{}'", path.string()));
+            }
+
+            ::madvise(file, m_size, MADV_WILLNEED);
+        }
+
+        ::close(fd);
+
+        m_data = static_cast<std::byte*>(base);
+    }
+
+    void MappedFile::unmap()
+    {
+        if (m_data == nullptr)
+        {
+            return;
+        }
+
+        ::munmap(m_data, m_mappingSize);
+
+        m_data = nullptr;
+    }
+#elif defined(_WIN32)
+    MappedFile::MappedFile(std::filesystem::path const& path, size_t padding)
+    {
+        m_size        = getFileSize(path);
+        m_mappingSize = m_size + padding;
+
+        // Nothing to map, views of empty files can't be created
+        if (m_mappingSize == 0)
+        {
+            return;
+        }
+
+        // Windows can't stitch an anonymous region behind a file view, so when padding is requested the file
+        // is read instead. Callers that need no padding (raw buffers, images) still get a real mapping.
+        if (padding > 0 || m_size == 0)
+        {
+            readHeapCopy(path);
+
+            return;
+        }
+
+        HANDLE file = CreateFileW(path.c_str(),
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                  nullptr);
+
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            MC_THROW Error(AssetError, std::format("Failed to open '{}' for mapping", path.string()));
+        }
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+
+        if (mapping != nullptr)
+        {
+            m_data = static_cast<std::byte*>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+
+            CloseHandle(mapping);
+        }
+
+        CloseHandle(file);
+
+        if (m_data == nullptr)
+        {
+            MC_THROW Error(AssetError, std::format("Failed to map '{}'", path.string()));
+        }
+    }
+
+    void MappedFile::unmap()
+    {
+        if (m_data == nullptr)
+        {
+            return;
+        }
+
+        if (m_ownsHeapCopy)
+        {
+            delete[] m_data;
+        }
+        else
+        {
+            UnmapViewOfFile(m_data);
+        }
+
+        m_data = nullptr;
+    }
+#else
+    MappedFile::MappedFile(std::filesystem::path const& path, size_t padding)
+    {
+        m_size        = getFileSize(path);
+        m_mappingSize = m_size + padding;
+
+        if (m_mappingSize == 0)
+        {
+            return;
+        }
+
+        readHeapCopy(path);
+    }
+
+    void MappedFile::unmap()
+    {
+        delete[] m_data;
+
+        m_data = nullptr;
+    }
+#endif
+
+#ifndef __linux__
+    auto MappedFile::getFileSize(std::filesystem::path const& path) -> size_t
+    {
+        std::error_code error;
+
+        auto const size = std::filesystem::file_size(path, error);
+
+        if (error)
+        {
+            MC_THROW Error(AssetError,
+                           std::format("Failed to stat '{}': {}", path.string(), error.message()));
+        }
+
+        return static_cast<size_t>(size);
+    }
+
+    void MappedFile::readHeapCopy(std::filesystem::path const& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file.is_open())
+        {
+            MC_THROW Error(AssetError, std::format("Failed to open '{}'", path.string()));
+        }
+
+        m_ownsHeapCopy = true;
+        m_data         = new std::byte[m_mappingSize] {};
+
+        if (!file.read(reinterpret_cast<char*>(m_data), static_cast<std::streamsize>(m_size)))
+        {
+            unmap();
+
+            MC_THROW Error(AssetError, std::format("Failed to read '{}'", path.string()));
+        }
+    }
+#endif
+
+    MappedFile::~MappedFile()
+    {
+        unmap();
+    }
+}  // namespace utils
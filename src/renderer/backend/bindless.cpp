@@ -0,0 +1,131 @@
+#include <mc/asserts.hpp>
+#include <mc/logger.hpp>
+#include <mc/renderer/backend/bindless.hpp>
+#include <mc/renderer/backend/vk_checker.hpp>
+
+#include <algorithm>
+
+namespace renderer::backend
+{
+    BindlessTextures::BindlessTextures(Device const& device) : m_device { &device }
+    {
+        auto const& physicalDevice = static_cast<vk::raii::PhysicalDevice const&>(device);
+
+        auto const limits = physicalDevice
+                                .getProperties2<vk::PhysicalDeviceProperties2,
+                                                vk::PhysicalDeviceVulkan12Properties>()
+                                .get<vk::PhysicalDeviceVulkan12Properties>();
+
+        m_capacity = std::min({ kMaxBindlessTextures,
+                                limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                limits.maxDescriptorSetUpdateAfterBindSamplers,
+                                limits.maxDescriptorSetUpdateAfterBindSampledImages });
+
+        logger::debug("Bindless texture array holds {} textures", m_capacity);
+
+        vk::DescriptorSetLayoutBinding const binding {
+            .binding         = 0,
+            .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = m_capacity,
+            .stageFlags      = vk::ShaderStageFlagBits::eFragment,
+        };
+
+        vk::DescriptorBindingFlags const bindingFlags =
+            vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::ePartiallyBound;
+
+        vk::DescriptorSetLayoutBindingFlagsCreateInfo const bindingFlagsInfo {
+            .bindingCount  = 1,
+            .pBindingFlags = &bindingFlags,
+        };
+
+        m_layout = device->createDescriptorSetLayout({
+                       .pNext        = &bindingFlagsInfo,
+                       .flags        = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+                       .bindingCount = 1,
+                       .pBindings    = &binding,
+                   }) >>
+                   ResultChecker();
+
+        vk::DescriptorPoolSize const poolSize {
+            .type            = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = m_capacity * kMaxFramesInFlight,
+        };
+
+        m_pool = device->createDescriptorPool({
+                     .flags         = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+                     .maxSets       = kMaxFramesInFlight,
+                     .poolSizeCount = 1,
+                     .pPoolSizes    = &poolSize,
+                 }) >>
+                 ResultChecker();
+
+        std::array<vk::DescriptorSetLayout, kMaxFramesInFlight> layouts {};
+        layouts.fill(*m_layout);
+
+        std::vector<vk::DescriptorSet> sets =
+            static_cast<vk::Device>(device).allocateDescriptorSets(
+                vk::DescriptorSetAllocateInfo().setDescriptorPool(*m_pool).setSetLayouts(layouts)) >>
+            ResultChecker();
+
+        std::ranges::copy(sets, m_sets.begin());
+    }
+
+    auto BindlessTextures::add(vk::ImageView imageView, vk::Sampler sampler) -> uint32_t
+    {
+        MC_ASSERT_MSG(m_slotCount < m_capacity, "Ran out of bindless texture slots");
+
+        uint32_t const slot = m_slotCount++;
+
+        set(slot, imageView, sampler);
+
+        return slot;
+    }
+
+    void BindlessTextures::set(uint32_t slot, vk::ImageView imageView, vk::Sampler sampler)
+    {
+        MC_ASSERT(slot < m_slotCount);
+
+        for (std::vector<Write>& writes : m_pendingWrites)
+        {
+            writes.push_back({
+                .slot      = slot,
+                .imageInfo = {
+                    .sampler     = sampler,
+                    .imageView   = imageView,
+                    .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                },
+            });
+        }
+    }
+
+    void BindlessTextures::flush(uint32_t frameIndex)
+    {
+        std::vector<Write>& writes = m_pendingWrites[frameIndex];
+
+        if (writes.empty())
+        {
+            return;
+        }
+
+        std::vector<vk::WriteDescriptorSet> descriptorWrites;
+        descriptorWrites.reserve(writes.size());
+
+        // Writes to the same slot are applied in order, the last one wins
+        for (Write const& write : writes)
+        {
+            descriptorWrites.push_back({
+                .dstSet          = m_sets[frameIndex],
+                .dstBinding      = 0,
+                .dstArrayElement = write.slot,
+                .descriptorCount = 1,
+                .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                .pImageInfo      = &write.imageInfo,
+            });
+        }
+
+        (*m_device)->updateDescriptorSets(descriptorWrites, {});
+
+        writes.clear();
+    }
+}  // namespace renderer::backend
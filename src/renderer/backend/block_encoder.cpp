@@ -0,0 +1,1101 @@
+#include <mc/asserts.hpp>
+#include <mc/renderer/backend/block_encoder.hpp>
+#include <mc/renderer/backend/image.hpp>
+#include <mc/timer.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <utility>
+
+#include <immintrin.h>
+#include <tracy/Tracy.hpp>
+
+namespace rn = std::ranges;
+
+namespace
+{
+    using namespace renderer::backend;
+
+    // 4x4 texels, RGBA8 in row order
+    using Block   = std::array<uint8_t, 64>;
+    using Color   = std::array<float, 4>;
+    using Indices = std::array<uint8_t, 16>;
+
+    // Palette entries in the same int16 RGBA layout as BlockPixels
+    using PaletteColor = std::array<int16_t, 4>;
+
+    // Interpolation weights of BC7's 4-bit indices, out of 64
+    constexpr std::array<int, 16> kBc7Weights { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // Position of each BC1 index between color0 (0) and color1 (1)
+    constexpr std::array<float, 4> kBc1Weights { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+    // Same for BC4's 8 value mode
+    constexpr std::array<float, 8> kBc4Weights {
+        0.f, 1.f, 1.f / 7.f, 2.f / 7.f, 3.f / 7.f, 4.f / 7.f, 5.f / 7.f, 6.f / 7.f,
+    };
+
+    // A block widened to int16 RGBA for the index search, four texels per register. Plain arrays as
+    // std::array drops the vector types' alignment attributes.
+    struct BlockPixels
+    {
+        __m256i rgba[4];
+    };
+
+    auto loadBlock(std::span<uint8_t const> rgba, vk::Extent2D dimensions, uint32_t blockX, uint32_t blockY)
+        -> Block
+    {
+        Block block;
+
+        for (uint32_t y = 0; y < 4; ++y)
+        {
+            uint32_t const sourceY = std::min(blockY * 4 + y, dimensions.height - 1);
+
+            for (uint32_t x = 0; x < 4; ++x)
+            {
+                uint32_t const sourceX = std::min(blockX * 4 + x, dimensions.width - 1);
+
+                std::memcpy(&block[(y * 4 + x) * 4],
+                            &rgba[(static_cast<size_t>(sourceY) * dimensions.width + sourceX) * 4],
+                            4);
+            }
+        }
+
+        return block;
+    }
+
+    // BC1 has no alpha in its opaque mode, so it is masked out of the error
+    auto loadBlockPixels(Block const& block, bool ignoreAlpha) -> BlockPixels
+    {
+        __m256i const mask = _mm256_set1_epi64x(ignoreAlpha ? 0x0000ffffffffffff : -1);
+
+        BlockPixels pixels;
+
+        for (size_t i = 0; i < 4; ++i)
+        {
+            __m128i const texels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(block.data() + i * 16));
+
+            pixels.rgba[i] = _mm256_and_si256(_mm256_cvtepu8_epi16(texels), mask);
+        }
+
+        return pixels;
+    }
+
+    // Picks the closest palette entry for every texel, 8 texels at a time, and returns the summed squared
+    // error
+    auto selectIndices(BlockPixels const& pixels, std::span<PaletteColor const> palette, Indices& indices)
+        -> uint32_t
+    {
+        __m256i bestError[2] { _mm256_set1_epi32(std::numeric_limits<int32_t>::max()),
+                               _mm256_set1_epi32(std::numeric_limits<int32_t>::max()) };
+        __m256i bestIndex[2] { _mm256_setzero_si256(), _mm256_setzero_si256() };
+
+        for (size_t i = 0; i < palette.size(); ++i)
+        {
+            int64_t packed = 0;
+            std::memcpy(&packed, palette[i].data(), sizeof(packed));
+
+            __m256i const color = _mm256_set1_epi64x(packed);
+            __m256i const index = _mm256_set1_epi32(static_cast<int32_t>(i));
+
+            for (size_t half = 0; half < 2; ++half)
+            {
+                __m256i const low  = _mm256_sub_epi16(pixels.rgba[half * 2], color);
+                __m256i const high = _mm256_sub_epi16(pixels.rgba[half * 2 + 1], color);
+
+                // madd sums R+G and B+A, hadd the two halves of every texel
+                __m256i const error =
+                    _mm256_hadd_epi32(_mm256_madd_epi16(low, low), _mm256_madd_epi16(high, high));
+                __m256i const closer = _mm256_cmpgt_epi32(bestError[half], error);
+
+                bestError[half] = _mm256_min_epi32(bestError[half], error);
+                bestIndex[half] = _mm256_blendv_epi8(bestIndex[half], index, closer);
+            }
+        }
+
+        // hadd works within 128-bit lanes, which leaves texels 0 1 4 5 2 3 6 7 in a register
+        __m256i const order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+
+        std::array<int32_t, 16> selected;
+        std::array<int32_t, 16> errors;
+
+        for (size_t half = 0; half < 2; ++half)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(&selected[half * 8]),
+                                _mm256_permutevar8x32_epi32(bestIndex[half], order));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(&errors[half * 8]), bestError[half]);
+        }
+
+        uint32_t totalError = 0;
+
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            indices[i] = static_cast<uint8_t>(selected[i]);
+            totalError += static_cast<uint32_t>(errors[i]);
+        }
+
+        return totalError;
+    }
+
+    auto clampColor(Color color) -> Color
+    {
+        for (float& channel : color)
+        {
+            channel = std::clamp(channel, 0.f, 255.f);
+        }
+
+        return color;
+    }
+
+    // Endpoints on a line through the block's mean, spanning the projections of all texels. The line is
+    // either the principal axis, found with a few power iterations on the covariance matrix, or the bounding
+    // box diagonal with each channel flipped to follow its correlation with the widest one.
+    auto findEndpoints(std::array<Color, 16> const& texels, uint32_t channelCount, bool principalAxis)
+        -> std::pair<Color, Color>
+    {
+        Color mean {};
+
+        for (Color const& texel : texels)
+        {
+            for (uint32_t c = 0; c < channelCount; ++c)
+            {
+                mean[c] += texel[c] / 16.f;
+            }
+        }
+
+        std::array<std::array<float, 4>, 4> covariance {};
+        Color low { 255.f, 255.f, 255.f, 255.f }, high {};
+
+        for (Color const& texel : texels)
+        {
+            for (uint32_t i = 0; i < channelCount; ++i)
+            {
+                low[i]  = std::min(low[i], texel[i]);
+                high[i] = std::max(high[i], texel[i]);
+
+                for (uint32_t j = 0; j < channelCount; ++j)
+                {
+                    covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+                }
+            }
+        }
+
+        uint32_t widest = 0;
+
+        for (uint32_t c = 1; c < channelCount; ++c)
+        {
+            widest = high[c] - low[c] > high[widest] - low[widest] ? c : widest;
+        }
+
+        Color axis {};
+
+        for (uint32_t c = 0; c < channelCount; ++c)
+        {
+            axis[c] = covariance[widest][c] < 0.f ? low[c] - high[c] : high[c] - low[c];
+        }
+
+        if (principalAxis)
+        {
+            for (int iteration = 0; iteration < 8; ++iteration)
+            {
+                Color next {};
+                float largest = 0.f;
+
+                for (uint32_t i = 0; i < channelCount; ++i)
+                {
+                    for (uint32_t j = 0; j < channelCount; ++j)
+                    {
+                        next[i] += covariance[i][j] * axis[j];
+                    }
+
+                    largest = std::max(largest, std::abs(next[i]));
+                }
+
+                if (largest == 0.f)
+                {
+                    break;
+                }
+
+                for (uint32_t c = 0; c < channelCount; ++c)
+                {
+                    axis[c] = next[c] / largest;
+                }
+            }
+        }
+
+        float axisLength = 0.f;
+
+        for (uint32_t c = 0; c < channelCount; ++c)
+        {
+            axisLength += axis[c] * axis[c];
+        }
+
+        if (axisLength < 1e-6f)
+        {
+            return { mean, mean };
+        }
+
+        float minT = std::numeric_limits<float>::max(), maxT = std::numeric_limits<float>::lowest();
+
+        for (Color const& texel : texels)
+        {
+            float t = 0.f;
+
+            for (uint32_t c = 0; c < channelCount; ++c)
+            {
+                t += (texel[c] - mean[c]) * axis[c];
+            }
+
+            minT = std::min(minT, t / axisLength);
+            maxT = std::max(maxT, t / axisLength);
+        }
+
+        Color first {}, second {};
+
+        for (uint32_t c = 0; c < channelCount; ++c)
+        {
+            first[c]  = mean[c] + axis[c] * minT;
+            second[c] = mean[c] + axis[c] * maxT;
+        }
+
+        return { clampColor(first), clampColor(second) };
+    }
+
+    // Least squares fit of both endpoints to the texels, given where along the line each of them was placed.
+    // Empty when every texel sits at the same position.
+    auto refineEndpoints(std::array<Color, 16> const& texels,
+                         std::array<float, 16> const& weights,
+                         uint32_t channelCount) -> std::optional<std::pair<Color, Color>>
+    {
+        float aa = 0.f, ab = 0.f, bb = 0.f;
+        Color ax {}, bx {};
+
+        for (size_t i = 0; i < texels.size(); ++i)
+        {
+            float const b = weights[i], a = 1.f - b;
+
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+
+            for (uint32_t c = 0; c < channelCount; ++c)
+            {
+                ax[c] += a * texels[i][c];
+                bx[c] += b * texels[i][c];
+            }
+        }
+
+        float const determinant = aa * bb - ab * ab;
+
+        if (std::abs(determinant) < 1e-6f)
+        {
+            return std::nullopt;
+        }
+
+        Color first {}, second {};
+
+        for (uint32_t c = 0; c < channelCount; ++c)
+        {
+            first[c]  = (bb * ax[c] - ab * bx[c]) / determinant;
+            second[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+        }
+
+        return std::pair { clampColor(first), clampColor(second) };
+    }
+
+    auto getTexels(Block const& block, std::array<uint8_t, 4> channels) -> std::array<Color, 16>
+    {
+        std::array<Color, 16> texels;
+
+        for (size_t i = 0; i < texels.size(); ++i)
+        {
+            for (size_t c = 0; c < 4; ++c)
+            {
+                texels[i][c] = block[i * 4 + channels[c]];
+            }
+        }
+
+        return texels;
+    }
+
+    auto getRefinementIterations(BlockEncoderEffort effort) -> int
+    {
+        switch (effort)
+        {
+            case BlockEncoderEffort::Normal:
+                return 1;
+            case BlockEncoderEffort::High:
+                return 3;
+            default:
+                return 0;
+        }
+    }
+
+    class BitWriter
+    {
+    public:
+        void write(uint64_t value, uint32_t bitCount)
+        {
+            for (uint32_t bit = 0; bit < bitCount; ++bit, ++m_position)
+            {
+                m_bits[m_position / 64] |= ((value >> bit) & 1) << (m_position % 64);
+            }
+        }
+
+        void store(std::byte* destination) const { std::memcpy(destination, m_bits.data(), 16); }
+
+    private:
+        std::array<uint64_t, 2> m_bits {};
+        uint32_t m_position { 0 };
+    };
+
+    class BitReader
+    {
+    public:
+        explicit BitReader(std::byte const* source) { std::memcpy(m_bits.data(), source, 16); }
+
+        auto read(uint32_t bitCount) -> uint32_t
+        {
+            uint32_t value = 0;
+
+            for (uint32_t bit = 0; bit < bitCount; ++bit, ++m_position)
+            {
+                value |= static_cast<uint32_t>((m_bits[m_position / 64] >> (m_position % 64)) & 1) << bit;
+            }
+
+            return value;
+        }
+
+    private:
+        std::array<uint64_t, 2> m_bits {};
+        uint32_t m_position { 0 };
+    };
+
+    //
+    // BC7 mode 6
+    //
+
+    struct Bc7Endpoint
+    {
+        std::array<int, 4> values;
+        int pBit;
+
+        // 7 bits plus the shared p-bit as the lowest one
+        [[nodiscard]] auto expand(size_t channel) const -> int { return values[channel] << 1 | pBit; }
+    };
+
+    struct Bc7Block
+    {
+        Bc7Endpoint first;
+        Bc7Endpoint second;
+        Indices indices;
+        uint32_t error { std::numeric_limits<uint32_t>::max() };
+    };
+
+    auto quantizeBc7(Color const& color, int pBit) -> Bc7Endpoint
+    {
+        Bc7Endpoint endpoint { .pBit = pBit };
+
+        for (size_t c = 0; c < 4; ++c)
+        {
+            endpoint.values[c] = std::clamp(static_cast<int>(std::lround((color[c] - pBit) / 2.f)), 0, 127);
+        }
+
+        return endpoint;
+    }
+
+    // The p-bit that gets the quantized color closest to `color`
+    auto quantizeBc7(Color const& color) -> Bc7Endpoint
+    {
+        Bc7Endpoint best {};
+        float bestError = std::numeric_limits<float>::max();
+
+        for (int pBit = 0; pBit < 2; ++pBit)
+        {
+            Bc7Endpoint const endpoint = quantizeBc7(color, pBit);
+            float error                = 0.f;
+
+            for (size_t c = 0; c < 4; ++c)
+            {
+                float const difference = static_cast<float>(endpoint.expand(c)) - color[c];
+                error += difference * difference;
+            }
+
+            if (error < bestError)
+            {
+                best      = endpoint;
+                bestError = error;
+            }
+        }
+
+        return best;
+    }
+
+    auto getBc7Palette(Bc7Endpoint const& first, Bc7Endpoint const& second) -> std::array<PaletteColor, 16>
+    {
+        std::array<PaletteColor, 16> palette;
+
+        for (size_t i = 0; i < palette.size(); ++i)
+        {
+            for (size_t c = 0; c < 4; ++c)
+            {
+                palette[i][c] = static_cast<int16_t>(
+                    ((64 - kBc7Weights[i]) * first.expand(c) + kBc7Weights[i] * second.expand(c) + 32) >> 6);
+            }
+        }
+
+        return palette;
+    }
+
+    auto evaluateBc7(BlockPixels const& pixels, Bc7Endpoint const& first, Bc7Endpoint const& second)
+        -> Bc7Block
+    {
+        Bc7Block block { .first = first, .second = second };
+
+        block.error = selectIndices(pixels, getBc7Palette(first, second), block.indices);
+
+        return block;
+    }
+
+    auto fitBc7(BlockPixels const& pixels, std::pair<Color, Color> const& endpoints, bool allPBits)
+        -> Bc7Block
+    {
+        if (!allPBits)
+        {
+            return evaluateBc7(pixels, quantizeBc7(endpoints.first), quantizeBc7(endpoints.second));
+        }
+
+        Bc7Block best;
+
+        for (int pBits = 0; pBits < 4; ++pBits)
+        {
+            Bc7Block candidate = evaluateBc7(
+                pixels, quantizeBc7(endpoints.first, pBits & 1), quantizeBc7(endpoints.second, pBits >> 1));
+
+            best = candidate.error < best.error ? candidate : best;
+        }
+
+        return best;
+    }
+
+    void encodeBc7(Block const& source, BlockEncoderEffort effort, std::byte* destination)
+    {
+        BlockPixels const pixels           = loadBlockPixels(source, false);
+        std::array<Color, 16> const texels = getTexels(source, { 0, 1, 2, 3 });
+        bool const principalAxis           = effort != BlockEncoderEffort::Fast;
+        bool const allPBits                = effort == BlockEncoderEffort::High;
+
+        Bc7Block best = fitBc7(pixels, findEndpoints(texels, 4, principalAxis), allPBits);
+
+        for (int iteration = 0; iteration < getRefinementIterations(effort) && best.error > 0; ++iteration)
+        {
+            std::array<float, 16> weights;
+
+            for (size_t i = 0; i < weights.size(); ++i)
+            {
+                weights[i] = static_cast<float>(kBc7Weights[best.indices[i]]) / 64.f;
+            }
+
+            std::optional<std::pair<Color, Color>> refined = refineEndpoints(texels, weights, 4);
+
+            if (!refined)
+            {
+                break;
+            }
+
+            Bc7Block candidate = fitBc7(pixels, *refined, allPBits);
+
+            if (candidate.error >= best.error)
+            {
+                break;
+            }
+
+            best = candidate;
+        }
+
+        // The anchor (texel 0) index is stored without its top bit, swapping the endpoints mirrors every
+        // index
+        if (best.indices[0] >= 8)
+        {
+            std::swap(best.first, best.second);
+
+            for (uint8_t& index : best.indices)
+            {
+                index = static_cast<uint8_t>(15 - index);
+            }
+        }
+
+        BitWriter writer;
+
+        writer.write(1 << 6, 7);
+
+        for (size_t c = 0; c < 4; ++c)
+        {
+            writer.write(static_cast<uint64_t>(best.first.values[c]), 7);
+            writer.write(static_cast<uint64_t>(best.second.values[c]), 7);
+        }
+
+        writer.write(static_cast<uint64_t>(best.first.pBit), 1);
+        writer.write(static_cast<uint64_t>(best.second.pBit), 1);
+
+        for (size_t i = 0; i < best.indices.size(); ++i)
+        {
+            writer.write(best.indices[i], i == 0 ? 3 : 4);
+        }
+
+        writer.store(destination);
+    }
+
+    auto decodeBc7(std::byte const* source) -> Block
+    {
+        BitReader reader(source);
+
+        [[maybe_unused]] uint32_t const mode = reader.read(7);
+
+        MC_ASSERT_MSG(mode == 1 << 6, "Only BC7 mode 6 blocks can be decoded");
+
+        Bc7Endpoint first {}, second {};
+
+        for (size_t c = 0; c < 4; ++c)
+        {
+            first.values[c]  = static_cast<int>(reader.read(7));
+            second.values[c] = static_cast<int>(reader.read(7));
+        }
+
+        first.pBit  = static_cast<int>(reader.read(1));
+        second.pBit = static_cast<int>(reader.read(1));
+
+        std::array<PaletteColor, 16> const palette = getBc7Palette(first, second);
+
+        Block block;
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            PaletteColor const& color = palette[reader.read(i == 0 ? 3 : 4)];
+
+            for (size_t c = 0; c < 4; ++c)
+            {
+                block[i * 4 + c] = static_cast<uint8_t>(color[c]);
+            }
+        }
+
+        return block;
+    }
+
+    //
+    // BC1, opaque four color mode only
+    //
+
+    auto quantize565(Color const& color) -> uint16_t
+    {
+        auto const quantize = [](float value, int maximum)
+        { return static_cast<uint16_t>(std::lround(value * static_cast<float>(maximum) / 255.f)); };
+
+        return static_cast<uint16_t>(quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 |
+                                     quantize(color[2], 31));
+    }
+
+    auto expand565(uint16_t color) -> PaletteColor
+    {
+        int const red = color >> 11, green = (color >> 5) & 63, blue = color & 31;
+
+        return { static_cast<int16_t>(red << 3 | red >> 2),
+                 static_cast<int16_t>(green << 2 | green >> 4),
+                 static_cast<int16_t>(blue << 3 | blue >> 2),
+                 0 };
+    }
+
+    // color0 > color1 selects the four color mode, equal endpoints fall back to the three color one where
+    // index 0 is still color0. The color blocks of BC2 and BC3 always use the four color mode.
+    auto getBc1Palette(uint16_t first, uint16_t second, bool fourColor) -> std::array<PaletteColor, 4>
+    {
+        PaletteColor const a = expand565(first), b = expand565(second);
+
+        std::array<PaletteColor, 4> palette { a, b };
+
+        for (size_t c = 0; c < 3; ++c)
+        {
+            if (fourColor)
+            {
+                palette[2][c] = static_cast<int16_t>((2 * a[c] + b[c]) / 3);
+                palette[3][c] = static_cast<int16_t>((a[c] + 2 * b[c]) / 3);
+            }
+            else
+            {
+                palette[2][c] = static_cast<int16_t>((a[c] + b[c]) / 2);
+                palette[3][c] = 0;
+            }
+        }
+
+        return palette;
+    }
+
+    struct Bc1Block
+    {
+        uint16_t first;
+        uint16_t second;
+        Indices indices;
+        uint32_t error;
+    };
+
+    auto fitBc1(BlockPixels const& pixels, std::pair<Color, Color> const& endpoints) -> Bc1Block
+    {
+        Bc1Block block {
+            .first  = quantize565(endpoints.first),
+            .second = quantize565(endpoints.second),
+        };
+
+        if (block.first < block.second)
+        {
+            std::swap(block.first, block.second);
+        }
+
+        std::array<PaletteColor, 4> const palette =
+            getBc1Palette(block.first, block.second, block.first > block.second);
+
+        // Only the first two entries are safe to pick from in the three color mode
+        block.error = selectIndices(
+            pixels, std::span { palette }.first(block.first > block.second ? 4 : 1), block.indices);
+
+        return block;
+    }
+
+    void encodeBc1(Block const& source, BlockEncoderEffort effort, std::byte* destination)
+    {
+        BlockPixels const pixels           = loadBlockPixels(source, true);
+        std::array<Color, 16> const texels = getTexels(source, { 0, 1, 2, 3 });
+
+        Bc1Block best = fitBc1(pixels, findEndpoints(texels, 3, effort != BlockEncoderEffort::Fast));
+
+        for (int iteration = 0; iteration < getRefinementIterations(effort) && best.error > 0; ++iteration)
+        {
+            std::array<float, 16> weights;
+
+            for (size_t i = 0; i < weights.size(); ++i)
+            {
+                weights[i] = kBc1Weights[best.indices[i]];
+            }
+
+            std::optional<std::pair<Color, Color>> refined = refineEndpoints(texels, weights, 3);
+
+            if (!refined)
+            {
+                break;
+            }
+
+            Bc1Block candidate = fitBc1(pixels, *refined);
+
+            if (candidate.error >= best.error)
+            {
+                break;
+            }
+
+            best = candidate;
+        }
+
+        uint32_t indices = 0;
+
+        for (size_t i = 0; i < best.indices.size(); ++i)
+        {
+            indices |= static_cast<uint32_t>(best.indices[i]) << (i * 2);
+        }
+
+        std::memcpy(destination, &best.first, 2);
+        std::memcpy(destination + 2, &best.second, 2);
+        std::memcpy(destination + 4, &indices, 4);
+    }
+
+    // Leaves alpha opaque, apart from the transparent index of the three color mode
+    auto decodeBc1(std::byte const* source, bool alwaysFourColor = false) -> Block
+    {
+        uint16_t first = 0, second = 0;
+        uint32_t indices = 0;
+
+        std::memcpy(&first, source, 2);
+        std::memcpy(&second, source + 2, 2);
+        std::memcpy(&indices, source + 4, 4);
+
+        bool const fourColor = alwaysFourColor || first > second;
+
+        std::array<PaletteColor, 4> const palette = getBc1Palette(first, second, fourColor);
+
+        Block block;
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            uint32_t const index = (indices >> (i * 2)) & 3;
+
+            for (size_t c = 0; c < 3; ++c)
+            {
+                block[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+            }
+
+            block[i * 4 + 3] = !fourColor && index == 3 ? 0 : 255;
+        }
+
+        return block;
+    }
+
+    //
+    // BC4, eight value mode only. BC5 is two of these.
+    //
+
+    auto getBc4Palette(int first, int second) -> std::array<int, 8>
+    {
+        std::array<int, 8> palette { first, second };
+
+        for (int i = 2; i < 8; ++i)
+        {
+            palette[i] = first > second ? ((8 - i) * first + (i - 1) * second + 3) / 7 : first;
+        }
+
+        return palette;
+    }
+
+    struct Bc4Block
+    {
+        int first;
+        int second;
+        Indices indices;
+        uint32_t error { 0 };
+    };
+
+    auto fitBc4(std::array<Color, 16> const& texels, float low, float high) -> Bc4Block
+    {
+        Bc4Block block {
+            .first  = std::clamp(static_cast<int>(std::lround(high)), 0, 255),
+            .second = std::clamp(static_cast<int>(std::lround(low)), 0, 255),
+        };
+
+        if (block.first < block.second)
+        {
+            std::swap(block.first, block.second);
+        }
+
+        std::array<int, 8> const palette = getBc4Palette(block.first, block.second);
+
+        for (size_t i = 0; i < texels.size(); ++i)
+        {
+            auto const value   = static_cast<int>(texels[i][0]);
+            uint32_t bestError = std::numeric_limits<uint32_t>::max();
+
+            for (size_t index = 0; index < palette.size(); ++index)
+            {
+                auto const error = static_cast<uint32_t>((palette[index] - value) * (palette[index] - value));
+
+                if (error < bestError)
+                {
+                    bestError        = error;
+                    block.indices[i] = static_cast<uint8_t>(index);
+                }
+            }
+
+            block.error += bestError;
+        }
+
+        return block;
+    }
+
+    void encodeBc4(Block const& source, uint8_t channel, BlockEncoderEffort effort, std::byte* destination)
+    {
+        std::array<Color, 16> const texels = getTexels(source, { channel, channel, channel, channel });
+
+        auto const [low, high] = rn::minmax(texels, {}, [](Color const& texel) { return texel[0]; });
+
+        Bc4Block best = fitBc4(texels, low[0], high[0]);
+
+        for (int iteration = 0; iteration < getRefinementIterations(effort) && best.error > 0; ++iteration)
+        {
+            std::array<float, 16> weights;
+
+            for (size_t i = 0; i < weights.size(); ++i)
+            {
+                weights[i] = kBc4Weights[best.indices[i]];
+            }
+
+            std::optional<std::pair<Color, Color>> refined = refineEndpoints(texels, weights, 1);
+
+            if (!refined)
+            {
+                break;
+            }
+
+            Bc4Block candidate = fitBc4(texels, refined->second[0], refined->first[0]);
+
+            if (candidate.error >= best.error)
+            {
+                break;
+            }
+
+            best = candidate;
+        }
+
+        uint64_t bits = static_cast<uint64_t>(best.first) | static_cast<uint64_t>(best.second) << 8;
+
+        for (size_t i = 0; i < best.indices.size(); ++i)
+        {
+            bits |= static_cast<uint64_t>(best.indices[i]) << (16 + i * 3);
+        }
+
+        std::memcpy(destination, &bits, 8);
+    }
+
+    // Writes the decoded values into `channel` of `block`
+    void decodeBc4(std::byte const* source, size_t channel, Block& block)
+    {
+        uint64_t bits = 0;
+        std::memcpy(&bits, source, 8);
+
+        auto const first = static_cast<int>(bits & 0xff), second = static_cast<int>(bits >> 8 & 0xff);
+
+        std::array<int, 8> palette = getBc4Palette(first, second);
+
+        // The encoder never produces the six value mode, blocks with equal endpoints still decode right
+        if (first <= second)
+        {
+            for (int i = 2; i < 6; ++i)
+            {
+                palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1] + 2) / 5;
+            }
+
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        for (size_t i = 0; i < 16; ++i)
+        {
+            block[i * 4 + channel] = static_cast<uint8_t>(palette[(bits >> (16 + i * 3)) & 7]);
+        }
+    }
+
+    //
+    // BC2, only decoded. Alpha is stored explicitly with 4 bits per texel.
+    //
+
+    void decodeBc2Alpha(std::byte const* source, Block& block)
+    {
+        uint64_t bits = 0;
+        std::memcpy(&bits, source, 8);
+
+        for (size_t i = 0; i < 16; ++i)
+        {
+            block[i * 4 + 3] = static_cast<uint8_t>(((bits >> (i * 4)) & 15) * 17);
+        }
+    }
+
+    // The mode is the position of the first set bit
+    auto isBc7Mode6(std::byte const* source) -> bool
+    {
+        return (std::to_integer<uint8_t>(source[0]) & 0x7f) == 1 << 6;
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    auto getBlockEncoderEffortName(BlockEncoderEffort effort) -> std::string_view
+    {
+        switch (effort)
+        {
+            case BlockEncoderEffort::None:
+                return "none";
+            case BlockEncoderEffort::Fast:
+                return "fast";
+            case BlockEncoderEffort::Normal:
+                return "normal";
+            case BlockEncoderEffort::High:
+                return "high";
+        }
+
+        return "unknown";
+    }
+
+    auto encodeBlocks(std::span<std::byte const> rgba,
+                      vk::Extent2D dimensions,
+                      BlockEncoding const& encoding,
+                      BlockEncoderEffort effort,
+                      std::span<std::byte> blocks) -> BlockEncoderStats
+    {
+        ZoneScopedN("Encode blocks");
+
+        MC_ASSERT(rgba.size() == static_cast<size_t>(dimensions.width) * dimensions.height * 4);
+        MC_ASSERT(blocks.size() == getImageLevelSize(encoding.format, dimensions));
+
+        auto const startTime = Timer::Clock::now();
+
+        std::span<uint8_t const> texels { reinterpret_cast<uint8_t const*>(rgba.data()), rgba.size() };
+
+        uint32_t const blocksX = (dimensions.width + 3) / 4, blocksY = (dimensions.height + 3) / 4;
+        size_t const blockSize = blocks.size() / (static_cast<size_t>(blocksX) * blocksY);
+
+        // Source channel each decoded channel is compared against, and how many of them are kept
+        std::array<uint8_t, 4> compared { 0, 1, 2, 3 };
+        uint32_t comparedCount = 4;
+
+        switch (encoding.format)
+        {
+            case vk::Format::eBc1RgbUnormBlock:
+                comparedCount = 3;
+                break;
+            case vk::Format::eBc4UnormBlock:
+                compared      = { encoding.channels[0] };
+                comparedCount = 1;
+                break;
+            case vk::Format::eBc5UnormBlock:
+                compared      = { encoding.channels[0], encoding.channels[1] };
+                comparedCount = 2;
+                break;
+            case vk::Format::eBc7UnormBlock:
+                break;
+            default:
+                MC_ASSERT_MSG(false, "Can't encode blocks of {}", vk::to_string(encoding.format));
+                break;
+        }
+
+        BlockEncoderStats stats {
+            .pixelCount  = static_cast<uint64_t>(dimensions.width) * dimensions.height,
+            .sampleCount = static_cast<uint64_t>(dimensions.width) * dimensions.height * comparedCount,
+        };
+
+        for (uint32_t blockY = 0; blockY < blocksY; ++blockY)
+        {
+            for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+            {
+                size_t const blockIndex = static_cast<size_t>(blockY) * blocksX + blockX;
+                Block const source      = loadBlock(texels, dimensions, blockX, blockY);
+                std::byte* destination  = &blocks[blockIndex * blockSize];
+
+                Block decoded {};
+
+                switch (encoding.format)
+                {
+                    case vk::Format::eBc1RgbUnormBlock:
+                        encodeBc1(source, effort, destination);
+                        decoded = decodeBc1(destination);
+                        break;
+                    case vk::Format::eBc4UnormBlock:
+                        encodeBc4(source, encoding.channels[0], effort, destination);
+                        decodeBc4(destination, 0, decoded);
+                        break;
+                    case vk::Format::eBc5UnormBlock:
+                        encodeBc4(source, encoding.channels[0], effort, destination);
+                        encodeBc4(source, encoding.channels[1], effort, destination + 8);
+                        decodeBc4(destination, 0, decoded);
+                        decodeBc4(destination + 8, 1, decoded);
+                        break;
+                    default:
+                        encodeBc7(source, effort, destination);
+                        decoded = decodeBc7(destination);
+                        break;
+                }
+
+                // Texels repeated to fill edge blocks aren't part of the image
+                uint32_t const width  = std::min(dimensions.width - blockX * 4, 4u);
+                uint32_t const height = std::min(dimensions.height - blockY * 4, 4u);
+
+                for (uint32_t y = 0; y < height; ++y)
+                {
+                    for (uint32_t x = 0; x < width; ++x)
+                    {
+                        for (uint32_t c = 0; c < comparedCount; ++c)
+                        {
+                            int const difference =
+                                decoded[(y * 4 + x) * 4 + c] - source[(y * 4 + x) * 4 + compared[c]];
+
+                            stats.squaredError += difference * difference;
+                        }
+                    }
+                }
+            }
+        }
+
+        stats.seconds = Timer::Seconds(Timer::Clock::now() - startTime).count();
+
+        return stats;
+    }
+
+    auto decodeBlocks(std::span<std::byte const> blocks,
+                      vk::Extent2D dimensions,
+                      vk::Format format,
+                      std::span<std::byte> rgba) -> bool
+    {
+        ZoneScopedN("Decode blocks");
+
+        MC_ASSERT(rgba.size() == static_cast<size_t>(dimensions.width) * dimensions.height * 4);
+        MC_ASSERT(blocks.size() == getImageLevelSize(format, dimensions));
+
+        uint32_t const blocksX = (dimensions.width + 3) / 4, blocksY = (dimensions.height + 3) / 4;
+        size_t const blockSize = blocks.size() / (static_cast<size_t>(blocksX) * blocksY);
+
+        for (uint32_t blockY = 0; blockY < blocksY; ++blockY)
+        {
+            for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+            {
+                size_t const blockIndex = static_cast<size_t>(blockY) * blocksX + blockX;
+                std::byte const* source = &blocks[blockIndex * blockSize];
+
+                // Channels a format doesn't store read as 0, and alpha as 1
+                Block decoded {};
+
+                switch (format)
+                {
+                    case vk::Format::eBc1RgbUnormBlock:
+                    case vk::Format::eBc1RgbSrgbBlock:
+                    case vk::Format::eBc1RgbaUnormBlock:
+                    case vk::Format::eBc1RgbaSrgbBlock:
+                        decoded = decodeBc1(source);
+                        break;
+                    case vk::Format::eBc2UnormBlock:
+                    case vk::Format::eBc2SrgbBlock:
+                        decoded = decodeBc1(source + 8, true);
+                        decodeBc2Alpha(source, decoded);
+                        break;
+                    case vk::Format::eBc3UnormBlock:
+                    case vk::Format::eBc3SrgbBlock:
+                        decoded = decodeBc1(source + 8, true);
+                        decodeBc4(source, 3, decoded);
+                        break;
+                    case vk::Format::eBc4UnormBlock:
+                        decodeBc4(source, 0, decoded);
+                        break;
+                    case vk::Format::eBc5UnormBlock:
+                        decodeBc4(source, 0, decoded);
+                        decodeBc4(source + 8, 1, decoded);
+                        break;
+                    case vk::Format::eBc7UnormBlock:
+                    case vk::Format::eBc7SrgbBlock:
+                        if (!isBc7Mode6(source))
+                        {
+                            return false;
+                        }
+
+                        decoded = decodeBc7(source);
+                        break;
+                    default:
+                        return false;
+                }
+
+                if (format == vk::Format::eBc4UnormBlock || format == vk::Format::eBc5UnormBlock)
+                {
+                    for (size_t i = 0; i < 16; ++i)
+                    {
+                        decoded[i * 4 + 3] = 255;
+                    }
+                }
+
+                // Edge blocks only partially cover the level
+                uint32_t const width  = std::min(dimensions.width - blockX * 4, 4u);
+                uint32_t const height = std::min(dimensions.height - blockY * 4, 4u);
+
+                for (uint32_t y = 0; y < height; ++y)
+                {
+                    size_t const texel = static_cast<size_t>(blockY * 4 + y) * dimensions.width + blockX * 4;
+
+                    std::memcpy(&rgba[texel * 4], &decoded[y * 16], width * 4);
+                }
+            }
+        }
+
+        return true;
+    }
+}  // namespace renderer::backend
@@ -42,4 +42,14 @@ namespace renderer::backend
 
         m_buffer = nullptr;
     }
+
+    void GPUBuffer::invalidate() const
+    {
+        vk::Result(vmaInvalidateAllocation(*m_allocator, m_allocation, 0, VK_WHOLE_SIZE)) >> ResultChecker();
+    }
+
+    void GPUBuffer::flush() const
+    {
+        vk::Result(vmaFlushAllocation(*m_allocator, m_allocation, 0, VK_WHOLE_SIZE)) >> ResultChecker();
+    }
 }  // namespace renderer::backend
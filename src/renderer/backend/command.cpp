@@ -64,7 +64,56 @@ namespace renderer::backend
                 ->allocateCommandBuffers(vk::CommandBufferAllocateInfo()
                                              .setCommandPool(m_graphicsCommandPool)
                                              .setLevel(vk::CommandBufferLevel::ePrimary)
-                                             .setCommandBufferCount(kNumFramesInFlight))
+                                             .setCommandBufferCount(kMaxFramesInFlight))
                 .value();
     }
+
+    void CommandManager::createRecordingPools(Device const& device, uint32_t threadCount)
+    {
+        for (std::vector<RecordingPool>& framePools : m_recordingPools)
+        {
+            framePools.clear();
+
+            for (uint32_t thread = 0; thread < threadCount; ++thread)
+            {
+                // Buffers are only ever reset together with the pool
+                framePools.push_back({
+                    .pool = device
+                                ->createCommandPool(
+                                    vk::CommandPoolCreateInfo()
+                                        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+                                        .setQueueFamilyIndex(device.getQueueFamilyIndices().graphicsFamily))
+                                .value(),
+                });
+            }
+        }
+    }
+
+    auto CommandManager::acquireSecondaryCmdBuffer(Device const& device, size_t frameIndex, uint32_t thread)
+        -> vk::CommandBuffer
+    {
+        RecordingPool& recordingPool = m_recordingPools[frameIndex][thread];
+
+        if (recordingPool.usedCount == recordingPool.buffers.size())
+        {
+            recordingPool.buffers.push_back(
+                std::move(device
+                              ->allocateCommandBuffers(vk::CommandBufferAllocateInfo()
+                                                           .setCommandPool(recordingPool.pool)
+                                                           .setLevel(vk::CommandBufferLevel::eSecondary)
+                                                           .setCommandBufferCount(1))
+                              .value()[0]));
+        }
+
+        return recordingPool.buffers[recordingPool.usedCount++];
+    }
+
+    void CommandManager::resetRecordingPools(size_t frameIndex)
+    {
+        for (RecordingPool& recordingPool : m_recordingPools[frameIndex])
+        {
+            recordingPool.pool.reset();
+            recordingPool.usedCount = 0;
+        }
+    }
 }  // namespace renderer::backend
@@ -0,0 +1,23 @@
+#include <mc/renderer/backend/deletion_queue.hpp>
+
+#include <tracy/Tracy.hpp>
+
+namespace renderer::backend
+{
+    void DeletionQueue::collect()
+    {
+        if (m_entries.empty())
+        {
+            return;
+        }
+
+        ZoneScopedN("Collect retired resources");
+
+        uint64_t const completedValue = m_timeline->getCompletedValue();
+
+        while (!m_entries.empty() && m_entries.front().value <= completedValue)
+        {
+            m_entries.pop_front();
+        }
+    }
+}  // namespace renderer::backend
@@ -0,0 +1,253 @@
+#include <mc/renderer/backend/depth_pyramid.hpp>
+#include <mc/renderer/backend/vk_checker.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <utility>
+
+#include <glm/ext/vector_float2.hpp>
+
+namespace
+{
+    // Matches local_size_x and local_size_y in depth_reduce.comp
+    constexpr uint32_t kGroupSize = 16;
+
+    struct ReducePushConstants
+    {
+        glm::vec2 levelSize;
+    };
+}  // namespace
+
+namespace renderer::backend
+{
+    DepthPyramid::DepthPyramid(Device const& device, Allocator const& allocator)
+        : m_device { &device }, m_allocator { &allocator }
+    {
+        // Without min reductions the sampler averages, the pyramid is then only an approximation and
+        // RendererBackend doesn't cull against it
+        vk::SamplerReductionModeCreateInfo const reductionInfo {
+            .reductionMode = vk::SamplerReductionMode::eMin,
+        };
+
+        m_sampler = device->createSampler({
+                        .pNext        = device.isOcclusionCullingSupported() ? &reductionInfo : nullptr,
+                        .magFilter    = vk::Filter::eLinear,
+                        .minFilter    = vk::Filter::eLinear,
+                        .mipmapMode   = vk::SamplerMipmapMode::eNearest,
+                        .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+                        .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+                        .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+                        .minLod       = 0.f,
+                        .maxLod       = vk::LodClampNone,
+                    }) >>
+                    ResultChecker();
+
+        m_reduceLayout = DescriptorLayoutBuilder()
+                             // The level being written
+                             .addBinding(0, vk::DescriptorType::eStorageImage)
+                             // The level above, or the depth image
+                             .addBinding(1, vk::DescriptorType::eCombinedImageSampler)
+                             .build(device, vk::ShaderStageFlagBits::eCompute);
+
+        m_samplingLayout = DescriptorLayoutBuilder()
+                               .addBinding(0, vk::DescriptorType::eCombinedImageSampler)
+                               .build(device, vk::ShaderStageFlagBits::eCompute);
+
+        m_reducePipelineLayout =
+            PipelineLayout(device,
+                           PipelineLayoutConfig()
+                               .setDescriptorSetLayouts({ m_reduceLayout })
+                               .setPushConstantSettings(sizeof(ReducePushConstants),
+                                                        vk::ShaderStageFlagBits::eCompute));
+
+        m_reducePipeline = ComputePipeline(device, m_reducePipelineLayout, "depth_reduce.comp", "main");
+    }
+
+    void DepthPyramid::resize(vk::ImageView depthView, vk::Extent2D depthExtent, DeletionQueue& deletionQueue)
+    {
+        deletionQueue.retire(std::move(m_image));
+        deletionQueue.retire(std::move(m_levelViews));
+        deletionQueue.retire(std::move(m_descriptorAllocator));
+
+        createLevels(depthView, depthExtent);
+    }
+
+    void DepthPyramid::createLevels(vk::ImageView depthView, vk::Extent2D depthExtent)
+    {
+        // Rounded down to powers of two, so that every level exactly halves the one above it
+        vk::Extent2D const extent {
+            std::bit_floor(depthExtent.width),
+            std::bit_floor(depthExtent.height),
+        };
+
+        uint32_t const levelCount = getMipLevelCount(extent);
+
+        m_levelViews.clear();
+        m_initialLayoutPending = true;
+
+        // Moving into an Image doesn't release the one it replaces
+        {
+            Image previous = std::move(m_image);
+        }
+
+        m_image = Image(*m_device,
+                        *m_allocator,
+                        extent,
+                        vk::Format::eR32Sfloat,
+                        vk::SampleCountFlagBits::e1,
+                        vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage,
+                        vk::ImageAspectFlagBits::eColor,
+                        levelCount);
+
+        for (uint32_t level = 0; level < levelCount; ++level)
+        {
+            m_levelViews.push_back((*m_device)->createImageView({
+                                       .image            = m_image,
+                                       .viewType         = vk::ImageViewType::e2D,
+                                       .format           = vk::Format::eR32Sfloat,
+                                       .subresourceRange = {
+                                           .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                           .baseMipLevel   = level,
+                                           .levelCount     = 1,
+                                           .baseArrayLayer = 0,
+                                           .layerCount     = 1,
+                                       },
+                                   }) >>
+                                   ResultChecker());
+        }
+
+        // One reduction set per level and the sampling set
+        std::array<DescriptorAllocator::PoolSizeRatio, 2> ratios { {
+            { vk::DescriptorType::eStorageImage,         1 },
+            { vk::DescriptorType::eCombinedImageSampler, 1 },
+        } };
+
+        m_descriptorAllocator = DescriptorAllocator(*m_device, levelCount + 1, ratios);
+
+        m_reduceSets.clear();
+
+        DescriptorWriter writer;
+
+        for (uint32_t level = 0; level < levelCount; ++level)
+        {
+            vk::DescriptorSet const set = m_descriptorAllocator.allocate(*m_device, m_reduceLayout);
+
+            writer.clear();
+            writer.write_image(0,
+                               m_levelViews[level],
+                               nullptr,
+                               vk::ImageLayout::eGeneral,
+                               vk::DescriptorType::eStorageImage);
+
+            if (level == 0)
+            {
+                writer.write_image(1,
+                                   depthView,
+                                   m_sampler,
+                                   vk::ImageLayout::eShaderReadOnlyOptimal,
+                                   vk::DescriptorType::eCombinedImageSampler);
+            }
+            else
+            {
+                writer.write_image(1,
+                                   m_levelViews[level - 1],
+                                   m_sampler,
+                                   vk::ImageLayout::eGeneral,
+                                   vk::DescriptorType::eCombinedImageSampler);
+            }
+
+            writer.update_set(*m_device, set);
+
+            m_reduceSets.push_back(set);
+        }
+
+        m_samplingSet = m_descriptorAllocator.allocate(*m_device, m_samplingLayout);
+
+        writer.clear();
+        writer.write_image(0,
+                           m_image.getImageView(),
+                           m_sampler,
+                           vk::ImageLayout::eGeneral,
+                           vk::DescriptorType::eCombinedImageSampler);
+        writer.update_set(*m_device, m_samplingSet);
+    }
+
+    void DepthPyramid::recordInitialLayout(vk::CommandBuffer commandBuffer)
+    {
+        if (!m_initialLayoutPending)
+        {
+            return;
+        }
+
+        recordLayoutBarrier(commandBuffer);
+
+        m_initialLayoutPending = false;
+    }
+
+    void DepthPyramid::recordLayoutBarrier(vk::CommandBuffer commandBuffer) const
+    {
+        // Every level is rewritten, the previous frame's culling pass may still be sampling them
+        vk::ImageMemoryBarrier2 const layoutBarrier {
+            .srcStageMask     = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstStageMask     = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask    = vk::AccessFlagBits2::eShaderStorageWrite,
+            .oldLayout        = vk::ImageLayout::eUndefined,
+            .newLayout        = vk::ImageLayout::eGeneral,
+            .image            = m_image,
+            .subresourceRange = {
+                .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel   = 0,
+                .levelCount     = vk::RemainingMipLevels,
+                .baseArrayLayer = 0,
+                .layerCount     = 1,
+            },
+        };
+
+        commandBuffer.pipelineBarrier2(vk::DependencyInfo().setImageMemoryBarriers(layoutBarrier));
+    }
+
+    void DepthPyramid::recordBuild(vk::CommandBuffer commandBuffer) const
+    {
+        recordLayoutBarrier(commandBuffer);
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_reducePipeline);
+
+        vk::Extent2D levelExtent = m_image.getDimensions();
+
+        for (vk::DescriptorSet set : m_reduceSets)
+        {
+            commandBuffer.bindDescriptorSets(
+                vk::PipelineBindPoint::eCompute, m_reducePipelineLayout, 0, set, {});
+
+            ReducePushConstants const pushConstants {
+                .levelSize = glm::vec2(levelExtent.width, levelExtent.height),
+            };
+
+            commandBuffer.pushConstants(m_reducePipelineLayout,
+                                        vk::ShaderStageFlagBits::eCompute,
+                                        0,
+                                        sizeof(ReducePushConstants),
+                                        &pushConstants);
+
+            commandBuffer.dispatch((levelExtent.width + kGroupSize - 1) / kGroupSize,
+                                   (levelExtent.height + kGroupSize - 1) / kGroupSize,
+                                   1);
+
+            // The next level, and after the last one the culling pass, samples this one
+            vk::MemoryBarrier2 const levelBarrier {
+                .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+                .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+                .dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead,
+            };
+
+            commandBuffer.pipelineBarrier2(vk::DependencyInfo().setMemoryBarriers(levelBarrier));
+
+            levelExtent = vk::Extent2D {
+                std::max(levelExtent.width / 2, 1u),
+                std::max(levelExtent.height / 2, 1u),
+            };
+        }
+    }
+}  // namespace renderer::backend
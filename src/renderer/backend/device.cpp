@@ -7,7 +7,9 @@
 #include <mc/renderer/backend/vk_checker.hpp>
 #include <mc/utils.hpp>
 
+#include <span>
 #include <unordered_set>
+#include <vector>
 
 #include <vulkan/vulkan_raii.hpp>
 
@@ -18,7 +20,6 @@ namespace
     // clang-format off
     constexpr std::array requiredExtensions
     {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
         VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
         VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
@@ -29,6 +30,18 @@ namespace
 
     // clang-format on
 
+    auto getRequiredExtensions(bool presenting) -> std::vector<char const*>
+    {
+        std::vector<char const*> extensions(requiredExtensions.begin(), requiredExtensions.end());
+
+        if (presenting)
+        {
+            extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
+
+        return extensions;
+    }
+
     bool areAllQueueFamiliesPresent(QueueFamilyIndices const& indices)
     {
         auto max = std::numeric_limits<uint32_t>::max();
@@ -36,13 +49,13 @@ namespace
         return indices.presentFamily != max && indices.graphicsFamily != max && indices.transferFamily != max;
     };
 
-    auto checkDeviceExtensionSupport(vk::PhysicalDevice device) -> bool
+    auto checkDeviceExtensionSupport(vk::PhysicalDevice device, std::span<char const* const> extensions)
+        -> bool
     {
         std::vector<vk::ExtensionProperties> availableExtensions =
             device.enumerateDeviceExtensionProperties() >> ResultChecker();
 
-        std::unordered_set<std::string> requiredExtensionsSet(requiredExtensions.begin(),
-                                                              requiredExtensions.end());
+        std::unordered_set<std::string> requiredExtensionsSet(extensions.begin(), extensions.end());
 
         for (auto const& extension : availableExtensions)
         {
@@ -52,35 +65,53 @@ namespace
         return requiredExtensionsSet.empty();
     }
 
+    // What BindlessTextures needs out of descriptor indexing
+    auto checkBindlessTextureSupport(vk::raii::PhysicalDevice const& device) -> bool
+    {
+        auto const features =
+            device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>()
+                .get<vk::PhysicalDeviceVulkan12Features>();
+
+        return features.shaderSampledImageArrayNonUniformIndexing &&
+               features.descriptorBindingSampledImageUpdateAfterBind &&
+               features.descriptorBindingPartiallyBound && features.runtimeDescriptorArray;
+    }
+
     auto findQueueFamilies(vk::PhysicalDevice device, vk::SurfaceKHR surface) -> QueueFamilyIndices
     {
         QueueFamilyIndices indices;
 
         std::vector<vk::QueueFamilyProperties> queueFamilies = device.getQueueFamilyProperties();
 
+        uint32_t invalidIndex = std::numeric_limits<uint32_t>::max();
+
         for (uint32_t i = 0; auto const& queueFamily : queueFamilies)
         {
-            if (areAllQueueFamiliesPresent(indices))
-            {
-                break;
-            }
+            vk::QueueFlags const flags = queueFamily.queueFlags;
 
-            if (queueFamily.queueFlags & vk::QueueFlagBits::eTransfer &&
-                queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+            // Transfer-only families map to the copy engines, which run alongside graphics work. Families
+            // that can also compute are the next best thing.
+            if (flags & vk::QueueFlagBits::eTransfer && !(flags & vk::QueueFlagBits::eGraphics))
             {
-                logger::debug("Found a dedicated transfer queue!");
-                indices.transferFamily = i;
+                bool const replacesCompute =
+                    indices.transferFamily != invalidIndex &&
+                    queueFamilies[indices.transferFamily].queueFlags & vk::QueueFlagBits::eCompute &&
+                    !(flags & vk::QueueFlagBits::eCompute);
+
+                if (indices.transferFamily == invalidIndex || replacesCompute)
+                {
+                    indices.transferFamily = i;
+                }
             }
 
-            if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+            if (flags & vk::QueueFlagBits::eGraphics && indices.graphicsFamily == invalidIndex)
             {
                 indices.graphicsFamily = i;
             }
 
-            VkBool32 presentSupport = 0u;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-
-            if (device.getSurfaceSupportKHR(i, surface) >> ResultChecker())
+            // Presenting from the graphics family saves an ownership transfer of the swapchain images
+            if (surface && device.getSurfaceSupportKHR(i, surface) >> ResultChecker() &&
+                (indices.presentFamily == invalidIndex || i == indices.graphicsFamily))
             {
                 indices.presentFamily = i;
             }
@@ -88,9 +119,17 @@ namespace
             ++i;
         }
 
-        uint32_t invalidIndex = std::numeric_limits<uint32_t>::max();
+        // Headless, nothing is presented
+        if (!surface)
+        {
+            indices.presentFamily = indices.graphicsFamily;
+        }
 
-        if (indices.transferFamily == invalidIndex && indices.graphicsFamily != invalidIndex)
+        if (indices.transferFamily != invalidIndex)
+        {
+            logger::debug("Found a dedicated transfer queue family ({})", indices.transferFamily);
+        }
+        else if (indices.graphicsFamily != invalidIndex)
         {
             logger::debug("Could not find a dedicated transfer queue. Using the graphics "
                           "queue for this purpose.");
@@ -113,13 +152,14 @@ namespace renderer::backend
         int score { 0 };
     };
 
-    Device::Device(Instance& instance, Surface& surface)
+    Device::Device(Instance& instance, Surface* surface)
+        : m_extensions { getRequiredExtensions(surface != nullptr) }
     {
         selectPhysicalDevice(instance, surface);
         selectLogicalDevice();
     }
 
-    void Device::selectPhysicalDevice(Instance& instance, Surface& surface)
+    void Device::selectPhysicalDevice(Instance& instance, Surface* surface)
     {
         std::vector<vk::raii::PhysicalDevice> devices =
             instance->enumeratePhysicalDevices() >> ResultChecker();
@@ -128,7 +168,9 @@ namespace renderer::backend
 
         for (auto& device : devices)
         {
-            QueueFamilyIndices queueFamilyIndices { findQueueFamilies(device, surface) };
+            vk::SurfaceKHR const surfaceHandle = surface ? surface->get() : vk::SurfaceKHR {};
+
+            QueueFamilyIndices queueFamilyIndices { findQueueFamilies(device, surfaceHandle) };
 
             vk::PhysicalDeviceProperties deviceProperties = device.getProperties();
             vk::PhysicalDeviceFeatures deviceFeatures     = device.getFeatures();
@@ -136,16 +178,25 @@ namespace renderer::backend
             // clang-format off
             std::array necessaryConditions { std::to_array<std::pair<std::string_view, bool>>({
                 { "Geometry shader availability",
-                  static_cast<bool>(deviceFeatures.geometryShader)    },
+                  static_cast<bool>(deviceFeatures.geometryShader)            },
 
                 { "Anisotropy availability",
-                  static_cast<bool>(deviceFeatures.samplerAnisotropy) },
+                  static_cast<bool>(deviceFeatures.samplerAnisotropy)         },
+
+                { "Multi draw indirect availability",
+                  static_cast<bool>(deviceFeatures.multiDrawIndirect)         },
+
+                { "Indirect first instance availability",
+                  static_cast<bool>(deviceFeatures.drawIndirectFirstInstance) },
+
+                { "Bindless texture availability",
+                  checkBindlessTextureSupport(device)                         },
 
                 { "Necessary queues present",
-                  areAllQueueFamiliesPresent(queueFamilyIndices)      },
+                  areAllQueueFamiliesPresent(queueFamilyIndices)              },
 
                 { "Necessary extensions supported",
-                  checkDeviceExtensionSupport(device)                 }
+                  checkDeviceExtensionSupport(device, m_extensions)           }
             })};
             // clang-format on
 
@@ -198,6 +249,44 @@ namespace renderer::backend
         m_physicalHandle     = bestCandidate.device;
         m_queueFamilyIndices = bestCandidate.queueFamilyIndices;
 
+        m_drawIndirectCountSupported =
+            m_physicalHandle.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>()
+                .get<vk::PhysicalDeviceVulkan12Features>()
+                .drawIndirectCount;
+
+        if (!m_drawIndirectCountSupported)
+        {
+            logger::info("drawIndirectCount is not supported, culled draws are skipped on the GPU instead");
+        }
+
+        m_textureCompressionBCSupported = bestCandidate.features.textureCompressionBC;
+
+        if (!m_textureCompressionBCSupported)
+        {
+            logger::info("BC texture compression is not supported, compressed textures are decoded on load");
+        }
+
+        {
+            auto const features =
+                m_physicalHandle
+                    .getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>()
+                    .get<vk::PhysicalDeviceVulkan12Features>();
+
+            auto const properties =
+                m_physicalHandle
+                    .getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>()
+                    .get<vk::PhysicalDeviceVulkan12Properties>();
+
+            m_occlusionCullingSupported =
+                features.samplerFilterMinmax &&
+                static_cast<bool>(properties.supportedDepthResolveModes & vk::ResolveModeFlagBits::eMin);
+        }
+
+        if (!m_occlusionCullingSupported)
+        {
+            logger::info("Min reductions are not supported, occlusion culling is disabled");
+        }
+
         vk::SampleCountFlags sampleCounts = bestCandidate.properties.limits.framebufferColorSampleCounts &
                                             bestCandidate.properties.limits.framebufferDepthSampleCounts;
 
@@ -220,7 +309,10 @@ namespace renderer::backend
 
         std::string_view deviceType;
 
-        surface.refresh(m_physicalHandle);
+        if (surface)
+        {
+            surface->refresh(m_physicalHandle);
+        }
 
         switch (bestCandidate.properties.deviceType)
         {
@@ -268,13 +360,23 @@ namespace renderer::backend
                            vk::PhysicalDeviceVulkan13Features> chain {
             {
                 .features = { .sampleRateShading             = true,
+                              .multiDrawIndirect             = true,
+                              .drawIndirectFirstInstance     = true,
                               .fillModeNonSolid              = true,
                               .samplerAnisotropy             = true,
+                              .textureCompressionBC          = m_textureCompressionBCSupported,
                               .shaderStorageImageMultisample = true, },
             },
             {
-                .descriptorIndexing  = true,
-                .bufferDeviceAddress = true,
+                .drawIndirectCount                            = m_drawIndirectCountSupported,
+                .descriptorIndexing                           = true,
+                .shaderSampledImageArrayNonUniformIndexing    = true,
+                .descriptorBindingSampledImageUpdateAfterBind = true,
+                .descriptorBindingPartiallyBound              = true,
+                .runtimeDescriptorArray                       = true,
+                .samplerFilterMinmax                          = m_occlusionCullingSupported,
+                .timelineSemaphore                            = true,
+                .bufferDeviceAddress                          = true,
             },
             {
                 .synchronization2 = true,
@@ -286,12 +388,26 @@ namespace renderer::backend
             m_physicalHandle.createDevice(vk::DeviceCreateInfo()
                                               .setPNext(&chain.get<vk::PhysicalDeviceFeatures2>())
                                               .setQueueCreateInfos(queueCreateInfos)
-                                              .setPEnabledExtensionNames(requiredExtensions)) >>
+                                              .setPEnabledExtensionNames(m_extensions)) >>
             ResultChecker();
 
         // Already checked that these families exist, no error handling needed here
         m_graphicsQueue = m_logicalHandle.getQueue(m_queueFamilyIndices.graphicsFamily, 0) >> ResultChecker();
         m_presentQueue  = m_logicalHandle.getQueue(m_queueFamilyIndices.presentFamily, 0) >> ResultChecker();
         m_transferQueue = m_logicalHandle.getQueue(m_queueFamilyIndices.transferFamily, 0) >> ResultChecker();
+
+        // Kept next to the executable, where the working directory points
+        m_pipelineCache =
+            PipelineCache(m_logicalHandle, getDeviceProperties(), std::filesystem::current_path());
+
+        // Shaders are read from the source tree when it's around, so edits there are picked up while running
+        std::filesystem::path shaderDirectory = std::filesystem::path(ROOT_SOURCE_PATH) / "shaders";
+
+        if (std::error_code error; !std::filesystem::is_directory(shaderDirectory, error))
+        {
+            shaderDirectory = std::filesystem::current_path() / "shaders";
+        }
+
+        m_shaderManager = ShaderManager(shaderDirectory, std::filesystem::current_path() / "shader_cache");
     }
 }  // namespace renderer::backend
@@ -0,0 +1,117 @@
+#include <mc/asserts.hpp>
+#include <mc/renderer/backend/frustum_culler.hpp>
+#include <mc/renderer/backend/gltfloader.hpp>
+#include <mc/renderer/backend/scene_graph.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#include <glm/geometric.hpp>
+#include <immintrin.h>
+#include <tracy/Tracy.hpp>
+
+namespace renderer::backend
+{
+    FrustumCuller::FrustumCuller(std::span<SceneDraw const> draws, SceneGraph const& sceneGraph)
+        : m_drawCount { static_cast<uint32_t>(draws.size()) }
+    {
+        size_t const paddedCount = (draws.size() + 31) & ~size_t { 31 };
+
+        // Padding spheres fail every plane test, their bits stay clear
+        m_centersX.assign(paddedCount, 0.f);
+        m_centersY.assign(paddedCount, 0.f);
+        m_centersZ.assign(paddedCount, 0.f);
+        m_radii.assign(paddedCount, std::numeric_limits<float>::lowest());
+
+        updateBounds(draws, sceneGraph);
+    }
+
+    void FrustumCuller::updateBounds(std::span<SceneDraw const> draws, SceneGraph const& sceneGraph)
+    {
+        ZoneScopedN("Frustum culler bounds");
+
+        MC_ASSERT(draws.size() == m_drawCount);
+
+        std::span<glm::mat4 const> worldTransforms = sceneGraph.getWorldTransforms();
+
+        for (size_t i = 0; i < draws.size(); ++i)
+        {
+            glm::mat4 const& transform = worldTransforms[draws[i].nodeIndex];
+            Primitive const& primitive = draws[i].primitive;
+
+            glm::vec3 const center = glm::vec3(transform * glm::vec4(primitive.sphereCenter, 1.f));
+
+            float const maxScale = std::max({ glm::length(glm::vec3(transform[0])),
+                                              glm::length(glm::vec3(transform[1])),
+                                              glm::length(glm::vec3(transform[2])) });
+
+            m_centersX[i] = center.x;
+            m_centersY[i] = center.y;
+            m_centersZ[i] = center.z;
+            m_radii[i]    = primitive.sphereRadius * maxScale;
+        }
+    }
+
+    auto FrustumCuller::cull(std::array<glm::vec4, 6> const& planes, std::span<uint32_t> visibility) const
+        -> uint32_t
+    {
+        ZoneScopedN("Frustum culling");
+
+        MC_ASSERT(visibility.size() >= getVisibilityWordCount());
+
+        // Each plane component broadcast to all lanes. Plain arrays as std::array drops the vector type's
+        // alignment attributes.
+        __m256 planeComponents[6][4];
+
+        for (size_t p = 0; p < planes.size(); ++p)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                planeComponents[p][c] = _mm256_set1_ps(planes[p][c]);
+            }
+        }
+
+        uint32_t visibleCount = 0;
+
+        for (size_t word = 0; word < getVisibilityWordCount(); ++word)
+        {
+            uint32_t bits = 0;
+
+            for (size_t group = 0; group < 4; ++group)
+            {
+                size_t const first = word * 32 + group * 8;
+
+                __m256 const x         = _mm256_loadu_ps(&m_centersX[first]);
+                __m256 const y         = _mm256_loadu_ps(&m_centersY[first]);
+                __m256 const z         = _mm256_loadu_ps(&m_centersZ[first]);
+                __m256 const radius    = _mm256_loadu_ps(&m_radii[first]);
+                __m256 const negRadius = _mm256_sub_ps(_mm256_setzero_ps(), radius);
+
+                // A sphere is outside once it lies entirely behind any plane
+                __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+                for (auto const& plane : planeComponents)
+                {
+                    __m256 const distance = _mm256_add_ps(
+                        _mm256_add_ps(_mm256_mul_ps(plane[0], x), _mm256_mul_ps(plane[1], y)),
+                        _mm256_add_ps(_mm256_mul_ps(plane[2], z), plane[3]));
+
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+
+                    if (_mm256_testz_ps(inside, inside))
+                    {
+                        break;
+                    }
+                }
+
+                bits |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (group * 8);
+            }
+
+            visibility[word] = bits;
+            visibleCount += static_cast<uint32_t>(std::popcount(bits));
+        }
+
+        return visibleCount;
+    }
+}  // namespace renderer::backend
@@ -1,528 +1,1263 @@
-#include "mc/renderer/backend/command.hpp"
-#include <cstring>
+#include <mc/asserts.hpp>
+#include <mc/exceptions.hpp>
+#include <mc/logger.hpp>
+#include <mc/mapped_file.hpp>
 #include <mc/renderer/backend/allocator.hpp>
 #include <mc/renderer/backend/gltfloader.hpp>
+#include <mc/renderer/backend/mesh_optimizer.hpp>
 #include <mc/renderer/backend/renderer_backend.hpp>
-
+#include <mc/renderer/backend/scene_cache.hpp>
+#include <mc/renderer/backend/texture_container.hpp>
+#include <mc/renderer/backend/texture_loader.hpp>
+#include <mc/timer.hpp>
+#include <mc/utils.hpp>
+
+#include <algorithm>
+#include <cstddef>
 #include <filesystem>
-
+#include <format>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <variant>
+
+#include <fastgltf/glm_element_traits.hpp>
+#include <fastgltf/parser.hpp>
+#include <fastgltf/tools.hpp>
+#include <glm/common.hpp>
+#include <glm/matrix.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/packing.hpp>
+#include <stb_image.h>
+#include <tracy/Tracy.hpp>
 #include <vulkan/vulkan_structs.hpp>
 
-namespace renderer::backend
+namespace
 {
-    namespace fs = std::filesystem;
+    using namespace renderer::backend;
 
-    void RendererBackend::processGltf()
+    auto getTextureIndex(auto const& textureInfo) -> std::optional<size_t>
     {
-#if 0
-        fs::path gltfDir  = "../../khrSampleModels/2.0/Cube/glTF";
-        fs::path prevPath = fs::current_path();
-        fs::current_path(gltfDir);
-        fs::path path = fs::current_path() / "Cube.gltf";
-#elif 0
-        fs::path gltfDir  = "../../khrSampleModels/2.0/AntiqueCamera/glTF";
-        fs::path prevPath = fs::current_path();
-        fs::current_path(gltfDir);
-        fs::path path = fs::current_path() / "AntiqueCamera.gltf";
-
-#else
-        fs::path gltfDir  = "../../khrSampleModels/2.0/Sponza/glTF";
-        fs::path prevPath = fs::current_path();
-        fs::current_path(gltfDir);
-        fs::path path = fs::current_path() / "Sponza.gltf";
-#endif
+        return textureInfo.has_value() ? std::optional { textureInfo->textureIndex } : std::nullopt;
+    }
 
-        MC_ASSERT_MSG(fs::exists(path), "glTF file path does not exist: {}", path.string());
+    auto toMiB(size_t bytes) -> double
+    {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
 
-        tinygltf::Model glTFInput;
-        tinygltf::TinyGLTF gltfContext;
-        std::string error, warning;
+    void importImages(fastgltf::Asset const& asset, GltfBufferMappings const& buffers, SceneData& scene)
+    {
+        // Decoding happens later, possibly on another thread and after the buffers are gone, so embedded
+        // images are copied out here. Only the compressed bytes are copied.
+        scene.images.reserve(asset.images.size());
 
-        MC_ASSERT(gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, path));
+        for (auto [i, gltfImage] : vi::enumerate(asset.images))
+        {
+            SceneImageSource& source = scene.images.emplace_back();
+
+            source.name = gltfImage.name.empty() ? std::format("#{}", i)
+                                                 : std::string(std::string_view(gltfImage.name));
+
+            std::visit(fastgltf::visitor {
+                           [&](fastgltf::sources::URI const& uri)
+                           {
+                               MC_ASSERT_MSG(uri.uri.isLocalPath(),
+                                             "Only local glTF images are supported, got '{}'",
+                                             uri.uri.fspath().string());
+
+                               source.path   = uri.uri.fspath();
+                               source.offset = uri.fileByteOffset;
+                           },
+                           [&](fastgltf::sources::BufferView const& view)
+                           {
+                               std::span<std::byte const> bytes =
+                                   buffers.getBufferViewBytes(view.bufferViewIndex);
+
+                               source.encoded.assign(bytes.begin(), bytes.end());
+                           },
+                           [&](fastgltf::sources::ByteView const& view)
+                           { source.encoded.assign(view.bytes.begin(), view.bytes.end()); },
+                           [&](fastgltf::sources::Vector const& vector)
+                           {
+                               std::span<std::byte const> bytes = std::as_bytes(std::span { vector.bytes });
+
+                               source.encoded.assign(bytes.begin(), bytes.end());
+                           },
+                           [](auto const&) { MC_ASSERT_MSG(false, "Unsupported glTF image source"); },
+                       },
+                       gltfImage.data);
+        }
+    }
 
-        // TODO(aether) maybe you could half this?
-        std::vector<uint32_t> indexBuffer;
-        std::vector<Vertex> vertexBuffer;
+    void importMaterials(fastgltf::Asset const& asset, SceneData& scene)
+    {
+        auto getImageIndex = [&](std::optional<size_t> textureIndex) -> uint32_t
+        {
+            if (!textureIndex.has_value())
+            {
+                return kNoImage;
+            }
 
-        loadImages(glTFInput);
-        loadTextures(glTFInput);
-        loadMaterials(glTFInput);
+            fastgltf::Texture const& texture = asset.textures[*textureIndex];
 
-        tinygltf::Scene const& scene = glTFInput.scenes[0];
+            // MSFT_texture_dds sources come with their BCn mip chain already built, prefer them
+            if (texture.ddsImageIndex.has_value())
+            {
+                return static_cast<uint32_t>(*texture.ddsImageIndex);
+            }
 
-        for (size_t i = 0; i < scene.nodes.size(); i++)
-        {
-            tinygltf::Node const node = glTFInput.nodes[scene.nodes[i]];
-            loadNode(node, glTFInput, nullptr, indexBuffer, vertexBuffer);
-        }
+            MC_ASSERT_MSG(
+                texture.imageIndex.has_value(), "glTF texture {} has no image source", *textureIndex);
 
-        // We delayed this so that loadNode can set the vertex attribute material flags
-        // such as "TangentVertexAttribute", "TexcoordVertexAttribute", etc.
-        ScopedCommandBuffer(
-            m_device, m_commandManager.getTransferCmdPool(), m_device.getTransferQueue(), true)
-            ->copyBuffer(m_sceneResources.hostMaterialBuffer,
-                         m_sceneResources.materialBuffer,
-                         vk::BufferCopy().setSize(m_sceneResources.hostMaterialBuffer.getSize()));
+            return static_cast<uint32_t>(*texture.imageIndex);
+        };
 
-        m_sceneResources.materialBufferDirty = false;
+        for (fastgltf::Material const& inputMaterial : asset.materials)
+        {
+            Material& material = scene.materials.emplace_back();
 
-        size_t vertexBufferSize     = vertexBuffer.size() * sizeof(Vertex);
-        size_t indexBufferSize      = indexBuffer.size() * sizeof(uint32_t);
-        m_sceneResources.indexCount = static_cast<uint32_t>(indexBuffer.size());
+            material.baseColorFactor = glm::make_vec4(inputMaterial.pbrData.baseColorFactor.data());
+            material.emissiveFactor  = glm::make_vec3(inputMaterial.emissiveFactor.data());
+            material.metallicFactor  = inputMaterial.pbrData.metallicFactor;
+            material.roughnessFactor = inputMaterial.pbrData.roughnessFactor;
+            material.occlusionFactor =
+                inputMaterial.occlusionTexture.has_value() ? inputMaterial.occlusionTexture->strength : 1.f;
 
-        GPUBuffer vertexStaging(m_allocator,
-                                vertexBufferSize,
-                                vk::BufferUsageFlagBits::eTransferSrc,
-                                VMA_MEMORY_USAGE_AUTO,
-                                VMA_ALLOCATION_CREATE_MAPPED_BIT |
-                                    VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+            if (inputMaterial.doubleSided)
+            {
+                material.flags |= std::to_underlying(MaterialFeatures::DoubleSided);
+            }
 
-        GPUBuffer indexStaging(
-            m_allocator,
-            vertexBufferSize,
-            vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eShaderDeviceAddress,
-            VMA_MEMORY_USAGE_AUTO,
-            VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+            // Masked materials are drawn like opaque ones
+            if (inputMaterial.alphaMode == fastgltf::AlphaMode::Blend)
+            {
+                material.flags |= std::to_underlying(MaterialFeatures::AlphaBlend);
+            }
 
-        std::memcpy(indexStaging.getMappedData(), indexBuffer.data(), indexBufferSize);
-        std::memcpy(vertexStaging.getMappedData(), vertexBuffer.data(), vertexBufferSize);
+            // Ordered by descriptor binding
+            using TextureSlot = std::pair<std::optional<size_t>, MaterialFeatures>;
 
-        m_sceneResources.vertexBuffer =
-            GPUBuffer(m_allocator,
-                      vertexBufferSize,
-                      vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress,
-                      VMA_MEMORY_USAGE_AUTO,
-                      VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+            std::array<TextureSlot, kMaterialTextureCount> textureSlots { {
+                { getTextureIndex(inputMaterial.pbrData.baseColorTexture), MaterialFeatures::ColorTexture },
+                { getTextureIndex(inputMaterial.pbrData.metallicRoughnessTexture),
+                 MaterialFeatures::RoughnessTexture },
+                { getTextureIndex(inputMaterial.occlusionTexture), MaterialFeatures::OcclusionTexture },
+                { getTextureIndex(inputMaterial.emissiveTexture), MaterialFeatures::EmissiveTexture },
+                { getTextureIndex(inputMaterial.normalTexture), MaterialFeatures::NormalTexture },
+            } };
 
-        m_sceneResources.indexBuffer =
-            GPUBuffer(m_allocator,
-                      indexBufferSize,
-                      vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
-                      VMA_MEMORY_USAGE_AUTO,
-                      VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+            MaterialTextures& images = scene.materialTextures.emplace_back();
 
-        ScopedCommandBuffer cmdBuf(
-            m_device, m_commandManager.getTransferCmdPool(), m_device.getTransferQueue());
+            for (auto [binding, slot] : vi::enumerate(textureSlots))
+            {
+                images[binding] = getImageIndex(slot.first);
 
-        cmdBuf->copyBuffer(
-            indexStaging, m_sceneResources.indexBuffer, vk::BufferCopy().setSize(indexBufferSize));
+                if (images[binding] != kNoImage)
+                {
+                    material.flags |= std::to_underlying(slot.second);
+                }
+            }
+        }
 
-        cmdBuf->copyBuffer(
-            vertexStaging, m_sceneResources.vertexBuffer, vk::BufferCopy().setSize(vertexBufferSize));
+        // Primitives without a material fall back to the first one, so there has to be at least one
+        if (scene.materials.empty())
+        {
+            scene.materials.push_back({
+                .baseColorFactor = glm::vec4(1.f),
+                .emissiveFactor  = glm::vec3(0.f),
+                .metallicFactor  = 1.f,
+                .roughnessFactor = 1.f,
+                .occlusionFactor = 1.f,
+            });
+
+            scene.materialTextures.push_back({ kNoImage, kNoImage, kNoImage, kNoImage, kNoImage });
+        }
     }
 
-    void RendererBackend::loadImages(tinygltf::Model& input)
+    void importNode(fastgltf::Asset const& asset,
+                    GltfBufferMappings const& buffers,
+                    size_t nodeIndex,
+                    int32_t parent,
+                    SceneData& scene)
     {
-        // Images can be stored inside the glTF (which is the case for the sample
-        // model), so instead of directly loading them from disk, we fetch them from
-        // the glTF loader and upload the buffers
-        m_sceneResources.images.resize(input.images.size());
-
-        for (size_t i = 0; i < input.images.size(); i++)
-        {
-            tinygltf::Image& glTFImage = input.images[i];
-            // Get the image data from the glTF loader
-            unsigned char* buffer   = nullptr;
-            VkDeviceSize bufferSize = 0;
-            bool deleteBuffer       = false;
-            // We convert RGB-only images to RGBA, as most devices don't support
-            // RGB-formats in Vulkan
-            if (glTFImage.component == 3)
+        fastgltf::Node const& inputNode = asset.nodes[nodeIndex];
+
+        auto const self = static_cast<int32_t>(scene.nodes.size());
+
+        SceneNode node {
+            .transform      = glm::mat4(1.0f),
+            .parent         = parent,
+            .firstPrimitive = static_cast<uint32_t>(scene.primitives.size()),
+            .primitiveCount = 0,
+        };
+
+        // Get the local node matrix
+        // It's either made up from translation, rotation, scale or a 4x4 matrix
+        std::visit(fastgltf::visitor {
+                       [&](fastgltf::Node::TransformMatrix const& matrix)
+                       { node.transform = glm::make_mat4x4(matrix.data()); },
+                       [&](fastgltf::Node::TRS const& trs)
+                       {
+                           glm::vec3 translation = glm::make_vec3(trs.translation.data());
+                           glm::quat rotation    = glm::make_quat(trs.rotation.data());
+                           glm::vec3 scale       = glm::make_vec3(trs.scale.data());
+
+                           node.transform = glm::translate(glm::mat4(1.0f), translation) *
+                                            glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale);
+                       },
+                   },
+                   inputNode.transform);
+
+        // If the node contains mesh data, we load vertices and indices from the
+        // buffers In glTF this is done via accessors and buffer views
+        if (inputNode.meshIndex.has_value())
+        {
+            fastgltf::Mesh const& mesh = asset.meshes[*inputNode.meshIndex];
+
+            for (fastgltf::Primitive const& gltfPrimitive : mesh.primitives)
             {
-                bufferSize          = glTFImage.width * glTFImage.height * 4;
-                buffer              = new unsigned char[bufferSize];
-                unsigned char* rgba = buffer;
-                unsigned char* rgb  = &glTFImage.image[0];
-                for (size_t i = 0; i < glTFImage.width * glTFImage.height; ++i)
+                auto firstIndex  = static_cast<uint32_t>(scene.indices.size());
+                auto vertexStart = static_cast<uint32_t>(scene.vertices.size());
+
+                uint32_t materialIndex = gltfPrimitive.materialIndex.has_value()
+                                             ? static_cast<uint32_t>(*gltfPrimitive.materialIndex)
+                                             : 0;
+
+                Material& material = scene.materials[materialIndex];
+
+                glm::vec3 boundsMin(std::numeric_limits<float>::max());
+                glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+
+                // Vertices, read in place from the mapped buffers
+                {
+                    auto const positionIt = gltfPrimitive.findAttribute("POSITION");
+
+                    MC_ASSERT_MSG(positionIt != gltfPrimitive.attributes.end(),
+                                  "glTF primitive of mesh '{}' has no positions",
+                                  mesh.name);
+
+                    fastgltf::Accessor const& positionAccessor = asset.accessors[positionIt->second];
+
+                    scene.vertices.resize(vertexStart + positionAccessor.count);
+
+                    std::span<Vertex> vertices { scene.vertices.begin() + vertexStart,
+                                                 positionAccessor.count };
+
+                    fastgltf::iterateAccessorWithIndex<glm::vec3>(
+                        asset,
+                        positionAccessor,
+                        [&](glm::vec3 position, size_t v)
+                        {
+                            vertices[v].position = position;
+
+                            boundsMin = glm::min(boundsMin, position);
+                            boundsMax = glm::max(boundsMax, position);
+                        },
+                        buffers);
+
+                    if (auto it = gltfPrimitive.findAttribute("NORMAL"); it != gltfPrimitive.attributes.end())
+                    {
+                        fastgltf::iterateAccessorWithIndex<glm::vec3>(
+                            asset,
+                            asset.accessors[it->second],
+                            [&](glm::vec3 normal, size_t v) { vertices[v].normal = glm::normalize(normal); },
+                            buffers);
+                    }
+
+                    if (auto it = gltfPrimitive.findAttribute("TANGENT");
+                        it != gltfPrimitive.attributes.end())
+                    {
+                        fastgltf::iterateAccessorWithIndex<glm::vec4>(
+                            asset,
+                            asset.accessors[it->second],
+                            [&](glm::vec4 tangent, size_t v) { vertices[v].tangent = tangent; },
+                            buffers);
+
+                        material.flags |= std::to_underlying(MaterialFeatures::TangentVertexAttribute);
+                    }
+
+                    // glTF supports multiple sets, we only load the first one
+                    if (auto it = gltfPrimitive.findAttribute("TEXCOORD_0");
+                        it != gltfPrimitive.attributes.end())
+                    {
+                        fastgltf::iterateAccessorWithIndex<glm::vec2>(
+                            asset,
+                            asset.accessors[it->second],
+                            [&](glm::vec2 uv, size_t v)
+                            {
+                                vertices[v].uv_x = uv.x;
+                                vertices[v].uv_y = uv.y;
+                            },
+                            buffers);
+
+                        material.flags |= std::to_underlying(MaterialFeatures::TexcoordVertexAttribute);
+                    }
+                }
+
+                auto const vertexCount = static_cast<uint32_t>(scene.vertices.size()) - vertexStart;
+
+                glm::vec3 const sphereCenter = (boundsMin + boundsMax) * 0.5f;
+                float sphereRadius           = 0.f;
+
+                for (Vertex const& vertex : std::span(scene.vertices).subspan(vertexStart))
+                {
+                    sphereRadius = std::max(sphereRadius, glm::distance(vertex.position, sphereCenter));
+                }
+
+                // Indices, relative to the primitive's vertices. Any component type is widened to 32 bits by
+                // the accessor tools, packIndices narrows them again where possible.
+                if (gltfPrimitive.indicesAccessor.has_value())
+                {
+                    fastgltf::Accessor const& indexAccessor = asset.accessors[*gltfPrimitive.indicesAccessor];
+
+                    scene.indices.reserve(scene.indices.size() + indexAccessor.count);
+
+                    fastgltf::iterateAccessor<uint32_t>(
+                        asset,
+                        indexAccessor,
+                        [&](uint32_t index) { scene.indices.push_back(index); },
+                        buffers);
+                }
+                else
                 {
-                    memcpy(rgba, rgb, sizeof(unsigned char) * 3);
-                    rgba += 4;
-                    rgb += 3;
+                    for (uint32_t v = 0; v < vertexCount; v++)
+                    {
+                        scene.indices.push_back(v);
+                    }
                 }
-                deleteBuffer = true;
+
+                scene.primitives.push_back({
+                    .firstIndex    = firstIndex,
+                    .indexCount    = static_cast<uint32_t>(scene.indices.size()) - firstIndex,
+                    .materialIndex = materialIndex,
+                    .firstVertex   = vertexStart,
+                    .vertexCount   = vertexCount,
+                    .indexType     = vk::IndexType::eUint32,
+                    .boundsMin     = boundsMin,
+                    .boundsMax     = boundsMax,
+                    .sphereCenter  = sphereCenter,
+                    .sphereRadius  = sphereRadius,
+                });
+
+                ++node.primitiveCount;
+            }
+        }
+
+        scene.nodes.push_back(node);
+
+        // Load node's children
+        for (size_t childIndex : inputNode.children)
+        {
+            importNode(asset, buffers, childIndex, self, scene);
+        }
+    }
+
+    // Runs every primitive through the mesh optimizer and repacks the scene's vertex and index arrays, which
+    // shrink as duplicate vertices are merged. The optimized triangle order is then split into meshlets.
+    void optimizePrimitives(SceneData& scene)
+    {
+        ZoneScopedN("Optimize primitives");
+
+        auto const startTime = Timer::Clock::now();
+
+        std::vector<Vertex> vertices;
+        vertices.reserve(scene.vertices.size());
+
+        std::vector<uint32_t> indices;
+        indices.reserve(scene.indices.size());
+
+        std::vector<Vertex> primitiveVertices;
+        std::vector<uint32_t> primitiveIndices;
+
+        VertexCacheStats before, after;
+
+        for (Primitive& primitive : scene.primitives)
+        {
+            primitiveVertices.assign(scene.vertices.begin() + primitive.firstVertex,
+                                     scene.vertices.begin() + primitive.firstVertex + primitive.vertexCount);
+
+            auto const sourceIndices =
+                std::span(scene.indices).subspan(primitive.firstIndex, primitive.indexCount);
+
+            primitiveIndices.assign(sourceIndices.begin(), sourceIndices.end());
+
+            before += analyzeVertexCache(primitiveIndices, primitiveVertices.size());
+
+            optimizeMesh(primitiveVertices, primitiveIndices);
+
+            after += analyzeVertexCache(primitiveIndices, primitiveVertices.size());
+
+            bool const doubleSided = (scene.materials[primitive.materialIndex].flags &
+                                      std::to_underlying(MaterialFeatures::DoubleSided)) != 0;
+
+            std::vector<Meshlet> meshlets = buildMeshlets(primitiveVertices, primitiveIndices, doubleSided);
+
+            primitive.firstMeshlet = static_cast<uint32_t>(scene.meshlets.size());
+            primitive.meshletCount = static_cast<uint32_t>(meshlets.size());
+
+            scene.meshlets.insert(scene.meshlets.end(), meshlets.begin(), meshlets.end());
+
+            primitive.firstVertex = static_cast<uint32_t>(vertices.size());
+            primitive.vertexCount = static_cast<uint32_t>(primitiveVertices.size());
+            primitive.firstIndex  = static_cast<uint32_t>(indices.size());
+
+            vertices.insert(vertices.end(), primitiveVertices.begin(), primitiveVertices.end());
+            indices.insert(indices.end(), primitiveIndices.begin(), primitiveIndices.end());
+        }
+
+        logger::info("Optimized {} primitives in {:.2f} ms: {} -> {} vertices, ACMR {:.3f} -> {:.3f}, "
+                     "ATVR {:.3f} -> {:.3f} (FIFO cache of {}), {} meshlets",
+                     scene.primitives.size(),
+                     Timer::Milliseconds(Timer::Clock::now() - startTime).count(),
+                     scene.vertices.size(),
+                     vertices.size(),
+                     before.getAcmr(),
+                     after.getAcmr(),
+                     before.getAtvr(),
+                     after.getAtvr(),
+                     kVertexCacheSize,
+                     scene.meshlets.size());
+
+        scene.vertices = std::move(vertices);
+        scene.indices  = std::move(indices);
+    }
+
+    // Moves the indices of every primitive whose vertex range fits into 16 bits to the short index pool
+    void packIndices(SceneData& scene)
+    {
+        std::vector<uint32_t> wideIndices;
+
+        for (Primitive& primitive : scene.primitives)
+        {
+            auto const indices = std::span(scene.indices).subspan(primitive.firstIndex, primitive.indexCount);
+
+            if (primitive.vertexCount <= std::numeric_limits<uint16_t>::max() + 1u)
+            {
+                primitive.indexType  = vk::IndexType::eUint16;
+                primitive.firstIndex = static_cast<uint32_t>(scene.shortIndices.size());
+
+                rn::transform(indices,
+                              std::back_inserter(scene.shortIndices),
+                              [](uint32_t index) { return static_cast<uint16_t>(index); });
             }
             else
             {
-                buffer     = &glTFImage.image[0];
-                bufferSize = glTFImage.image.size();
+                primitive.indexType  = vk::IndexType::eUint32;
+                primitive.firstIndex = static_cast<uint32_t>(wideIndices.size());
+
+                wideIndices.insert(wideIndices.end(), indices.begin(), indices.end());
             }
+        }
+
+        logger::info("Packed indices: {} 16-bit, {} 32-bit ({:.2f} MiB -> {:.2f} MiB)",
+                     scene.shortIndices.size(),
+                     wideIndices.size(),
+                     toMiB(scene.indices.size() * sizeof(uint32_t)),
+                     toMiB(std::span(scene.shortIndices).size_bytes() + std::span(wideIndices).size_bytes()));
+
+        scene.indices = std::move(wideIndices);
+    }
+
+    // Octahedral mapping of a unit vector onto [-1, 1]^2, decoded by decodeOctahedral in vs.vert
+    auto encodeOctahedral(glm::vec3 n) -> glm::vec2
+    {
+        float const l1Norm = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+
+        // Primitives without normals or tangents leave them zeroed
+        if (l1Norm == 0.f)
+        {
+            return glm::vec2(0.f);
+        }
+
+        n /= l1Norm;
+
+        if (n.z >= 0.f)
+        {
+            return { n.x, n.y };
+        }
+
+        glm::vec2 const signs { n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f };
+
+        return (1.f - glm::abs(glm::vec2(n.y, n.x))) * signs;
+    }
+
+    void quantizeVertices(SceneData& scene)
+    {
+        ZoneScopedN("Quantize vertices");
 
-            // Load texture from image buffer
-            m_sceneResources.images[i].texture =
-                Texture(m_device,
-                        m_allocator,
-                        m_commandManager,
-                        vk::Extent2D { static_cast<uint32_t>(glTFImage.width),
-                                       static_cast<uint32_t>(glTFImage.height) },
-                        buffer,
-                        bufferSize);
-
-            if (deleteBuffer)
+        scene.quantizedVertices.resize(scene.vertices.size());
+
+        for (Primitive const& primitive : scene.primitives)
+        {
+            glm::vec3 const extent = primitive.boundsMax - primitive.boundsMin;
+
+            // Flat primitives have a zero extent on at least one axis, everything maps to the minimum there
+            glm::vec3 const scale { extent.x > 0.f ? 1.f / extent.x : 0.f,
+                                    extent.y > 0.f ? 1.f / extent.y : 0.f,
+                                    extent.z > 0.f ? 1.f / extent.z : 0.f };
+
+            for (uint32_t v = primitive.firstVertex; v < primitive.firstVertex + primitive.vertexCount; ++v)
             {
-                delete[] buffer;
+                Vertex const& vertex = scene.vertices[v];
+
+                glm::vec3 const position = (vertex.position - primitive.boundsMin) * scale;
+                float const tangentSign  = vertex.tangent.w < 0.f ? 0.f : 1.f;
+
+                scene.quantizedVertices[v] = {
+                    .positionXY           = glm::packUnorm2x16({ position.x, position.y }),
+                    .positionZTangentSign = glm::packUnorm2x16({ position.z, tangentSign }),
+                    .normal               = glm::packSnorm2x16(encodeOctahedral(vertex.normal)),
+                    .tangent              = glm::packSnorm2x16(encodeOctahedral(glm::vec3(vertex.tangent))),
+                    .uv                   = glm::packHalf2x16({ vertex.uv_x, vertex.uv_y }),
+                };
             }
         }
+
+        logger::info("Quantized {} vertices: {:.2f} MiB -> {:.2f} MiB",
+                     scene.vertices.size(),
+                     toMiB(scene.vertices.size() * sizeof(Vertex)),
+                     toMiB(scene.quantizedVertices.size() * sizeof(QuantizedVertex)));
+
+        scene.vertexFormat = VertexFormat::Quantized;
+        scene.vertices     = {};
+    }
+
+    // Mirrors MeshletDraw in meshlet_cull.comp and Draw in draw.glsl, one per SceneDraw. The culling pass
+    // writes its index as the firstInstance of its meshlets' commands.
+    struct GPUMeshletDraw
+    {
+        // Primitive::firstIndex and firstVertex, meshlet offsets are added on top
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+
+        // World matrix in the scene graph's node buffer
+        uint32_t nodeIndex;
+
+        // Where the culling pass compacts the draw's commands, see SceneResources::commandRanges
+        uint32_t commandRange;
+
+        // Dequantizes positions of VertexFormat::Quantized scenes, see QuantizedVertex
+        glm::vec3 positionOffset;
+        uint32_t materialIndex;
+        glm::vec4 positionScale;
     };
 
-    void RendererBackend::loadTextures(tinygltf::Model& input)
+    static_assert(sizeof(GPUMeshletDraw) == 48);
+
+    // Mirrors MeshletInstance in meshlet_cull.comp, one per meshlet per SceneDraw
+    struct GPUMeshletInstance
     {
-        m_sceneResources.textures.resize(input.textures.size());
+        uint32_t meshletIndex;
+        uint32_t drawIndex;
+    };
+}  // namespace
 
-        logger::debug("{} textures in the gltf scene", input.textures.size());
+namespace renderer::backend
+{
+    namespace fs = std::filesystem;
 
-        for (size_t i = 0; i < input.textures.size(); i++)
+    GltfBufferMappings::GltfBufferMappings(fastgltf::Asset const& asset, fs::path const& directory)
+        : m_asset { &asset }
+    {
+        m_buffers.reserve(asset.buffers.size());
+
+        for (fastgltf::Buffer const& buffer : asset.buffers)
         {
-            m_sceneResources.textures[i].imageIndex = input.textures[i].source;
+            // Moving a MappedFile doesn't move the mapping, so the spans stay valid when m_files grows
+            m_buffers.push_back(std::visit(
+                fastgltf::visitor {
+                    [&](fastgltf::sources::URI const& uri) -> std::span<std::byte const>
+                    {
+                        MC_ASSERT_MSG(uri.uri.isLocalPath(),
+                                      "Only local glTF buffers are supported, got '{}'",
+                                      uri.uri.fspath().string());
+
+                        utils::MappedFile& file = m_files.emplace_back(directory / uri.uri.fspath());
+
+                        return file.getBytes().subspan(uri.fileByteOffset, buffer.byteLength);
+                    },
+                    [](fastgltf::sources::ByteView const& view) -> std::span<std::byte const>
+                    {
+                        return { view.bytes.data(), view.bytes.size() };
+                    },
+                    [](fastgltf::sources::Vector const& vector) -> std::span<std::byte const>
+                    {
+                        return std::as_bytes(std::span { vector.bytes });
+                    },
+                    [](auto const&) -> std::span<std::byte const>
+                    {
+                        MC_ASSERT_MSG(false, "Unsupported glTF buffer source");
+                        return {};
+                    },
+                },
+                buffer.data));
         }
-    };
+    }
 
-    void RendererBackend::loadMaterials(tinygltf::Model& input)
+    auto GltfBufferMappings::getBufferViewBytes(size_t bufferViewIndex) const -> std::span<std::byte const>
     {
-        m_sceneResources.materialRenderInfos.resize(input.materials.size());
+        fastgltf::BufferView const& view = m_asset->bufferViews[bufferViewIndex];
 
-        std::vector<DescriptorAllocator::PoolSizeRatio> sizes = {
-            { vk::DescriptorType::eCombinedImageSampler, 5 }
-        };
+        return m_buffers[view.bufferIndex].subspan(view.byteOffset, view.byteLength);
+    }
 
-        m_sceneResources.descriptorAllocator = DescriptorAllocator(m_device, input.materials.size(), sizes);
+    auto GltfBufferMappings::getMappedSize() const -> size_t
+    {
+        return std::accumulate(m_buffers.begin(),
+                               m_buffers.end(),
+                               size_t { 0 },
+                               [](size_t total, std::span<std::byte const> bytes)
+                               { return total + bytes.size(); });
+    }
 
-        m_sceneResources.hostMaterialBuffer = GPUBuffer(
-            m_allocator,
-            sizeof(Material) * input.materials.size(),
-            vk::BufferUsageFlagBits::eTransferSrc,
-            VMA_MEMORY_USAGE_AUTO,
-            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    auto GltfBufferMappings::operator()(fastgltf::Buffer const& buffer) const -> std::byte const*
+    {
+        return m_buffers[static_cast<size_t>(&buffer - m_asset->buffers.data())].data();
+    }
 
-        std::memset(m_sceneResources.hostMaterialBuffer.getMappedData(),
-                    0,
-                    m_sceneResources.hostMaterialBuffer.getSize());
+    auto importGltf(fs::path const& path, VertexFormat vertexFormat) -> SceneData
+    {
+        MC_ASSERT_MSG(fs::exists(path), "glTF file path does not exist: {}", path.string());
 
-        for (size_t i = 0; i < input.materials.size(); i++)
-        {
-            tinygltf::Material inputMaterial = input.materials[i];
+        auto const startTime  = Timer::Clock::now();
+        size_t const startRss = utils::getPeakResidentMemory();
+
+        // simdjson overreads its input, so the file is mapped with fastgltf's padding behind it and handed
+        // over as-is instead of being copied into a GltfDataBuffer
+        utils::MappedFile gltfFile(path, fastgltf::getGltfBufferPadding());
+
+        fastgltf::GltfDataBuffer data;
+        data.fromByteView(
+            reinterpret_cast<uint8_t*>(gltfFile.mutableData()), gltfFile.size(), gltfFile.capacity());
+
+        // Neither LoadExternalBuffers nor LoadGLBBuffers is set: external buffers are mapped by
+        // GltfBufferMappings and the GLB binary chunk stays a view into gltfFile
+        fastgltf::Parser parser(fastgltf::Extensions::MSFT_texture_dds);
+        fastgltf::GltfType const type = fastgltf::determineGltfFileType(&data);
 
-            Material& material =
-                reinterpret_cast<Material*>(m_sceneResources.hostMaterialBuffer.getMappedData())[i];
+        auto asset = type == fastgltf::GltfType::GLB
+                         ? parser.loadGltfBinary(&data, path.parent_path(), fastgltf::Options::None)
+                         : parser.loadGltfJson(&data, path.parent_path(), fastgltf::Options::None);
 
-            MaterialRenderInfo& renderInfo = m_sceneResources.materialRenderInfos[i];
+        if (asset.error() != fastgltf::Error::None)
+        {
+            MC_THROW Error(AssetError,
+                           std::format("Failed to parse glTF file '{}': {}",
+                                       path.string(),
+                                       fastgltf::getErrorMessage(asset.error())));
+        }
 
-            renderInfo.descriptorSet =
-                m_sceneResources.descriptorAllocator.allocate(m_device, m_materialDescriptorLayout);
+        fastgltf::Asset const& gltf = asset.get();
+        GltfBufferMappings buffers(gltf, path.parent_path());
 
-            DescriptorWriter descriptorWriter;
+        SceneData scene;
 
-            if (inputMaterial.values.find("baseColorFactor") != inputMaterial.values.end())
+        for (fastgltf::Buffer const& buffer : gltf.buffers)
+        {
+            if (auto const* uri = std::get_if<fastgltf::sources::URI>(&buffer.data))
             {
-                material.baseColorFactor =
-                    glm::make_vec4(inputMaterial.values["baseColorFactor"].ColorFactor().data());
+                scene.dependencies.push_back(uri->uri.fspath());
             }
+        }
 
-            std::unordered_map<char const*, MaterialFeatures> textureMap {
-                { "baseColorTexture",         MaterialFeatures::ColorTexture     },
-                { "metallicRoughnessTexture", MaterialFeatures::RoughnessTexture },
-                { "occlusionTexture",         MaterialFeatures::OcclusionTexture },
-                { "emissiveTexture",          MaterialFeatures::EmissiveTexture  },
-                { "normalTexture",            MaterialFeatures::NormalTexture    },
-            };
+        importImages(gltf, buffers, scene);
+        importMaterials(gltf, scene);
 
-            for (auto [i, pair] : vi::enumerate(textureMap))
+        for (SceneImageSource const& image : scene.images)
+        {
+            if (!image.path.empty())
             {
-                if (inputMaterial.values.find(pair.first) != inputMaterial.values.end())
-                {
-                    renderInfo.baseColorTextureIndex = inputMaterial.values[pair.first].TextureIndex();
+                scene.dependencies.push_back(image.path);
+            }
+        }
 
-                    descriptorWriter.write_image(
-                        i,
-                        m_sceneResources.images[renderInfo.baseColorTextureIndex].texture.getImageView(),
-                        // TODO(aether) using the dummy sampler
-                        m_dummySampler,
-                        vk::ImageLayout::eShaderReadOnlyOptimal,
-                        vk::DescriptorType::eCombinedImageSampler);
+        size_t const sceneIndex = gltf.defaultScene.has_value() ? *gltf.defaultScene : 0;
 
-                    material.flags |= std::to_underlying(pair.second);
-                }
-                else
-                {
-                    descriptorWriter.write_image(i,
-                                                 m_dummyTexture.getImageView(),
-                                                 m_dummySampler,
-                                                 vk::ImageLayout::eShaderReadOnlyOptimal,
-                                                 vk::DescriptorType::eCombinedImageSampler);
-                }
+        // A file without scenes only carries resources, it's imported as an empty scene
+        if (sceneIndex >= gltf.scenes.size() && gltf.defaultScene.has_value())
+        {
+            MC_THROW Error(AssetError,
+                           std::format("glTF file '{}' has no scene {}, only {}",
+                                       path.string(),
+                                       sceneIndex,
+                                       gltf.scenes.size()));
+        }
+
+        if (sceneIndex < gltf.scenes.size())
+        {
+            for (size_t nodeIndex : gltf.scenes[sceneIndex].nodeIndices)
+            {
+                importNode(gltf, buffers, nodeIndex, -1, scene);
             }
+        }
 
-            descriptorWriter.update_set(m_device, renderInfo.descriptorSet);
+        optimizePrimitives(scene);
+        packIndices(scene);
+
+        // The peak RSS delta is what the import cost on top of the mapped source files, which the kernel can
+        // page out and back in at will
+        logger::info("Imported '{}' in {:.2f} ms: {} vertices, {} indices, {} images",
+                     path.filename().string(),
+                     Timer::Milliseconds(Timer::Clock::now() - startTime).count(),
+                     scene.vertices.size(),
+                     scene.shortIndices.size() + scene.indices.size(),
+                     scene.images.size());
+
+        logger::info("Peak resident memory grew by {:.2f} MiB for {:.2f} MiB of glTF source "
+                     "({:.2f} MiB buffers)",
+                     toMiB(utils::getPeakResidentMemory() - startRss),
+                     toMiB(gltfFile.size() + (type == fastgltf::GltfType::GLB ? 0 : buffers.getMappedSize())),
+                     toMiB(buffers.getMappedSize()));
+
+        if (vertexFormat == VertexFormat::Quantized)
+        {
+            quantizeVertices(scene);
         }
 
-        m_sceneResources.materialBuffer =
-            GPUBuffer(m_allocator,
-                      m_sceneResources.hostMaterialBuffer.getSize(),
-                      vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress,
-                      VMA_MEMORY_USAGE_AUTO,
-                      VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+        // Relative image paths are resolved against the glTF's directory from now on
+        for (SceneImageSource& image : scene.images)
+        {
+            if (!image.path.empty())
+            {
+                image.path = path.parent_path() / image.path;
+            }
+        }
 
-        m_sceneResources.materialBufferDirty = true;
-    };
+        return scene;
+    }
 
-    void RendererBackend::loadNode(tinygltf::Node const& inputNode,
-                                   tinygltf::Model const& input,
-                                   GltfNode* parent,
-                                   std::vector<uint32_t>& indexBuffer,
-                                   std::vector<Vertex>& vertexBuffer)
+    auto decodeImage(SceneImageSource const& source) -> DecodedImage
     {
-        GltfNode* node       = new GltfNode {};
-        node->transformation = glm::mat4(1.0f);
-        node->parent         = parent;
+        ZoneScopedN("Decode image");
 
-        // Get the local node matrix
-        // It's either made up from translation, rotation, scale or a 4x4 matrix
-        if (inputNode.translation.size() == 3)
+        utils::MappedFile file;
+        std::span<std::byte const> encoded = source.encoded;
+
+        if (!source.path.empty())
+        {
+            file    = utils::MappedFile(source.path);
+            encoded = file.getBytes().subspan(source.offset);
+        }
+
+        // DDS and KTX2 are uploaded as stored, the mapping (or a copy of the embedded bytes) backs the result
+        if (isTextureContainer(encoded))
         {
-            node->transformation =
-                glm::translate(node->transformation, glm::vec3(glm::make_vec3(inputNode.translation.data())));
+            if (file)
+            {
+                // Moving the mapping keeps its address, `encoded` stays valid
+                return parseTextureContainer(
+                    encoded, std::make_shared<utils::MappedFile>(std::move(file)), source.name);
+            }
+
+            auto owned = std::make_shared<std::vector<std::byte>>(source.encoded);
+            std::span<std::byte const> bytes = *owned;
+
+            return parseTextureContainer(bytes, std::move(owned), source.name);
         }
 
-        if (inputNode.rotation.size() == 4)
+        int width = 0, height = 0, channels = 0;
+
+        // stb expands RGB images to RGBA while decoding, as most devices don't support RGB-formats in Vulkan
+        stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<stbi_uc const*>(encoded.data()),
+                                                static_cast<int>(encoded.size()),
+                                                &width,
+                                                &height,
+                                                &channels,
+                                                STBI_rgb_alpha);
+
+        MC_ASSERT_MSG(pixels, "Failed to decode glTF image '{}': {}", source.name, stbi_failure_reason());
+
+        return {
+            .dimensions = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) },
+            .mipLevels  = 1,
+            .data       = { reinterpret_cast<std::byte const*>(pixels),
+                           static_cast<size_t>(width) * static_cast<size_t>(height) * 4 },
+            .owner      = std::shared_ptr<void const>(pixels, stbi_image_free),
+        };
+    }
+
+    void RendererBackend::processGltf(fs::path const& path, VertexFormat vertexFormat)
+    {
+        auto const startTime = Timer::Clock::now();
+
+        // Warm start: everything is already in its GPU layout, the mapped cache is copied into the upload
+        // ring as-is and the pre-mipped textures stream straight out of the mapping
+        if (std::optional<SceneCache> cache = SceneCache::open(path, vertexFormat))
         {
-            glm::quat q = glm::make_quat(inputNode.rotation.data());
-            node->transformation *= glm::mat4(q);
+            SceneView scene = cache->getView();
+
+            uploadScene(scene);
+
+            for (uint32_t i = 0; i < scene.imageCount; ++i)
+            {
+                m_textureLoader.enqueue(i, cache->getImage(i));
+            }
+
+            logger::info("Loaded '{}' from the scene cache (warm) in {:.2f} ms",
+                         path.filename().string(),
+                         Timer::Milliseconds(Timer::Clock::now() - startTime).count());
+
+            return;
         }
-        if (inputNode.scale.size() == 3)
+
+        SceneData scene = importGltf(path, vertexFormat);
+
+        uploadScene(scene.getView());
+
+        for (auto [i, image] : vi::enumerate(scene.images))
         {
-            node->transformation =
-                glm::scale(node->transformation, glm::vec3(glm::make_vec3(inputNode.scale.data())));
+            m_textureLoader.enqueue(static_cast<uint32_t>(i),
+                                    [image = std::move(image)] { return decodeImage(image); });
         }
 
-        if (inputNode.matrix.size() == 16)
+        logger::info("Loaded '{}' from glTF (cold) in {:.2f} ms, run with --bake {} to cache it",
+                     path.filename().string(),
+                     Timer::Milliseconds(Timer::Clock::now() - startTime).count(),
+                     path.string());
+    }
+
+    void RendererBackend::uploadScene(SceneView const& scene)
+    {
+        m_sceneResources.images.resize(scene.imageCount);
+
+        // Every image gets its slot up front, sampling the dummy texture until it has streamed in
+        for (GltfImage& image : m_sceneResources.images)
         {
-            node->transformation = glm::make_mat4x4(inputNode.matrix.data());
-        };
+            // TODO(aether) using the dummy sampler
+            image.bindlessSlot = m_bindlessTextures.add(m_dummyTexture.getImageView(), m_dummySampler);
+        }
 
-        // Load node's children
-        if (inputNode.children.size() > 0)
+        std::vector<Material> materials(scene.materials.begin(), scene.materials.end());
+
+        for (auto [material, images] : vi::zip(materials, scene.materialTextures))
         {
-            for (size_t i = 0; i < inputNode.children.size(); i++)
+            for (auto [slot, imageIndex] : vi::zip(material.textures, images))
             {
-                loadNode(input.nodes[inputNode.children[i]], input, node, indexBuffer, vertexBuffer);
+                slot = imageIndex == kNoImage ? m_dummyTextureSlot
+                                              : m_sceneResources.images[imageIndex].bindlessSlot;
             }
         }
 
-        // If the node contains mesh data, we load vertices and indices from the
-        // buffers In glTF this is done via accessors and buffer views
-        if (inputNode.mesh > -1)
+        m_sceneResources.sceneGraph = SceneGraph(m_allocator, scene.nodes);
+
+        // One draw per placed primitive, its meshlets find the world matrix through the node index
+        std::vector<GPUMeshletDraw> meshletDraws;
+        std::vector<GPUMeshletInstance> meshletInstances;
+
+        m_sceneResources.draws.clear();
+
+        // Draws are bucketed by draw pass, the pipeline permutation of their material and by index type,
+        // ordered like the keys so that the blended ranges come last. Holds the bucket's meshlet count first,
+        // its range index once the ranges are laid out.
+        std::map<uint64_t, uint32_t> rangeIndices;
+
+        auto isBlended = [&](Primitive const& primitive) -> bool
+        {
+            return (scene.materials[primitive.materialIndex].flags &
+                    std::to_underlying(MaterialFeatures::AlphaBlend)) != 0;
+        };
+
+        auto getRangeKey = [&](Primitive const& primitive) -> uint64_t
+        {
+            uint32_t const features =
+                scene.materials[primitive.materialIndex].flags & kSpecializedMaterialFeatures;
+
+            return (uint64_t { isBlended(primitive) } << 33) | (uint64_t { features } << 1) |
+                   (primitive.indexType == vk::IndexType::eUint32 ? 1 : 0);
+        };
+
+        for (SceneNode const& sceneNode : scene.nodes)
         {
-            tinygltf::Mesh const mesh = input.meshes[inputNode.mesh];
-            // Iterate through all primitives of this node's mesh
-            for (size_t i = 0; i < mesh.primitives.size(); i++)
+            for (Primitive const& primitive :
+                 scene.primitives.subspan(sceneNode.firstPrimitive, sceneNode.primitiveCount))
             {
-                tinygltf::Primitive const& glTFPrimitive = mesh.primitives[i];
+                rangeIndices[getRangeKey(primitive)] += primitive.meshletCount;
+            }
+        }
 
-                uint32_t firstIndex  = static_cast<uint32_t>(indexBuffer.size());
-                uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
-                uint32_t indexCount  = 0;
+        m_sceneResources.commandRanges.clear();
 
-                // Vertices
-                {
-                    float const* positionBuffer  = nullptr;
-                    float const* normalsBuffer   = nullptr;
-                    float const* tangentsBuffer  = nullptr;
-                    float const* texCoordsBuffer = nullptr;
-                    size_t vertexCount           = 0;
-
-                    // Get buffer data for vertex positions
-                    if (glTFPrimitive.attributes.find("POSITION") != glTFPrimitive.attributes.end())
-                    {
-                        tinygltf::Accessor const& accessor =
-                            input.accessors[glTFPrimitive.attributes.find("POSITION")->second];
-                        tinygltf::BufferView const& view = input.bufferViews[accessor.bufferView];
-                        positionBuffer                   = reinterpret_cast<float const*>(
-                            &(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                        vertexCount = accessor.count;
-                    }
+        uint32_t firstCommand = 0;
 
-                    // Get buffer data for vertex normals
-                    if (glTFPrimitive.attributes.find("NORMAL") != glTFPrimitive.attributes.end())
-                    {
-                        tinygltf::Accessor const& accessor =
-                            input.accessors[glTFPrimitive.attributes.find("NORMAL")->second];
-                        tinygltf::BufferView const& view = input.bufferViews[accessor.bufferView];
-                        normalsBuffer                    = reinterpret_cast<float const*>(
-                            &(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                    }
+        for (auto& [key, value] : rangeIndices)
+        {
+            uint32_t const commandCount =
+                std::exchange(value, static_cast<uint32_t>(m_sceneResources.commandRanges.size()));
 
-                    // Get buffer data for vertex tangents
-                    if (glTFPrimitive.attributes.find("TANGENT") != glTFPrimitive.attributes.end())
-                    {
-                        tinygltf::Accessor const& accessor =
-                            input.accessors[glTFPrimitive.attributes.find("TANGENT")->second];
-                        tinygltf::BufferView const& view = input.bufferViews[accessor.bufferView];
-                        tangentsBuffer                   = reinterpret_cast<float const*>(
-                            &(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                    }
+            if (commandCount == 0)
+            {
+                continue;
+            }
 
-                    // Get buffer data for vertex texture coordinates
-                    // glTF supports multiple sets, we only load the first one
-                    if (glTFPrimitive.attributes.find("TEXCOORD_0") != glTFPrimitive.attributes.end())
-                    {
-                        tinygltf::Accessor const& accessor =
-                            input.accessors[glTFPrimitive.attributes.find("TEXCOORD_0")->second];
-                        tinygltf::BufferView const& view = input.bufferViews[accessor.bufferView];
-                        texCoordsBuffer                  = reinterpret_cast<float const*>(
-                            &(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                    }
+            m_sceneResources.commandRanges.push_back({
+                .materialFeatures = static_cast<uint32_t>(key >> 1),
+                .indexType        = (key & 1) != 0 ? vk::IndexType::eUint32 : vk::IndexType::eUint16,
+                .pass             = (key >> 33) != 0 ? DrawPass::Blended : DrawPass::Opaque,
+                .firstCommand     = firstCommand,
+                .commandCount     = commandCount,
+            });
 
-                    // Append data to model's vertex buffer
-                    for (size_t v = 0; v < vertexCount; v++)
-                    {
-                        Vertex vert {};
-                        vert.position = glm::make_vec3(&positionBuffer[v * 3]);
-                        vert.normal   = glm::normalize(glm::vec3(
-                            normalsBuffer ? glm::make_vec3(&normalsBuffer[v * 3]) : glm::vec3(0.0f)));
-                        vert.tangent =
-                            tangentsBuffer ? glm::make_vec4(&tangentsBuffer[v * 4]) : glm::vec4(0.0f);
-
-                        if (texCoordsBuffer)
-                        {
-                            glm::vec2 uv_vec = glm::make_vec2(&texCoordsBuffer[v * 2]);
-                            vert.uv_x        = uv_vec.x;
-                            vert.uv_y        = uv_vec.y;
-                        }
+            firstCommand += commandCount;
+        }
 
-                        vertexBuffer.push_back(vert);
-                    }
-                }
+        // Built here on the main thread, the recording threads only look them up
+        for (CommandRange const& range : m_sceneResources.commandRanges)
+        {
+            getMaterialPipeline(scene.vertexFormat, range.materialFeatures, range.pass);
+        }
 
-                // Indices
+        for (auto [nodeIndex, sceneNode] : vi::enumerate(scene.nodes))
+        {
+            for (Primitive const& primitive :
+                 scene.primitives.subspan(sceneNode.firstPrimitive, sceneNode.primitiveCount))
+            {
+                if (primitive.meshletCount == 0)
                 {
-                    tinygltf::Accessor const& accessor     = input.accessors[glTFPrimitive.indices];
-                    tinygltf::BufferView const& bufferView = input.bufferViews[accessor.bufferView];
-                    tinygltf::Buffer const& buffer         = input.buffers[bufferView.buffer];
+                    continue;
+                }
 
-                    indexCount += static_cast<uint32_t>(accessor.count);
+                auto const drawIndex      = static_cast<uint32_t>(meshletDraws.size());
+                uint32_t const rangeIndex = rangeIndices.at(getRangeKey(primitive));
 
-                    // glTF supports different component types of indices
-                    switch (accessor.componentType)
-                    {
-                        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
-                            {
-                                uint32_t const* buf = reinterpret_cast<uint32_t const*>(
-                                    &buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-                                for (size_t index = 0; index < accessor.count; index++)
-                                {
-                                    indexBuffer.push_back(buf[index] + vertexStart);
-                                }
-                                break;
-                            }
-                        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
-                            {
-                                uint16_t const* buf = reinterpret_cast<uint16_t const*>(
-                                    &buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-                                for (size_t index = 0; index < accessor.count; index++)
-                                {
-                                    indexBuffer.push_back(buf[index] + vertexStart);
-                                }
-                                break;
-                            }
-                        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
-                            {
-                                uint8_t const* buf = reinterpret_cast<uint8_t const*>(
-                                    &buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-                                for (size_t index = 0; index < accessor.count; index++)
-                                {
-                                    indexBuffer.push_back(buf[index] + vertexStart);
-                                }
-                                break;
-                            }
-                        default:
-                            MC_ASSERT_MSG(false, "Unsupported index type");
-                            return;
-                    }
-                }
+                m_sceneResources.draws.push_back({
+                    .nodeIndex            = static_cast<uint32_t>(nodeIndex),
+                    .primitive            = primitive,
+                    .firstMeshletInstance = static_cast<uint32_t>(meshletInstances.size()),
+                    .pass                 = isBlended(primitive) ? DrawPass::Blended : DrawPass::Opaque,
+                    .commandRange         = rangeIndex,
+                });
 
-                node->mesh.primitives.push_back({
-                    .firstIndex    = firstIndex,
-                    .indexCount    = indexCount,
-                    .materialIndex = static_cast<uint32_t>(glTFPrimitive.material),
+                meshletDraws.push_back({
+                    .firstIndex     = primitive.firstIndex,
+                    .vertexOffset   = static_cast<int32_t>(primitive.firstVertex),
+                    .nodeIndex      = static_cast<uint32_t>(nodeIndex),
+                    .commandRange   = rangeIndex,
+                    .positionOffset = primitive.boundsMin,
+                    .materialIndex  = primitive.materialIndex,
+                    .positionScale  = glm::vec4(primitive.boundsMax - primitive.boundsMin, 0.f),
                 });
+
+                for (uint32_t meshlet = 0; meshlet < primitive.meshletCount; ++meshlet)
+                {
+                    meshletInstances.push_back({ primitive.firstMeshlet + meshlet, drawIndex });
+                }
             }
         }
 
-        if (parent)
+        m_sceneResources.meshletInstanceCount = static_cast<uint32_t>(meshletInstances.size());
+
+        std::span<std::byte const> vertexBytes = scene.vertexFormat == VertexFormat::Quantized
+                                                     ? std::as_bytes(scene.quantizedVertices)
+                                                     : std::as_bytes(scene.vertices);
+
+        // bindIndexBuffer offsets have to be aligned to the index size
+        vk::DeviceSize const wideIndexOffset = (scene.shortIndices.size_bytes() + 3) & ~vk::DeviceSize { 3 };
+
+        size_t vertexBufferSize       = vertexBytes.size();
+        size_t indexBufferSize        = wideIndexOffset + scene.indices.size_bytes();
+        size_t materialBufferSize     = scene.materials.size_bytes();
+        m_sceneResources.indexCount   = scene.shortIndices.size() + scene.indices.size();
+        m_sceneResources.vertexFormat = scene.vertexFormat;
+
+        m_sceneResources.wideIndexOffset = wideIndexOffset;
+
+        m_sceneResources.materialBuffer =
+            GPUBuffer(m_allocator,
+                      materialBufferSize,
+                      vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                      VMA_MEMORY_USAGE_AUTO,
+                      VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+
+        m_sceneResources.vertexBuffer =
+            GPUBuffer(m_allocator,
+                      vertexBufferSize,
+                      vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                      VMA_MEMORY_USAGE_AUTO,
+                      VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+
+        m_sceneResources.indexBuffer =
+            GPUBuffer(m_allocator,
+                      indexBufferSize,
+                      vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
+                      VMA_MEMORY_USAGE_AUTO,
+                      VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+
+        constexpr vk::AccessFlags2 kStorageRead = vk::AccessFlagBits2::eShaderStorageRead;
+
+        m_uploadManager.uploadBuffer(std::as_bytes(std::span(materials)),
+                                     m_sceneResources.materialBuffer,
+                                     0,
+                                     vk::PipelineStageFlagBits2::eVertexShader |
+                                         vk::PipelineStageFlagBits2::eFragmentShader,
+                                     kStorageRead);
+
+        m_uploadManager.uploadBuffer(std::as_bytes(scene.shortIndices),
+                                     m_sceneResources.indexBuffer,
+                                     0,
+                                     vk::PipelineStageFlagBits2::eIndexInput,
+                                     vk::AccessFlagBits2::eIndexRead);
+
+        m_uploadManager.uploadBuffer(std::as_bytes(scene.indices),
+                                     m_sceneResources.indexBuffer,
+                                     wideIndexOffset,
+                                     vk::PipelineStageFlagBits2::eIndexInput,
+                                     vk::AccessFlagBits2::eIndexRead);
+
+        m_uploadManager.uploadBuffer(vertexBytes,
+                                     m_sceneResources.vertexBuffer,
+                                     0,
+                                     vk::PipelineStageFlagBits2::eVertexShader,
+                                     kStorageRead);
+
+        if (m_sceneResources.meshletInstanceCount > 0)
         {
-            parent->children.push_back(node);
+            auto upload = [&](std::span<std::byte const> bytes, vk::PipelineStageFlags2 dstStage) -> GPUBuffer
+            {
+                GPUBuffer buffer(m_allocator,
+                                 bytes.size(),
+                                 vk::BufferUsageFlagBits::eTransferDst |
+                                     vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                                 VMA_MEMORY_USAGE_AUTO);
+
+                m_uploadManager.uploadBuffer(bytes, buffer, 0, dstStage, kStorageRead);
+
+                return buffer;
+            };
+
+            constexpr vk::PipelineStageFlags2 kCullStage = vk::PipelineStageFlagBits2::eComputeShader;
+
+            m_sceneResources.meshletBuffer = upload(std::as_bytes(scene.meshlets), kCullStage);
+            m_sceneResources.meshletInstanceBuffer =
+                upload(std::as_bytes(std::span(meshletInstances)), kCullStage);
+
+            // vs.vert looks its draw up as well
+            m_sceneResources.meshletDrawBuffer =
+                upload(std::as_bytes(std::span(meshletDraws)),
+                       kCullStage | vk::PipelineStageFlagBits2::eVertexShader);
+
+            // Later changes go out through SceneGraph::recordUpload
+            SceneGraph const& sceneGraph = m_sceneResources.sceneGraph;
+
+            m_uploadManager.uploadBuffer(std::as_bytes(sceneGraph.getWorldTransforms()),
+                                         sceneGraph.getBuffer(),
+                                         0,
+                                         kCullStage | vk::PipelineStageFlagBits2::eVertexShader,
+                                         kStorageRead);
+
+            // Written by meshlet_cull.comp every frame, cleared first when there is no drawIndirectCount
+            for (GPUBuffer& commandBuffer : m_sceneResources.indirectCommandBuffers)
+            {
+                commandBuffer = GPUBuffer(m_allocator,
+                                          meshletInstances.size() * sizeof(vk::DrawIndexedIndirectCommand),
+                                          vk::BufferUsageFlagBits::eIndirectBuffer |
+                                              vk::BufferUsageFlagBits::eTransferDst |
+                                              vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                                          VMA_MEMORY_USAGE_AUTO);
+            }
+
+            // Nothing counts as visible at first, the first late phase draws everything in the frustum
+            std::vector<uint32_t> const meshletVisibility(meshletInstances.size(), 0);
+
+            m_sceneResources.meshletVisibilityBuffer =
+                GPUBuffer(m_allocator,
+                          meshletVisibility.size() * sizeof(uint32_t),
+                          vk::BufferUsageFlagBits::eTransferDst |
+                              vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                          VMA_MEMORY_USAGE_AUTO);
+
+            m_uploadManager.uploadBuffer(std::as_bytes(std::span(meshletVisibility)),
+                                         m_sceneResources.meshletVisibilityBuffer,
+                                         0,
+                                         kCullStage,
+                                         kStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+            FrustumCuller& frustumCuller = m_sceneResources.frustumCuller;
+
+            frustumCuller = FrustumCuller(m_sceneResources.draws, sceneGraph);
+            m_sceneResources.drawVisibility.assign(frustumCuller.getVisibilityWordCount(), 0);
+
+            m_sceneResources.renderQueue.clear();
+            m_sceneResources.queuedInstanceCount = 0;
+
+            for (GPUBuffer& orderBuffer : m_sceneResources.instanceOrderBuffers)
+            {
+                orderBuffer = GPUBuffer(m_allocator,
+                                        meshletInstances.size() * sizeof(uint32_t),
+                                        vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                                        VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                                        VMA_ALLOCATION_CREATE_MAPPED_BIT |
+                                            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+            }
         }
-        else
+
+        // Goes out with the next frame, which keeps drawing without the scene until it has landed
+        m_sceneResources.uploadTicket = m_uploadManager.getRecordingTicket();
+    }
+
+    void RendererBackend::onTexturesLoaded(std::span<LoadedTexture> textures)
+    {
+        for (LoadedTexture& loaded : textures)
         {
-            m_sceneResources.nodes.push_back(node);
+            GltfImage& image = m_sceneResources.images[loaded.id];
+
+            image.texture = std::move(loaded.texture);
+
+            // Frames already in flight keep sampling the dummy texture
+            // TODO(aether) using the dummy sampler
+            m_bindlessTextures.set(image.bindlessSlot, image.texture.getImageView(), m_dummySampler);
         }
     }
 
-    void RendererBackend::drawNode(vk::CommandBuffer commandBuffer,
+    auto RendererBackend::isSceneReady() const -> bool
+    {
+        return m_sceneResources.meshletInstanceCount > 0 &&
+               m_uploadManager.isReady(m_sceneResources.uploadTicket);
+    }
+
+    void RendererBackend::drawGltf(vk::CommandBuffer commandBuffer,
                                    vk::PipelineLayout pipelineLayout,
-                                   GltfNode* node)
+                                   CullPhase phase,
+                                   uint32_t chunk,
+                                   uint32_t chunkCount)
     {
-        if (node->mesh.primitives.size() > 0)
+        if (!isSceneReady())
+        {
+            return;
+        }
+
+        FrameResources const& frame = m_frameResources[m_currentFrame];
+
+        // Materials index the bindless texture array, one bind covers the whole scene
+        commandBuffer.bindDescriptorSets(
+            vk::PipelineBindPoint::eGraphics,
+            m_texturedPipelineLayout,
+            0,
+            { m_sceneDataDescriptors, m_bindlessTextures.getSet(m_currentFrame) },
+            { frame.sceneDataOffset, frame.lightDataOffset });
+
+        auto getAddress = [&](vk::Buffer buffer)
+        { return m_device->getBufferAddress(vk::BufferDeviceAddressInfo().setBuffer(buffer)); };
+
+        GPUDrawPushConstants pushConstants {
+            .vertexBuffer   = getAddress(m_sceneResources.vertexBuffer),
+            .materialBuffer = getAddress(m_sceneResources.materialBuffer),
+            .drawBuffer     = getAddress(m_sceneResources.meshletDrawBuffer),
+            .nodeBuffer     = getAddress(m_sceneResources.sceneGraph.getBuffer()),
+        };
+
+        commandBuffer.pushConstants(pipelineLayout,
+                                    vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+                                    0,
+                                    sizeof(GPUDrawPushConstants),
+                                    &pushConstants);
+
+        GPUBuffer const& indirectCommandBuffer =
+            m_sceneResources.indirectCommandBuffers[std::to_underlying(phase)];
+
+        bool const countSupported = m_device.isDrawIndirectCountSupported();
+
+        // Timestamps need every range recorded as a whole by one chunk, which only draws with a count are
+        bool const timed = countSupported && m_timestampPeriod > 0.f;
+
+        vk::Pipeline boundPipeline = nullptr;
+
+        auto const rangeCount = utils::size(m_sceneResources.commandRanges);
+
+        // One multi-draw per command range, the index pools live in the same buffer and only differ in
+        // offset. The chunks are executed in order, which has to keep the blended ranges after every opaque
+        // draw.
+        for (auto [rangeIndex, range] : vi::enumerate(m_sceneResources.commandRanges))
         {
-            // Pass the node's matrix via push constants
-            // Traverse the node hierarchy to the top-most parent to get the final
-            // matrix of the current node
-            glm::mat4 nodeTransform = node->transformation;
-            GltfNode* currentParent = node->parent;
+            // A count covers the whole range, the ranges are dealt out to the chunks in contiguous runs then.
+            // Without one, every chunk draws an even share of each opaque range and the last chunk draws the
+            // blended ranges.
+            uint32_t firstCommand = range.firstCommand;
+            uint32_t commandCount = range.commandCount;
 
-            while (currentParent)
+            if (countSupported)
             {
-                nodeTransform = currentParent->transformation * nodeTransform;
-                currentParent = currentParent->parent;
+                if (static_cast<uint32_t>(rangeIndex) * chunkCount / rangeCount != chunk)
+                {
+                    continue;
+                }
             }
-
-            for (Primitive& primitive : node->mesh.primitives)
+            else if (range.pass == DrawPass::Blended)
             {
-                if (primitive.indexCount > 0)
+                if (chunk != chunkCount - 1)
                 {
-                    GPUDrawPushConstants pushConstants {
-                        .model        = nodeTransform,
-                        .vertexBuffer = m_device->getBufferAddress(
-                            vk::BufferDeviceAddressInfo().setBuffer(m_sceneResources.vertexBuffer)),
-                        .materialBuffer = m_device->getBufferAddress(
-                            vk::BufferDeviceAddressInfo().setBuffer(m_sceneResources.materialBuffer)),
-                        .materialIndex = primitive.materialIndex
-                    };
-
-                    commandBuffer.pushConstants(pipelineLayout,
-                                                vk::ShaderStageFlagBits::eVertex,
-                                                0,
-                                                sizeof(GPUDrawPushConstants),
-                                                &pushConstants);
-                    commandBuffer.bindDescriptorSets(
-                        vk::PipelineBindPoint::eGraphics,
-                        m_texturedPipelineLayout,
-                        0,
-                        { m_sceneDataDescriptors,
-                          m_sceneResources.materialRenderInfos[primitive.materialIndex].descriptorSet },
-                        {});
-
-                    commandBuffer.drawIndexed(primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+                    continue;
                 }
             }
-        }
-        for (auto& child : node->children)
-        {
-            drawNode(commandBuffer, pipelineLayout, child);
-        }
-    };
+            else
+            {
+                uint32_t const chunkSize  = (range.commandCount + chunkCount - 1) / chunkCount;
+                uint32_t const chunkStart = chunk * chunkSize;
 
-    void RendererBackend::drawGltf(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout)
-    {
-        // All vertices and indices are stored in single buffers, so we only need to
-        // bind once
-        commandBuffer.bindIndexBuffer(m_sceneResources.indexBuffer, 0, vk::IndexType::eUint32);
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_texturedPipeline);
+                if (chunkStart >= range.commandCount)
+                {
+                    continue;
+                }
 
-        // Render all nodes at top-level
-        for (auto& node : m_sceneResources.nodes)
-        {
-            drawNode(commandBuffer, pipelineLayout, node);
+                firstCommand += chunkStart;
+                commandCount  = std::min(chunkSize, range.commandCount - chunkStart);
+            }
+
+            uint32_t const features = m_uberMaterialShader ? kUberMaterialFeatures : range.materialFeatures;
+
+            vk::Pipeline const pipeline = m_materialPipelines.at(
+                getMaterialPipelineKey(m_sceneResources.vertexFormat, features, range.pass));
+
+            if (pipeline != boundPipeline)
+            {
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+
+                boundPipeline = pipeline;
+            }
+
+            vk::DeviceSize const indexOffset =
+                range.indexType == vk::IndexType::eUint32 ? m_sceneResources.wideIndexOffset : 0;
+
+            commandBuffer.bindIndexBuffer(m_sceneResources.indexBuffer, indexOffset, range.indexType);
+
+            vk::DeviceSize const commandOffset = firstCommand * sizeof(vk::DrawIndexedIndirectCommand);
+
+            uint32_t const timestampQuery = getRangeTimestampQuery(phase, static_cast<uint32_t>(rangeIndex));
+
+            if (timed)
+            {
+                commandBuffer.writeTimestamp2(
+                    vk::PipelineStageFlagBits2::eAllCommands, frame.timestampQueryPool, timestampQuery);
+            }
+
+            if (countSupported)
+            {
+                vk::DeviceSize const countIndex = std::to_underlying(phase) * kMaxCommandRanges + rangeIndex;
+
+                commandBuffer.drawIndexedIndirectCount(indirectCommandBuffer,
+                                                       commandOffset,
+                                                       frame.drawCountBuffer,
+                                                       offsetof(GPUDrawCounts, drawCounts) +
+                                                           countIndex * sizeof(uint32_t),
+                                                       range.commandCount,
+                                                       sizeof(vk::DrawIndexedIndirectCommand));
+            }
+            else
+            {
+                // cullMeshlets zeroed the commands past the visible ones
+                commandBuffer.drawIndexedIndirect(indirectCommandBuffer,
+                                                  commandOffset,
+                                                  commandCount,
+                                                  sizeof(vk::DrawIndexedIndirectCommand));
+            }
+
+            if (timed)
+            {
+                commandBuffer.writeTimestamp2(
+                    vk::PipelineStageFlagBits2::eAllCommands, frame.timestampQueryPool, timestampQuery + 1);
+            }
         }
     }
 }  // namespace renderer::backend
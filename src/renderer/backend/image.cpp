@@ -6,6 +6,10 @@
 #include <mc/renderer/backend/image.hpp>
 #include <mc/renderer/backend/vk_checker.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include <stb_image.h>
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_core.h>
@@ -26,6 +30,62 @@ namespace
 
 namespace renderer::backend
 {
+    auto getMipLevelCount(vk::Extent2D dimensions) -> uint32_t
+    {
+        uint32_t const largest = std::max(dimensions.width, dimensions.height);
+
+        return static_cast<uint32_t>(std::floor(std::log2(largest))) + 1;
+    }
+
+    auto isBlockCompressed(vk::Format format) -> bool
+    {
+        switch (format)
+        {
+            case vk::Format::eBc1RgbUnormBlock:
+            case vk::Format::eBc1RgbSrgbBlock:
+            case vk::Format::eBc1RgbaUnormBlock:
+            case vk::Format::eBc1RgbaSrgbBlock:
+            case vk::Format::eBc2UnormBlock:
+            case vk::Format::eBc2SrgbBlock:
+            case vk::Format::eBc3UnormBlock:
+            case vk::Format::eBc3SrgbBlock:
+            case vk::Format::eBc4UnormBlock:
+            case vk::Format::eBc4SnormBlock:
+            case vk::Format::eBc5UnormBlock:
+            case vk::Format::eBc5SnormBlock:
+            case vk::Format::eBc7UnormBlock:
+            case vk::Format::eBc7SrgbBlock:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    auto getImageLevelSize(vk::Format format, vk::Extent2D dimensions) -> vk::DeviceSize
+    {
+        if (!isBlockCompressed(format))
+        {
+            return static_cast<vk::DeviceSize>(dimensions.width) * dimensions.height * 4;
+        }
+
+        // Partial blocks along the edges of small levels are stored whole
+        vk::DeviceSize const blocks = static_cast<vk::DeviceSize>((dimensions.width + 3) / 4) *
+                                      ((dimensions.height + 3) / 4);
+
+        switch (format)
+        {
+            case vk::Format::eBc1RgbUnormBlock:
+            case vk::Format::eBc1RgbSrgbBlock:
+            case vk::Format::eBc1RgbaUnormBlock:
+            case vk::Format::eBc1RgbaSrgbBlock:
+            case vk::Format::eBc4UnormBlock:
+            case vk::Format::eBc4SnormBlock:
+                return blocks * 8;
+            default:
+                return blocks * 16;
+        }
+    }
+
     StbiImage::StbiImage(std::string_view const& path)
     {
         int texWidth { 0 };
@@ -55,7 +115,9 @@ namespace renderer::backend
                  vk::SampleCountFlagBits sampleCount,
                  vk::ImageUsageFlags usageFlags,
                  vk::ImageAspectFlags aspectFlags,
-                 uint32_t mipLevels)
+                 uint32_t mipLevels,
+                 uint32_t arrayLayers,
+                 vk::ComponentMapping components)
         : m_device { &device },
           m_allocator { &allocator },
           m_format { format },
@@ -63,6 +125,8 @@ namespace renderer::backend
           m_usageFlags { usageFlags },
           m_aspectFlags { aspectFlags },
           m_mipLevels { mipLevels },
+          m_arrayLayers { arrayLayers },
+          m_components { components },
           m_dimensions { dimensions }
     {
         create();
@@ -80,13 +144,14 @@ namespace renderer::backend
                     m_usageFlags,
                     vk::MemoryPropertyFlagBits::eDeviceLocal,
                     m_mipLevels,
+                    m_arrayLayers,
                     m_sampleCount);
 
         // If the image is solely being used for transfer, dont make a view
         if ((m_usageFlags & (vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst)) <
             m_usageFlags)
         {
-            createImageView(m_format, m_aspectFlags, 1);
+            createImageView(m_format, m_aspectFlags, m_mipLevels, m_arrayLayers, m_components);
         }
     }
 
@@ -104,11 +169,17 @@ namespace renderer::backend
     }
 
     void Image::copyTo(vk::CommandBuffer cmdBuf, vk::Image dst, vk::Extent2D dstSize, vk::Extent2D offset)
+    {
+        blit(cmdBuf, m_handle, offset, dst, dstSize);
+    }
+
+    void Image::blit(
+        vk::CommandBuffer cmdBuf, vk::Image src, vk::Extent2D srcSize, vk::Image dst, vk::Extent2D dstSize)
     {
         vk::ImageBlit2 blitRegion {};
 
-        blitRegion.srcOffsets[1].x = static_cast<int32_t>(offset.width);
-        blitRegion.srcOffsets[1].y = static_cast<int32_t>(offset.height);
+        blitRegion.srcOffsets[1].x = static_cast<int32_t>(srcSize.width);
+        blitRegion.srcOffsets[1].y = static_cast<int32_t>(srcSize.height);
         blitRegion.srcOffsets[1].z = 1;
 
         blitRegion.dstOffsets[1].x = static_cast<int32_t>(dstSize.width);
@@ -130,7 +201,7 @@ namespace renderer::backend
         blitInfo.dstImage       = dst;
         blitInfo.dstImageLayout = vk::ImageLayout::eTransferDstOptimal;
 
-        blitInfo.srcImage       = m_handle;
+        blitInfo.srcImage       = src;
         blitInfo.srcImageLayout = vk::ImageLayout::eTransferSrcOptimal;
 
         blitInfo.filter      = vk::Filter::eLinear;
@@ -179,6 +250,7 @@ namespace renderer::backend
                             vk::ImageUsageFlags usage,
                             vk::MemoryPropertyFlags properties,
                             uint32_t mipLevels,
+                            uint32_t arrayLayers,
                             vk::SampleCountFlagBits numSamples)
     {
         vk::ImageCreateInfo imageInfo {
@@ -186,7 +258,7 @@ namespace renderer::backend
             .format        = format,
             .extent        = { m_dimensions.width, m_dimensions.height, 1 },
             .mipLevels     = mipLevels,
-            .arrayLayers   = 1,
+            .arrayLayers   = arrayLayers,
             .samples       = numSamples,
             .tiling        = tiling,
             .usage         = usage,
@@ -207,175 +279,127 @@ namespace renderer::backend
                        nullptr);
     }
 
-    void Image::createImageView(vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels)
+    void Image::createImageView(vk::Format format,
+                                vk::ImageAspectFlags aspectFlags,
+                                uint32_t mipLevels,
+                                uint32_t arrayLayers,
+                                vk::ComponentMapping components)
     {
         vk::ImageViewCreateInfo viewInfo {
             .image              = m_handle,
-            .viewType           = vk::ImageViewType::e2D,
+            .viewType           = arrayLayers > 1 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D,
             .format             = format,
+            .components         = components,
             .subresourceRange   = {
                 .aspectMask     = aspectFlags,
                 .baseMipLevel   = 0,
                 .levelCount     = mipLevels,
                 .baseArrayLayer = 0,
-                .layerCount     = 1,
+                .layerCount     = arrayLayers,
             }
         };
 
         m_imageView = m_device->get().createImageView(viewInfo) >> ResultChecker();
     }
 
+    Texture::Texture(Device& device, Allocator& allocator, vk::Extent2D dimensions)
+        : Texture(device, allocator, dimensions, vk::Format::eR8G8B8A8Unorm, getMipLevelCount(dimensions), 1)
+    {
+    }
+
     Texture::Texture(Device& device,
                      Allocator& allocator,
-                     CommandManager& commandManager,
-                     StbiImage const& stbiImage)
+                     vk::Extent2D dimensions,
+                     vk::Format format,
+                     uint32_t mipLevels,
+                     uint32_t arrayLayers,
+                     vk::ComponentMapping components)
         : m_device { &device },
           m_allocator { &allocator },
-          m_commandManager { &commandManager },
           m_image { *m_device,
                     allocator,
-                    stbiImage.getDimensions(),
-                    vk::Format::eR8G8B8A8Unorm,
+                    dimensions,
+                    format,
                     vk::SampleCountFlagBits::e1,
                     vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst |
                         vk::ImageUsageFlagBits::eSampled,
                     vk::ImageAspectFlagBits::eColor,
-                    static_cast<uint32_t>(std::floor(std::log2(
-                        std::max(stbiImage.getDimensions().width, stbiImage.getDimensions().height)))) +
-                        1 }
+                    mipLevels,
+                    arrayLayers,
+                    components }
     {
-        vk::Extent2D dimensions = stbiImage.getDimensions();
-
-        uint32_t mipLevels = m_image.getMipLevels();
-
-        GPUBuffer uploadBuffer(*m_allocator,
-                               stbiImage.getDataSize(),
-                               vk::BufferUsageFlagBits::eTransferSrc,
-                               VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
-                               VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-                                   VMA_ALLOCATION_CREATE_MAPPED_BIT);
-
-        std::memcpy(uploadBuffer.getMappedData(), stbiImage.getData(), stbiImage.getDataSize());
-
-        {
-            ScopedCommandBuffer commandBuffer(
-                *m_device, m_commandManager->getGraphicsCmdPool(), m_device->getGraphicsQueue());
-
-            Image::transition(
-                commandBuffer, m_image, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-
-            transitionImageLayout(commandBuffer,
-                                  m_image,
-                                  vk::Format::eR8G8B8A8Unorm,
-                                  vk::ImageLayout::eUndefined,
-                                  vk::ImageLayout::eTransferDstOptimal,
-                                  mipLevels);
-
-            vk::BufferImageCopy region {
-                .bufferOffset      = 0,
-                .bufferRowLength   = 0,
-                .bufferImageHeight = 0,
-                .imageSubresource  = {
-                    .aspectMask     = vk::ImageAspectFlagBits::eColor,
-                    .mipLevel       = 0,
-                    .baseArrayLayer = 0,
-                    .layerCount     = 1,
-                },
-                .imageOffset = { 0, 0, 0 },
-                .imageExtent = { dimensions.width, dimensions.height, 1 },
-            };
-
-            commandBuffer->copyBufferToImage(
-                uploadBuffer, m_image, vk::ImageLayout::eTransferDstOptimal, { region });
-
-            //transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL here
-            generateMipmaps(commandBuffer,
-                            m_image,
-                            { dimensions.width, dimensions.height },
-                            vk::Format::eR8G8B8A8Unorm,
-                            mipLevels);
-        }
     }
 
-    Texture::Texture(Device& device,
-                     Allocator& allocator,
-                     CommandManager& commandManager,
-                     vk::Extent2D dimensions,
-                     void* data,
-                     size_t dataSize)
-        : m_device { &device },
-          m_allocator { &allocator },
-          m_commandManager { &commandManager },
-          m_image {
-              *m_device,
-              allocator,
-              dimensions,
-              vk::Format::eR8G8B8A8Unorm,
-              vk::SampleCountFlagBits::e1,
-              vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst |
-                  vk::ImageUsageFlagBits::eSampled,
-              vk::ImageAspectFlagBits::eColor,
-              static_cast<uint32_t>(std::floor(std::log2(std::max(dimensions.width, dimensions.height)))) + 1
-          }
+    void Texture::recordCopy(vk::CommandBuffer commandBuffer,
+                             vk::Buffer staging,
+                             vk::DeviceSize stagingOffset,
+                             uint32_t providedMipLevels,
+                             std::span<vk::DeviceSize const> subresourceOffsets) const
     {
-        uint32_t mipLevels = m_image.getMipLevels();
-
-        GPUBuffer uploadBuffer(*m_allocator,
-                               dataSize,
-                               vk::BufferUsageFlagBits::eTransferSrc,
-                               VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
-                               VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-                                   VMA_ALLOCATION_CREATE_MAPPED_BIT);
-
-        std::memcpy(uploadBuffer.getMappedData(), data, dataSize);
-
+        vk::Extent2D dimensions = m_image.getDimensions();
+        vk::Format format       = m_image.getFormat();
+        uint32_t mipLevels      = m_image.getMipLevels();
+        uint32_t arrayLayers    = m_image.getArrayLayers();
+
+        MC_ASSERT_MSG(providedMipLevels == 1 || providedMipLevels == mipLevels,
+                      "Expected either mip 0 or all {} mip levels, got {}",
+                      mipLevels,
+                      providedMipLevels);
+        MC_ASSERT_MSG(providedMipLevels == mipLevels || !isBlockCompressed(format),
+                      "Block-compressed images need all {} mip levels, got {}",
+                      mipLevels,
+                      providedMipLevels);
+        MC_ASSERT(subresourceOffsets.empty() || subresourceOffsets.size() == providedMipLevels * arrayLayers);
+
+        Image::transition(
+            commandBuffer, m_image, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+
+        std::vector<vk::BufferImageCopy> regions;
+        regions.reserve(providedMipLevels * arrayLayers);
+
+        vk::DeviceSize packedOffset = stagingOffset;
+
+        for (uint32_t level = 0; level < providedMipLevels; ++level)
         {
-            ScopedCommandBuffer commandBuffer(
-                *m_device, m_commandManager->getGraphicsCmdPool(), m_device->getGraphicsQueue());
-
-            Image::transition(
-                commandBuffer, m_image, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-
-            transitionImageLayout(commandBuffer,
-                                  m_image,
-                                  vk::Format::eR8G8B8A8Unorm,
-                                  vk::ImageLayout::eUndefined,
-                                  vk::ImageLayout::eTransferDstOptimal,
-                                  mipLevels);
-
-            vk::BufferImageCopy region {
-                .bufferOffset      = 0,
-                .bufferRowLength   = 0,
-                .bufferImageHeight = 0,
-                .imageSubresource  = {
-                    .aspectMask     = vk::ImageAspectFlagBits::eColor,
-                    .mipLevel       = 0,
-                    .baseArrayLayer = 0,
-                    .layerCount     = 1,
-                },
-                .imageOffset = { 0, 0, 0 },
-                .imageExtent = { dimensions.width, dimensions.height, 1 },
-            };
-
-            commandBuffer->copyBufferToImage(
-                uploadBuffer, m_image, vk::ImageLayout::eTransferDstOptimal, { region });
-
-            //transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL here
-            generateMipmaps(commandBuffer,
-                            m_image,
-                            { dimensions.width, dimensions.height },
-                            vk::Format::eR8G8B8A8Unorm,
-                            mipLevels);
+            uint32_t width  = std::max(dimensions.width >> level, 1u);
+            uint32_t height = std::max(dimensions.height >> level, 1u);
+
+            for (uint32_t layer = 0; layer < arrayLayers; ++layer)
+            {
+                size_t const subresource = level * arrayLayers + layer;
+
+                regions.push_back({
+                    .bufferOffset      = subresourceOffsets.empty()
+                                             ? packedOffset
+                                             : stagingOffset + subresourceOffsets[subresource],
+                    .bufferRowLength   = 0,
+                    .bufferImageHeight = 0,
+                    .imageSubresource  = {
+                        .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                        .mipLevel       = level,
+                        .baseArrayLayer = layer,
+                        .layerCount     = 1,
+                    },
+                    .imageOffset = { 0, 0, 0 },
+                    .imageExtent = { width, height, 1 },
+                });
+
+                packedOffset += getImageLevelSize(format, { width, height });
+            }
         }
+
+        commandBuffer.copyBufferToImage(staging, m_image, vk::ImageLayout::eTransferDstOptimal, regions);
     }
 
-    void Texture::generateMipmaps(ScopedCommandBuffer& commandBuffer,
+    void Texture::generateMipmaps(Device const& device,
+                                  vk::CommandBuffer commandBuffer,
                                   vk::Image image,
                                   vk::Extent2D dimensions,
                                   vk::Format imageFormat,
-                                  uint32_t mipLevels)
+                                  uint32_t mipLevels,
+                                  uint32_t arrayLayers)
     {
-        MC_ASSERT(m_device->getFormatProperties(imageFormat).optimalTilingFeatures &
+        MC_ASSERT(device.getFormatProperties(imageFormat).optimalTilingFeatures &
                   vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
 
         vk::ImageMemoryBarrier barrier {
@@ -386,7 +410,7 @@ namespace renderer::backend
             .aspectMask      = vk::ImageAspectFlagBits::eColor,
             .levelCount      = 1,
             .baseArrayLayer  = 0,
-            .layerCount      = 1,
+            .layerCount      = arrayLayers,
         }
     };
 
@@ -401,12 +425,12 @@ namespace renderer::backend
             barrier.srcAccessMask                 = vk::AccessFlagBits::eTransferWrite;
             barrier.dstAccessMask                 = vk::AccessFlagBits::eTransferRead;
 
-            commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-                                           vk::PipelineStageFlagBits::eTransfer,
-                                           vk::DependencyFlags { 0 },
-                                           {},
-                                           {},
-                                           { barrier });
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                          vk::PipelineStageFlagBits::eTransfer,
+                                          vk::DependencyFlags { 0 },
+                                          {},
+                                          {},
+                                          { barrier });
 
             // clang-format off
             vk::ImageBlit blit{
@@ -414,7 +438,7 @@ namespace renderer::backend
                     .aspectMask     = vk::ImageAspectFlagBits::eColor,
                     .mipLevel       = i - 1,
                     .baseArrayLayer = 0,
-                    .layerCount     = 1,
+                    .layerCount     = arrayLayers,
                 },
                 .srcOffsets         = std::array {
                     vk::Offset3D { 0, 0, 0 },
@@ -424,7 +448,7 @@ namespace renderer::backend
                     .aspectMask     = vk::ImageAspectFlagBits::eColor,
                     .mipLevel       = i,
                     .baseArrayLayer = 0,
-                    .layerCount     = 1
+                    .layerCount     = arrayLayers
                 },
                 .dstOffsets         = std::array {
                     vk::Offset3D { 0, 0, 0 },
@@ -435,24 +459,24 @@ namespace renderer::backend
             };
             // clang-format on
 
-            commandBuffer->blitImage(image,
-                                     vk::ImageLayout::eTransferSrcOptimal,
-                                     image,
-                                     vk::ImageLayout::eTransferDstOptimal,
-                                     { blit },
-                                     vk::Filter::eLinear);
+            commandBuffer.blitImage(image,
+                                    vk::ImageLayout::eTransferSrcOptimal,
+                                    image,
+                                    vk::ImageLayout::eTransferDstOptimal,
+                                    { blit },
+                                    vk::Filter::eLinear);
 
             barrier.oldLayout     = vk::ImageLayout::eTransferSrcOptimal;
             barrier.newLayout     = vk::ImageLayout::eShaderReadOnlyOptimal;
             barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
             barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
 
-            commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-                                           vk::PipelineStageFlagBits::eFragmentShader,
-                                           vk::DependencyFlags { 0 },
-                                           {},
-                                           {},
-                                           { barrier });
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                          vk::PipelineStageFlagBits::eFragmentShader,
+                                          vk::DependencyFlags { 0 },
+                                          {},
+                                          {},
+                                          { barrier });
 
             mipWidth /= (mipWidth > 1) ? 2 : 1;
             mipHeight /= (mipHeight > 1) ? 2 : 1;
@@ -464,12 +488,12 @@ namespace renderer::backend
         barrier.srcAccessMask                 = vk::AccessFlagBits::eTransferWrite;
         barrier.dstAccessMask                 = vk::AccessFlagBits::eShaderRead;
 
-        commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-                                       vk::PipelineStageFlagBits::eFragmentShader,
-                                       vk::DependencyFlags { 0 },
-                                       {},
-                                       {},
-                                       { barrier });
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                      vk::PipelineStageFlagBits::eFragmentShader,
+                                      vk::DependencyFlags { 0 },
+                                      {},
+                                      {},
+                                      { barrier });
     }
 }  // namespace renderer::backend
 
@@ -0,0 +1,263 @@
+#include <mc/asserts.hpp>
+#include <mc/logger.hpp>
+#include <mc/renderer/backend/image_writer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <glm/gtc/color_space.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/vec3.hpp>
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+    // EXR is little endian, the values are copied as they are
+    static_assert(std::endian::native == std::endian::little);
+
+    template <typename T>
+    void append(std::vector<char>& out, T value)
+    {
+        auto const bytes = std::bit_cast<std::array<char, sizeof(T)>>(value);
+
+        out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+
+    // Null terminated
+    void appendString(std::vector<char>& out, std::string_view string)
+    {
+        out.insert(out.end(), string.begin(), string.end());
+        out.push_back('\0');
+    }
+
+    void appendAttribute(std::vector<char>& out, std::string_view name, std::string_view type, int32_t size)
+    {
+        appendString(out, name);
+        appendString(out, type);
+        append(out, size);
+    }
+
+    void appendBox(std::vector<char>& out, std::string_view name, vk::Extent2D extent)
+    {
+        appendAttribute(out, name, "box2i", 16);
+        append(out, int32_t { 0 });
+        append(out, int32_t { 0 });
+        append(out, static_cast<int32_t>(extent.width) - 1);
+        append(out, static_cast<int32_t>(extent.height) - 1);
+    }
+
+    // 8 bit sRGB, as writePng stores the pixels
+    auto toSrgb(std::span<uint16_t const> pixels) -> std::vector<uint8_t>
+    {
+        auto const toUnorm = [](float value)
+        { return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+
+        std::vector<uint8_t> srgb(pixels.size());
+
+        for (size_t i = 0; i < pixels.size(); i += 4)
+        {
+            glm::vec3 const linear { glm::unpackHalf1x16(pixels[i]),
+                                     glm::unpackHalf1x16(pixels[i + 1]),
+                                     glm::unpackHalf1x16(pixels[i + 2]) };
+
+            glm::vec3 const color = glm::convertLinearToSRGB(linear);
+
+            srgb[i]     = toUnorm(color.r);
+            srgb[i + 1] = toUnorm(color.g);
+            srgb[i + 2] = toUnorm(color.b);
+            srgb[i + 3] = toUnorm(glm::unpackHalf1x16(pixels[i + 3]));
+        }
+
+        return srgb;
+    }
+
+    void writeFile(std::filesystem::path const& path, std::span<char const> data)
+    {
+        std::ofstream file { path, std::ios::binary | std::ios::trunc };
+
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        file.close();
+
+        if (!file.good())
+        {
+            logger::error("Failed to write image '{}'", path.string());
+        }
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    void writePng(std::filesystem::path const& path, vk::Extent2D extent, std::span<uint16_t const> pixels)
+    {
+        ZoneScopedN("Write PNG");
+
+        MC_ASSERT(pixels.size() == size_t { extent.width } * extent.height * 4);
+
+        std::vector<uint8_t> const srgb = toSrgb(pixels);
+
+        int const width  = static_cast<int>(extent.width);
+        int const height = static_cast<int>(extent.height);
+
+        if (stbi_write_png(path.string().c_str(), width, height, 4, srgb.data(), width * 4) == 0)
+        {
+            logger::error("Failed to write image '{}'", path.string());
+        }
+    }
+
+    void writeExr(std::filesystem::path const& path, vk::Extent2D extent, std::span<uint16_t const> pixels)
+    {
+        ZoneScopedN("Write EXR");
+
+        MC_ASSERT(pixels.size() == size_t { extent.width } * extent.height * 4);
+
+        // Channels are stored in alphabetical order, as offsets into an RGBA pixel
+        constexpr std::array<std::pair<std::string_view, uint32_t>, 4> channels {
+            { { "A", 3 }, { "B", 2 }, { "G", 1 }, { "R", 0 } }
+        };
+
+        constexpr int32_t kHalf = 1;
+
+        std::vector<char> out;
+
+        append(out, uint32_t { 20000630 });
+        append(out, uint32_t { 2 });
+
+        // Name, pixel type, pLinear with 3 reserved bytes and the x and y sampling of every channel
+        appendAttribute(out, "channels", "chlist", static_cast<int32_t>(channels.size() * 18 + 1));
+
+        for (auto const& [name, offset] : channels)
+        {
+            appendString(out, name);
+            append(out, kHalf);
+            append(out, uint32_t { 0 });
+            append(out, int32_t { 1 });
+            append(out, int32_t { 1 });
+        }
+
+        out.push_back('\0');
+
+        appendAttribute(out, "compression", "compression", 1);
+        out.push_back('\0');
+
+        appendBox(out, "dataWindow", extent);
+        appendBox(out, "displayWindow", extent);
+
+        // Increasing y
+        appendAttribute(out, "lineOrder", "lineOrder", 1);
+        out.push_back('\0');
+
+        appendAttribute(out, "pixelAspectRatio", "float", 4);
+        append(out, 1.0f);
+
+        appendAttribute(out, "screenWindowCenter", "v2f", 8);
+        append(out, 0.0f);
+        append(out, 0.0f);
+
+        appendAttribute(out, "screenWindowWidth", "float", 4);
+        append(out, 1.0f);
+
+        out.push_back('\0');
+
+        // One block per scanline without compression, each with its y and size in front
+        size_t const lineSize   = size_t { extent.width } * channels.size() * sizeof(uint16_t);
+        size_t const blockSize  = 2 * sizeof(int32_t) + lineSize;
+        size_t const firstBlock = out.size() + extent.height * sizeof(uint64_t);
+
+        out.reserve(firstBlock + extent.height * blockSize);
+
+        for (uint32_t y = 0; y < extent.height; ++y)
+        {
+            append(out, static_cast<uint64_t>(firstBlock + y * blockSize));
+        }
+
+        for (uint32_t y = 0; y < extent.height; ++y)
+        {
+            append(out, static_cast<int32_t>(y));
+            append(out, static_cast<int32_t>(lineSize));
+
+            std::span<uint16_t const> const line = pixels.subspan(size_t { y } * extent.width * 4,
+                                                                  size_t { extent.width } * 4);
+
+            for (auto const& [name, offset] : channels)
+            {
+                for (uint32_t x = 0; x < extent.width; ++x)
+                {
+                    append(out, line[x * 4 + offset]);
+                }
+            }
+        }
+
+        writeFile(path, out);
+    }
+
+    auto compareWithPng(std::filesystem::path const& reference,
+                        vk::Extent2D extent,
+                        std::span<uint16_t const> pixels,
+                        uint8_t tolerance) -> std::optional<ImageDifference>
+    {
+        ZoneScopedN("Compare with PNG");
+
+        MC_ASSERT(pixels.size() == size_t { extent.width } * extent.height * 4);
+
+        int width = 0, height = 0, channels = 0;
+
+        std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> const expected {
+            stbi_load(reference.string().c_str(), &width, &height, &channels, STBI_rgb_alpha),
+            stbi_image_free,
+        };
+
+        if (!expected)
+        {
+            logger::error(
+                "Failed to read reference image '{}': {}", reference.string(), stbi_failure_reason());
+
+            return std::nullopt;
+        }
+
+        if (static_cast<uint32_t>(width) != extent.width || static_cast<uint32_t>(height) != extent.height)
+        {
+            logger::error("Reference image '{}' is {}x{}, the frame is {}x{}",
+                          reference.string(),
+                          width,
+                          height,
+                          extent.width,
+                          extent.height);
+
+            return std::nullopt;
+        }
+
+        std::vector<uint8_t> const actual = toSrgb(pixels);
+
+        ImageDifference difference { .pixelCount = size_t { extent.width } * extent.height };
+
+        for (size_t i = 0; i < actual.size(); i += 4)
+        {
+            uint8_t pixelDifference = 0;
+
+            for (size_t c = 0; c < 4; ++c)
+            {
+                int const channelDifference = std::abs(actual[i + c] - expected.get()[i + c]);
+
+                pixelDifference = std::max(pixelDifference, static_cast<uint8_t>(channelDifference));
+            }
+
+            if (pixelDifference > tolerance)
+            {
+                ++difference.differingPixelCount;
+            }
+
+            difference.maxDifference = std::max(difference.maxDifference, pixelDifference);
+        }
+
+        return difference;
+    }
+}  // namespace renderer::backend
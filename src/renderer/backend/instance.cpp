@@ -53,7 +53,7 @@ namespace
 
 namespace renderer::backend
 {
-    Instance::Instance()
+    Instance::Instance(bool presenting)
     {
         vk::raii::Context context {};
 
@@ -69,6 +69,7 @@ namespace renderer::backend
         std::vector<vk::ExtensionProperties> supportedExtensions =
             context.enumerateInstanceExtensionProperties();
 
+        if (presenting)
         {
             uint32_t count {};
             char const** glfwExtStrings = glfwGetRequiredInstanceExtensions(&count);
@@ -0,0 +1,584 @@
+#include <mc/renderer/backend/mesh_optimizer.hpp>
+#include <mc/utils.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <ranges>
+#include <unordered_map>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <tracy/Tracy.hpp>
+
+namespace rn = std::ranges;
+namespace vi = std::ranges::views;
+
+namespace
+{
+    using namespace renderer::backend;
+
+    constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+    // A hard cluster is split into smaller ones as soon as the part so far is within this factor of the
+    // whole cluster's ACMR. Smaller clusters sort better for overdraw at a slight cost in cache efficiency.
+    constexpr float kOverdrawThreshold = 1.05f;
+
+    // Timestamp based FIFO cache, an entry is evicted `cacheSize` insertions after it was added
+    class VertexCache
+    {
+    public:
+        VertexCache(size_t vertexCount, uint32_t cacheSize)
+            : m_insertionTimes(vertexCount, 0), m_time { cacheSize + 1 }, m_cacheSize { cacheSize }
+        {
+        }
+
+        // Returns 1 on a miss
+        auto transform(uint32_t vertex) -> uint32_t
+        {
+            if (m_time - m_insertionTimes[vertex] <= m_cacheSize)
+            {
+                return 0;
+            }
+
+            m_insertionTimes[vertex] = m_time++;
+
+            return 1;
+        }
+
+        void flush() { m_time += m_cacheSize + 1; }
+
+        [[nodiscard]] auto getTransformedVertexCount() const -> uint32_t
+        {
+            return static_cast<uint32_t>(
+                rn::count_if(m_insertionTimes, [](uint32_t time) { return time != 0; }));
+        }
+
+    private:
+        std::vector<uint32_t> m_insertionTimes;
+        uint32_t m_time;
+        uint32_t m_cacheSize;
+    };
+
+    void deduplicateVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        // Vertex has no padding, so comparing bytes is comparing every attribute
+        static_assert(sizeof(Vertex) == sizeof(glm::vec4) * 3);
+
+        auto hash = [&](uint32_t v)
+        { return utils::hashBytes(std::as_bytes(std::span { &vertices[v], 1 })); };
+
+        auto equal = [&](uint32_t a, uint32_t b)
+        { return std::memcmp(&vertices[a], &vertices[b], sizeof(Vertex)) == 0; };
+
+        std::unordered_map<uint32_t, uint32_t, decltype(hash), decltype(equal)> firstOccurrences(
+            vertices.size(), hash, equal);
+
+        std::vector<uint32_t> remap(vertices.size());
+        std::vector<Vertex> unique;
+        unique.reserve(vertices.size());
+
+        for (uint32_t v = 0; v < vertices.size(); ++v)
+        {
+            auto [it, inserted] = firstOccurrences.try_emplace(v, static_cast<uint32_t>(unique.size()));
+
+            if (inserted)
+            {
+                unique.push_back(vertices[v]);
+            }
+
+            remap[v] = it->second;
+        }
+
+        for (uint32_t& index : indices)
+        {
+            index = remap[index];
+        }
+
+        vertices = std::move(unique);
+    }
+
+    // Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (2007).
+    // Emits triangle fans around a fanning vertex, then moves on to the adjacent vertex that is most likely
+    // to still be cached once its remaining triangles are emitted.
+    auto tipsify(std::span<uint32_t const> indices, size_t vertexCount, uint32_t cacheSize)
+        -> std::vector<uint32_t>
+    {
+        ZoneScopedN("Tipsify");
+
+        // Vertex -> triangle adjacency, compressed into one array
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+
+        for (uint32_t index : indices)
+        {
+            ++liveTriangles[index];
+        }
+
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        std::inclusive_scan(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+        for (uint32_t i = 0; i < indices.size(); ++i)
+        {
+            adjacency[fillOffsets[indices[i]]++] = i / 3;
+        }
+
+        std::vector<uint32_t> cacheTimes(vertexCount, 0);
+        std::vector<bool> emitted(indices.size() / 3, false);
+        std::vector<uint32_t> deadEnds, candidates;
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        uint32_t time    = cacheSize + 1;
+        uint32_t cursor  = 0;
+        uint32_t fanning = vertexCount > 0 ? 0 : kNone;
+
+        while (fanning != kNone)
+        {
+            candidates.clear();
+
+            for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; ++a)
+            {
+                uint32_t const triangle = adjacency[a];
+
+                if (emitted[triangle])
+                {
+                    continue;
+                }
+
+                for (uint32_t v : indices.subspan(triangle * 3, 3))
+                {
+                    result.push_back(v);
+                    deadEnds.push_back(v);
+                    candidates.push_back(v);
+
+                    --liveTriangles[v];
+
+                    if (time - cacheTimes[v] > cacheSize)
+                    {
+                        cacheTimes[v] = time++;
+                    }
+                }
+
+                emitted[triangle] = true;
+            }
+
+            // Prefer the oldest candidate that stays cached while fanning around it, any live one otherwise
+            fanning          = kNone;
+            int64_t priority = -1;
+
+            for (uint32_t v : candidates)
+            {
+                if (liveTriangles[v] == 0)
+                {
+                    continue;
+                }
+
+                int64_t candidatePriority = 0;
+
+                if (time - cacheTimes[v] + 2 * liveTriangles[v] <= cacheSize)
+                {
+                    candidatePriority = time - cacheTimes[v];
+                }
+
+                if (candidatePriority > priority)
+                {
+                    priority = candidatePriority;
+                    fanning  = v;
+                }
+            }
+
+            // Dead end: backtrack through recent vertices, then scan for unprocessed ones as a last resort
+            while (fanning == kNone && !deadEnds.empty())
+            {
+                uint32_t v = deadEnds.back();
+                deadEnds.pop_back();
+
+                if (liveTriangles[v] > 0)
+                {
+                    fanning = v;
+                }
+            }
+
+            for (; fanning == kNone && cursor < vertexCount; ++cursor)
+            {
+                if (liveTriangles[cursor] > 0)
+                {
+                    fanning = cursor;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // Splits a cache-optimized triangle list into clusters that can be reordered freely without losing much
+    // cache efficiency. Returns the first triangle of each cluster followed by the triangle count.
+    auto findClusters(std::span<uint32_t const> indices, size_t vertexCount, uint32_t cacheSize)
+        -> std::vector<uint32_t>
+    {
+        auto const triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+        VertexCache cache(vertexCount, cacheSize);
+
+        auto transformTriangle = [&](uint32_t triangle)
+        {
+            return cache.transform(indices[triangle * 3]) + cache.transform(indices[triangle * 3 + 1]) +
+                   cache.transform(indices[triangle * 3 + 2]);
+        };
+
+        // Hard boundaries, where every vertex of a triangle missed because Tipsify restarted somewhere cold
+        std::vector<uint32_t> hardBoundaries { 0 };
+
+        for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+        {
+            if (transformTriangle(triangle) == 3 && triangle > 0)
+            {
+                hardBoundaries.push_back(triangle);
+            }
+        }
+
+        hardBoundaries.push_back(triangleCount);
+
+        // Soft boundaries, with the cache flushed at every split to account for the cluster moving elsewhere
+        std::vector<uint32_t> clusters;
+
+        for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h)
+        {
+            uint32_t const start = hardBoundaries[h], end = hardBoundaries[h + 1];
+
+            cache.flush();
+
+            uint32_t clusterMisses = 0;
+
+            for (uint32_t triangle = start; triangle < end; ++triangle)
+            {
+                clusterMisses += transformTriangle(triangle);
+            }
+
+            float const threshold =
+                kOverdrawThreshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+            size_t const firstCluster = clusters.size();
+            clusters.push_back(start);
+
+            cache.flush();
+
+            uint32_t runningMisses = 0, runningTriangles = 0;
+
+            for (uint32_t triangle = start; triangle < end; ++triangle)
+            {
+                runningMisses += transformTriangle(triangle);
+                ++runningTriangles;
+
+                if (static_cast<float>(runningMisses) / static_cast<float>(runningTriangles) <= threshold)
+                {
+                    clusters.push_back(triangle + 1);
+
+                    cache.flush();
+
+                    runningMisses = runningTriangles = 0;
+                }
+            }
+
+            // Either the last split landed on `end` or the tail never got efficient enough to stand on its
+            // own, both ways it's merged into the cluster before it
+            if (clusters.size() - firstCluster > 1)
+            {
+                clusters.pop_back();
+            }
+        }
+
+        clusters.push_back(triangleCount);
+
+        return clusters;
+    }
+
+    auto sortClusters(std::span<Vertex const> vertices,
+                      std::span<uint32_t const> indices,
+                      std::span<uint32_t const> clusters) -> std::vector<uint32_t>
+    {
+        struct ClusterInfo
+        {
+            glm::vec3 centroid { 0.f };
+            glm::vec3 normal { 0.f };
+            float area { 0.f };
+        };
+
+        std::vector<ClusterInfo> infos(clusters.size() - 1);
+
+        glm::vec3 meshCentroid { 0.f };
+        float meshArea = 0.f;
+
+        for (size_t c = 0; c < infos.size(); ++c)
+        {
+            ClusterInfo& info = infos[c];
+
+            for (uint32_t triangle = clusters[c]; triangle < clusters[c + 1]; ++triangle)
+            {
+                glm::vec3 const p0 = vertices[indices[triangle * 3]].position;
+                glm::vec3 const p1 = vertices[indices[triangle * 3 + 1]].position;
+                glm::vec3 const p2 = vertices[indices[triangle * 3 + 2]].position;
+
+                // Twice the area, weighted by it
+                glm::vec3 const normal = glm::cross(p1 - p0, p2 - p0);
+                float const area       = glm::length(normal);
+
+                info.centroid += (p0 + p1 + p2) * (area / 3.f);
+                info.normal += normal;
+                info.area += area;
+            }
+
+            meshCentroid += info.centroid;
+            meshArea += info.area;
+
+            info.centroid /= info.area > 0.f ? info.area : 1.f;
+        }
+
+        meshCentroid /= meshArea > 0.f ? meshArea : 1.f;
+
+        // How far a cluster sits out along its own normal, the ones furthest out are the least likely to be
+        // covered by anything else and go first
+        std::vector<float> sortKeys(infos.size());
+
+        for (auto [c, info] : vi::enumerate(infos))
+        {
+            float const normalLength = glm::length(info.normal);
+
+            sortKeys[c] =
+                normalLength > 0.f ? glm::dot(info.centroid - meshCentroid, info.normal / normalLength) : 0.f;
+        }
+
+        std::vector<uint32_t> order(infos.size());
+        std::iota(order.begin(), order.end(), 0);
+
+        rn::stable_sort(order, [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        for (uint32_t c : order)
+        {
+            result.insert(
+                result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+        }
+
+        return result;
+    }
+
+    // Renumbers vertices in order of first use and drops unreferenced ones
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        std::vector<uint32_t> remap(vertices.size(), kNone);
+        std::vector<Vertex> reordered;
+        reordered.reserve(vertices.size());
+
+        for (uint32_t& index : indices)
+        {
+            if (remap[index] == kNone)
+            {
+                remap[index] = static_cast<uint32_t>(reordered.size());
+                reordered.push_back(vertices[index]);
+            }
+
+            index = remap[index];
+        }
+
+        vertices = std::move(reordered);
+    }
+
+    auto computeMeshletBounds(std::span<Vertex const> vertices,
+                              std::span<uint32_t const> indices,
+                              std::span<uint32_t const> meshletVertices,
+                              bool doubleSided) -> Meshlet
+    {
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+
+        for (uint32_t v : meshletVertices)
+        {
+            boundsMin = glm::min(boundsMin, vertices[v].position);
+            boundsMax = glm::max(boundsMax, vertices[v].position);
+        }
+
+        Meshlet meshlet {
+            .center     = (boundsMin + boundsMax) * 0.5f,
+            .radius     = 0.f,
+            .coneAxis   = glm::vec3(0.f),
+            .coneCutoff = 1.f,
+        };
+
+        for (uint32_t v : meshletVertices)
+        {
+            meshlet.radius = std::max(meshlet.radius, glm::length(vertices[v].position - meshlet.center));
+        }
+
+        if (doubleSided)
+        {
+            return meshlet;
+        }
+
+        auto getFaceNormal = [&](size_t triangle)
+        {
+            glm::vec3 const p0 = vertices[indices[triangle * 3]].position;
+            glm::vec3 const p1 = vertices[indices[triangle * 3 + 1]].position;
+            glm::vec3 const p2 = vertices[indices[triangle * 3 + 2]].position;
+
+            glm::vec3 const normal = glm::cross(p1 - p0, p2 - p0);
+            float const length     = glm::length(normal);
+
+            // Degenerate triangles can't be seen from any side and don't constrain the cone
+            return length > 0.f ? normal / length : glm::vec3(0.f);
+        };
+
+        glm::vec3 axis(0.f);
+
+        for (size_t triangle = 0; triangle < indices.size() / 3; ++triangle)
+        {
+            axis += getFaceNormal(triangle);
+        }
+
+        float const axisLength = glm::length(axis);
+
+        if (axisLength == 0.f)
+        {
+            return meshlet;
+        }
+
+        axis /= axisLength;
+
+        float minDot = 1.f;
+
+        for (size_t triangle = 0; triangle < indices.size() / 3; ++triangle)
+        {
+            glm::vec3 const normal = getFaceNormal(triangle);
+
+            if (glm::dot(normal, normal) > 0.f)
+            {
+                minDot = std::min(minDot, glm::dot(axis, normal));
+            }
+        }
+
+        // Cones wider than ~84 degrees hardly ever cull anything
+        if (minDot > 0.1f)
+        {
+            meshlet.coneAxis   = axis;
+            meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+        }
+
+        return meshlet;
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    auto analyzeVertexCache(std::span<uint32_t const> indices,
+                            size_t vertexCount,
+                            uint32_t cacheSize) -> VertexCacheStats
+    {
+        VertexCache cache(vertexCount, cacheSize);
+
+        uint32_t transformCount = 0;
+
+        for (uint32_t index : indices)
+        {
+            transformCount += cache.transform(index);
+        }
+
+        return {
+            .triangleCount  = static_cast<uint32_t>(indices.size() / 3),
+            .vertexCount    = cache.getTransformedVertexCount(),
+            .transformCount = transformCount,
+        };
+    }
+
+    void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        ZoneScopedN("Optimize mesh");
+
+        // Only triangle lists are handled
+        if (indices.size() < 3 || indices.size() % 3 != 0)
+        {
+            return;
+        }
+
+        deduplicateVertices(vertices, indices);
+
+        std::vector<uint32_t> tipsified = tipsify(indices, vertices.size(), kVertexCacheSize);
+        std::vector<uint32_t> clusters  = findClusters(tipsified, vertices.size(), kVertexCacheSize);
+
+        indices = sortClusters(vertices, tipsified, clusters);
+
+        optimizeVertexFetch(vertices, indices);
+    }
+
+    auto buildMeshlets(std::span<Vertex const> vertices,
+                       std::span<uint32_t const> indices,
+                       bool doubleSided) -> std::vector<Meshlet>
+    {
+        ZoneScopedN("Build meshlets");
+
+        auto const triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+        std::vector<Meshlet> meshlets;
+
+        // Last meshlet that referenced each vertex, so unique vertices are counted without a set per meshlet
+        std::vector<uint32_t> vertexOwners(vertices.size(), kNone);
+
+        std::vector<uint32_t> meshletVertices;
+        meshletVertices.reserve(kMeshletMaxVertices);
+
+        uint32_t firstTriangle = 0;
+
+        auto finishMeshlet = [&](uint32_t endTriangle)
+        {
+            std::span<uint32_t const> meshletIndices =
+                indices.subspan(firstTriangle * 3, (endTriangle - firstTriangle) * 3);
+
+            Meshlet& meshlet = meshlets.emplace_back(
+                computeMeshletBounds(vertices, meshletIndices, meshletVertices, doubleSided));
+
+            meshlet.firstIndex = firstTriangle * 3;
+            meshlet.indexCount = static_cast<uint32_t>(meshletIndices.size());
+
+            meshletVertices.clear();
+            firstTriangle = endTriangle;
+        };
+
+        for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+        {
+            std::span<uint32_t const> triangleIndices = indices.subspan(triangle * 3, 3);
+
+            size_t const newVertices = rn::count_if(triangleIndices,
+                                                    [&](uint32_t v)
+                                                    { return vertexOwners[v] != meshlets.size(); });
+
+            if (meshletVertices.size() + newVertices > kMeshletMaxVertices ||
+                triangle - firstTriangle == kMeshletMaxTriangles)
+            {
+                finishMeshlet(triangle);
+            }
+
+            for (uint32_t v : triangleIndices)
+            {
+                if (vertexOwners[v] != meshlets.size())
+                {
+                    vertexOwners[v] = static_cast<uint32_t>(meshlets.size());
+                    meshletVertices.push_back(v);
+                }
+            }
+        }
+
+        if (firstTriangle < triangleCount)
+        {
+            finishMeshlet(triangleCount);
+        }
+
+        return meshlets;
+    }
+}  // namespace renderer::backend
@@ -7,8 +7,10 @@
 #include <mc/utils.hpp>
 
 #include <algorithm>
-
+#include <format>
 #include <ranges>
+#include <utility>
+
 #include <vulkan/vulkan_core.h>
 
 namespace rn = std::ranges;
@@ -16,11 +18,11 @@ namespace vi = std::ranges::views;
 
 namespace renderer::backend
 {
-    auto PipelineLayoutConfig::setPushConstantSettings(uint32_t size, vk::ShaderStageFlagBits shaderStage)
+    auto PipelineLayoutConfig::setPushConstantSettings(uint32_t size, vk::ShaderStageFlags shaderStages)
         -> PipelineLayoutConfig&
     {
         pushConstants = {
-            .stageFlags = shaderStage,
+            .stageFlags = shaderStages,
             .offset     = 0,
             .size       = size,
         };
@@ -54,7 +56,10 @@ namespace renderer::backend
 
     auto GraphicsPipelineConfig::blendingSetAlphaBlend() -> GraphicsPipelineConfig&
     {
-        srcColorBlendFactor = vk::BlendFactor::eOneMinusDstAlpha;
+        // Over operator, the target stays opaque where it was
+        srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+        dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+        dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
 
         return *this;
     }
@@ -62,6 +67,8 @@ namespace renderer::backend
     auto GraphicsPipelineConfig::blendingSetAdditiveBlend() -> GraphicsPipelineConfig&
     {
         srcColorBlendFactor = vk::BlendFactor::eOne;
+        dstColorBlendFactor = vk::BlendFactor::eDstAlpha;
+        dstAlphaBlendFactor = vk::BlendFactor::eZero;
 
         return *this;
     }
@@ -208,9 +215,33 @@ namespace renderer::backend
         return *this;
     };
 
+    auto GraphicsPipelineConfig::setSpecializationConstant(uint32_t constantId,
+                                                           uint32_t value) -> GraphicsPipelineConfig&
+    {
+        auto it = rn::find(specializationEntries, constantId, &vk::SpecializationMapEntry::constantID);
+
+        if (it != specializationEntries.end())
+        {
+            specializationData[static_cast<size_t>(it - specializationEntries.begin())] = value;
+
+            return *this;
+        }
+
+        specializationEntries.push_back({
+            .constantID = constantId,
+            .offset     = static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t)),
+            .size       = sizeof(uint32_t),
+        });
+
+        specializationData.push_back(value);
+
+        return *this;
+    };
+
     GraphicsPipeline::GraphicsPipeline(Device const& device,
                                        PipelineLayout const& layout,
                                        GraphicsPipelineConfig const& config)
+        : m_device { &device }, m_layout { layout }, m_config { config }
     {
         [[maybe_unused]] auto checkShaderStagePresent =
             [&shaders = config.shaders](vk::ShaderStageFlagBits stage)
@@ -231,6 +262,21 @@ namespace renderer::backend
                       "Graphics pipeline builder was not correctly configured");
         // clang-format on
 
+        std::optional<vk::raii::Pipeline> pipeline = recreate();
+
+        if (!pipeline)
+        {
+            MC_THROW Error(GraphicsError, "Failed to compile the shaders of a graphics pipeline");
+        }
+
+        m_pipeline = std::move(*pipeline);
+    };
+
+    auto GraphicsPipeline::recreate() const -> std::optional<vk::raii::Pipeline>
+    {
+        Device const& device                 = *m_device;
+        GraphicsPipelineConfig const& config = m_config;
+
         std::array dynamicStates { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
 
         auto dynamicState = vk::PipelineDynamicStateCreateInfo().setDynamicStates(dynamicStates);
@@ -238,10 +284,10 @@ namespace renderer::backend
         vk::PipelineColorBlendAttachmentState colorBlendAttachment {
             .blendEnable         = config.blendingEnable,
             .srcColorBlendFactor = config.srcColorBlendFactor,
-            .dstColorBlendFactor = vk::BlendFactor::eDstAlpha,
+            .dstColorBlendFactor = config.dstColorBlendFactor,
             .colorBlendOp        = vk::BlendOp::eAdd,
             .srcAlphaBlendFactor = vk::BlendFactor::eOne,
-            .dstAlphaBlendFactor = vk::BlendFactor::eZero,
+            .dstAlphaBlendFactor = config.dstAlphaBlendFactor,
             .alphaBlendOp        = vk::BlendOp::eAdd,
             .colorWriteMask      = config.blendingColorWriteMask,
         };
@@ -307,14 +353,29 @@ namespace renderer::backend
         std::vector<vk::raii::ShaderModule> shaderModules;
         shaderModules.reserve(config.shaders.size());
 
+        auto specializationInfo = vk::SpecializationInfo()
+                                      .setMapEntries(config.specializationEntries)
+                                      .setData<uint32_t>(config.specializationData);
+
         for (uint32_t i : vi::iota(0u, config.shaders.size()))
         {
             ShaderInfo const& info = config.shaders[i];
 
-            shaderModules.push_back(createShaderModule(device.get(), info.path));
+            std::vector<uint32_t> const code = device.getShaderManager().getSpirv(info.path);
+
+            if (code.empty())
+            {
+                return std::nullopt;
+            }
+
+            shaderModules.push_back(createShaderModule(device.get(), code));
 
-            shaderStages.push_back(
-                { .stage = info.stage, .module = shaderModules[i], .pName = info.entryPoint.data() });
+            shaderStages.push_back({
+                .stage               = info.stage,
+                .module              = shaderModules[i],
+                .pName               = info.entryPoint.data(),
+                .pSpecializationInfo = config.specializationEntries.empty() ? nullptr : &specializationInfo,
+            });
         }
 
         vk::GraphicsPipelineCreateInfo pipelineInfo {
@@ -329,28 +390,73 @@ namespace renderer::backend
             .pDepthStencilState  = &depthStencil,
             .pColorBlendState    = &colorBlending,
             .pDynamicState       = &dynamicState,
-            .layout              = layout,
+            .layout              = m_layout,
             .basePipelineHandle  = nullptr,
             .basePipelineIndex   = -1,
         };
 
-        m_pipeline = device->createGraphicsPipeline({ nullptr }, pipelineInfo) >> ResultChecker();
+        return device->createGraphicsPipeline(device.getPipelineCache().get(), pipelineInfo) >>
+               ResultChecker();
     };
 
+    auto GraphicsPipeline::replace(vk::raii::Pipeline pipeline) -> vk::raii::Pipeline
+    {
+        return std::exchange(m_pipeline, std::move(pipeline));
+    }
+
+    auto GraphicsPipeline::getShaderNames() const -> std::vector<std::filesystem::path>
+    {
+        return m_config.shaders | vi::transform(&ShaderInfo::path) | rn::to<std::vector>();
+    }
+
     ComputePipeline::ComputePipeline(Device const& device,
                                      PipelineLayout const& layout,
-                                     std::filesystem::path const& path,
+                                     std::filesystem::path const& name,
                                      std::string_view entryPoint)
+        : m_device { &device },
+          m_layout { layout },
+          m_shader { name, vk::ShaderStageFlagBits::eCompute, std::string(entryPoint) }
     {
-        vk::raii::ShaderModule shaderModule = createShaderModule(device.get(), path);
+        std::optional<vk::raii::Pipeline> pipeline = recreate();
+
+        if (!pipeline)
+        {
+            MC_THROW Error(GraphicsError,
+                           std::format("Failed to compile compute shader '{}'", name.string()));
+        }
+
+        m_pipeline = std::move(*pipeline);
+    }
+
+    auto ComputePipeline::recreate() const -> std::optional<vk::raii::Pipeline>
+    {
+        std::vector<uint32_t> const code = m_device->getShaderManager().getSpirv(m_shader.path);
+
+        if (code.empty())
+        {
+            return std::nullopt;
+        }
+
+        vk::raii::ShaderModule shaderModule = createShaderModule(m_device->get(), code);
 
         vk::ComputePipelineCreateInfo pipelineCreateInfo {
-            .stage  = { .stage  = vk::ShaderStageFlagBits::eCompute,
+            .stage  = { .stage  = m_shader.stage,
                        .module = shaderModule,
-                       .pName  = entryPoint.data() },
-            .layout = layout,
+                       .pName  = m_shader.entryPoint.data() },
+            .layout = m_layout,
         };
 
-        m_pipeline = device->createComputePipeline({ nullptr }, pipelineCreateInfo) >> ResultChecker();
+        return (*m_device)->createComputePipeline(m_device->getPipelineCache().get(), pipelineCreateInfo) >>
+               ResultChecker();
+    }
+
+    auto ComputePipeline::replace(vk::raii::Pipeline pipeline) -> vk::raii::Pipeline
+    {
+        return std::exchange(m_pipeline, std::move(pipeline));
+    }
+
+    auto ComputePipeline::getShaderNames() const -> std::vector<std::filesystem::path>
+    {
+        return { m_shader.path };
     }
 }  // namespace renderer::backend
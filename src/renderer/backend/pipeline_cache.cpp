@@ -0,0 +1,145 @@
+#include <mc/logger.hpp>
+#include <mc/renderer/backend/pipeline_cache.hpp>
+#include <mc/renderer/backend/vk_checker.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <span>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    auto getCacheFileName(vk::PhysicalDeviceProperties const& properties) -> std::string
+    {
+        std::string uuid;
+
+        for (uint8_t byte : properties.pipelineCacheUUID)
+        {
+            uuid += std::format("{:02x}", byte);
+        }
+
+        return std::format("pipeline_cache_{:04x}_{:04x}_{:08x}_{}.bin",
+                           properties.vendorID,
+                           properties.deviceID,
+                           properties.driverVersion,
+                           uuid);
+    }
+
+    // The driver ignores data it doesn't recognize at best
+    auto isCompatible(std::span<std::byte const> data, vk::PhysicalDeviceProperties const& properties) -> bool
+    {
+        VkPipelineCacheHeaderVersionOne header {};
+
+        if (data.size() < sizeof(header))
+        {
+            return false;
+        }
+
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        return header.headerSize >= sizeof(header) &&
+               header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+               std::ranges::equal(header.pipelineCacheUUID, properties.pipelineCacheUUID);
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    PipelineCache::PipelineCache(vk::raii::Device const& device,
+                                 vk::PhysicalDeviceProperties const& properties,
+                                 fs::path const& directory)
+        : m_path { directory / getCacheFileName(properties) }
+    {
+        // Read rather than mapped, MappedFile throws on files it can't open and a broken cache only costs
+        // a cold start
+        std::vector<std::byte> data;
+
+        if (std::error_code error; fs::exists(m_path, error))
+        {
+            std::ifstream file { m_path, std::ios::binary };
+
+            auto const size = fs::file_size(m_path, error);
+
+            if (file.is_open() && !error && size > 0)
+            {
+                data.resize(size);
+
+                if (!file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size)))
+                {
+                    data.clear();
+                }
+            }
+
+            if (data.empty())
+            {
+                logger::warn("Ignoring pipeline cache '{}', it is empty or can't be read", m_path.string());
+            }
+            else
+            {
+                m_warm = isCompatible(data, properties);
+
+                if (!m_warm)
+                {
+                    logger::warn("Ignoring pipeline cache '{}', it was written by another device or driver",
+                                 m_path.string());
+                }
+            }
+        }
+
+        auto createInfo = vk::PipelineCacheCreateInfo();
+
+        if (m_warm)
+        {
+            createInfo.setInitialDataSize(data.size()).setPInitialData(data.data());
+        }
+
+        m_cache = device.createPipelineCache(createInfo) >> ResultChecker();
+
+        logger::info("Pipeline cache '{}' is {}", m_path.filename().string(), m_warm ? "warm" : "cold");
+    }
+
+    void PipelineCache::save() const
+    {
+        std::vector<uint8_t> const data = m_cache.getData();
+
+        fs::path tempPath = m_path;
+        tempPath += ".tmp";
+
+        {
+            std::ofstream file { tempPath, std::ios::binary | std::ios::trunc };
+
+            file.write(reinterpret_cast<char const*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+            // The last write may only fail once the buffer goes out
+            file.close();
+
+            if (!file.good())
+            {
+                logger::error("Failed to write pipeline cache '{}'", tempPath.string());
+
+                return;
+            }
+        }
+
+        std::error_code error;
+
+        fs::rename(tempPath, m_path, error);
+
+        if (error)
+        {
+            logger::error("Failed to replace pipeline cache '{}': {}", m_path.string(), error.message());
+
+            return;
+        }
+
+        logger::info("Saved {:.2f} KiB pipeline cache to '{}'",
+                     static_cast<double>(data.size()) / 1024.0,
+                     m_path.filename().string());
+    }
+}  // namespace renderer::backend
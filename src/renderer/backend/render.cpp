@@ -1,7 +1,25 @@
+#include <mc/asserts.hpp>
 #include <mc/renderer/backend/image.hpp>
+#include <mc/renderer/backend/image_writer.hpp>
 #include <mc/renderer/backend/info_structs.hpp>
 #include <mc/renderer/backend/render.hpp>
 #include <mc/renderer/backend/vk_checker.hpp>
+#include <mc/utils.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <imgui.h>
@@ -14,6 +32,15 @@
 #include <vulkan/vulkan_handles.hpp>
 #include <vulkan/vulkan_structs.hpp>
 
+namespace vi = std::ranges::views;
+
+namespace
+{
+    // A chunk records a handful of commands per command range, handing it to another thread and executing
+    // one more secondary buffer costs more than that until there are a few ranges to share
+    constexpr uint32_t kMinRangesPerGeometryChunk = 4;
+}  // namespace
+
 namespace renderer::backend
 {
     void RendererBackend::render()
@@ -26,12 +53,40 @@ namespace renderer::backend
 
         FrameResources& frame = m_frameResources[m_currentFrame];
 
-        m_device->waitForFences({ frame.inFlightFence }, true, std::numeric_limits<uint64_t>::max()) >>
-            ResultChecker();
-        m_device->resetFences({ frame.inFlightFence });
+        // Everything the slot's previous frame used can be reused once it has completed
+        m_frameTimeline.wait(frame.timelineValue);
+
+        // Including the copy of its draw image
+        if (frame.readbackFrame)
+        {
+            writeReadback(frame);
+        }
+
+        // The secondary buffers this frame slot executed last time have retired with it
+        m_commandManager.resetRecordingPools(m_currentFrame);
+
+        // Resources retired before any completed submission are unused as well
+        m_deletionQueue.collect();
+
+        // And everything it allocated out of its region of the uniform ring
+        m_uniformRing.beginFrame(m_currentFrame);
+
+        frame.sceneDataOffset = m_uniformRing.push(m_sceneData).offset;
+        frame.lightDataOffset = m_uniformRing.push(m_light).offset;
+
+        reloadChangedPipelines();
+
+        m_textureLoader.pump([this](std::span<LoadedTexture> textures) { onTexturesLoaded(textures); });
+
+        // Everything recorded since the last frame goes out in one batch
+        m_uploadManager.submit();
+
+        // This frame's set is idle now, textures that landed above are sampled from here on
+        m_bindlessTextures.flush(m_currentFrame);
 
         uint32_t imageIndex {};
 
+        if (!m_headless)
         {
             auto [result, index] = m_swapchain->acquireNextImage(
                 std::numeric_limits<uint64_t>::max(), { frame.imageAvailableSemaphore }, {});
@@ -59,32 +114,51 @@ namespace renderer::backend
 
         auto cmdinfo = vk::CommandBufferSubmitInfo().setCommandBuffer(cmdBuf);
 
-        auto waitInfo = vk::SemaphoreSubmitInfo()
-                            .setValue(1)
-                            .setStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
-                            .setSemaphore(frame.imageAvailableSemaphore);
+        std::array waitInfos {
+            vk::SemaphoreSubmitInfo()
+                .setValue(1)
+                .setStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+                .setSemaphore(frame.imageAvailableSemaphore),
+            m_uploadManager.getWaitInfo(),
+        };
+
+        std::array signalInfos {
+            vk::SemaphoreSubmitInfo()
+                .setValue(1)
+                .setStageMask(vk::PipelineStageFlagBits2::eAllGraphics)
+                .setSemaphore(frame.renderFinishedSemaphore),
+            m_frameTimeline.signal(),
+        };
+
+        frame.timelineValue = m_frameTimeline.getSubmittedValue();
 
-        auto signalInfo = vk::SemaphoreSubmitInfo()
-                              .setValue(1)
-                              .setStageMask(vk::PipelineStageFlagBits2::eAllGraphics)
-                              .setSemaphore(frame.renderFinishedSemaphore);
+        std::span<vk::SemaphoreSubmitInfo const> waits   = waitInfos;
+        std::span<vk::SemaphoreSubmitInfo const> signals = signalInfos;
+
+        // Headless frames have no swapchain image to wait for or present
+        if (m_headless)
+        {
+            waits   = waits.subspan(1);
+            signals = signals.subspan(1);
+        }
 
         auto submit = vk::SubmitInfo2()
                           .setCommandBufferInfos(cmdinfo)
-                          .setWaitSemaphoreInfos(waitInfo)
-                          .setSignalSemaphoreInfos(signalInfo);
+                          .setWaitSemaphoreInfos(waits)
+                          .setSignalSemaphoreInfos(signals);
 
         {
             ZoneNamedN(tracy_queue_submit_zone, "Queue Submit", true);
-            m_device.getGraphicsQueue().submit2(submit, frame.inFlightFence);
+            m_device.getGraphicsQueue().submit2(submit);
         }
 
-        auto presentInfo = vk::PresentInfoKHR()
-                               .setWaitSemaphores(*frame.renderFinishedSemaphore)
-                               .setSwapchains(*m_swapchain.get())
-                               .setImageIndices(imageIndex);
-
+        if (!m_headless)
         {
+            auto presentInfo = vk::PresentInfoKHR()
+                                   .setWaitSemaphores(*frame.renderFinishedSemaphore)
+                                   .setSwapchains(*m_swapchain.get())
+                                   .setImageIndices(imageIndex);
+
             ZoneNamedN(tracy_queue_present_zone, "Queue presentation", true);
             vk::Result result = m_device.getPresentQueue().presentKHR(presentInfo);
 
@@ -100,29 +174,209 @@ namespace renderer::backend
             }
         }
 
-        m_currentFrame = (m_currentFrame + 1) % kNumFramesInFlight;
+        m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
         ++m_frameCount;
     }
 
-    void RendererBackend::drawGeometry(vk::CommandBuffer cmdBuf)
+    auto RendererBackend::copyReadback(FrameResources const& frame) const -> std::vector<uint16_t>
+    {
+        frame.readbackBuffer.invalidate();
+
+        vk::Extent2D const extent = m_headless->extent;
+
+        auto const* data = static_cast<uint16_t const*>(frame.readbackBuffer.getMappedData());
+
+        return { data, data + size_t { extent.width } * extent.height * 4 };
+    }
+
+    auto RendererBackend::readLastFrame() const -> std::vector<uint16_t>
+    {
+        MC_ASSERT_MSG(m_headless && m_frameCount > 0, "Only headless frames are read back");
+
+        return copyReadback(m_frameResources[(m_currentFrame + m_framesInFlight - 1) % m_framesInFlight]);
+    }
+
+    void RendererBackend::writeReadback(FrameResources& frame)
     {
-        vk::Extent2D imageExtent = m_drawImage.getDimensions();
+        ZoneScopedN("Frame readback");
+
+        vk::Extent2D const extent = m_headless->extent;
+        bool const exr            = m_headless->exr;
+
+        // Copied out, the buffer is written again by the slot's next frame
+        std::vector<uint16_t> pixels = copyReadback(frame);
+
+        std::filesystem::path path = m_headless->outputDirectory /
+                                     std::format("frame_{:05}.{}", *frame.readbackFrame, exr ? "exr" : "png");
+
+        frame.readbackFrame.reset();
+
+        std::erase_if(m_readbackWrites,
+                      [](std::future<void> const& write)
+                      { return write.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+
+        m_readbackWrites.push_back(m_threadPool.submit(
+            [path = std::move(path), extent, exr, pixels = std::move(pixels)]
+            {
+                if (exr)
+                {
+                    writeExr(path, extent, pixels);
+                }
+                else
+                {
+                    writePng(path, extent, pixels);
+                }
+            }));
+    }
+
+    void RendererBackend::finishFrames()
+    {
+        m_device->waitIdle();
+
+        for (FrameResources& frame : m_frameResources)
+        {
+            if (frame.readbackFrame)
+            {
+                writeReadback(frame);
+            }
+        }
+
+        for (std::future<void>& write : m_readbackWrites)
+        {
+            write.wait();
+        }
+
+        m_readbackWrites.clear();
+    }
+
+    void RendererBackend::reloadChangedPipelines()
+    {
+        ZoneScopedN("Reload pipelines");
+
+        std::vector<std::filesystem::path> const changed = m_shaderWatcher.poll();
+
+        ShaderManager const& shaderManager = m_device.getShaderManager();
+
+        for (size_t i = 0; i < m_watchedPipelines.size() && !changed.empty(); ++i)
+        {
+            WatchedPipeline const& watched = m_watchedPipelines[i];
+
+            auto isChanged = [&](std::filesystem::path const& name)
+            {
+                return std::ranges::any_of(changed,
+                                           [&](std::filesystem::path const& file)
+                                           {
+                                               return shaderManager.dependsOn(name, file);
+                                           });
+            };
+
+            bool const affected = std::ranges::any_of(watched.shaders, isChanged);
+
+            if (!affected)
+            {
+                continue;
+            }
+
+            auto pending = std::ranges::find(m_pipelineRebuilds, i, &PipelineRebuild::pipelineIndex);
+
+            if (pending != m_pipelineRebuilds.end())
+            {
+                pending->stale = true;
+
+                continue;
+            }
+
+            m_pipelineRebuilds.push_back({
+                .pipelineIndex = i,
+                .result        = m_threadPool.submit(watched.recreate),
+                .stale         = false,
+            });
+        }
+
+        for (auto it = m_pipelineRebuilds.begin(); it != m_pipelineRebuilds.end();)
+        {
+            if (it->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++it;
+
+                continue;
+            }
+
+            WatchedPipeline& watched = m_watchedPipelines[it->pipelineIndex];
 
+            std::string shaderNames;
+
+            for (std::filesystem::path const& name : watched.shaders)
+            {
+                shaderNames += (shaderNames.empty() ? "" : ", ") + name.string();
+            }
+
+            if (std::optional<vk::raii::Pipeline> pipeline = it->result.get())
+            {
+                m_deletionQueue.retire(watched.replace(std::move(*pipeline)));
+
+                logger::info("Reloaded pipeline of {}", shaderNames);
+            }
+            else
+            {
+                logger::warn("Keeping the previous pipeline of {}, its shaders failed to compile",
+                             shaderNames);
+            }
+
+            if (std::exchange(it->stale, false))
+            {
+                it->result = m_threadPool.submit(watched.recreate);
+
+                ++it;
+
+                continue;
+            }
+
+            it = m_pipelineRebuilds.erase(it);
+        }
+    }
+
+    void RendererBackend::drawGeometry(vk::CommandBuffer cmdBuf, CullPhase phase)
+    {
+        vk::Extent2D imageExtent = m_renderGraph.getExtent(m_renderTargets.draw);
+
+        bool const early = phase == CullPhase::Early;
+
+        // The render graph has the attachments in their layouts and orders the phases
         auto colorAttachment = vk::RenderingAttachmentInfo()
-                                   .setImageView(m_drawImage.getImageView())
-                                   .setImageLayout(vk::ImageLayout::eGeneral)
+                                   .setImageView(m_renderGraph.getImageView(m_renderTargets.draw))
+                                   .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
                                    .setLoadOp(vk::AttachmentLoadOp::eLoad)
-                                   .setStoreOp(vk::AttachmentStoreOp::eStore)
-                                   .setResolveImageView(m_drawImageResolve.getImageView())
-                                   .setResolveImageLayout(vk::ImageLayout::eGeneral)
-                                   .setResolveMode(vk::ResolveModeFlagBits::eAverage);
+                                   .setStoreOp(vk::AttachmentStoreOp::eStore);
+
+        // Only the finished image is resolved
+        if (!early)
+        {
+            colorAttachment.setResolveImageView(m_renderGraph.getImageView(m_renderTargets.drawResolve))
+                .setResolveImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+                .setResolveMode(vk::ResolveModeFlagBits::eAverage);
+        }
 
         auto depthAttachment = vk::RenderingAttachmentInfo()
-                                   .setImageView(m_depthImage.getImageView())
+                                   .setImageView(m_renderGraph.getImageView(m_renderTargets.depth))
                                    .setImageLayout(vk::ImageLayout::eDepthAttachmentOptimal)
-                                   .setLoadOp(vk::AttachmentLoadOp::eClear)
-                                   .setStoreOp(vk::AttachmentStoreOp::eStore)
-                                   .setClearValue({ .depthStencil = { .depth = 0.f } });
+                                   .setLoadOp(vk::AttachmentLoadOp::eLoad)
+                                   .setStoreOp(vk::AttachmentStoreOp::eDontCare);
+
+        // The depth pyramid is built from the farthest sample of every pixel
+        if (early)
+        {
+            vk::ResolveModeFlagBits const resolveMode = m_device.isOcclusionCullingSupported()
+                                                            ? vk::ResolveModeFlagBits::eMin
+                                                            : vk::ResolveModeFlagBits::eSampleZero;
+
+            depthAttachment.setLoadOp(vk::AttachmentLoadOp::eClear)
+                .setStoreOp(vk::AttachmentStoreOp::eStore)
+                .setClearValue({ .depthStencil = { .depth = 0.f } })
+                .setResolveImageView(m_renderGraph.getImageView(m_renderTargets.depthResolve))
+                .setResolveImageLayout(vk::ImageLayout::eDepthAttachmentOptimal)
+                .setResolveMode(resolveMode);
+        }
 
         auto renderInfo = vk::RenderingInfo()
                               .setRenderArea({ .extent = imageExtent })
@@ -130,105 +384,696 @@ namespace renderer::backend
                               .setPDepthAttachment(&depthAttachment)
                               .setLayerCount(1);
 
+        // Without a scene the pass only clears and resolves
+        if (!isSceneReady())
+        {
+            cmdBuf.beginRendering(renderInfo);
+            cmdBuf.endRendering();
+
+            return;
+        }
+
+        std::vector<vk::CommandBuffer> const chunks = recordGeometryChunks(phase);
+
+        renderInfo.setFlags(vk::RenderingFlagBits::eContentsSecondaryCommandBuffers);
+
         cmdBuf.beginRendering(renderInfo);
+        cmdBuf.executeCommands(chunks);
+        cmdBuf.endRendering();
+
+        // drawGltf timed every command range of both phases, see there
+        if (!early && m_device.isDrawIndirectCountSupported() && m_timestampPeriod > 0.f)
+        {
+            m_frameResources[m_currentFrame].rangeTimestampsWritten = true;
+        }
+    }
+
+    auto RendererBackend::getGeometryChunkCount() const -> uint32_t
+    {
+        uint32_t const threadCount = m_commandManager.getRecordingThreadCount();
+        uint32_t const rangeCount  = utils::size(m_sceneResources.commandRanges);
+
+        return std::min(std::max(rangeCount / kMinRangesPerGeometryChunk, 1u), threadCount);
+    }
+
+    auto RendererBackend::recordGeometryChunks(CullPhase phase) -> std::vector<vk::CommandBuffer>
+    {
+        ZoneScopedN("Record geometry chunks");
+
+        auto const startTime = Timer::Clock::now();
+
+        vk::Extent2D const imageExtent = m_renderGraph.getExtent(m_renderTargets.draw);
+        vk::Format const colorFormat   = kDrawImageFormat;
 
-        vk::Viewport viewport = {
-            .x        = 0,
-            .y        = 0,
-            .width    = static_cast<float>(imageExtent.width),
-            .height   = static_cast<float>(imageExtent.height),
-            .minDepth = 0.f,
-            .maxDepth = 1.f,
+        vk::CommandBufferInheritanceRenderingInfo const renderingInfo {
+            .flags                   = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers,
+            .colorAttachmentCount    = 1,
+            .pColorAttachmentFormats = &colorFormat,
+            .depthAttachmentFormat   = kDepthStencilFormat,
+            .rasterizationSamples    = m_device.getMaxUsableSampleCount(),
         };
 
-        cmdBuf.setViewport(0, viewport);
+        vk::CommandBufferInheritanceInfo const inheritanceInfo { .pNext = &renderingInfo };
 
-        auto scissor = vk::Rect2D().setExtent(imageExtent).setOffset({ 0, 0 });
+        uint32_t const chunkCount = getGeometryChunkCount();
 
-        cmdBuf.setScissor(0, scissor);
+        // Chunk i is recorded with thread i's pool, whichever thread ends up running it
+        auto recordChunk = [&](uint32_t chunk) -> vk::CommandBuffer
+        {
+            ZoneScopedN("Record geometry chunk");
+
+            vk::CommandBuffer const commandBuffer =
+                m_commandManager.acquireSecondaryCmdBuffer(m_device, m_currentFrame, chunk);
+
+            commandBuffer.begin({
+                .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+                         vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+                .pInheritanceInfo = &inheritanceInfo,
+            }) >> ResultChecker();
+
+            // Dynamic state isn't inherited from the primary
+            vk::Viewport const viewport = {
+                .x        = 0,
+                .y        = 0,
+                .width    = static_cast<float>(imageExtent.width),
+                .height   = static_cast<float>(imageExtent.height),
+                .minDepth = 0.f,
+                .maxDepth = 1.f,
+            };
 
-        m_stats.drawcall_count = 0;
-        m_stats.triangle_count = 0;
+            commandBuffer.setViewport(0, viewport);
+            commandBuffer.setScissor(0, vk::Rect2D().setExtent(imageExtent).setOffset({ 0, 0 }));
 
-        drawGltf(cmdBuf, m_texturedPipelineLayout);
+            drawGltf(commandBuffer, m_texturedPipelineLayout, phase, chunk, chunkCount);
 
-        cmdBuf.endRendering();
+            commandBuffer.end() >> ResultChecker();
+
+            return commandBuffer;
+        };
+
+        std::vector<std::future<vk::CommandBuffer>> pending;
+
+        for (uint32_t chunk = 1; chunk < chunkCount; ++chunk)
+        {
+            pending.push_back(
+                m_recordingThreads.submit([&recordChunk, chunk] { return recordChunk(chunk); }));
+        }
+
+        // Executed in chunk order, which keeps the draws in the order of the indirect commands
+        std::vector<vk::CommandBuffer> chunks { recordChunk(0) };
+
+        for (std::future<vk::CommandBuffer>& future : pending)
+        {
+            chunks.push_back(future.get());
+        }
+
+        m_stats.geometry_record_ms += Timer::Milliseconds(Timer::Clock::now() - startTime).count();
+        m_stats.geometry_chunk_count = chunkCount;
+
+        return chunks;
     }
 
-    void RendererBackend::recordCommandBuffer(uint32_t imageIndex)
+    void RendererBackend::prepareCulling(vk::CommandBuffer cmdBuf)
     {
-#if PROFILED
-        TracyVkCtx tracyCtx = m_frameResources[m_currentFrame].tracyContext;
-#endif
+        FrameResources& frame = m_frameResources[m_currentFrame];
 
-        vk::CommandBuffer cmdBuf = m_commandManager.getGraphicsCmdBuffer(m_currentFrame);
+        m_stats = {};
 
-        auto beginInfo =
-            vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+        // Like the counts below, written by this frame slot's previous submission
+        if (frame.timestampsWritten)
+        {
+            auto [result, timestamps] = frame.timestampQueryPool.getResults<uint64_t>(
+                0, 2, 2 * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
 
-        cmdBuf.begin(beginInfo) >> ResultChecker();
+            if (result == vk::Result::eSuccess)
+            {
+                m_stats.pyramid_build_ms =
+                    static_cast<double>(timestamps[1] - timestamps[0]) * m_timestampPeriod / 1e6;
+            }
+
+            frame.timestampsWritten = false;
+        }
 
+        if (frame.rangeTimestampsWritten)
         {
-            TracyVkZone(tracyCtx, cmdBuf, "Command buffer recording");
+            auto const rangeCount = utils::size(m_sceneResources.commandRanges);
 
-            vk::Image swapchainImage = m_swapchain.getImages()[imageIndex];
-            vk::Extent2D imageExtent = m_swapchain.getImageExtent();
+            m_stats.range_ms_valid = true;
 
-            Image::transition(
-                cmdBuf, m_drawImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-            Image::transition(
-                cmdBuf, m_depthImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthAttachmentOptimal);
+            for (CullPhase phase : { CullPhase::Early, CullPhase::Late })
+            {
+                auto [result, timestamps] =
+                    frame.timestampQueryPool.getResults<uint64_t>(getRangeTimestampQuery(phase, 0),
+                                                                  2 * rangeCount,
+                                                                  2 * rangeCount * sizeof(uint64_t),
+                                                                  sizeof(uint64_t),
+                                                                  vk::QueryResultFlagBits::e64);
+
+                m_stats.range_ms_valid &= result == vk::Result::eSuccess;
+
+                for (uint32_t range = 0; range < rangeCount && result == vk::Result::eSuccess; ++range)
+                {
+                    m_stats.range_ms[range] += static_cast<double>(timestamps[2 * range + 1] -
+                                                                   timestamps[2 * range]) *
+                                               m_timestampPeriod / 1e6;
+                }
+            }
 
-            vk::ClearColorValue clearValue {
-                std::array { 33.f / 255.f, 33.f / 255.f, 33.f / 255.f, 1.f }
-            };
+            frame.rangeTimestampsWritten = false;
+        }
+
+        if (m_timestampPeriod > 0.f)
+        {
+            // drawGltf writes them from inside the geometry passes, where queries can't be reset
+            cmdBuf.resetQueryPool(frame.timestampQueryPool,
+                                  kPyramidTimestampQueries,
+                                  kTimestampQueryCount - kPyramidTimestampQueries);
+        }
+
+        if (!isSceneReady())
+        {
+            return;
+        }
+
+        m_depthPyramid.recordInitialLayout(cmdBuf);
+
+        m_cullData.pyramidWidth     = m_depthPyramid.getExtent().width;
+        m_cullData.pyramidHeight    = m_depthPyramid.getExtent().height;
+        m_cullData.occlusionEnabled = m_device.isOcclusionCullingSupported();
+
+        frame.cullDataAddress = m_uniformRing.push(m_cullData).address;
+
+        // Nodes moved since the last frame, both this pass and drawGltf read the world matrices
+        if (m_sceneResources.sceneGraph.update())
+        {
+            m_sceneResources.frustumCuller.updateBounds(m_sceneResources.draws, m_sceneResources.sceneGraph);
+        }
+
+        m_sceneResources.sceneGraph.recordUpload(cmdBuf, m_currentFrame);
+
+        FrustumCuller const& frustumCuller = m_sceneResources.frustumCuller;
+
+        uint32_t const visibleCount =
+            frustumCuller.cull(m_cullData.frustumPlanes, m_sceneResources.drawVisibility);
+
+        m_stats.visible_count = visibleCount;
+        m_stats.culled_count  = frustumCuller.getDrawCount() - visibleCount;
+
+        queueVisibleDraws();
+
+        // Still holds the counts of this frame slot's previous submission, which the timeline wait has
+        // retired. The stats lag the frames in flight behind. The memory may not be host coherent.
+        frame.drawCountBuffer.invalidate();
+
+        auto& drawCounts = *static_cast<GPUDrawCounts*>(frame.drawCountBuffer.getMappedData());
+
+        m_stats.drawcall_count = std::reduce(drawCounts.drawCounts.begin(), drawCounts.drawCounts.end(), 0u);
+        m_stats.triangle_count = drawCounts.triangleCount;
+        m_stats.occluded_count = drawCounts.occludedCount;
+
+        drawCounts = {};
+
+        frame.drawCountBuffer.flush();
+    }
+
+    void RendererBackend::queueVisibleDraws()
+    {
+        ZoneScopedN("Queue visible draws");
+
+        RenderQueue& queue = m_sceneResources.renderQueue;
+        std::span<SceneDraw const> draws = m_sceneResources.draws;
+        std::span<glm::mat4 const> worldTransforms = m_sceneResources.sceneGraph.getWorldTransforms();
+
+        glm::vec3 const cameraPosition = m_cullData.cameraPosition;
+
+        queue.clear();
+
+        for (uint32_t word = 0; word < m_sceneResources.drawVisibility.size(); ++word)
+        {
+            for (uint32_t bits = m_sceneResources.drawVisibility[word]; bits != 0; bits &= bits - 1)
+            {
+                uint32_t const drawIndex = word * 32 + static_cast<uint32_t>(std::countr_zero(bits));
+                SceneDraw const& draw    = draws[drawIndex];
+
+                glm::vec3 const center =
+                    glm::vec3(worldTransforms[draw.nodeIndex] * glm::vec4(draw.primitive.sphereCenter, 1.f));
+                glm::vec3 const offset = center - cameraPosition;
+
+                // Draws of a command range share pipeline permutation and index type, each range has its own
+                // indirect draw
+                uint32_t const pipeline = draw.commandRange;
+
+                uint32_t const material = draw.primitive.materialIndex;
 
-            auto range = vk::ImageSubresourceRange()
-                             .setAspectMask(vk::ImageAspectFlagBits::eColor)
-                             .setLayerCount(vk::RemainingArrayLayers)
-                             .setLevelCount(vk::RemainingMipLevels)
-                             .setBaseMipLevel(0)
-                             .setBaseArrayLayer(0);
+                // Squared distances order like the distances
+                queue.push(DrawKey::make(draw.pass, pipeline, material, glm::dot(offset, offset)), drawIndex);
+            }
+        }
+
+        queue.sort();
+
+        // Host writes are made visible to the dispatch by the submission, once flushed
+        GPUBuffer const& orderBuffer = m_sceneResources.instanceOrderBuffers[m_currentFrame];
+        auto* instanceOrder          = static_cast<uint32_t*>(orderBuffer.getMappedData());
+
+        uint32_t instanceCount = 0;
 
-            cmdBuf.clearColorImage(m_drawImage, vk::ImageLayout::eTransferDstOptimal, clearValue, range);
+        std::array<uint32_t, kMaxCommandRanges> blendedCounts {};
 
-            Image::transition(cmdBuf,
-                              m_drawImage,
-                              vk::ImageLayout::eTransferDstOptimal,
-                              vk::ImageLayout::eColorAttachmentOptimal);
+        for (RenderQueueEntry const& entry : queue.getEntries())
+        {
+            SceneDraw const& draw = draws[entry.drawIndex];
 
+            if (draw.pass == DrawPass::Blended)
             {
-                TracyVkZone(tracyCtx, cmdBuf, "Geometry render");
+                blendedCounts[draw.commandRange] += draw.primitive.meshletCount;
+
+                continue;
+            }
+
+            std::iota(instanceOrder + instanceCount,
+                      instanceOrder + instanceCount + draw.primitive.meshletCount,
+                      draw.firstMeshletInstance);
+
+            instanceCount += draw.primitive.meshletCount;
+        }
+
+        // Blended draws sort by depth before their range. Grouping their instances by range keeps each
+        // range back to front, meshlet_cull.comp gives every blended instance the command of its position.
+        std::array<uint32_t, kMaxCommandRanges>& firstQueuedInstances = m_sceneResources.firstQueuedInstances;
+
+        for (uint32_t range = 0; range < kMaxCommandRanges; ++range)
+        {
+            firstQueuedInstances[range] = instanceCount;
+
+            instanceCount += blendedCounts[range];
+        }
+
+        std::array<uint32_t, kMaxCommandRanges> cursors = firstQueuedInstances;
 
-                // drawGeometry(cmdBuf);
+        for (RenderQueueEntry const& entry : queue.getEntries())
+        {
+            SceneDraw const& draw = draws[entry.drawIndex];
+
+            if (draw.pass != DrawPass::Blended)
+            {
+                continue;
             }
 
+            uint32_t& cursor = cursors[draw.commandRange];
+
+            std::iota(instanceOrder + cursor,
+                      instanceOrder + cursor + draw.primitive.meshletCount,
+                      draw.firstMeshletInstance);
+
+            cursor += draw.primitive.meshletCount;
+        }
+
+        orderBuffer.flush();
+
+        m_sceneResources.queuedInstanceCount = instanceCount;
+    }
+
+    void RendererBackend::cullMeshlets(vk::CommandBuffer cmdBuf, CullPhase phase)
+    {
+        // Matches local_size_x in meshlet_cull.comp
+        constexpr uint32_t kGroupSize = 64;
+
+        if (!isSceneReady())
+        {
+            return;
+        }
+
+        uint32_t const instanceCount = m_sceneResources.queuedInstanceCount;
+
+        FrameResources& frame = m_frameResources[m_currentFrame];
+
+        GPUBuffer const& commandBuffer = m_sceneResources.indirectCommandBuffers[std::to_underlying(phase)];
+
+        auto getAddress = [&](vk::Buffer buffer)
+        { return m_device->getBufferAddress(vk::BufferDeviceAddressInfo().setBuffer(buffer)); };
+
+        MeshletCullPushConstants pushConstants {
+            .meshletBuffer           = getAddress(m_sceneResources.meshletBuffer),
+            .drawBuffer              = getAddress(m_sceneResources.meshletDrawBuffer),
+            .nodeBuffer              = getAddress(m_sceneResources.sceneGraph.getBuffer()),
+            .instanceBuffer          = getAddress(m_sceneResources.meshletInstanceBuffer),
+            .commandBuffer           = getAddress(commandBuffer),
+            .drawCountBuffer         = getAddress(frame.drawCountBuffer),
+            .cullDataBuffer          = frame.cullDataAddress,
+            .instanceOrderBuffer     = getAddress(m_sceneResources.instanceOrderBuffers[m_currentFrame]),
+            .meshletVisibilityBuffer = getAddress(m_sceneResources.meshletVisibilityBuffer),
+            .instanceCount           = instanceCount,
+            .phase                   = phase,
+            .firstBlendedRange       = kMaxCommandRanges,
+        };
+
+        for (auto [rangeIndex, range] : vi::enumerate(m_sceneResources.commandRanges))
+        {
+            pushConstants.firstCommands[rangeIndex] = range.firstCommand;
+
+            if (range.pass == DrawPass::Blended)
             {
-                TracyVkZone(tracyCtx, cmdBuf, "Draw image copy");
+                // Indexed with the invocation instead of a compacted slot, wraps around like the shader
+                pushConstants.firstCommands[rangeIndex] -= m_sceneResources.firstQueuedInstances[rangeIndex];
 
-                Image::transition(cmdBuf,
-                                  m_drawImageResolve,
-                                  vk::ImageLayout::eUndefined,
-                                  vk::ImageLayout::eTransferSrcOptimal);
+                pushConstants.firstBlendedRange =
+                    std::min(pushConstants.firstBlendedRange, static_cast<uint32_t>(rangeIndex));
+            }
+        }
+
+        if (phase == CullPhase::Early)
+        {
+            // The previous frame may still be reading the commands this frame overwrites, its late phase
+            // wrote the meshlet visibility read here
+            vk::MemoryBarrier2 readBarrier {
+                .srcStageMask =
+                    vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eComputeShader,
+                .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                .dstStageMask =
+                    vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eClear,
+                .dstAccessMask =
+                    vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+            };
+
+            cmdBuf.pipelineBarrier2(vk::DependencyInfo().setMemoryBarriers(readBarrier));
+        }
+        else
+        {
+            // Both phases count into the same buffer
+            vk::MemoryBarrier2 countBarrier {
+                .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+                .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+                .dstAccessMask =
+                    vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+            };
+
+            cmdBuf.pipelineBarrier2(vk::DependencyInfo().setMemoryBarriers(countBarrier));
+        }
+
+        // Without a count the draws go over every command, those past the visible meshlets have to be empty
+        if (!m_device.isDrawIndirectCountSupported())
+        {
+            cmdBuf.fillBuffer(commandBuffer, 0, vk::WholeSize, 0);
+
+            vk::MemoryBarrier2 clearBarrier {
+                .srcStageMask  = vk::PipelineStageFlagBits2::eClear,
+                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+                .dstAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+            };
+
+            cmdBuf.pipelineBarrier2(vk::DependencyInfo().setMemoryBarriers(clearBarrier));
+        }
+
+        cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_meshletCullPipeline);
+        cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                  m_meshletCullPipelineLayout,
+                                  0,
+                                  m_depthPyramid.getSamplingSet(),
+                                  {});
+        cmdBuf.pushConstants(m_meshletCullPipelineLayout,
+                             vk::ShaderStageFlagBits::eCompute,
+                             0,
+                             sizeof(MeshletCullPushConstants),
+                             &pushConstants);
+        cmdBuf.dispatch((instanceCount + kGroupSize - 1) / kGroupSize, 1, 1);
+
+        // The counts are read back on the host once this frame slot comes around again
+        std::array writeBarriers {
+            vk::MemoryBarrier2 {
+                .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+                .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                .dstStageMask  = vk::PipelineStageFlagBits2::eDrawIndirect,
+                .dstAccessMask = vk::AccessFlagBits2::eIndirectCommandRead,
+            },
+            vk::MemoryBarrier2 {
+                .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+                .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                .dstStageMask  = vk::PipelineStageFlagBits2::eHost,
+                .dstAccessMask = vk::AccessFlagBits2::eHostRead,
+            },
+        };
+
+        cmdBuf.pipelineBarrier2(vk::DependencyInfo().setMemoryBarriers(writeBarriers));
+    }
+
+    void RendererBackend::buildDepthPyramid(vk::CommandBuffer cmdBuf)
+    {
+        if (!isSceneReady())
+        {
+            return;
+        }
+
+        FrameResources& frame = m_frameResources[m_currentFrame];
+
+        if (m_timestampPeriod > 0.f)
+        {
+            cmdBuf.resetQueryPool(frame.timestampQueryPool, 0, 2);
+            cmdBuf.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, frame.timestampQueryPool, 0);
+        }
+
+        m_depthPyramid.recordBuild(cmdBuf);
+
+        if (m_timestampPeriod > 0.f)
+        {
+            cmdBuf.writeTimestamp2(vk::PipelineStageFlagBits2::eComputeShader, frame.timestampQueryPool, 1);
+
+            frame.timestampsWritten = true;
+        }
+    }
+
+    void RendererBackend::buildRenderGraph(uint32_t imageIndex)
+    {
+#if PROFILED
+        TracyVkCtx tracyCtx = m_frameResources[m_currentFrame].tracyContext;
+#endif
+
+        m_renderGraph.reset();
+
+        RenderGraph::TransientImageInfo colorInfo {
+            .extent = getRenderExtent(),
+            .format = kDrawImageFormat,
+        };
 
-                Image::transition(cmdBuf,
-                                  swapchainImage,
-                                  vk::ImageLayout::eUndefined,
-                                  vk::ImageLayout::eTransferDstOptimal);
+        RenderGraph::TransientImageInfo depthInfo {
+            .extent = colorInfo.extent,
+            .format = kDepthStencilFormat,
+            .aspect = vk::ImageAspectFlagBits::eDepth,
+        };
+
+        m_renderTargets.drawResolve  = m_renderGraph.createImage("Draw image resolve", colorInfo);
+        m_renderTargets.depthResolve = m_renderGraph.createImage("Depth resolve image", depthInfo);
+
+        colorInfo.samples = m_device.getMaxUsableSampleCount();
+        depthInfo.samples = colorInfo.samples;
+
+        m_renderTargets.draw  = m_renderGraph.createImage("Draw image", colorInfo);
+        m_renderTargets.depth = m_renderGraph.createImage("Depth image", depthInfo);
+
+        // The passes run from recordCommandBuffer, after this returns
+        m_renderGraph
+            .addPass("Clear",
+                     [=, this](vk::CommandBuffer cmdBuf)
+                     {
+                         vk::ClearColorValue clearValue {
+                             std::array { 33.f / 255.f, 33.f / 255.f, 33.f / 255.f, 1.f }
+                         };
+
+                         auto range = vk::ImageSubresourceRange()
+                                          .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                                          .setLayerCount(vk::RemainingArrayLayers)
+                                          .setLevelCount(vk::RemainingMipLevels)
+                                          .setBaseMipLevel(0)
+                                          .setBaseArrayLayer(0);
+
+                         cmdBuf.clearColorImage(m_renderGraph.getImage(m_renderTargets.draw),
+                                                vk::ImageLayout::eTransferDstOptimal,
+                                                clearValue,
+                                                range);
+                     })
+            .write(m_renderTargets.draw, image_access::kTransferWrite);
+
+        // Writes the buffers of the culling passes and the draws, which synchronize them themselves
+        m_renderGraph
+            .addPass("Meshlet culling",
+                     [=, this](vk::CommandBuffer cmdBuf)
+                     {
+                         TracyVkZone(tracyCtx, cmdBuf, "Meshlet culling");
+
+                         prepareCulling(cmdBuf);
+                         cullMeshlets(cmdBuf, CullPhase::Early);
+                     })
+            .setSideEffects();
+
+        m_renderGraph
+            .addPass("Geometry render",
+                     [=, this](vk::CommandBuffer cmdBuf)
+                     {
+                         TracyVkZone(tracyCtx, cmdBuf, "Geometry render");
+
+                         drawGeometry(cmdBuf, CullPhase::Early);
+                     })
+            .readWrite(m_renderTargets.draw, image_access::kColorAttachment)
+            .write(m_renderTargets.depth, image_access::kDepthAttachment)
+            .write(m_renderTargets.depthResolve, image_access::kDepthResolve);
+
+        m_renderGraph
+            .addPass("Depth pyramid",
+                     [=, this](vk::CommandBuffer cmdBuf)
+                     {
+                         TracyVkZone(tracyCtx, cmdBuf, "Depth pyramid");
+
+                         buildDepthPyramid(cmdBuf);
+                     })
+            .read(m_renderTargets.depthResolve, image_access::kComputeSampled)
+            .setSideEffects();
+
+        m_renderGraph
+            .addPass("Late meshlet culling",
+                     [=, this](vk::CommandBuffer cmdBuf)
+                     {
+                         TracyVkZone(tracyCtx, cmdBuf, "Late meshlet culling");
+
+                         cullMeshlets(cmdBuf, CullPhase::Late);
+                     })
+            .setSideEffects();
+
+        m_renderGraph
+            .addPass("Late geometry render",
+                     [=, this](vk::CommandBuffer cmdBuf)
+                     {
+                         TracyVkZone(tracyCtx, cmdBuf, "Late geometry render");
+
+                         drawGeometry(cmdBuf, CullPhase::Late);
+                     })
+            .readWrite(m_renderTargets.draw, image_access::kColorAttachment)
+            .readWrite(m_renderTargets.depth, image_access::kDepthAttachment)
+            .write(m_renderTargets.drawResolve, image_access::kColorAttachment);
+
+        if (m_headless)
+        {
+            FrameResources& frame = m_frameResources[m_currentFrame];
 
-                m_drawImageResolve.copyTo(cmdBuf, swapchainImage, imageExtent, m_drawImage.getDimensions());
+            if (!m_headless->outputDirectory.empty())
+            {
+                frame.readbackFrame = m_frameCount;
             }
 
+            vk::Buffer const readbackBuffer = frame.readbackBuffer;
+
+            // Copies out every frame, whether it's written or not. The host reads it once the frame's
+            // timeline value has been reached.
+            m_renderGraph
+                .addPass("Readback",
+                         [=, this](vk::CommandBuffer cmdBuf)
+                         {
+                             TracyVkZone(tracyCtx, cmdBuf, "Readback");
+
+                             vk::Extent2D const extent = m_renderGraph.getExtent(m_renderTargets.drawResolve);
+
+                             cmdBuf.copyImageToBuffer(
+                                 m_renderGraph.getImage(m_renderTargets.drawResolve),
+                                 vk::ImageLayout::eTransferSrcOptimal,
+                                 readbackBuffer,
+                                 vk::BufferImageCopy {
+                                     .imageSubresource = { .aspectMask = vk::ImageAspectFlagBits::eColor,
+                                                           .layerCount = 1 },
+                                     .imageExtent      = { extent.width, extent.height, 1 },
+                                 });
+
+                             auto const barrier = vk::BufferMemoryBarrier2()
+                                                      .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+                                                      .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+                                                      .setDstStageMask(vk::PipelineStageFlagBits2::eHost)
+                                                      .setDstAccessMask(vk::AccessFlagBits2::eHostRead)
+                                                      .setBuffer(readbackBuffer)
+                                                      .setSize(vk::WholeSize);
+
+                             cmdBuf.pipelineBarrier2(vk::DependencyInfo().setBufferMemoryBarriers(barrier));
+                         })
+                .read(m_renderTargets.drawResolve, image_access::kTransferRead)
+                .setSideEffects();
+
+            return;
+        }
+
+        // Acquired for the color attachment output stage, see render
+        ImageAccess const acquired {
+            .stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            .layout = vk::ImageLayout::eUndefined,
+        };
+
+        RenderGraph::ImportedImageInfo const swapchainInfo {
+            .image   = m_swapchain.getImages()[imageIndex],
+            .view    = *m_swapchain.getImageViews()[imageIndex],
+            .extent  = m_swapchain.getImageExtent(),
+            .initial = acquired,
+            .final   = image_access::kPresent,
+        };
+
+        GraphImage const swapchainImage = m_renderGraph.importImage("Swapchain image", swapchainInfo);
+
+        m_renderGraph
+            .addPass("Draw image copy",
+                     [=, this](vk::CommandBuffer cmdBuf)
+                     {
+                         TracyVkZone(tracyCtx, cmdBuf, "Draw image copy");
+
+                         Image::blit(cmdBuf,
+                                     m_renderGraph.getImage(m_renderTargets.drawResolve),
+                                     m_renderGraph.getExtent(m_renderTargets.drawResolve),
+                                     m_renderGraph.getImage(swapchainImage),
+                                     m_renderGraph.getExtent(swapchainImage));
+                     })
+            .read(m_renderTargets.drawResolve, image_access::kTransferRead)
+            .write(swapchainImage, image_access::kTransferWrite);
+
+        m_renderGraph
+            .addPass("ImGui render",
+                     [=, this](vk::CommandBuffer cmdBuf)
+                     {
+                         TracyVkZone(tracyCtx, cmdBuf, "ImGui render");
+
+                         renderImgui(cmdBuf, m_renderGraph.getImageView(swapchainImage));
+                     })
+            .readWrite(swapchainImage, image_access::kColorAttachment);
+    }
+
+    void RendererBackend::recordCommandBuffer(uint32_t imageIndex)
+    {
+#if PROFILED
+        TracyVkCtx tracyCtx = m_frameResources[m_currentFrame].tracyContext;
+#endif
+
+        vk::CommandBuffer cmdBuf = m_commandManager.getGraphicsCmdBuffer(m_currentFrame);
+
+        auto beginInfo =
+            vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+        cmdBuf.begin(beginInfo) >> ResultChecker();
+
+        {
+            TracyVkZone(tracyCtx, cmdBuf, "Command buffer recording");
+
             {
-                TracyVkZone(tracyCtx, cmdBuf, "ImGui render");
+                TracyVkZone(tracyCtx, cmdBuf, "Upload acquires");
 
-                renderImgui(cmdBuf, *m_swapchain.getImageViews()[imageIndex]);
+                m_uploadManager.recordAcquires(cmdBuf);
             }
 
-            Image::transition(cmdBuf,
-                              swapchainImage,
-                              vk::ImageLayout::eTransferDstOptimal,
-                              vk::ImageLayout::ePresentSrcKHR);
+            buildRenderGraph(imageIndex);
+
+            // Render targets realized anew come with new views, the depth pyramid samples the depth resolve's
+            if (m_renderGraph.compile(m_deletionQueue))
+            {
+                m_depthPyramid.resize(m_renderGraph.getImageView(m_renderTargets.depthResolve),
+                                      m_renderGraph.getExtent(m_renderTargets.depthResolve),
+                                      m_deletionQueue);
+            }
+
+            m_renderGraph.execute(cmdBuf);
         }
 
         TracyVkCollect(tracyCtx, cmdBuf);
@@ -265,7 +1110,7 @@ namespace renderer::backend
 
         auto colorAttachment = vk::RenderingAttachmentInfo()
                                    .setImageView(targetImage)
-                                   .setImageLayout(vk::ImageLayout::eGeneral)
+                                   .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
                                    .setLoadOp(vk::AttachmentLoadOp::eLoad)
                                    .setStoreOp(vk::AttachmentStoreOp::eStore);
 
@@ -298,8 +1143,45 @@ namespace renderer::backend
                                "Vsync: %s",
                                m_surface.getVsync() ? "on" : "off");
 
-            ImGui::Text("Triangles %i", m_stats.triangle_count);
-            ImGui::Text("Draws %i", m_stats.drawcall_count);
+            ImGui::Text("Frames in flight %u", m_framesInFlight);
+            ImGui::Text("Triangles %" PRIu64, m_stats.triangle_count);
+            ImGui::Text("Draws %" PRIu64, m_stats.drawcall_count);
+            ImGui::Text("Primitives %" PRIu64 " visible, %" PRIu64 " culled",
+                        m_stats.visible_count,
+                        m_stats.culled_count);
+            ImGui::Text("Meshlets %" PRIu64 " occluded", m_stats.occluded_count);
+            ImGui::Text("Depth pyramid %.3f ms", m_stats.pyramid_build_ms);
+            ImGui::Text("Geometry recording %.3f ms, %u chunks",
+                        m_stats.geometry_record_ms,
+                        m_stats.geometry_chunk_count);
+            ImGui::Text("Uniform ring %.2f / %.2f KiB",
+                        static_cast<double>(m_uniformRing.getFrameUsage()) / 1024.0,
+                        static_cast<double>(m_uniformRing.getFrameCapacity()) / 1024.0);
+            ImGui::Text("Render graph %u passes, %u culled",
+                        m_renderGraph.getPassCount(),
+                        m_renderGraph.getCulledPassCount());
+            ImGui::Text("Render targets %.2f MiB, %.2f MiB saved by aliasing",
+                        static_cast<double>(m_renderGraph.getAllocatedSize()) / (1024.0 * 1024.0),
+                        static_cast<double>(m_renderGraph.getTransientSize() -
+                                            m_renderGraph.getAllocatedSize()) /
+                            (1024.0 * 1024.0));
+
+            // Compare with the uber-shader through toggleUberMaterialShader
+            ImGui::Text("Material shader: %s", m_uberMaterialShader ? "uber" : "specialized");
+
+            for (auto [rangeIndex, range] : vi::enumerate(m_sceneResources.commandRanges))
+            {
+                if (!m_stats.range_ms_valid)
+                {
+                    break;
+                }
+
+                ImGui::Text("  %s features %#x, %s indices %.3f ms",
+                            range.pass == DrawPass::Blended ? "blended" : "opaque",
+                            range.materialFeatures,
+                            range.indexType == vk::IndexType::eUint32 ? "32-bit" : "16-bit",
+                            m_stats.range_ms[rangeIndex]);
+            }
 
             ImGui::End();
         }
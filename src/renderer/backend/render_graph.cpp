@@ -0,0 +1,541 @@
+#include <mc/asserts.hpp>
+#include <mc/logger.hpp>
+#include <mc/renderer/backend/render_graph.hpp>
+#include <mc/renderer/backend/vk_checker.hpp>
+
+#include <algorithm>
+#include <format>
+#include <iterator>
+#include <numeric>
+#include <ranges>
+#include <utility>
+
+#include <tracy/Tracy.hpp>
+
+namespace rn = std::ranges;
+namespace vi = std::ranges::views;
+
+namespace
+{
+    constexpr vk::AccessFlags2 kWriteAccess =
+        vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+        vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderWrite |
+        vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eMemoryWrite;
+
+    constexpr uint32_t kUnused = ~0u;
+
+    auto toMiB(vk::DeviceSize size) -> double
+    {
+        return static_cast<double>(size) / (1024.0 * 1024.0);
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    auto RenderGraph::PassBuilder::read(GraphImage image, ImageAccess const& access) -> PassBuilder&
+    {
+        return use(image, access, true, false);
+    }
+
+    auto RenderGraph::PassBuilder::write(GraphImage image, ImageAccess const& access) -> PassBuilder&
+    {
+        return use(image, access, false, true);
+    }
+
+    auto RenderGraph::PassBuilder::readWrite(GraphImage image, ImageAccess const& access) -> PassBuilder&
+    {
+        return use(image, access, true, true);
+    }
+
+    auto RenderGraph::PassBuilder::setSideEffects() -> PassBuilder&
+    {
+        m_graph->m_passes[m_pass].sideEffects = true;
+
+        return *this;
+    }
+
+    auto RenderGraph::PassBuilder::use(GraphImage image, ImageAccess const& access, bool read, bool write)
+        -> PassBuilder&
+    {
+        MC_ASSERT(image.index < m_graph->m_images.size());
+
+        Pass& pass = m_graph->m_passes[m_pass];
+
+        auto it = rn::find(pass.uses, image.index, &Use::image);
+
+        if (it == pass.uses.end())
+        {
+            pass.uses.push_back({ .image = image.index, .access = access, .read = read, .write = write });
+
+            return *this;
+        }
+
+        // Both uses become one, a single barrier covers them
+        MC_ASSERT_MSG(it->access.layout == access.layout,
+                      "{} uses {} in two layouts",
+                      pass.name,
+                      m_graph->m_images[image.index].name);
+
+        it->access.stages |= access.stages;
+        it->access.access |= access.access;
+        it->access.usage |= access.usage;
+        it->read  = it->read || read;
+        it->write = it->write || write;
+
+        return *this;
+    }
+
+    RenderGraph::RenderGraph(Device const& device, Allocator const& allocator)
+        : m_device { &device }, m_allocator { &allocator }
+    {
+    }
+
+    void RenderGraph::reset()
+    {
+        m_passes.clear();
+        m_images.clear();
+        m_finalBarriers.clear();
+    }
+
+    auto RenderGraph::createImage(std::string name, TransientImageInfo const& info) -> GraphImage
+    {
+        m_images.push_back({
+            .name      = std::move(name),
+            .extent    = info.extent,
+            .aspect    = info.aspect,
+            .transient = true,
+            .format    = info.format,
+            .samples   = info.samples,
+        });
+
+        return { static_cast<uint32_t>(m_images.size() - 1) };
+    }
+
+    auto RenderGraph::importImage(std::string name, ImportedImageInfo const& info) -> GraphImage
+    {
+        m_images.push_back({
+            .name    = std::move(name),
+            .extent  = info.extent,
+            .aspect  = info.aspect,
+            .image   = info.image,
+            .view    = info.view,
+            .initial = info.initial,
+            .final   = info.final,
+        });
+
+        return { static_cast<uint32_t>(m_images.size() - 1) };
+    }
+
+    auto RenderGraph::addPass(std::string name, std::function<void(vk::CommandBuffer)> execute) -> PassBuilder
+    {
+        m_passes.push_back({ .name = std::move(name), .execute = std::move(execute) });
+
+        return { *this, static_cast<uint32_t>(m_passes.size() - 1) };
+    }
+
+    auto RenderGraph::compile(DeletionQueue& deletionQueue) -> bool
+    {
+        ZoneScopedN("Compile render graph");
+
+        cullPasses();
+
+        for (uint32_t passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+        {
+            if (m_passes[passIndex].culled)
+            {
+                continue;
+            }
+
+            for (Use const& use : m_passes[passIndex].uses)
+            {
+                ImageNode& image = m_images[use.image];
+
+                image.firstPass = std::min(image.firstPass, passIndex);
+                image.lastPass  = std::max(image.lastPass, passIndex);
+                image.usage |= use.access.usage;
+            }
+        }
+
+        bool const realized = realize(deletionQueue);
+
+        buildBarriers();
+
+        return realized;
+    }
+
+    void RenderGraph::execute(vk::CommandBuffer commandBuffer) const
+    {
+        for (Pass const& pass : m_passes)
+        {
+            if (pass.culled)
+            {
+                continue;
+            }
+
+            if (!pass.barriers.empty())
+            {
+                commandBuffer.pipelineBarrier2(vk::DependencyInfo().setImageMemoryBarriers(pass.barriers));
+            }
+
+            pass.execute(commandBuffer);
+        }
+
+        if (!m_finalBarriers.empty())
+        {
+            commandBuffer.pipelineBarrier2(vk::DependencyInfo().setImageMemoryBarriers(m_finalBarriers));
+        }
+    }
+
+    auto RenderGraph::getImage(GraphImage image) const -> vk::Image
+    {
+        ImageNode const& node = m_images[image.index];
+
+        if (!node.transient)
+        {
+            return node.image;
+        }
+
+        MC_ASSERT_MSG(node.physical != kUnused, "{} isn't used by any pass", node.name);
+
+        return *m_realization.images[node.physical];
+    }
+
+    auto RenderGraph::getImageView(GraphImage image) const -> vk::ImageView
+    {
+        ImageNode const& node = m_images[image.index];
+
+        if (!node.transient)
+        {
+            return node.view;
+        }
+
+        MC_ASSERT_MSG(node.physical != kUnused, "{} isn't used by any pass", node.name);
+
+        return *m_realization.views[node.physical];
+    }
+
+    void RenderGraph::cullPasses()
+    {
+        // Images whose contents are still going to be read, from the end of the graph backwards
+        std::vector<bool> needed(m_images.size());
+
+        for (uint32_t index = 0; index < m_images.size(); ++index)
+        {
+            needed[index] = m_images[index].final.has_value();
+        }
+
+        m_culledPassCount = 0;
+
+        for (Pass& pass : m_passes | vi::reverse)
+        {
+            auto writesNeeded = [&](Use const& use) { return use.write && needed[use.image]; };
+
+            pass.culled = !pass.sideEffects && rn::none_of(pass.uses, writesNeeded);
+
+            if (pass.culled)
+            {
+                ++m_culledPassCount;
+
+                continue;
+            }
+
+            // Earlier contents of what the pass replaces are never seen
+            for (Use const& use : pass.uses)
+            {
+                needed[use.image] = use.read || (needed[use.image] && !use.write);
+            }
+        }
+    }
+
+    auto RenderGraph::realize(DeletionQueue& deletionQueue) -> bool
+    {
+        std::vector<PhysicalImageKey> keys;
+
+        for (ImageNode& image : m_images)
+        {
+            if (!image.transient || image.firstPass == kUnused)
+            {
+                continue;
+            }
+
+            image.physical = static_cast<uint32_t>(keys.size());
+
+            keys.push_back({
+                .extent    = image.extent,
+                .format    = image.format,
+                .samples   = image.samples,
+                .usage     = image.usage,
+                .aspect    = image.aspect,
+                .firstPass = image.firstPass,
+                .lastPass  = image.lastPass,
+            });
+        }
+
+        if (keys == m_physicalKeys)
+        {
+            return false;
+        }
+
+        ZoneScopedN("Realize render graph");
+
+        // Frames in flight may still render into the previous images
+        deletionQueue.retire(std::exchange(m_realization, {}));
+
+        m_physicalKeys = std::move(keys);
+
+        std::vector<vk::MemoryRequirements> requirements;
+
+        for (PhysicalImageKey const& key : m_physicalKeys)
+        {
+            vk::ImageCreateInfo const imageInfo {
+                .imageType     = vk::ImageType::e2D,
+                .format        = key.format,
+                .extent        = { key.extent.width, key.extent.height, 1 },
+                .mipLevels     = 1,
+                .arrayLayers   = 1,
+                .samples       = key.samples,
+                .tiling        = vk::ImageTiling::eOptimal,
+                .usage         = key.usage,
+                .sharingMode   = vk::SharingMode::eExclusive,
+                .initialLayout = vk::ImageLayout::eUndefined,
+            };
+
+            m_realization.images.push_back((*m_device)->createImage(imageInfo) >> ResultChecker());
+
+            requirements.push_back(m_realization.images.back().getMemoryRequirements());
+        }
+
+        struct Block
+        {
+            VkMemoryRequirements requirements;
+            std::vector<uint32_t> images;
+        };
+
+        std::vector<Block> blocks;
+
+        // Largest first, smaller images then fit into the memory of larger ones
+        std::vector<uint32_t> order(m_physicalKeys.size());
+        std::iota(order.begin(), order.end(), 0u);
+        rn::stable_sort(order, rn::greater {}, [&](uint32_t index) { return requirements[index].size; });
+
+        m_realization.imageBlocks.resize(m_physicalKeys.size());
+
+        for (uint32_t index : order)
+        {
+            PhysicalImageKey const& key        = m_physicalKeys[index];
+            vk::MemoryRequirements const& reqs = requirements[index];
+
+            auto overlaps = [&](uint32_t other)
+            {
+                return key.firstPass <= m_physicalKeys[other].lastPass &&
+                       m_physicalKeys[other].firstPass <= key.lastPass;
+            };
+
+            auto fits = [&](Block const& block)
+            {
+                return (block.requirements.memoryTypeBits & reqs.memoryTypeBits) != 0 &&
+                       rn::none_of(block.images, overlaps);
+            };
+
+            auto it = rn::find_if(blocks, fits);
+
+            if (it == blocks.end())
+            {
+                blocks.push_back({ .requirements = reqs });
+                it = std::prev(blocks.end());
+            }
+            else
+            {
+                it->requirements.size      = std::max(it->requirements.size, reqs.size);
+                it->requirements.alignment = std::max(it->requirements.alignment, reqs.alignment);
+                it->requirements.memoryTypeBits &= reqs.memoryTypeBits;
+            }
+
+            it->images.push_back(index);
+            m_realization.imageBlocks[index] = static_cast<uint32_t>(it - blocks.begin());
+        }
+
+        VmaAllocationCreateInfo const allocInfo {
+            .usage         = VMA_MEMORY_USAGE_GPU_ONLY,
+            .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        };
+
+        for (Block const& block : blocks)
+        {
+            VmaAllocation allocation { nullptr };
+
+            vk::Result(vmaAllocateMemory(
+                *m_allocator, &block.requirements, &allocInfo, &allocation, nullptr)) >>
+                ResultChecker();
+
+            m_realization.blocks.emplace_back(allocation, MemoryDeleter { *m_allocator });
+
+            // Every image in the block starts at its beginning
+            for (uint32_t index : block.images)
+            {
+                vk::Result(vmaBindImageMemory(
+                    *m_allocator, allocation, static_cast<VkImage>(*m_realization.images[index]))) >>
+                    ResultChecker();
+            }
+        }
+
+        for (auto [index, key] : vi::enumerate(m_physicalKeys))
+        {
+            m_realization.views.push_back((*m_device)->createImageView({
+                                              .image            = *m_realization.images[index],
+                                              .viewType         = vk::ImageViewType::e2D,
+                                              .format           = key.format,
+                                              .subresourceRange = {
+                                                  .aspectMask     = key.aspect,
+                                                  .baseMipLevel   = 0,
+                                                  .levelCount     = 1,
+                                                  .baseArrayLayer = 0,
+                                                  .layerCount     = 1,
+                                              },
+                                          }) >>
+                                          ResultChecker());
+        }
+
+        // Fresh memory, nothing to wait for
+        m_blockStates.assign(blocks.size(), {});
+
+        m_transientSize = std::accumulate(
+            requirements.begin(),
+            requirements.end(),
+            vk::DeviceSize { 0 },
+            [](vk::DeviceSize sum, vk::MemoryRequirements const& reqs) { return sum + reqs.size; });
+
+        m_allocatedSize = std::accumulate(blocks.begin(),
+                                          blocks.end(),
+                                          vk::DeviceSize { 0 },
+                                          [](vk::DeviceSize sum, Block const& block)
+                                          { return sum + block.requirements.size; });
+
+        logger::info("Render graph realized {} images in {} memory blocks, {:.2f} MiB ({:.2f} MiB saved by "
+                     "aliasing)",
+                     m_physicalKeys.size(),
+                     blocks.size(),
+                     toMiB(m_allocatedSize),
+                     toMiB(m_transientSize - m_allocatedSize));
+
+        return true;
+    }
+
+    void RenderGraph::buildBarriers()
+    {
+        std::vector<ImageState> states(m_images.size());
+
+        for (auto [index, image] : vi::enumerate(m_images))
+        {
+            if (!image.transient)
+            {
+                states[index] = {
+                    .layout      = image.initial.layout,
+                    .writeStages = image.initial.stages,
+                    .writeAccess = image.initial.access & kWriteAccess,
+                };
+            }
+        }
+
+        for (uint32_t passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+        {
+            Pass& pass = m_passes[passIndex];
+
+            pass.barriers.clear();
+
+            if (pass.culled)
+            {
+                continue;
+            }
+
+            for (Use const& use : pass.uses)
+            {
+                ImageNode const& image = m_images[use.image];
+                ImageState& state      = states[use.image];
+
+                vk::Image const handle = getImage({ use.image });
+
+                uint32_t const block =
+                    image.transient ? m_realization.imageBlocks[image.physical] : kUnused;
+
+                // The memory's previous occupant, an earlier alias or the last one of the previous graph
+                if (image.transient && passIndex == image.firstPass)
+                {
+                    MC_ASSERT_MSG(use.write, "{} reads {} before anything writes it", pass.name, image.name);
+
+                    state        = m_blockStates[block];
+                    state.layout = vk::ImageLayout::eUndefined;
+                }
+
+                ImageAccess const& access = use.access;
+
+                if (use.write || state.layout != access.layout)
+                {
+                    pass.barriers.push_back(makeBarrier(state, access, handle, image.aspect));
+
+                    // A read-only layout transition is ordered before the pass, later readers only need to
+                    // wait for it
+                    state = {
+                        .layout        = access.layout,
+                        .writeStages   = access.stages,
+                        .writeAccess   = access.access & kWriteAccess,
+                        .readStages    = use.write ? vk::PipelineStageFlags2 {} : access.stages,
+                        .visibleStages = use.write ? vk::PipelineStageFlags2 {} : access.stages,
+                        .visibleAccess = use.write ? vk::AccessFlags2 {} : access.access,
+                    };
+                }
+                else if (state.writeStages && ((access.stages & ~state.visibleStages) ||
+                                               (access.access & ~state.visibleAccess)))
+                {
+                    pass.barriers.push_back(makeBarrier(state, access, handle, image.aspect));
+
+                    state.readStages |= access.stages;
+                    state.visibleStages |= access.stages;
+                    state.visibleAccess |= access.access;
+                }
+                else
+                {
+                    state.readStages |= access.stages;
+                }
+
+                if (image.transient)
+                {
+                    m_blockStates[block] = state;
+                }
+            }
+        }
+
+        for (auto [index, image] : vi::enumerate(m_images))
+        {
+            ImageState const& state = states[index];
+
+            if (image.final && (state.layout != image.final->layout || state.writeAccess))
+            {
+                m_finalBarriers.push_back(makeBarrier(state, *image.final, image.image, image.aspect));
+            }
+        }
+    }
+
+    auto RenderGraph::makeBarrier(ImageState const& state,
+                                  ImageAccess const& access,
+                                  vk::Image image,
+                                  vk::ImageAspectFlags aspect) -> vk::ImageMemoryBarrier2
+    {
+        return {
+            .srcStageMask     = state.writeStages | state.readStages,
+            .srcAccessMask    = state.writeAccess,
+            .dstStageMask     = access.stages,
+            .dstAccessMask    = access.access,
+            .oldLayout        = state.layout,
+            .newLayout        = access.layout,
+            .image            = image,
+            .subresourceRange = {
+                .aspectMask     = aspect,
+                .baseMipLevel   = 0,
+                .levelCount     = vk::RemainingMipLevels,
+                .baseArrayLayer = 0,
+                .layerCount     = vk::RemainingArrayLayers,
+            },
+        };
+    }
+}  // namespace renderer::backend
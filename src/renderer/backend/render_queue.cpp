@@ -0,0 +1,116 @@
+#include <mc/asserts.hpp>
+#include <mc/renderer/backend/render_queue.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <utility>
+
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+    constexpr uint64_t kDepthMask = (uint64_t { 1 } << renderer::backend::DrawKey::kDepthBits) - 1;
+
+    constexpr uint32_t kRadixBits    = 8;
+    constexpr uint32_t kRadixBuckets = 1 << kRadixBits;
+    constexpr uint32_t kRadixPasses  = 64 / kRadixBits;
+
+    auto getDigit(uint64_t key, uint32_t pass) -> uint32_t
+    {
+        return static_cast<uint32_t>(key >> (pass * kRadixBits)) & (kRadixBuckets - 1);
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    auto DrawKey::make(DrawPass pass, uint32_t pipeline, uint32_t material, float distance) -> uint64_t
+    {
+        static_assert(2 + kPipelineBits + kMaterialBits + kDepthBits <= 64);
+
+        MC_ASSERT(pipeline < (1u << kPipelineBits));
+        MC_ASSERT(material < (1u << kMaterialBits));
+
+        uint64_t const depth =
+            (std::bit_cast<uint32_t>(std::max(distance, 0.f)) >> (32 - kDepthBits)) & kDepthMask;
+
+        uint64_t const passBits = uint64_t { std::to_underlying(pass) } << 62;
+
+        if (pass == DrawPass::Blended)
+        {
+            return passBits | ((~depth & kDepthMask) << (kPipelineBits + kMaterialBits)) |
+                   (uint64_t { pipeline } << kMaterialBits) | material;
+        }
+
+        return passBits | (uint64_t { pipeline } << (kMaterialBits + kDepthBits)) |
+               (uint64_t { material } << kDepthBits) | depth;
+    }
+
+    void RenderQueue::clear()
+    {
+        m_entries.clear();
+    }
+
+    void RenderQueue::sort()
+    {
+        ZoneScopedN("Render queue sort");
+
+        m_scratch.resize(m_entries.size());
+
+        radixSort(m_entries, m_scratch);
+    }
+
+    void radixSort(std::span<RenderQueueEntry> entries, std::span<RenderQueueEntry> scratch)
+    {
+        MC_ASSERT(scratch.size() >= entries.size());
+
+        if (entries.size() < 2)
+        {
+            return;
+        }
+
+        // Every pass' histogram comes out of a single read of the keys
+        std::array<std::array<uint32_t, kRadixBuckets>, kRadixPasses> histograms {};
+
+        for (RenderQueueEntry const& entry : entries)
+        {
+            for (uint32_t pass = 0; pass < kRadixPasses; ++pass)
+            {
+                ++histograms[pass][getDigit(entry.key, pass)];
+            }
+        }
+
+        std::span<RenderQueueEntry> source      = entries;
+        std::span<RenderQueueEntry> destination = scratch.first(entries.size());
+
+        for (uint32_t pass = 0; pass < kRadixPasses; ++pass)
+        {
+            std::array<uint32_t, kRadixBuckets>& histogram = histograms[pass];
+
+            // Keys agreeing on this digit would be copied over unchanged
+            if (histogram[getDigit(source.front().key, pass)] == source.size())
+            {
+                continue;
+            }
+
+            uint32_t offset = 0;
+
+            for (uint32_t& count : histogram)
+            {
+                offset += std::exchange(count, offset);
+            }
+
+            for (RenderQueueEntry const& entry : source)
+            {
+                destination[histogram[getDigit(entry.key, pass)]++] = entry;
+            }
+
+            std::swap(source, destination);
+        }
+
+        if (source.data() != entries.data())
+        {
+            std::ranges::copy(source, entries.begin());
+        }
+    }
+}  // namespace renderer::backend
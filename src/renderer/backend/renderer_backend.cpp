@@ -15,8 +15,11 @@
 #include <mc/timer.hpp>
 #include <mc/utils.hpp>
 
+#include <algorithm>
 #include <filesystem>
+#include <optional>
 #include <print>
+#include <utility>
 
 #include <glm/ext.hpp>
 #include <imgui_impl_glfw.h>
@@ -40,48 +43,41 @@ namespace
 
 namespace renderer::backend
 {
-    RendererBackend::RendererBackend(window::Window& window)
+    RendererBackend::RendererBackend(window::Window& window) : RendererBackend(&window, std::nullopt) {}
+
+    RendererBackend::RendererBackend(HeadlessSettings const& settings) : RendererBackend(nullptr, settings) {}
+
+    RendererBackend::RendererBackend(window::Window* window, std::optional<HeadlessSettings> headless)
         // clang_format off
-        : m_surface { window, m_instance },
+        : m_headless { std::move(headless) },
+
+          m_instance { window != nullptr },
 
-          m_device { m_instance, m_surface },
+          m_surface { window ? Surface(*window, m_instance) : Surface() },
 
-          m_swapchain { m_device, m_surface },
+          m_device { m_instance, window ? &m_surface : nullptr },
+
+          m_swapchain { window ? Swapchain(m_device, m_surface) : Swapchain() },
 
           m_allocator { m_instance, m_device },
 
           m_commandManager { m_device },
 
-          m_drawImage { m_device,
-                        m_allocator,
-                        m_surface.getFramebufferExtent(),
-                        vk::Format::eR16G16B16A16Sfloat,
-                        m_device.getMaxUsableSampleCount(),
-                        vk::ImageUsageFlagBits::eTransferSrc |
-                            vk::ImageUsageFlagBits::eTransferDst |  // maybe remove?
-                            vk::ImageUsageFlagBits::eColorAttachment,
-                        vk::ImageAspectFlagBits::eColor },
-
-          m_drawImageResolve { m_device,
-                               m_allocator,
-                               m_drawImage.getDimensions(),
-                               m_drawImage.getFormat(),
-                               vk::SampleCountFlagBits::e1,
-                               vk::ImageUsageFlagBits::eColorAttachment |
-                                   vk::ImageUsageFlagBits::eTransferSrc |
-                                   vk::ImageUsageFlagBits::eTransferDst,
-                               vk::ImageAspectFlagBits::eColor },
-
-          m_depthImage { m_device,
-                         m_allocator,
-                         m_drawImage.getDimensions(),
-                         kDepthStencilFormat,
-                         m_device.getMaxUsableSampleCount(),
-                         vk::ImageUsageFlagBits::eDepthStencilAttachment,
-                         vk::ImageAspectFlagBits::eDepth }
+          m_uploadManager { m_device, m_allocator },
+
+          m_renderGraph { m_device, m_allocator },
+
+          m_textureLoader { m_device, m_allocator, m_uploadManager, m_threadPool }
     // clang_format on
     {
-        initImgui(window.getHandle());
+        // The main thread records a chunk as well
+        m_commandManager.createRecordingPools(m_device,
+                                              static_cast<uint32_t>(m_recordingThreads.getThreadCount()) + 1);
+
+        if (window)
+        {
+            initImgui(window->getHandle());
+        }
 
         // Create dummy samplers
 
@@ -97,7 +93,7 @@ namespace renderer::backend
                              .maxAnisotropy    = m_device.getDeviceProperties().limits.maxSamplerAnisotropy,
                              .compareEnable    = false,
                              .minLod           = 0.0f,
-                             .maxLod           = 1,
+                             .maxLod           = vk::LodClampNone,
                              .borderColor      = vk::BorderColor::eIntOpaqueBlack,
                              .unnormalizedCoordinates = false,
                          }) >>
@@ -106,23 +102,13 @@ namespace renderer::backend
         {
             uint32_t zero = 0;
 
-            m_dummyTexture = Texture(
-                m_device, m_allocator, m_commandManager, vk::Extent2D { 1, 1 }, &zero, sizeof(uint32_t));
-        }
+            // Only bound to materials, which aren't drawn before the scene's later upload is ready
+            m_dummyTexture = Texture(m_device, m_allocator, vk::Extent2D { 1, 1 });
 
-        m_gpuSceneDataBuffer = GPUBuffer(m_allocator,
-                                         sizeof(GPUSceneData),
-                                         vk::BufferUsageFlagBits::eUniformBuffer,
-                                         VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
-                                         VMA_ALLOCATION_CREATE_MAPPED_BIT |
-                                             VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+            m_uploadManager.uploadTexture(m_dummyTexture, std::as_bytes(std::span(&zero, 1)));
+        }
 
-        m_lightDataBuffer = GPUBuffer(m_allocator,
-                                      sizeof(Light),
-                                      vk::BufferUsageFlagBits::eUniformBuffer,
-                                      VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
-                                      VMA_ALLOCATION_CREATE_MAPPED_BIT |
-                                          VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+        m_uniformRing = UniformRing(m_device, m_allocator, kUniformRingFrameCapacity);
 
         initDescriptors();
 
@@ -133,28 +119,112 @@ namespace renderer::backend
 
         m_texturelessPipelineLayout = PipelineLayout(m_device, pipelineLayoutConfig);
 
-        pipelineLayoutConfig.setDescriptorSetLayouts(
-            { m_sceneDataDescriptorLayout, m_materialDescriptorLayout });
+        // fs.frag reads the material through the push constants' buffer address
+        pipelineLayoutConfig
+            .setDescriptorSetLayouts({ m_sceneDataDescriptorLayout, m_bindlessTextures.getLayout() })
+            .setPushConstantSettings(sizeof(GPUDrawPushConstants),
+                                     vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
 
         m_texturedPipelineLayout = PipelineLayout(m_device, pipelineLayoutConfig);
 
+        // Compared across runs, a warm pipeline cache skips the driver's shader compilation
+        auto const pipelineStartTime = Timer::Clock::now();
+
+        m_materialPipelineConfig =
+            GraphicsPipelineConfig()
+                .addShader("fs.frag", vk::ShaderStageFlagBits::eFragment, "main")
+                .addShader("vs.vert", vk::ShaderStageFlagBits::eVertex, "main")
+                .setColorAttachmentFormat(kDrawImageFormat)
+                .setDepthAttachmentFormat(kDepthStencilFormat)
+                .setDepthStencilSettings(true, vk::CompareOp::eGreaterOrEqual)
+                // .setCullingSettings(vk::CullModeFlagBits::eBack, vk::FrontFace::eCounterClockwise)
+                // .setPolygonMode(vk::PolygonMode::eLine)
+                .setSampleCount(m_device.getMaxUsableSampleCount())
+                .setSampleShadingSettings(true, 0.1f);
+
+        // The uber-shader of either vertex format and pass, the specialized permutations follow the scene's
+        // materials
+        for (VertexFormat format : { VertexFormat::Float, VertexFormat::Quantized })
+        {
+            for (DrawPass pass : { DrawPass::Opaque, DrawPass::Blended })
+            {
+                getMaterialPipeline(format, kUberMaterialFeatures, pass);
+            }
+        }
+
+        m_depthPyramid = DepthPyramid(m_device, m_allocator);
+
+        // The late phase samples the depth pyramid
+        m_meshletCullPipelineLayout = PipelineLayout(
+            m_device,
+            PipelineLayoutConfig()
+                .setDescriptorSetLayouts({ m_depthPyramid.getSamplingLayout() })
+                .setPushConstantSettings(sizeof(MeshletCullPushConstants),
+                                         vk::ShaderStageFlagBits::eCompute));
+
+        m_meshletCullPipeline =
+            ComputePipeline(m_device, m_meshletCullPipelineLayout, "meshlet_cull.comp", "main");
+
+        logger::info("Created pipelines in {:.2f} ms ({} pipeline cache)",
+                     Timer::Milliseconds(Timer::Clock::now() - pipelineStartTime).count(),
+                     m_device.getPipelineCache().isWarm() ? "warm" : "cold");
+
+        watchPipeline(m_meshletCullPipeline);
+        watchPipeline(m_depthPyramid.getReducePipeline());
+
+        m_shaderWatcher = utils::FileWatcher(m_device.getShaderManager().getSourceDirectory());
+
+        for (FrameResources& frame : m_frameResources)
         {
-            auto pipelineConfig =
-                GraphicsPipelineConfig()
-                    .addShader("shaders/fs.frag.spv", vk::ShaderStageFlagBits::eFragment, "main")
-                    .addShader("shaders/vs.vert.spv", vk::ShaderStageFlagBits::eVertex, "main")
-                    .setColorAttachmentFormat(m_drawImage.getFormat())
-                    .setDepthAttachmentFormat(kDepthStencilFormat)
-                    .setDepthStencilSettings(true, vk::CompareOp::eGreaterOrEqual)
-                    // .setCullingSettings(vk::CullModeFlagBits::eBack, vk::FrontFace::eCounterClockwise)
-                    // .setPolygonMode(vk::PolygonMode::eLine)
-                    .setSampleCount(m_device.getMaxUsableSampleCount())
-                    .setSampleShadingSettings(true, 0.1f);
-
-            m_texturedPipeline = GraphicsPipeline(m_device, m_texturedPipelineLayout, pipelineConfig);
+            frame.drawCountBuffer = GPUBuffer(m_allocator,
+                                              sizeof(GPUDrawCounts),
+                                              vk::BufferUsageFlagBits::eIndirectBuffer |
+                                                  vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                                              VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                                              VMA_ALLOCATION_CREATE_MAPPED_BIT |
+                                                  VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+
+            *static_cast<GPUDrawCounts*>(frame.drawCountBuffer.getMappedData()) = {};
+            frame.drawCountBuffer.flush();
+
+            frame.timestampQueryPool = m_device->createQueryPool({
+                                           .queryType  = vk::QueryType::eTimestamp,
+                                           .queryCount = kTimestampQueryCount,
+                                       }) >>
+                                       ResultChecker();
+
+            // RGBA half floats like the draw image
+            if (m_headless)
+            {
+                frame.readbackBuffer = GPUBuffer(m_allocator,
+                                                 size_t { m_headless->extent.width } *
+                                                     m_headless->extent.height * 4 * sizeof(uint16_t),
+                                                 vk::BufferUsageFlagBits::eTransferDst,
+                                                 VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                                                 VMA_ALLOCATION_CREATE_MAPPED_BIT |
+                                                     VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+            }
+        }
+
+        if (m_headless && !m_headless->outputDirectory.empty())
+        {
+            std::error_code error;
+
+            std::filesystem::create_directories(m_headless->outputDirectory, error);
+
+            if (error)
+            {
+                logger::error("Failed to create frame output directory '{}': {}",
+                              m_headless->outputDirectory.string(),
+                              error.message());
+            }
         }
 
-        // processGltf();
+        if (vk::PhysicalDeviceLimits const limits = m_device.getDeviceProperties().limits;
+            limits.timestampComputeAndGraphics)
+        {
+            m_timestampPeriod = limits.timestampPeriod;
+        }
 
         m_light = {
             .position    = { 1.5f,                  2.f,               0.f              },
@@ -165,7 +235,7 @@ namespace renderer::backend
 #if PROFILED
         for (size_t i : vi::iota(0u, utils::size(m_frameResources)))
         {
-            std::string ctxName = fmt::format("Frame {}/{}", i + 1, kNumFramesInFlight);
+            std::string ctxName = fmt::format("Frame {}/{}", i + 1, kMaxFramesInFlight);
 
             auto& ctx = m_frameResources[i].tracyContext;
 
@@ -193,11 +263,16 @@ namespace renderer::backend
             return;
         }
 
-        m_device->waitIdle();
+        finishFrames();
+
+        m_device.getPipelineCache().save();
 
-        ImGui_ImplVulkan_Shutdown();
-        ImGui_ImplGlfw_Shutdown();
-        ImGui::DestroyContext();
+        if (!m_headless)
+        {
+            ImGui_ImplVulkan_Shutdown();
+            ImGui_ImplGlfw_Shutdown();
+            ImGui::DestroyContext();
+        }
 
 #if PROFILED
         for (auto& resource : m_frameResources)
@@ -213,6 +288,7 @@ namespace renderer::backend
             std::vector<DescriptorAllocator::PoolSizeRatio> sizes = {
                 { vk::DescriptorType::eStorageBuffer,        4 },
                 { vk::DescriptorType::eUniformBuffer,        4 },
+                { vk::DescriptorType::eUniformBufferDynamic, 4 },
                 { vk::DescriptorType::eCombinedImageSampler, 4 },
             };
 
@@ -222,33 +298,31 @@ namespace renderer::backend
         {
             m_sceneDataDescriptorLayout =
                 DescriptorLayoutBuilder()
-                    // The scene data buffer
-                    .addBinding(0, vk::DescriptorType::eUniformBuffer)
-                    // The light data buffer
-                    .addBinding(1, vk::DescriptorType::eUniformBuffer)
+                    // The scene data, at the frame's offset into the uniform ring
+                    .addBinding(0, vk::DescriptorType::eUniformBufferDynamic)
+                    // The light data, likewise
+                    .addBinding(1, vk::DescriptorType::eUniformBufferDynamic)
                     .build(m_device, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
         }
 
         {
-            m_materialDescriptorLayout =
-                DescriptorLayoutBuilder()
-                    .addBinding(0, vk::DescriptorType::eCombinedImageSampler)  // diffuse
-                    .addBinding(1, vk::DescriptorType::eCombinedImageSampler)  // roughness
-                    .addBinding(2, vk::DescriptorType::eCombinedImageSampler)  // occlusion
-                    .addBinding(3, vk::DescriptorType::eCombinedImageSampler)  // emissive
-                    .addBinding(4, vk::DescriptorType::eCombinedImageSampler)  // normal
-                    .build(m_device, vk::ShaderStageFlagBits::eFragment);
+            m_bindlessTextures = BindlessTextures(m_device);
+
+            // Materials without some texture sample this one instead
+            m_dummyTextureSlot = m_bindlessTextures.add(m_dummyTexture.getImageView(), m_dummySampler);
         }
 
         m_sceneDataDescriptors = m_descriptorAllocator.allocate(m_device, m_sceneDataDescriptorLayout);
 
         {
-            // Global scene data descriptor set
+            // Global scene data descriptor set, written once. Every frame binds it with the dynamic offsets
+            // of its own copies in the uniform ring.
             DescriptorWriter writer;
 
             writer.write_buffer(
-                0, m_gpuSceneDataBuffer, sizeof(GPUSceneData), 0, vk::DescriptorType::eUniformBuffer);
-            writer.write_buffer(1, m_lightDataBuffer, sizeof(Light), 0, vk::DescriptorType::eUniformBuffer);
+                0, m_uniformRing, sizeof(GPUSceneData), 0, vk::DescriptorType::eUniformBufferDynamic);
+            writer.write_buffer(
+                1, m_uniformRing, sizeof(Light), 0, vk::DescriptorType::eUniformBufferDynamic);
             writer.update_set(m_device, m_sceneDataDescriptors);
         }
     }
@@ -258,12 +332,12 @@ namespace renderer::backend
         std::array poolSizes {
             vk::DescriptorPoolSize()
                 .setType(vk::DescriptorType::eCombinedImageSampler)
-                .setDescriptorCount(kNumFramesInFlight),
+                .setDescriptorCount(kMaxFramesInFlight),
         };
 
         vk::DescriptorPoolCreateInfo poolInfo {
             .flags   = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-            .maxSets = kNumFramesInFlight,
+            .maxSets = kMaxFramesInFlight,
         };
 
         poolInfo.setPoolSizes(poolSizes);
@@ -298,13 +372,13 @@ namespace renderer::backend
             .QueueFamily                 = m_device.getQueueFamilyIndices().graphicsFamily,
             .Queue                       = *m_device.getGraphicsQueue(),
             .DescriptorPool              = *m_imGuiPool,
-            .MinImageCount               = kNumFramesInFlight,
+            .MinImageCount               = kDefaultFramesInFlight,
             .ImageCount                  = utils::size(m_swapchain.getImageViews()),
             .MSAASamples                 = VK_SAMPLE_COUNT_1_BIT,
             .UseDynamicRendering         = true,
             .PipelineRenderingCreateInfo = vk::PipelineRenderingCreateInfo()
                                                .setColorAttachmentFormats(m_surface.getDetails().format)
-                                               .setDepthAttachmentFormat(m_depthImage.getFormat()),
+                                               .setDepthAttachmentFormat(kDepthStencilFormat),
             .CheckVkResultFn = kDebug ? reinterpret_cast<void (*)(VkResult)>(&imguiCheckerFn) : nullptr,
         };
 
@@ -318,21 +392,60 @@ namespace renderer::backend
         ImGui_ImplVulkan_CreateFontsTexture();
     }
 
+    auto RendererBackend::getMaterialPipeline(VertexFormat format, uint32_t features, DrawPass pass)
+        -> GraphicsPipeline&
+    {
+        auto [it, inserted] = m_materialPipelines.try_emplace(getMaterialPipelineKey(format, features, pass));
+
+        if (inserted)
+        {
+            bool const blended = pass == DrawPass::Blended;
+
+            // Constant 0 selects the vertex format in vs.vert, 1 the material features and 2 whether fs.frag
+            // writes the material's alpha
+            GraphicsPipelineConfig config = m_materialPipelineConfig;
+            config.setSpecializationConstant(0, format == VertexFormat::Quantized)
+                .setSpecializationConstant(1, features)
+                .setSpecializationConstant(2, blended)
+                .enableBlending(blended)
+                .setDepthStencilSettings(true, vk::CompareOp::eGreaterOrEqual, false, false, !blended);
+
+            if (blended)
+            {
+                config.blendingSetAlphaBlend();
+            }
+
+            it->second = GraphicsPipeline(m_device, m_texturedPipelineLayout, config);
+
+            watchPipeline(it->second);
+
+            logger::debug("Created {} material pipeline for features {:#x}",
+                          blended ? "blended" : "opaque",
+                          features);
+        }
+
+        return it->second;
+    }
+
     void RendererBackend::update(glm::vec3 cameraPos, glm::mat4 view, glm::mat4 projection)
     {
         ZoneScopedN("Backend update");
 
         m_timer.tick();
 
-        float radius = 1.0f;
-
-        m_light.position = {
-            radius * glm::fastCos(glm::radians(
-                         static_cast<float>(m_timer.getTotalTime<Timer::Seconds>().count()) * 90.f)),
-            0,
-            radius * glm::fastSin(glm::radians(
-                         static_cast<float>(m_timer.getTotalTime<Timer::Seconds>().count()) * 90.f)),
-        };
+        // Headless frames are compared against a reference image, the light stays where it starts there
+        if (!m_headless)
+        {
+            float radius = 1.0f;
+
+            m_light.position = {
+                radius * glm::fastCos(glm::radians(
+                             static_cast<float>(m_timer.getTotalTime<Timer::Seconds>().count()) * 90.f)),
+                0,
+                radius * glm::fastSin(glm::radians(
+                             static_cast<float>(m_timer.getTotalTime<Timer::Seconds>().count()) * 90.f)),
+            };
+        }
 
         // for (RenderItem& item : m_renderItems |
         //                             rn::views::filter(
@@ -355,10 +468,25 @@ namespace renderer::backend
         {
             frame.imageAvailableSemaphore = m_device->createSemaphore({}) >> ResultChecker();
             frame.renderFinishedSemaphore = m_device->createSemaphore({}) >> ResultChecker();
-            frame.inFlightFence =
-                m_device->createFence(vk::FenceCreateInfo().setFlags(vk::FenceCreateFlagBits::eSignaled)) >>
-                ResultChecker();
         }
+
+        // Acquire and present only take binary semaphores, everything else waits on the timeline
+        m_frameTimeline = Timeline(m_device);
+
+        m_deletionQueue = DeletionQueue(m_frameTimeline);
+    }
+
+    void RendererBackend::setFramesInFlight(uint32_t count)
+    {
+        m_framesInFlight = std::clamp(count, 1u, kMaxFramesInFlight);
+
+        // Slots past the new count keep their resources, they're just no longer cycled through
+        if (m_currentFrame >= m_framesInFlight)
+        {
+            m_currentFrame = 0;
+        }
+
+        logger::info("{} frames in flight", m_framesInFlight);
     }
 
     void RendererBackend::scheduleSwapchainUpdate()
@@ -368,13 +496,15 @@ namespace renderer::backend
 
     void RendererBackend::handleSurfaceResize()
     {
-        m_device->waitIdle();
+        ZoneScopedN("Surface resize");
 
-        m_swapchain = Swapchain(m_device, m_surface);
+        // Nothing waits for the GPU here, frames in flight keep rendering into and presenting the retired
+        // resources until they complete
+        Swapchain swapchain { m_device, m_surface, true, m_swapchain };
 
-        m_drawImage.resize(m_surface.getFramebufferExtent());
-        m_drawImageResolve.resize(m_surface.getFramebufferExtent());
-        m_depthImage.resize(m_surface.getFramebufferExtent());
+        m_deletionQueue.retire(std::exchange(m_swapchain, std::move(swapchain)));
+
+        // The render graph realizes its render targets at the new extent on the next frame
     }
 
     void RendererBackend::updateDescriptors(glm::vec3 cameraPos,
@@ -382,10 +512,8 @@ namespace renderer::backend
                                             glm::mat4 view,
                                             glm::mat4 projection)
     {
-        auto& sceneUniformData = *static_cast<GPUSceneData*>(m_gpuSceneDataBuffer.getMappedData());
-        auto& lightUniformData = *static_cast<Light*>(m_lightDataBuffer.getMappedData());
-
-        sceneUniformData = GPUSceneData {
+        // Frames in flight may still read the previous values, render copies these into the uniform ring
+        m_sceneData = GPUSceneData {
             .view              = view,
             .proj              = projection,
             .viewproj          = projection * view,
@@ -394,6 +522,26 @@ namespace renderer::backend
             .sunlightDirection = glm::vec3 { -0.2f, -1.0f, -0.3f }
         };
 
-        lightUniformData = m_light;
+        // Gribb-Hartmann: every plane is a sum or difference of the clip matrix's rows. With a [0, 1] depth
+        // range the two depth planes are z >= 0 and z <= w.
+        glm::mat4 const clip = glm::transpose(m_sceneData.viewproj);
+
+        std::array const planes {
+            clip[3] + clip[0], clip[3] - clip[0], clip[3] + clip[1],
+            clip[3] - clip[1], clip[2],           clip[3] - clip[2],
+        };
+
+        for (size_t i = 0; i < planes.size(); ++i)
+        {
+            m_cullData.frustumPlanes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+        }
+
+        m_cullData.cameraPosition = glm::vec4(cameraPos, 1.f);
+
+        m_cullData.view       = view;
+        m_cullData.projection = { projection[0][0], projection[1][1], projection[2][2], projection[3][2] };
+
+        // Reverse Z puts the near plane at depth 1, where P22 * -near + P32 equals near
+        m_cullData.nearPlane = projection[3][2] / (1.f + projection[2][2]);
     }
 }  // namespace renderer::backend
@@ -0,0 +1,680 @@
+#include <mc/asserts.hpp>
+#include <mc/logger.hpp>
+#include <mc/renderer/backend/block_encoder.hpp>
+#include <mc/renderer/backend/scene_cache.hpp>
+#include <mc/timer.hpp>
+#include <mc/utils.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <future>
+#include <map>
+#include <string>
+
+#include <tracy/Tracy.hpp>
+
+namespace renderer::backend
+{
+    struct SceneCacheSection
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct SceneCacheHeader
+    {
+        static constexpr uint32_t kMagic = 0x4353434d;  // "MCSC"
+
+        // Bump whenever the header or any struct stored in a section changes layout, or the importer starts
+        // producing different data
+        static constexpr uint32_t kVersion = 10;
+
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+
+        VertexFormat vertexFormat;
+        uint32_t pad;
+
+        SceneCacheSection dependencies;
+        SceneCacheSection strings;
+        SceneCacheSection vertices;
+        SceneCacheSection quantizedVertices;
+        SceneCacheSection shortIndices;
+        SceneCacheSection indices;
+        SceneCacheSection primitives;
+        SceneCacheSection meshlets;
+        SceneCacheSection nodes;
+        SceneCacheSection materials;
+        SceneCacheSection materialTextures;
+        SceneCacheSection images;
+        SceneCacheSection texels;
+    };
+}  // namespace renderer::backend
+
+namespace
+{
+    using namespace renderer::backend;
+
+    namespace fs = std::filesystem;
+
+    static_assert(std::endian::native == std::endian::little, "Scene caches are stored little-endian");
+
+    constexpr uint64_t kSectionAlignment = 16;
+
+    struct CachedDependency
+    {
+        uint64_t size;
+        int64_t writeTime;
+
+        // Relative to the source's directory, stored in the strings section
+        uint32_t pathOffset;
+        uint32_t pathSize;
+    };
+
+    struct CachedImage
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipLevels;
+        uint32_t arrayLayers;
+        vk::Format format;
+        vk::ComponentMapping components;
+        uint32_t pad;
+
+        // Relative to the texels section
+        uint64_t texelOffset;
+        uint64_t texelSize;
+    };
+
+    struct MippedImage
+    {
+        vk::Extent2D dimensions;
+        uint32_t mipLevels;
+        uint32_t arrayLayers;
+        vk::Format format;
+        vk::ComponentMapping components;
+        std::vector<std::byte> texels;
+
+        // Only filled when the bake compressed the image
+        BlockEncoderStats encoderStats;
+    };
+
+    // Material descriptor bindings, see MaterialTextures
+    enum MaterialBinding : uint32_t
+    {
+        kColorBinding,
+        kRoughnessBinding,
+        kOcclusionBinding,
+        kEmissiveBinding,
+        kNormalBinding,
+    };
+
+    auto getWriteTime(fs::path const& path) -> int64_t
+    {
+        return static_cast<int64_t>(fs::last_write_time(path).time_since_epoch().count());
+    }
+
+    template<typename T>
+    auto getSection(utils::MappedFile const& file, SceneCacheSection section) -> std::span<T const>
+    {
+        return { reinterpret_cast<T const*>(file.data() + section.offset), section.size / sizeof(T) };
+    }
+
+    // Images that already come with their levels (DDS, KTX2) are repacked level-major, the way
+    // Texture::recordCopy expects tightly packed data
+    auto repackSubresources(DecodedImage const& image) -> MippedImage
+    {
+        MippedImage result {
+            .dimensions  = image.dimensions,
+            .mipLevels   = image.mipLevels,
+            .arrayLayers = image.arrayLayers,
+            .format      = image.format,
+            .components  = image.components,
+        };
+
+        if (image.subresourceOffsets.empty())
+        {
+            result.texels.assign(image.data.begin(), image.data.end());
+
+            return result;
+        }
+
+        result.texels.reserve(image.data.size());
+
+        for (uint32_t level = 0; level < image.mipLevels; ++level)
+        {
+            vk::Extent2D const extent { std::max(image.dimensions.width >> level, 1u),
+                                        std::max(image.dimensions.height >> level, 1u) };
+            vk::DeviceSize const levelSize = getImageLevelSize(image.format, extent);
+
+            for (uint32_t layer = 0; layer < image.arrayLayers; ++layer)
+            {
+                vk::DeviceSize const offset = image.subresourceOffsets[level * image.arrayLayers + layer];
+                std::span<std::byte const> subresource = image.data.subspan(offset, levelSize);
+
+                result.texels.insert(result.texels.end(), subresource.begin(), subresource.end());
+            }
+        }
+
+        return result;
+    }
+
+    // Full chain down to 1x1 with a 2x2 box filter, same level count and extents as the blits in Texture
+    auto buildMipChain(DecodedImage const& image) -> MippedImage
+    {
+        ZoneScopedN("Build mip chain");
+
+        if (image.mipLevels > 1 || image.arrayLayers > 1 || image.format != vk::Format::eR8G8B8A8Unorm)
+        {
+            return repackSubresources(image);
+        }
+
+        vk::Extent2D const dimensions = image.dimensions;
+
+        uint32_t const mipLevels = getMipLevelCount(dimensions);
+
+        size_t texelSize = 0;
+
+        for (uint32_t level = 0; level < mipLevels; ++level)
+        {
+            texelSize += static_cast<size_t>(std::max(dimensions.width >> level, 1u)) *
+                         std::max(dimensions.height >> level, 1u) * 4;
+        }
+
+        MippedImage result {
+            .dimensions  = dimensions,
+            .mipLevels   = mipLevels,
+            .arrayLayers = 1,
+            .format      = image.format,
+            .components  = {},
+            .texels      = std::vector<std::byte>(texelSize),
+        };
+
+        std::memcpy(result.texels.data(), image.data.data(), image.data.size());
+
+        auto* src         = reinterpret_cast<uint8_t*>(result.texels.data());
+        uint32_t srcWidth = dimensions.width, srcHeight = dimensions.height;
+
+        for (uint32_t level = 1; level < mipLevels; ++level)
+        {
+            uint32_t dstWidth  = std::max(srcWidth / 2, 1u);
+            uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+            uint8_t* dst       = src + static_cast<size_t>(srcWidth) * srcHeight * 4;
+
+            for (uint32_t y = 0; y < dstHeight; ++y)
+            {
+                // Clamped so that 1-texel wide or tall levels repeat their only row or column
+                uint32_t y0 = std::min(y * 2, srcHeight - 1), y1 = std::min(y * 2 + 1, srcHeight - 1);
+
+                for (uint32_t x = 0; x < dstWidth; ++x)
+                {
+                    uint32_t x0 = std::min(x * 2, srcWidth - 1), x1 = std::min(x * 2 + 1, srcWidth - 1);
+
+                    for (uint32_t c = 0; c < 4; ++c)
+                    {
+                        uint32_t sum = src[(y0 * srcWidth + x0) * 4 + c] + src[(y0 * srcWidth + x1) * 4 + c] +
+                                       src[(y1 * srcWidth + x0) * 4 + c] + src[(y1 * srcWidth + x1) * 4 + c];
+
+                        dst[(y * dstWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                    }
+                }
+            }
+
+            src       = dst;
+            srcWidth  = dstWidth;
+            srcHeight = dstHeight;
+        }
+
+        return result;
+    }
+
+    // Two-channel data goes to BC5 and single channels to BC4, anything sampled as color to BC7, or BC1 when
+    // it is opaque and the effort is Fast. `bindings` has a bit per MaterialBinding the image is used with.
+    auto chooseBlockEncoding(uint32_t bindings, DecodedImage const& image, BlockEncoderEffort effort)
+        -> std::pair<BlockEncoding, vk::ComponentMapping>
+    {
+        switch (bindings)
+        {
+            // Only x and y are kept, shaders reconstruct z
+            case 1 << kNormalBinding:
+                return { { .format = vk::Format::eBc5UnormBlock, .channels = { 0, 1 } }, {} };
+            case 1 << kOcclusionBinding:
+                return { { .format = vk::Format::eBc4UnormBlock, .channels = { 0, 0 } }, {} };
+            // Roughness and metalness live in green and blue, the view moves them back from red and green
+            case 1 << kRoughnessBinding:
+                return { { .format = vk::Format::eBc5UnormBlock, .channels = { 1, 2 } },
+                         { .r = vk::ComponentSwizzle::eZero,
+                           .g = vk::ComponentSwizzle::eR,
+                           .b = vk::ComponentSwizzle::eG,
+                           .a = vk::ComponentSwizzle::eOne } };
+            default:
+                break;
+        }
+
+        auto const* texels = reinterpret_cast<uint8_t const*>(image.data.data());
+        bool opaque        = true;
+
+        for (size_t i = 3; i < image.data.size() && opaque; i += 4)
+        {
+            opaque = texels[i] == 255;
+        }
+
+        vk::Format const format = opaque && effort == BlockEncoderEffort::Fast ? vk::Format::eBc1RgbUnormBlock
+                                                                               : vk::Format::eBc7UnormBlock;
+
+        return { { .format = format }, {} };
+    }
+
+    // Encodes every level of an RGBA8 chain built by buildMipChain()
+    auto compressMipChain(MippedImage&& image,
+                          BlockEncoding const& encoding,
+                          vk::ComponentMapping components,
+                          BlockEncoderEffort effort) -> MippedImage
+    {
+        ZoneScopedN("Compress mip chain");
+
+        MippedImage result {
+            .dimensions  = image.dimensions,
+            .mipLevels   = image.mipLevels,
+            .arrayLayers = 1,
+            .format      = encoding.format,
+            .components  = components,
+        };
+
+        size_t blockSize = 0;
+
+        for (uint32_t level = 0; level < image.mipLevels; ++level)
+        {
+            blockSize += getImageLevelSize(encoding.format,
+                                           { std::max(image.dimensions.width >> level, 1u),
+                                             std::max(image.dimensions.height >> level, 1u) });
+        }
+
+        result.texels.resize(blockSize);
+
+        size_t sourceOffset = 0, blockOffset = 0;
+
+        for (uint32_t level = 0; level < image.mipLevels; ++level)
+        {
+            vk::Extent2D const extent { std::max(image.dimensions.width >> level, 1u),
+                                        std::max(image.dimensions.height >> level, 1u) };
+
+            size_t const sourceSize = static_cast<size_t>(extent.width) * extent.height * 4;
+            size_t const levelSize  = getImageLevelSize(encoding.format, extent);
+
+            result.encoderStats += encodeBlocks(std::span { image.texels }.subspan(sourceOffset, sourceSize),
+                                                extent,
+                                                encoding,
+                                                effort,
+                                                std::span { result.texels }.subspan(blockOffset, levelSize));
+
+            sourceOffset += sourceSize;
+            blockOffset += levelSize;
+        }
+
+        return result;
+    }
+
+    // Decodes, mips and unless `effort` is None compresses a single image
+    auto bakeImage(SceneImageSource const& source, uint32_t bindings, BlockEncoderEffort effort)
+        -> MippedImage
+    {
+        DecodedImage decoded = decodeImage(source);
+        MippedImage mipped   = buildMipChain(decoded);
+
+        // Containers come with their own (usually compressed) format and levels, those are kept as they are
+        if (effort == BlockEncoderEffort::None || mipped.format != vk::Format::eR8G8B8A8Unorm ||
+            decoded.mipLevels > 1 || decoded.arrayLayers > 1)
+        {
+            return mipped;
+        }
+
+        auto const [encoding, components] = chooseBlockEncoding(bindings, decoded, effort);
+
+        return compressMipChain(std::move(mipped), encoding, components, effort);
+    }
+
+    class CacheWriter
+    {
+    public:
+        explicit CacheWriter(fs::path const& path) : m_file { path, std::ios::binary | std::ios::trunc }
+        {
+            MC_ASSERT_MSG(m_file.is_open(), "Failed to open '{}' for writing", path.string());
+        }
+
+        // Pads to the section alignment and returns the new offset
+        auto align() -> uint64_t
+        {
+            constexpr std::array<char, kSectionAlignment> zeros {};
+
+            uint64_t padding = (kSectionAlignment - m_offset % kSectionAlignment) % kSectionAlignment;
+
+            m_file.write(zeros.data(), static_cast<std::streamsize>(padding));
+            m_offset += padding;
+
+            return m_offset;
+        }
+
+        auto write(std::span<std::byte const> bytes) -> SceneCacheSection
+        {
+            SceneCacheSection section { .offset = align(), .size = bytes.size() };
+
+            m_file.write(reinterpret_cast<char const*>(bytes.data()),
+                         static_cast<std::streamsize>(bytes.size()));
+            m_offset += bytes.size();
+
+            return section;
+        }
+
+        template<typename T>
+        auto write(std::vector<T> const& data) -> SceneCacheSection
+        {
+            return write(std::as_bytes(std::span { data }));
+        }
+
+        void writeHeader(SceneCacheHeader const& header)
+        {
+            m_file.seekp(0);
+            m_file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+            m_file.flush();
+        }
+
+        [[nodiscard]] auto getOffset() const -> uint64_t { return m_offset; }
+
+        [[nodiscard]] auto isGood() const -> bool { return m_file.good(); }
+
+    private:
+        std::ofstream m_file;
+        uint64_t m_offset { 0 };
+    };
+}  // namespace
+
+namespace renderer::backend
+{
+    namespace fs = std::filesystem;
+
+    auto SceneCache::getPath(fs::path const& source) -> fs::path
+    {
+        fs::path path = source;
+        path += ".mcscene";
+
+        return path;
+    }
+
+    auto SceneCache::open(fs::path const& source, VertexFormat vertexFormat) -> std::optional<SceneCache>
+    {
+        fs::path const cachePath = getPath(source);
+
+        if (!fs::exists(cachePath))
+        {
+            return std::nullopt;
+        }
+
+        auto stale = [&](std::string const& reason)
+        {
+            logger::info("Ignoring scene cache '{}': {}", cachePath.string(), reason);
+
+            return std::nullopt;
+        };
+
+        auto file = std::make_shared<utils::MappedFile>(cachePath);
+
+        if (file->size() < sizeof(SceneCacheHeader))
+        {
+            return stale("truncated");
+        }
+
+        auto const* header = reinterpret_cast<SceneCacheHeader const*>(file->data());
+
+        if (header->magic != SceneCacheHeader::kMagic || header->version != SceneCacheHeader::kVersion)
+        {
+            return stale("written by a different format version");
+        }
+
+        if (header->vertexFormat != vertexFormat)
+        {
+            return stale("baked with a different vertex format");
+        }
+
+        for (SceneCacheSection section : { header->dependencies,
+                                           header->strings,
+                                           header->vertices,
+                                           header->quantizedVertices,
+                                           header->shortIndices,
+                                           header->indices,
+                                           header->primitives,
+                                           header->meshlets,
+                                           header->nodes,
+                                           header->materials,
+                                           header->materialTextures,
+                                           header->images,
+                                           header->texels })
+        {
+            if (section.offset % kSectionAlignment != 0 || section.offset + section.size > file->size())
+            {
+                return stale("truncated");
+            }
+        }
+
+        // The glTF itself is hashed, everything it references is only checked for size and modification time
+        // so that validating a cache doesn't mean reading the whole scene
+        if (utils::hashBytes(utils::MappedFile(source).getBytes()) != header->sourceHash)
+        {
+            return stale(std::format("'{}' changed", source.filename().string()));
+        }
+
+        std::span<char const> strings = getSection<char>(*file, header->strings);
+
+        for (CachedDependency const& dependency : getSection<CachedDependency>(*file, header->dependencies))
+        {
+            std::string_view name { strings.data() + dependency.pathOffset, dependency.pathSize };
+            fs::path path = source.parent_path() / name;
+
+            std::error_code error;
+
+            if (fs::file_size(path, error) != dependency.size || error ||
+                getWriteTime(path) != dependency.writeTime)
+            {
+                return stale(std::format("'{}' changed", name));
+            }
+        }
+
+        return SceneCache(std::move(file));
+    }
+
+    SceneCache::SceneCache(std::shared_ptr<utils::MappedFile> file)
+        : m_file { std::move(file) }, m_header { reinterpret_cast<SceneCacheHeader const*>(m_file->data()) }
+    {
+    }
+
+    auto SceneCache::getView() const -> SceneView
+    {
+        return {
+            .vertexFormat      = m_header->vertexFormat,
+            .vertices          = getSection<Vertex>(*m_file, m_header->vertices),
+            .quantizedVertices = getSection<QuantizedVertex>(*m_file, m_header->quantizedVertices),
+            .shortIndices      = getSection<uint16_t>(*m_file, m_header->shortIndices),
+            .indices           = getSection<uint32_t>(*m_file, m_header->indices),
+            .primitives        = getSection<Primitive>(*m_file, m_header->primitives),
+            .meshlets          = getSection<Meshlet>(*m_file, m_header->meshlets),
+            .nodes             = getSection<SceneNode>(*m_file, m_header->nodes),
+            .materials         = getSection<Material>(*m_file, m_header->materials),
+            .materialTextures  = getSection<MaterialTextures>(*m_file, m_header->materialTextures),
+            .imageCount        = m_header->images.size / sizeof(CachedImage),
+        };
+    }
+
+    auto SceneCache::getImage(size_t index) const -> DecodedImage
+    {
+        CachedImage const& image     = getSection<CachedImage>(*m_file, m_header->images)[index];
+        std::span<std::byte const> texels = getSection<std::byte>(*m_file, m_header->texels);
+
+        return {
+            .dimensions  = { image.width, image.height },
+            .mipLevels   = image.mipLevels,
+            .arrayLayers = image.arrayLayers,
+            .format      = image.format,
+            .components  = image.components,
+            .data        = texels.subspan(image.texelOffset, image.texelSize),
+            .owner       = m_file,
+        };
+    }
+
+    void bakeSceneCache(fs::path const& source,
+                        VertexFormat vertexFormat,
+                        BlockEncoderEffort encoderEffort,
+                        utils::ThreadPool& threadPool)
+    {
+        auto const startTime = Timer::Clock::now();
+
+        SceneData scene = importGltf(source, vertexFormat);
+
+        // Which bindings every image is sampled through decides its block format
+        std::vector<uint32_t> imageBindings(scene.images.size(), 0);
+
+        for (MaterialTextures const& images : scene.materialTextures)
+        {
+            for (uint32_t binding = 0; binding < kMaterialTextureCount; ++binding)
+            {
+                if (images[binding] != kNoImage)
+                {
+                    imageBindings[images[binding]] |= 1u << binding;
+                }
+            }
+        }
+
+        std::vector<std::future<MippedImage>> mippedImages;
+        mippedImages.reserve(scene.images.size());
+
+        for (size_t i = 0; i < scene.images.size(); ++i)
+        {
+            mippedImages.push_back(threadPool.submit(
+                [&image = scene.images[i], bindings = imageBindings[i], encoderEffort]
+                { return bakeImage(image, bindings, encoderEffort); }));
+        }
+
+        std::string strings;
+        std::vector<CachedDependency> dependencies;
+
+        for (fs::path const& dependency : scene.dependencies)
+        {
+            fs::path path    = source.parent_path() / dependency;
+            std::string name = dependency.generic_string();
+
+            dependencies.push_back({
+                .size       = fs::file_size(path),
+                .writeTime  = getWriteTime(path),
+                .pathOffset = static_cast<uint32_t>(strings.size()),
+                .pathSize   = static_cast<uint32_t>(name.size()),
+            });
+
+            strings += name;
+        }
+
+        SceneCacheHeader header {
+            .magic        = SceneCacheHeader::kMagic,
+            .version      = SceneCacheHeader::kVersion,
+            .sourceHash   = utils::hashBytes(utils::MappedFile(source).getBytes()),
+            .vertexFormat = scene.vertexFormat,
+        };
+
+        fs::path const cachePath = SceneCache::getPath(source);
+        fs::path tempPath        = cachePath;
+        tempPath += ".tmp";
+
+        uint64_t cacheSize = 0;
+
+        struct EncodedFormatStats
+        {
+            BlockEncoderStats stats;
+            uint32_t imageCount { 0 };
+        };
+
+        std::map<vk::Format, EncodedFormatStats> encodedFormats;
+
+        {
+            CacheWriter writer(tempPath);
+
+            // Placeholder, rewritten once every section's offset is known
+            writer.write(std::as_bytes(std::span { &header, 1 }));
+
+            header.dependencies      = writer.write(dependencies);
+            header.strings           = writer.write(std::as_bytes(std::span { strings }));
+            header.vertices          = writer.write(scene.vertices);
+            header.quantizedVertices = writer.write(scene.quantizedVertices);
+            header.shortIndices      = writer.write(scene.shortIndices);
+            header.indices           = writer.write(scene.indices);
+            header.primitives        = writer.write(scene.primitives);
+            header.meshlets          = writer.write(scene.meshlets);
+            header.nodes             = writer.write(scene.nodes);
+            header.materials         = writer.write(scene.materials);
+            header.materialTextures  = writer.write(scene.materialTextures);
+
+            std::vector<CachedImage> images;
+            images.reserve(mippedImages.size());
+
+            uint64_t const texelStart = writer.align();
+
+            for (std::future<MippedImage>& future : mippedImages)
+            {
+                MippedImage mipped = future.get();
+
+                if (mipped.encoderStats.pixelCount > 0)
+                {
+                    EncodedFormatStats& formatStats = encodedFormats[mipped.format];
+
+                    formatStats.stats += mipped.encoderStats;
+                    ++formatStats.imageCount;
+                }
+
+                SceneCacheSection const texels = writer.write(std::span<std::byte const> { mipped.texels });
+
+                images.push_back({
+                    .width       = mipped.dimensions.width,
+                    .height      = mipped.dimensions.height,
+                    .mipLevels   = mipped.mipLevels,
+                    .arrayLayers = mipped.arrayLayers,
+                    .format      = mipped.format,
+                    .components  = mipped.components,
+                    .texelOffset = texels.offset - texelStart,
+                    .texelSize   = texels.size,
+                });
+            }
+
+            header.texels = { .offset = texelStart, .size = writer.getOffset() - texelStart };
+            header.images = writer.write(images);
+
+            cacheSize = writer.getOffset();
+
+            writer.writeHeader(header);
+
+            MC_ASSERT_MSG(writer.isGood(), "Failed to write scene cache '{}'", tempPath.string());
+        }
+
+        // Readers never see a half-written cache
+        fs::rename(tempPath, cachePath);
+
+        logger::info("Baked '{}' into '{}' ({:.2f} MiB, {} textures) in {:.2f} ms",
+                     source.filename().string(),
+                     cachePath.string(),
+                     static_cast<double>(cacheSize) / (1024.0 * 1024.0),
+                     scene.images.size(),
+                     Timer::Milliseconds(Timer::Clock::now() - startTime).count());
+
+        // Throughput is per encoding thread, summed over the images' encode times
+        for (auto const& [format, formatStats] : encodedFormats)
+        {
+            logger::info("{} ({} effort): {} textures, {:.1f} MPix, {:.2f} dB PSNR, {:.1f} MPix/s",
+                         vk::to_string(format),
+                         getBlockEncoderEffortName(encoderEffort),
+                         formatStats.imageCount,
+                         static_cast<double>(formatStats.stats.pixelCount) / 1'000'000.0,
+                         formatStats.stats.getPsnr(),
+                         formatStats.stats.getMegapixelsPerSecond());
+        }
+    }
+}  // namespace renderer::backend
@@ -0,0 +1,243 @@
+#include <mc/renderer/backend/gltfloader.hpp>
+#include <mc/renderer/backend/scene_graph.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+    constexpr auto align(size_t offset, size_t alignment) -> size_t
+    {
+        return (offset + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Appends an array of `count` T to a layout that is `size` bytes so far, returns its offset
+    template <typename T>
+    auto reserveArray(size_t& size, uint32_t count) -> size_t
+    {
+        size_t const offset = align(size, alignof(T));
+        size                = offset + count * sizeof(T);
+
+        return offset;
+    }
+
+    template <typename T>
+    auto carveArray(std::byte* storage, size_t offset, uint32_t count) -> std::span<T>
+    {
+        T* first = reinterpret_cast<T*>(storage + offset);
+        std::uninitialized_value_construct_n(first, count);
+
+        return { first, count };
+    }
+
+    auto composeTransform(glm::vec3 translation, glm::quat rotation, glm::vec3 scale) -> glm::mat4
+    {
+        return glm::scale(glm::translate(glm::mat4(1.f), translation) * glm::mat4_cast(rotation), scale);
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    SceneGraph::SceneGraph(Allocator& allocator, std::span<SceneNode const> nodes)
+        : m_nodeCount { static_cast<uint32_t>(nodes.size()) }
+    {
+        // Largest alignment first, every array starts at a multiple of its element's alignment
+        size_t size = 0;
+
+        size_t const worldOffset       = reserveArray<glm::mat4>(size, m_nodeCount);
+        size_t const rotationOffset    = reserveArray<glm::quat>(size, m_nodeCount);
+        size_t const translationOffset = reserveArray<glm::vec3>(size, m_nodeCount);
+        size_t const scaleOffset       = reserveArray<glm::vec3>(size, m_nodeCount);
+        size_t const parentOffset      = reserveArray<int32_t>(size, m_nodeCount);
+        size_t const dirtyOffset       = reserveArray<uint8_t>(size, m_nodeCount);
+
+        m_storage = std::make_unique_for_overwrite<std::byte[]>(size);
+
+        m_worldTransforms = carveArray<glm::mat4>(m_storage.get(), worldOffset, m_nodeCount);
+        m_rotations       = carveArray<glm::quat>(m_storage.get(), rotationOffset, m_nodeCount);
+        m_translations    = carveArray<glm::vec3>(m_storage.get(), translationOffset, m_nodeCount);
+        m_scales          = carveArray<glm::vec3>(m_storage.get(), scaleOffset, m_nodeCount);
+        m_parents         = carveArray<int32_t>(m_storage.get(), parentOffset, m_nodeCount);
+        m_dirty           = carveArray<uint8_t>(m_storage.get(), dirtyOffset, m_nodeCount);
+
+        for (uint32_t i = 0; i < m_nodeCount; ++i)
+        {
+            SceneNode const& node = nodes[i];
+
+            glm::vec3 skew;
+            glm::vec4 perspective;
+
+            // Degenerate matrices (zero scale, mostly) keep their translation and collapse
+            if (!glm::decompose(
+                    node.transform, m_scales[i], m_rotations[i], m_translations[i], skew, perspective))
+            {
+                m_translations[i] = glm::vec3(node.transform[3]);
+                m_rotations[i]    = glm::quat(1.f, 0.f, 0.f, 0.f);
+                m_scales[i]       = glm::vec3(0.f);
+            }
+
+            m_parents[i] = node.parent;
+
+            // Parents come first, their world matrices are final by now
+            m_worldTransforms[i] =
+                node.parent >= 0 ? m_worldTransforms[static_cast<size_t>(node.parent)] * node.transform
+                                 : node.transform;
+        }
+
+        m_firstDirty = m_nodeCount;
+
+        if (m_nodeCount == 0)
+        {
+            return;
+        }
+
+        vk::DeviceSize const bufferSize = m_nodeCount * sizeof(glm::mat4);
+
+        m_buffer = GPUBuffer(allocator,
+                             bufferSize,
+                             vk::BufferUsageFlagBits::eTransferDst |
+                                 vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                             VMA_MEMORY_USAGE_AUTO);
+
+        for (GPUBuffer& staging : m_stagingBuffers)
+        {
+            staging = GPUBuffer(allocator,
+                                bufferSize,
+                                vk::BufferUsageFlagBits::eTransferSrc,
+                                VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                                VMA_ALLOCATION_CREATE_MAPPED_BIT |
+                                    VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+        }
+    }
+
+    void SceneGraph::markDirty(uint32_t node)
+    {
+        m_dirty[node] = 1;
+        m_firstDirty  = std::min(m_firstDirty, node);
+    }
+
+    void SceneGraph::setTranslation(uint32_t node, glm::vec3 translation)
+    {
+        m_translations[node] = translation;
+        markDirty(node);
+    }
+
+    void SceneGraph::setRotation(uint32_t node, glm::quat rotation)
+    {
+        m_rotations[node] = rotation;
+        markDirty(node);
+    }
+
+    void SceneGraph::setScale(uint32_t node, glm::vec3 scale)
+    {
+        m_scales[node] = scale;
+        markDirty(node);
+    }
+
+    auto SceneGraph::update() -> bool
+    {
+        if (m_firstDirty == m_nodeCount)
+        {
+            return false;
+        }
+
+        ZoneScopedN("Scene graph update");
+
+        uint32_t lastChanged = m_firstDirty;
+
+        // A node changes when it was moved itself or its parent changed in this pass. The dirty flags double
+        // as the changed flags, so descendants pick them up further down.
+        for (uint32_t i = m_firstDirty; i < m_nodeCount; ++i)
+        {
+            int32_t const parent = m_parents[i];
+
+            if (parent >= 0 && m_dirty[static_cast<size_t>(parent)])
+            {
+                m_dirty[i] = 1;
+            }
+
+            if (!m_dirty[i])
+            {
+                continue;
+            }
+
+            glm::mat4 const local = composeTransform(m_translations[i], m_rotations[i], m_scales[i]);
+
+            m_worldTransforms[i] =
+                parent >= 0 ? m_worldTransforms[static_cast<size_t>(parent)] * local : local;
+
+            lastChanged = i;
+        }
+
+        std::fill(m_dirty.begin() + m_firstDirty, m_dirty.end(), 0);
+
+        // One contiguous range is copied per frame, it covers every changed matrix
+        if (m_uploadBegin == m_uploadEnd)
+        {
+            m_uploadBegin = m_firstDirty;
+            m_uploadEnd   = lastChanged + 1;
+        }
+        else
+        {
+            m_uploadBegin = std::min(m_uploadBegin, m_firstDirty);
+            m_uploadEnd   = std::max(m_uploadEnd, lastChanged + 1);
+        }
+
+        m_firstDirty = m_nodeCount;
+
+        return true;
+    }
+
+    void SceneGraph::recordUpload(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+    {
+        if (m_uploadBegin == m_uploadEnd)
+        {
+            return;
+        }
+
+        GPUBuffer const& staging = m_stagingBuffers[frameIndex];
+
+        vk::DeviceSize const offset = m_uploadBegin * sizeof(glm::mat4);
+        vk::DeviceSize const size   = (m_uploadEnd - m_uploadBegin) * sizeof(glm::mat4);
+
+        std::memcpy(static_cast<std::byte*>(staging.getMappedData()) + offset,
+                    m_worldTransforms.data() + m_uploadBegin,
+                    size);
+
+        // The previous frame may still be reading the matrices this copy overwrites
+        vk::MemoryBarrier2 const readBarrier {
+            .srcStageMask =
+                vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eVertexShader,
+            .dstStageMask = vk::PipelineStageFlagBits2::eCopy,
+        };
+
+        commandBuffer.pipelineBarrier2(vk::DependencyInfo().setMemoryBarriers(readBarrier));
+
+        commandBuffer.copyBuffer(staging,
+                                 m_buffer,
+                                 vk::BufferCopy {
+                                     .srcOffset = offset,
+                                     .dstOffset = offset,
+                                     .size      = size,
+                                 });
+
+        vk::MemoryBarrier2 const writeBarrier {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eCopy,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask =
+                vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eVertexShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+        };
+
+        commandBuffer.pipelineBarrier2(vk::DependencyInfo().setMemoryBarriers(writeBarrier));
+
+        m_uploadBegin = 0;
+        m_uploadEnd   = 0;
+    }
+}  // namespace renderer::backend
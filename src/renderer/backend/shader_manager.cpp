@@ -0,0 +1,375 @@
+#include <mc/defines.hpp>
+#include <mc/logger.hpp>
+#include <mc/renderer/backend/shader_manager.hpp>
+#include <mc/utils.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <sstream>
+
+#include <glslang/Public/ResourceLimits.h>
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+#include <spirv-tools/optimizer.hpp>
+#include <tracy/Tracy.hpp>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr int kGlslVersion = 460;
+
+    constexpr auto kMessages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
+
+    // Debug builds keep the source level debug info and skip the optimizer, so RenderDoc can step through
+    // the GLSL
+    constexpr bool kOptimize          = !kDebug;
+    constexpr bool kGenerateDebugInfo = kDebug;
+
+    // Goes into every cache key, a different compiler or different options can produce different SPIR-V
+    auto getCompilerSignature() -> std::string const&
+    {
+        static std::string const signature = []
+        {
+            glslang::Version const version = glslang::GetVersion();
+
+            return std::format("glslang {}.{}.{}{} {} optimize {} debug info {}",
+                               version.major,
+                               version.minor,
+                               version.patch,
+                               version.flavor,
+                               spvSoftwareVersionDetailsString(),
+                               kOptimize,
+                               kGenerateDebugInfo);
+        }();
+
+        return signature;
+    }
+
+    auto getStage(fs::path const& name) -> std::optional<EShLanguage>
+    {
+        fs::path const extension = name.extension();
+
+        if (extension == ".vert")
+        {
+            return EShLangVertex;
+        }
+
+        if (extension == ".frag")
+        {
+            return EShLangFragment;
+        }
+
+        if (extension == ".comp")
+        {
+            return EShLangCompute;
+        }
+
+        return std::nullopt;
+    }
+
+    auto readText(fs::path const& path) -> std::optional<std::string>
+    {
+        std::ifstream file { path, std::ios::binary };
+
+        if (!file.is_open())
+        {
+            return std::nullopt;
+        }
+
+        std::stringstream stream;
+        stream << file.rdbuf();
+
+        return std::move(stream).str();
+    }
+
+    // Resolves `#include "..."` against the source directory and records every file it hands out
+    class Includer : public glslang::TShader::Includer
+    {
+    public:
+        explicit Includer(fs::path const& directory) : m_directory { directory } {}
+
+        auto includeLocal(char const* headerName, char const*, size_t) -> IncludeResult* override
+        {
+            fs::path path = m_directory / headerName;
+
+            std::optional<std::string> text = readText(path);
+
+            if (!text)
+            {
+                return nullptr;
+            }
+
+            if (std::ranges::find(m_includes, path) == m_includes.end())
+            {
+                m_includes.push_back(path);
+            }
+
+            auto* data = new std::string(std::move(*text));
+
+            return new IncludeResult(path.string(), data->data(), data->size(), data);
+        }
+
+        void releaseInclude(IncludeResult* result) override
+        {
+            if (result != nullptr)
+            {
+                delete static_cast<std::string*>(result->userData);
+                delete result;
+            }
+        }
+
+        [[nodiscard]] auto getIncludes() const -> std::vector<fs::path> const& { return m_includes; }
+
+    private:
+        fs::path m_directory;
+
+        std::vector<fs::path> m_includes;
+    };
+
+    // glslang keeps the preamble pointer, it has to outlive the shader
+    void configure(glslang::TShader& shader, EShLanguage stage, std::string const& preamble)
+    {
+        shader.setPreamble(preamble.c_str());
+        shader.setEnvInput(glslang::EShSourceGlsl, stage, glslang::EShClientVulkan, 100);
+        shader.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_3);
+        shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_6);
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    ShaderManager::ShaderManager(fs::path sourceDirectory, fs::path cacheDirectory)
+        : m_sourceDirectory { std::move(sourceDirectory) },
+          m_cacheDirectory { std::move(cacheDirectory) },
+          m_state { std::make_unique<State>() }
+    {
+        glslang::InitializeProcess();
+
+        std::error_code error;
+
+        fs::create_directories(m_cacheDirectory, error);
+
+        if (error)
+        {
+            logger::warn("Failed to create shader cache directory '{}': {}",
+                         m_cacheDirectory.string(),
+                         error.message());
+        }
+    }
+
+    ShaderManager::~ShaderManager()
+    {
+        if (m_state)
+        {
+            glslang::FinalizeProcess();
+        }
+    }
+
+    auto ShaderManager::getSpirv(fs::path const& name,
+                                 std::span<std::string const> defines) const -> std::vector<uint32_t>
+    {
+        ZoneScopedN("Shader compile");
+
+        std::optional<EShLanguage> const stage = getStage(name);
+
+        if (!stage)
+        {
+            logger::error("Unknown shader stage of '{}'", name.string());
+
+            return {};
+        }
+
+        fs::path const path = m_sourceDirectory / name;
+
+        std::optional<std::string> const source = readText(path);
+
+        if (!source)
+        {
+            logger::error("Failed to read shader '{}'", path.string());
+
+            return {};
+        }
+
+        std::string preamble = "#extension GL_GOOGLE_include_directive : require\n";
+
+        for (std::string const& define : defines)
+        {
+            std::string directive = define;
+            std::ranges::replace(directive, '=', ' ');
+
+            preamble += std::format("#define {}\n", directive);
+        }
+
+        // Named after the file so errors point at it
+        std::string const pathString = path.string();
+
+        char const* sourceText = source->c_str();
+        char const* sourceName = pathString.c_str();
+
+        auto const* resources = GetDefaultResources();
+
+        Includer includer { m_sourceDirectory };
+
+        glslang::TShader preprocessor { *stage };
+        configure(preprocessor, *stage, preamble);
+        preprocessor.setStringsWithLengthsAndNames(&sourceText, nullptr, &sourceName, 1);
+
+        std::string preprocessed;
+
+        if (!preprocessor.preprocess(
+                resources, kGlslVersion, ENoProfile, false, false, kMessages, &preprocessed, includer))
+        {
+            logger::error("Failed to preprocess '{}':\n{}", name.string(), preprocessor.getInfoLog());
+
+            return {};
+        }
+
+        {
+            std::vector<fs::path> dependencies = includer.getIncludes();
+            dependencies.push_back(path);
+
+            std::scoped_lock lock { m_state->mutex };
+
+            m_state->dependencies[name.string()] = std::move(dependencies);
+        }
+
+        uint64_t key = utils::hashBytes(std::as_bytes(std::span(preprocessed)));
+        key          = utils::hashBytes(std::as_bytes(std::span(getCompilerSignature())), key);
+
+        for (std::string const& define : defines)
+        {
+            key = utils::hashBytes(std::as_bytes(std::span(define)), key);
+        }
+
+        key = utils::hashBytes(std::as_bytes(std::span(&*stage, 1)), key);
+
+        fs::path const cachePath = m_cacheDirectory / std::format("{:016x}.spv", key);
+
+        if (std::error_code error; fs::exists(cachePath, error))
+        {
+            std::vector<char> const bytes = utils::readBytes(cachePath);
+
+            if (!bytes.empty() && bytes.size() % sizeof(uint32_t) == 0)
+            {
+                std::vector<uint32_t> code(bytes.size() / sizeof(uint32_t));
+                std::memcpy(code.data(), bytes.data(), bytes.size());
+
+                return code;
+            }
+        }
+
+        glslang::TShader shader { *stage };
+        configure(shader, *stage, preamble);
+        shader.setStringsWithLengthsAndNames(&sourceText, nullptr, &sourceName, 1);
+
+        if (!shader.parse(resources, kGlslVersion, false, kMessages, includer))
+        {
+            logger::error("Failed to compile '{}':\n{}", name.string(), shader.getInfoLog());
+
+            return {};
+        }
+
+        glslang::TProgram program;
+        program.addShader(&shader);
+
+        if (!program.link(kMessages))
+        {
+            logger::error("Failed to link '{}':\n{}", name.string(), program.getInfoLog());
+
+            return {};
+        }
+
+        glslang::SpvOptions options {};
+        options.generateDebugInfo = kGenerateDebugInfo;
+
+        std::vector<uint32_t> code;
+
+        glslang::GlslangToSpv(*program.getIntermediate(*stage), code, &options);
+
+        if constexpr (kOptimize)
+        {
+            ZoneScopedN("Shader optimize");
+
+            spvtools::Optimizer optimizer { SPV_ENV_VULKAN_1_3 };
+
+            optimizer.SetMessageConsumer(
+                [&](spv_message_level_t level, char const*, spv_position_t const&, char const* message)
+                {
+                    if (level <= SPV_MSG_ERROR)
+                    {
+                        logger::error("Failed to optimize '{}': {}", name.string(), message);
+                    }
+                });
+
+            // The same passes as glslc -O
+            optimizer.RegisterPerformancePasses();
+
+            std::vector<uint32_t> optimized;
+
+            // The unoptimized code is still valid, keep drawing with it
+            if (optimizer.Run(code.data(), code.size(), &optimized))
+            {
+                code = std::move(optimized);
+            }
+        }
+
+        fs::path tempPath = cachePath;
+        tempPath += ".tmp";
+
+        // Two threads compiling the same source would otherwise write the same temporary file
+        std::scoped_lock lock { m_state->mutex };
+
+        {
+            std::ofstream file { tempPath, std::ios::binary | std::ios::trunc };
+
+            file.write(reinterpret_cast<char const*>(code.data()),
+                       static_cast<std::streamsize>(code.size() * sizeof(uint32_t)));
+
+            file.close();
+
+            if (!file.good())
+            {
+                logger::warn("Failed to write shader cache entry '{}'", tempPath.string());
+
+                return code;
+            }
+        }
+
+        std::error_code error;
+
+        fs::rename(tempPath, cachePath, error);
+
+        if (error)
+        {
+            logger::warn("Failed to write shader cache entry '{}': {}", cachePath.string(), error.message());
+        }
+
+        logger::debug("Compiled shader '{}' into '{}'", name.string(), cachePath.filename().string());
+
+        return code;
+    }
+
+    auto ShaderManager::dependsOn(fs::path const& name, fs::path const& file) const -> bool
+    {
+        std::scoped_lock lock { m_state->mutex };
+
+        auto it = m_state->dependencies.find(name.string());
+
+        if (it == m_state->dependencies.end())
+        {
+            return false;
+        }
+
+        std::error_code error;
+
+        return std::ranges::any_of(it->second,
+                                   [&](fs::path const& dependency)
+                                   {
+                                       return fs::equivalent(dependency, file, error);
+                                   });
+    }
+}  // namespace renderer::backend
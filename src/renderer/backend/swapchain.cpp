@@ -7,7 +7,11 @@
 
 namespace renderer::backend
 {
-    Swapchain::Swapchain(Device const& device, Surface& surface, bool refreshSurface) : m_device { &device }
+    Swapchain::Swapchain(Device const& device,
+                         Surface& surface,
+                         bool refreshSurface,
+                         vk::SwapchainKHR oldSwapchain)
+        : m_device { &device }
     {
         if (refreshSurface)
         {
@@ -47,6 +51,7 @@ namespace renderer::backend
             .compositeAlpha        = vk::CompositeAlphaFlagBitsKHR::eOpaque,
             .presentMode           = details.presentMode,
             .clipped               = true,
+            .oldSwapchain          = oldSwapchain,
         };
 
         m_handle = m_device->get().createSwapchainKHR(createInfo) >> ResultChecker();
@@ -0,0 +1,414 @@
+#include <mc/exceptions.hpp>
+#include <mc/renderer/backend/image.hpp>
+#include <mc/renderer/backend/texture_container.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <format>
+#include <optional>
+#include <ranges>
+
+#include <tracy/Tracy.hpp>
+
+namespace rn = std::ranges;
+
+namespace
+{
+    using namespace renderer::backend;
+
+    constexpr std::array<uint8_t, 4> kDdsMagic { 'D', 'D', 'S', ' ' };
+    constexpr std::array<uint8_t, 12> kKtx2Magic {
+        0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'
+    };
+
+    // https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+    struct DdsPixelFormat
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t rBitMask;
+        uint32_t gBitMask;
+        uint32_t bBitMask;
+        uint32_t aBitMask;
+    };
+
+    struct DdsHeader
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DdsPixelFormat pixelFormat;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    struct DdsHeaderDx10
+    {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+
+    static_assert(sizeof(DdsHeader) == 124);
+    static_assert(sizeof(DdsHeaderDx10) == 20);
+
+    constexpr uint32_t kDdsdMipMapCount    = 0x20000;
+    constexpr uint32_t kDdpfFourCC         = 0x4;
+    constexpr uint32_t kDdpfRgb            = 0x40;
+    constexpr uint32_t kDdsCaps2Cubemap    = 0x200;
+    constexpr uint32_t kDdsCaps2Volume     = 0x200000;
+    constexpr uint32_t kDx10MiscCube       = 0x4;
+    constexpr uint32_t kDx10DimensionTex2D = 3;
+
+    constexpr auto makeFourCC(char const (&code)[5]) -> uint32_t
+    {
+        return static_cast<uint32_t>(code[0]) | static_cast<uint32_t>(code[1]) << 8 |
+               static_cast<uint32_t>(code[2]) << 16 | static_cast<uint32_t>(code[3]) << 24;
+    }
+
+    // https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+    struct Ktx2Header
+    {
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+
+        // 64-bit values that are only 4-byte aligned relative to the header, unused
+        uint32_t sgdByteOffset[2];
+        uint32_t sgdByteLength[2];
+    };
+
+    struct Ktx2Level
+    {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    static_assert(sizeof(Ktx2Header) == 68);
+    static_assert(sizeof(Ktx2Level) == 24);
+
+    auto hasMagic(std::span<std::byte const> bytes, std::span<uint8_t const> magic) -> bool
+    {
+        return bytes.size() >= magic.size() && std::memcmp(bytes.data(), magic.data(), magic.size()) == 0;
+    }
+
+    template<typename T>
+    auto read(std::span<std::byte const> bytes, size_t offset, std::string_view name) -> T
+    {
+        if (offset + sizeof(T) > bytes.size())
+        {
+            MC_THROW Error(AssetError, std::format("Texture '{}' is truncated", name));
+        }
+
+        T value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+
+        return value;
+    }
+
+    auto fromDxgiFormat(uint32_t dxgiFormat) -> std::optional<vk::Format>
+    {
+        switch (dxgiFormat)
+        {
+            case 28:  // DXGI_FORMAT_R8G8B8A8_UNORM
+                return vk::Format::eR8G8B8A8Unorm;
+            case 29:  // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+                return vk::Format::eR8G8B8A8Srgb;
+            case 71:  // DXGI_FORMAT_BC1_UNORM
+                return vk::Format::eBc1RgbaUnormBlock;
+            case 72:  // DXGI_FORMAT_BC1_UNORM_SRGB
+                return vk::Format::eBc1RgbaSrgbBlock;
+            case 74:  // DXGI_FORMAT_BC2_UNORM
+                return vk::Format::eBc2UnormBlock;
+            case 75:  // DXGI_FORMAT_BC2_UNORM_SRGB
+                return vk::Format::eBc2SrgbBlock;
+            case 77:  // DXGI_FORMAT_BC3_UNORM
+                return vk::Format::eBc3UnormBlock;
+            case 78:  // DXGI_FORMAT_BC3_UNORM_SRGB
+                return vk::Format::eBc3SrgbBlock;
+            case 80:  // DXGI_FORMAT_BC4_UNORM
+                return vk::Format::eBc4UnormBlock;
+            case 81:  // DXGI_FORMAT_BC4_SNORM
+                return vk::Format::eBc4SnormBlock;
+            case 83:  // DXGI_FORMAT_BC5_UNORM
+                return vk::Format::eBc5UnormBlock;
+            case 84:  // DXGI_FORMAT_BC5_SNORM
+                return vk::Format::eBc5SnormBlock;
+            case 87:  // DXGI_FORMAT_B8G8R8A8_UNORM
+                return vk::Format::eB8G8R8A8Unorm;
+            case 91:  // DXGI_FORMAT_B8G8R8A8_UNORM_SRGB
+                return vk::Format::eB8G8R8A8Srgb;
+            case 98:  // DXGI_FORMAT_BC7_UNORM
+                return vk::Format::eBc7UnormBlock;
+            case 99:  // DXGI_FORMAT_BC7_UNORM_SRGB
+                return vk::Format::eBc7SrgbBlock;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    auto fromLegacyPixelFormat(DdsPixelFormat const& pixelFormat) -> std::optional<vk::Format>
+    {
+        if (pixelFormat.flags & kDdpfFourCC)
+        {
+            switch (pixelFormat.fourCC)
+            {
+                case makeFourCC("DXT1"):
+                    return vk::Format::eBc1RgbaUnormBlock;
+                case makeFourCC("DXT2"):
+                case makeFourCC("DXT3"):
+                    return vk::Format::eBc2UnormBlock;
+                case makeFourCC("DXT4"):
+                case makeFourCC("DXT5"):
+                    return vk::Format::eBc3UnormBlock;
+                case makeFourCC("ATI1"):
+                case makeFourCC("BC4U"):
+                    return vk::Format::eBc4UnormBlock;
+                case makeFourCC("BC4S"):
+                    return vk::Format::eBc4SnormBlock;
+                case makeFourCC("ATI2"):
+                case makeFourCC("BC5U"):
+                    return vk::Format::eBc5UnormBlock;
+                case makeFourCC("BC5S"):
+                    return vk::Format::eBc5SnormBlock;
+                default:
+                    return std::nullopt;
+            }
+        }
+
+        if ((pixelFormat.flags & kDdpfRgb) && pixelFormat.rgbBitCount == 32)
+        {
+            if (pixelFormat.rBitMask == 0x000000ff && pixelFormat.bBitMask == 0x00ff0000)
+            {
+                return vk::Format::eR8G8B8A8Unorm;
+            }
+
+            if (pixelFormat.rBitMask == 0x00ff0000 && pixelFormat.bBitMask == 0x000000ff)
+            {
+                return vk::Format::eB8G8R8A8Unorm;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    auto isSupportedFormat(vk::Format format) -> bool
+    {
+        return isBlockCompressed(format) || format == vk::Format::eR8G8B8A8Unorm ||
+               format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eB8G8R8A8Unorm ||
+               format == vk::Format::eB8G8R8A8Srgb;
+    }
+
+    auto parseDds(std::span<std::byte const> bytes, std::string_view name) -> DecodedImage
+    {
+        auto const header = read<DdsHeader>(bytes, kDdsMagic.size(), name);
+
+        size_t dataOffset = kDdsMagic.size() + sizeof(DdsHeader);
+
+        std::optional<vk::Format> format;
+        uint32_t arrayLayers = 1;
+
+        if ((header.pixelFormat.flags & kDdpfFourCC) && header.pixelFormat.fourCC == makeFourCC("DX10"))
+        {
+            auto const dx10 = read<DdsHeaderDx10>(bytes, dataOffset, name);
+
+            if (dx10.resourceDimension != kDx10DimensionTex2D)
+            {
+                MC_THROW Error(AssetError, std::format("DDS '{}' is not a 2D texture", name));
+            }
+
+            format      = fromDxgiFormat(dx10.dxgiFormat);
+            arrayLayers = std::max(dx10.arraySize, 1u) * ((dx10.miscFlag & kDx10MiscCube) != 0 ? 6u : 1u);
+            dataOffset += sizeof(DdsHeaderDx10);
+
+            if (!format)
+            {
+                MC_THROW Error(AssetError,
+                               std::format("DDS '{}' has unsupported DXGI format {}", name, dx10.dxgiFormat));
+            }
+        }
+        else
+        {
+            if (header.caps2 & kDdsCaps2Volume)
+            {
+                MC_THROW Error(AssetError, std::format("DDS '{}' is a volume texture", name));
+            }
+
+            format      = fromLegacyPixelFormat(header.pixelFormat);
+            arrayLayers = (header.caps2 & kDdsCaps2Cubemap) != 0 ? 6u : 1u;
+
+            if (!format)
+            {
+                MC_THROW Error(AssetError, std::format("DDS '{}' has an unsupported pixel format", name));
+            }
+        }
+
+        DecodedImage image {
+            .dimensions  = { header.width, std::max(header.height, 1u) },
+            .mipLevels   = (header.flags & kDdsdMipMapCount) != 0 ? std::max(header.mipMapCount, 1u) : 1u,
+            .arrayLayers = arrayLayers,
+            .format      = *format,
+        };
+
+        // DDS stores every layer's whole chain before the next layer, subresources are indexed level first
+        image.subresourceOffsets.resize(static_cast<size_t>(image.mipLevels) * arrayLayers);
+
+        vk::DeviceSize offset = 0;
+
+        for (uint32_t layer = 0; layer < arrayLayers; ++layer)
+        {
+            for (uint32_t level = 0; level < image.mipLevels; ++level)
+            {
+                image.subresourceOffsets[level * arrayLayers + layer] = offset;
+
+                offset += getImageLevelSize(image.format,
+                                            { std::max(image.dimensions.width >> level, 1u),
+                                              std::max(image.dimensions.height >> level, 1u) });
+            }
+        }
+
+        if (dataOffset + offset > bytes.size())
+        {
+            MC_THROW Error(AssetError, std::format("DDS '{}' is truncated", name));
+        }
+
+        image.data = bytes.subspan(dataOffset, offset);
+
+        return image;
+    }
+
+    auto parseKtx2(std::span<std::byte const> bytes, std::string_view name) -> DecodedImage
+    {
+        auto const header = read<Ktx2Header>(bytes, kKtx2Magic.size(), name);
+
+        if (header.supercompressionScheme != 0)
+        {
+            MC_THROW Error(AssetError,
+                           std::format("KTX2 '{}' uses supercompression scheme {}, only uncompressed "
+                                       "level data is supported",
+                                       name,
+                                       header.supercompressionScheme));
+        }
+
+        if (header.pixelDepth > 1)
+        {
+            MC_THROW Error(AssetError, std::format("KTX2 '{}' is a volume texture", name));
+        }
+
+        auto const format = static_cast<vk::Format>(header.vkFormat);
+
+        if (!isSupportedFormat(format))
+        {
+            MC_THROW Error(AssetError,
+                           std::format("KTX2 '{}' has unsupported VkFormat {}", name, header.vkFormat));
+        }
+
+        DecodedImage image {
+            .dimensions  = { header.pixelWidth, std::max(header.pixelHeight, 1u) },
+            .mipLevels   = std::max(header.levelCount, 1u),
+            .arrayLayers = std::max(header.layerCount, 1u) * std::max(header.faceCount, 1u),
+            .format      = format,
+        };
+
+        // Levels are stored smallest first, each holding every layer and face back to back. `data` spans
+        // from the lowest level offset so that the spec's level alignment carries over to the staging buffer.
+        std::vector<Ktx2Level> levels(image.mipLevels);
+
+        size_t const levelIndexOffset = kKtx2Magic.size() + sizeof(Ktx2Header);
+
+        for (uint32_t level = 0; level < image.mipLevels; ++level)
+        {
+            levels[level] = read<Ktx2Level>(bytes, levelIndexOffset + level * sizeof(Ktx2Level), name);
+        }
+
+        uint64_t const dataBegin = rn::min(levels, {}, &Ktx2Level::byteOffset).byteOffset;
+        uint64_t dataEnd         = dataBegin;
+
+        image.subresourceOffsets.resize(static_cast<size_t>(image.mipLevels) * image.arrayLayers);
+
+        for (uint32_t level = 0; level < image.mipLevels; ++level)
+        {
+            vk::DeviceSize const layerSize =
+                getImageLevelSize(image.format,
+                                  { std::max(image.dimensions.width >> level, 1u),
+                                    std::max(image.dimensions.height >> level, 1u) });
+
+            if (levels[level].byteLength < layerSize * image.arrayLayers)
+            {
+                MC_THROW Error(AssetError, std::format("KTX2 '{}' level {} is too small", name, level));
+            }
+
+            for (uint32_t layer = 0; layer < image.arrayLayers; ++layer)
+            {
+                image.subresourceOffsets[level * image.arrayLayers + layer] =
+                    levels[level].byteOffset - dataBegin + layer * layerSize;
+            }
+
+            dataEnd = std::max(dataEnd, levels[level].byteOffset + levels[level].byteLength);
+        }
+
+        if (dataEnd > bytes.size())
+        {
+            MC_THROW Error(AssetError, std::format("KTX2 '{}' is truncated", name));
+        }
+
+        image.data = bytes.subspan(dataBegin, dataEnd - dataBegin);
+
+        return image;
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    auto isTextureContainer(std::span<std::byte const> bytes) -> bool
+    {
+        return hasMagic(bytes, kDdsMagic) || hasMagic(bytes, kKtx2Magic);
+    }
+
+    auto parseTextureContainer(std::span<std::byte const> bytes,
+                               std::shared_ptr<void const> owner,
+                               std::string_view name) -> DecodedImage
+    {
+        ZoneScopedN("Parse texture container");
+
+        DecodedImage image = hasMagic(bytes, kDdsMagic) ? parseDds(bytes, name) : parseKtx2(bytes, name);
+
+        // Textures are bound into the bindless sampler2D array, array and cube views can't be sampled from it
+        if (image.arrayLayers > 1)
+        {
+            MC_THROW Error(AssetError,
+                           std::format("'{}' has {} layers or cube faces, only 2D textures are supported",
+                                       name,
+                                       image.arrayLayers));
+        }
+
+        image.owner = std::move(owner);
+
+        return image;
+    }
+}  // namespace renderer::backend
@@ -0,0 +1,271 @@
+#include <mc/asserts.hpp>
+#include <mc/exceptions.hpp>
+#include <mc/logger.hpp>
+#include <mc/renderer/backend/block_encoder.hpp>
+#include <mc/renderer/backend/texture_loader.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+    using namespace renderer::backend;
+
+    // Upper bound for the staging memory of a single batch, half the ring leaves room for the next one while
+    // it's in flight. A lone image larger than this still gets a batch of its own.
+    constexpr size_t kMaxBatchStagingSize = kUploadRingSize / 2;
+
+    auto isSrgb(vk::Format format) -> bool
+    {
+        switch (format)
+        {
+            case vk::Format::eBc1RgbSrgbBlock:
+            case vk::Format::eBc1RgbaSrgbBlock:
+            case vk::Format::eBc2SrgbBlock:
+            case vk::Format::eBc3SrgbBlock:
+            case vk::Format::eBc7SrgbBlock:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // For devices without BC support, decodes every level of a block-compressed image to RGBA8. Anything
+    // else is returned as it is.
+    auto decompress(DecodedImage image) -> DecodedImage
+    {
+        if (!isBlockCompressed(image.format))
+        {
+            return image;
+        }
+
+        ZoneScopedN("Decompress image");
+
+        MC_ASSERT(image.arrayLayers == 1);
+
+        std::vector<vk::Extent2D> levels(image.mipLevels);
+        size_t size = 0;
+
+        for (uint32_t level = 0; level < image.mipLevels; ++level)
+        {
+            levels[level] = { std::max(image.dimensions.width >> level, 1u),
+                              std::max(image.dimensions.height >> level, 1u) };
+
+            size += static_cast<size_t>(levels[level].width) * levels[level].height * 4;
+        }
+
+        auto pixels = std::make_shared<std::vector<std::byte>>(size);
+
+        vk::DeviceSize sourceOffset = 0;
+        size_t offset               = 0;
+
+        for (uint32_t level = 0; level < image.mipLevels; ++level)
+        {
+            vk::Extent2D const dimensions = levels[level];
+
+            vk::DeviceSize const sourceSize = getImageLevelSize(image.format, dimensions);
+            size_t const levelSize          = static_cast<size_t>(dimensions.width) * dimensions.height * 4;
+
+            if (!image.subresourceOffsets.empty())
+            {
+                sourceOffset = image.subresourceOffsets[level];
+            }
+
+            if (!decodeBlocks(image.data.subspan(sourceOffset, sourceSize),
+                              dimensions,
+                              image.format,
+                              std::span { *pixels }.subspan(offset, levelSize)))
+            {
+                MC_THROW Error(AssetError,
+                               std::format("Can't decode {} blocks, the device doesn't support BC textures",
+                                           vk::to_string(image.format)));
+            }
+
+            sourceOffset += sourceSize;
+            offset += levelSize;
+        }
+
+        return {
+            .dimensions = image.dimensions,
+            .mipLevels  = image.mipLevels,
+            .format     = isSrgb(image.format) ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm,
+            .components = image.components,
+            .data       = *pixels,
+            .owner      = pixels,
+        };
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    TextureLoader::TextureLoader(Device& device,
+                                 Allocator& allocator,
+                                 UploadManager& uploadManager,
+                                 utils::ThreadPool& threadPool)
+        : m_device { &device },
+          m_allocator { &allocator },
+          m_uploadManager { &uploadManager },
+          m_threadPool { &threadPool }
+    {
+    }
+
+    TextureLoader::~TextureLoader()
+    {
+        // Decode jobs own their inputs, so only the copies into the textures have to be waited on
+        if (!m_batches.empty())
+        {
+            m_uploadManager->wait(m_batches.back().ticket);
+        }
+    }
+
+    void TextureLoader::enqueue(uint32_t id, DecodeFn decode)
+    {
+        if (isIdle())
+        {
+            m_startTime = Timer::Clock::now();
+        }
+
+        if (!m_device->isTextureCompressionBCSupported())
+        {
+            decode = [decode = std::move(decode)] { return decompress(decode()); };
+        }
+
+        m_pending.push_back({ .id = id, .decoded = m_threadPool->submit(std::move(decode)) });
+    }
+
+    void TextureLoader::enqueue(uint32_t id, DecodedImage image)
+    {
+        // Decoding the blocks is too slow for the calling thread, it goes through the pool like a decode job
+        if (!m_device->isTextureCompressionBCSupported() && isBlockCompressed(image.format))
+        {
+            enqueue(id, [image = std::move(image)] { return image; });
+
+            return;
+        }
+
+        if (isIdle())
+        {
+            m_startTime = Timer::Clock::now();
+        }
+
+        std::promise<DecodedImage> decoded;
+
+        decoded.set_value(std::move(image));
+
+        m_pending.push_back({ .id = id, .decoded = decoded.get_future() });
+    }
+
+    void TextureLoader::pump(LoadedFn const& onLoaded)
+    {
+        ZoneScopedN("Texture loader pump");
+
+        retireBatches(onLoaded, false);
+
+        std::vector<std::pair<uint32_t, DecodedImage>> ready;
+        size_t stagingSize = 0;
+
+        for (auto it = m_pending.begin(); it != m_pending.end() && stagingSize < kMaxBatchStagingSize;)
+        {
+            if (it->decoded.wait_for(std::chrono::seconds { 0 }) != std::future_status::ready)
+            {
+                ++it;
+
+                continue;
+            }
+
+            DecodedImage image = it->decoded.get();
+
+            stagingSize += image.data.size();
+            ready.emplace_back(it->id, std::move(image));
+
+            it = m_pending.erase(it);
+        }
+
+        if (!ready.empty())
+        {
+            recordBatch(ready);
+        }
+    }
+
+    void TextureLoader::flush(LoadedFn const& onLoaded)
+    {
+        while (!m_pending.empty())
+        {
+            m_pending.front().decoded.wait();
+
+            pump(onLoaded);
+        }
+
+        retireBatches(onLoaded, true);
+    }
+
+    void TextureLoader::recordBatch(std::vector<std::pair<uint32_t, DecodedImage>>& images)
+    {
+        ZoneScopedN("Texture batch record");
+
+        Batch batch;
+        batch.textures.reserve(images.size());
+
+        for (auto& [id, image] : images)
+        {
+            // A lone uncompressed level gets its chain blitted, anything else is uploaded as stored
+            uint32_t const mipLevels = image.mipLevels == 1 && !isBlockCompressed(image.format)
+                                           ? getMipLevelCount(image.dimensions)
+                                           : image.mipLevels;
+
+            Texture texture(*m_device,
+                            *m_allocator,
+                            image.dimensions,
+                            image.format,
+                            mipLevels,
+                            image.arrayLayers,
+                            image.components);
+
+            m_uploadManager->uploadTexture(texture, image.data, image.mipLevels, image.subresourceOffsets);
+
+            batch.textures.push_back({ .id = id, .texture = std::move(texture) });
+        }
+
+        batch.ticket = m_uploadManager->getRecordingTicket();
+
+        m_batches.push_back(std::move(batch));
+        ++m_batchCount;
+    }
+
+    void TextureLoader::retireBatches(LoadedFn const& onLoaded, bool wait)
+    {
+        for (auto it = m_batches.begin(); it != m_batches.end();)
+        {
+            if (wait)
+            {
+                m_uploadManager->wait(it->ticket);
+            }
+            else if (!m_uploadManager->isReady(it->ticket))
+            {
+                ++it;
+
+                continue;
+            }
+
+            onLoaded(it->textures);
+
+            m_loadedCount += it->textures.size();
+
+            it = m_batches.erase(it);
+        }
+
+        if (isIdle() && m_loadedCount > 0)
+        {
+            logger::info("Streamed {} textures in {} batches, {:.2f} ms after the first one was queued",
+                         m_loadedCount,
+                         m_batchCount,
+                         Timer::Milliseconds(Timer::Clock::now() - m_startTime).count());
+
+            m_loadedCount = 0;
+            m_batchCount  = 0;
+        }
+    }
+}  // namespace renderer::backend
@@ -0,0 +1,52 @@
+#include <mc/renderer/backend/timeline.hpp>
+#include <mc/renderer/backend/vk_checker.hpp>
+
+#include <limits>
+
+#include <tracy/Tracy.hpp>
+
+namespace renderer::backend
+{
+    Timeline::Timeline(Device const& device) : m_device { &device }
+    {
+        vk::SemaphoreTypeCreateInfo timelineInfo {
+            .semaphoreType = vk::SemaphoreType::eTimeline,
+            .initialValue  = 0,
+        };
+
+        m_semaphore = device->createSemaphore(vk::SemaphoreCreateInfo { .pNext = &timelineInfo }) >>
+                      ResultChecker();
+    }
+
+    auto Timeline::signal(vk::PipelineStageFlags2 stage) -> vk::SemaphoreSubmitInfo
+    {
+        return vk::SemaphoreSubmitInfo()
+            .setSemaphore(*m_semaphore)
+            .setValue(++m_submittedValue)
+            .setStageMask(stage);
+    }
+
+    auto Timeline::getWaitInfo(uint64_t value, vk::PipelineStageFlags2 stage) const -> vk::SemaphoreSubmitInfo
+    {
+        return vk::SemaphoreSubmitInfo().setSemaphore(*m_semaphore).setValue(value).setStageMask(stage);
+    }
+
+    void Timeline::wait(uint64_t value) const
+    {
+        if (value == 0 || isComplete(value))
+        {
+            return;
+        }
+
+        ZoneScopedN("Timeline wait");
+
+        auto waitInfo = vk::SemaphoreWaitInfo().setSemaphores(*m_semaphore).setValues(value);
+
+        m_device->get().waitSemaphores(waitInfo, std::numeric_limits<uint64_t>::max()) >> ResultChecker();
+    }
+
+    auto Timeline::getCompletedValue() const -> uint64_t
+    {
+        return m_semaphore.getCounterValue();
+    }
+}  // namespace renderer::backend
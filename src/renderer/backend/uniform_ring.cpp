@@ -0,0 +1,70 @@
+#include <mc/asserts.hpp>
+#include <mc/exceptions.hpp>
+#include <mc/renderer/backend/constants.hpp>
+#include <mc/renderer/backend/uniform_ring.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <format>
+#include <limits>
+
+namespace
+{
+    // Buffer references default to 16 byte alignment
+    constexpr vk::DeviceSize kMinAlignment = 16;
+
+    // Alignments are powers of two
+    auto alignUp(vk::DeviceSize value, vk::DeviceSize alignment) -> vk::DeviceSize
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    UniformRing::UniformRing(Device const& device, Allocator& allocator, vk::DeviceSize frameCapacity)
+        : m_alignment { std::max(device.getDeviceProperties().limits.minUniformBufferOffsetAlignment,
+                                 kMinAlignment) },
+          m_frameCapacity { alignUp(frameCapacity, m_alignment) }
+    {
+        // Dynamic offsets are 32 bit
+        MC_ASSERT(m_frameCapacity * kMaxFramesInFlight <= std::numeric_limits<uint32_t>::max());
+
+        m_buffer = GPUBuffer(allocator,
+                             m_frameCapacity * kMaxFramesInFlight,
+                             vk::BufferUsageFlagBits::eUniformBuffer |
+                                 vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                             VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                             VMA_ALLOCATION_CREATE_MAPPED_BIT |
+                                 VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+        m_address = device->getBufferAddress(vk::BufferDeviceAddressInfo().setBuffer(m_buffer));
+    }
+
+    void UniformRing::beginFrame(uint32_t frameIndex)
+    {
+        m_frameBegin = m_frameCapacity * frameIndex;
+        m_offset     = m_frameBegin;
+    }
+
+    auto UniformRing::allocate(vk::DeviceSize size) -> Allocation
+    {
+        vk::DeviceSize const offset = m_offset;
+
+        if (offset + size > m_frameBegin + m_frameCapacity)
+        {
+            MC_THROW Error(GraphicsError,
+                           std::format("Uniform ring out of space, {} of {} bytes used this frame",
+                                       offset - m_frameBegin,
+                                       m_frameCapacity));
+        }
+
+        m_offset = alignUp(offset + size, m_alignment);
+
+        return {
+            .offset  = static_cast<uint32_t>(offset),
+            .data    = static_cast<std::byte*>(m_buffer.getMappedData()) + offset,
+            .address = m_address + offset,
+        };
+    }
+}  // namespace renderer::backend
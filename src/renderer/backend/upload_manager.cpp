@@ -0,0 +1,381 @@
+#include <mc/asserts.hpp>
+#include <mc/renderer/backend/upload_manager.hpp>
+#include <mc/renderer/backend/vk_checker.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+    // Buffer to image copies of block-compressed formats need offsets aligned to the block size
+    constexpr vk::DeviceSize kStagingAlignment = 16;
+
+    auto alignStagingOffset(vk::DeviceSize offset) -> vk::DeviceSize
+    {
+        return (offset + kStagingAlignment - 1) & ~(kStagingAlignment - 1);
+    }
+}  // namespace
+
+namespace renderer::backend
+{
+    UploadManager::UploadManager(Device& device, Allocator& allocator, vk::DeviceSize ringSize)
+        : m_device { &device },
+          m_allocator { &allocator },
+          m_ring { allocator,
+                   ringSize,
+                   vk::BufferUsageFlagBits::eTransferSrc,
+                   VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                   VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                       VMA_ALLOCATION_CREATE_MAPPED_BIT },
+          m_ringSize { ringSize }
+    {
+        MC_ASSERT(ringSize % kStagingAlignment == 0);
+
+        auto poolInfo = vk::CommandPoolCreateInfo()
+                            .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer |
+                                      vk::CommandPoolCreateFlagBits::eTransient)
+                            .setQueueFamilyIndex(device.getQueueFamilyIndices().transferFamily);
+
+        m_commandPool = device->createCommandPool(poolInfo) >> ResultChecker();
+
+        m_timeline = Timeline(device);
+    }
+
+    UploadManager::~UploadManager()
+    {
+        if (!m_timeline)
+        {
+            return;
+        }
+
+        // The staging memory and command buffers of in-flight batches go away with us
+        m_timeline.wait(m_timeline.getSubmittedValue());
+    }
+
+    void UploadManager::uploadBuffer(std::span<std::byte const> data,
+                                     vk::Buffer dst,
+                                     vk::DeviceSize dstOffset,
+                                     vk::PipelineStageFlags2 dstStage,
+                                     vk::AccessFlags2 dstAccess)
+    {
+        if (data.empty())
+        {
+            return;
+        }
+
+        Staging staging = stage(data);
+
+        m_recording.commandBuffer.copyBuffer(
+            staging.buffer,
+            dst,
+            vk::BufferCopy { .srcOffset = staging.offset, .dstOffset = dstOffset, .size = data.size() });
+
+        QueueFamilyIndices const& families = m_device->getQueueFamilyIndices();
+
+        m_recording.acquires.buffers.push_back({
+            .dstStageMask        = dstStage,
+            .dstAccessMask       = dstAccess,
+            .srcQueueFamilyIndex = families.transferFamily,
+            .dstQueueFamilyIndex = families.graphicsFamily,
+            .buffer              = dst,
+            .offset              = dstOffset,
+            .size                = data.size(),
+        });
+    }
+
+    void UploadManager::uploadTexture(Texture const& texture,
+                                      std::span<std::byte const> data,
+                                      uint32_t providedMipLevels,
+                                      std::span<vk::DeviceSize const> subresourceOffsets)
+    {
+        Image const& image = texture.getImage();
+
+        Staging staging = stage(data);
+
+        texture.recordCopy(*m_recording.commandBuffer,
+                           staging.buffer,
+                           staging.offset,
+                           providedMipLevels,
+                           subresourceOffsets);
+
+        QueueFamilyIndices const& families = m_device->getQueueFamilyIndices();
+
+        // The rest of the chain is blitted on the graphics queue, until then everything stays a copy target
+        bool const generatesMips = providedMipLevels < image.getMipLevels();
+
+        vk::PipelineStageFlags2 const sampledStages =
+            vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader;
+
+        vk::PipelineStageFlags2 const dstStage =
+            generatesMips ? vk::PipelineStageFlagBits2::eBlit : sampledStages;
+
+        vk::AccessFlags2 const dstAccess =
+            generatesMips ? vk::AccessFlagBits2::eTransferRead | vk::AccessFlagBits2::eTransferWrite
+                          : vk::AccessFlagBits2::eShaderSampledRead;
+
+        m_recording.acquires.images.push_back({
+            .dstStageMask        = dstStage,
+            .dstAccessMask       = dstAccess,
+            .oldLayout           = vk::ImageLayout::eTransferDstOptimal,
+            .newLayout           = generatesMips ? vk::ImageLayout::eTransferDstOptimal
+                                                 : vk::ImageLayout::eShaderReadOnlyOptimal,
+            .srcQueueFamilyIndex = families.transferFamily,
+            .dstQueueFamilyIndex = families.graphicsFamily,
+            .image               = image,
+            .subresourceRange    = {
+                .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel   = 0,
+                .levelCount     = vk::RemainingMipLevels,
+                .baseArrayLayer = 0,
+                .layerCount     = vk::RemainingArrayLayers,
+            },
+        });
+
+        if (generatesMips)
+        {
+            m_recording.acquires.mipChains.push_back({
+                .image       = image,
+                .dimensions  = image.getDimensions(),
+                .format      = image.getFormat(),
+                .mipLevels   = image.getMipLevels(),
+                .arrayLayers = image.getArrayLayers(),
+            });
+        }
+    }
+
+    auto UploadManager::submit() -> UploadTicket
+    {
+        if (!*m_recording.commandBuffer)
+        {
+            return { m_timeline.getSubmittedValue() };
+        }
+
+        ZoneScopedN("Upload batch submit");
+
+        Acquires& acquires = m_recording.acquires;
+
+        // Without an ownership transfer the timeline semaphore already makes the copies visible to the
+        // graphics queue, only the layout transitions are left and those can happen right here
+        if (!isOwnershipTransferred())
+        {
+            acquires.buffers.clear();
+        }
+
+        std::vector<vk::BufferMemoryBarrier2> bufferReleases = acquires.buffers;
+        std::vector<vk::ImageMemoryBarrier2> imageReleases   = acquires.images;
+
+        for (vk::BufferMemoryBarrier2& barrier : bufferReleases)
+        {
+            barrier.setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+                .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+                .setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+                .setDstAccessMask(vk::AccessFlagBits2::eNone);
+        }
+
+        for (vk::ImageMemoryBarrier2& barrier : imageReleases)
+        {
+            barrier.setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+                .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+                .setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+                .setDstAccessMask(vk::AccessFlagBits2::eNone);
+        }
+
+        if (!isOwnershipTransferred())
+        {
+            acquires.images.clear();
+        }
+
+        m_recording.commandBuffer.pipelineBarrier2(vk::DependencyInfo()
+                                                       .setBufferMemoryBarriers(bufferReleases)
+                                                       .setImageMemoryBarriers(imageReleases));
+
+        m_recording.commandBuffer.end();
+
+        auto signalInfo = m_timeline.signal();
+
+        m_recording.value   = signalInfo.value;
+        m_recording.ringEnd = m_ringHead;
+
+        auto cmdInfo = vk::CommandBufferSubmitInfo().setCommandBuffer(*m_recording.commandBuffer);
+
+        auto submit = vk::SubmitInfo2().setCommandBufferInfos(cmdInfo).setSignalSemaphoreInfos(signalInfo);
+
+        m_device->getTransferQueue().submit2(submit);
+
+        m_inFlight.push_back(std::move(m_recording));
+        m_recording = {};
+
+        return { m_timeline.getSubmittedValue() };
+    }
+
+    void UploadManager::recordAcquires(vk::CommandBuffer commandBuffer)
+    {
+        reclaim();
+
+        if (!m_completed.buffers.empty() || !m_completed.images.empty())
+        {
+            commandBuffer.pipelineBarrier2(vk::DependencyInfo()
+                                               .setBufferMemoryBarriers(m_completed.buffers)
+                                               .setImageMemoryBarriers(m_completed.images));
+        }
+
+        for (MipChain const& chain : m_completed.mipChains)
+        {
+            Texture::generateMipmaps(*m_device,
+                                     commandBuffer,
+                                     chain.image,
+                                     chain.dimensions,
+                                     chain.format,
+                                     chain.mipLevels,
+                                     chain.arrayLayers);
+        }
+
+        m_completed     = {};
+        m_acquiredValue = m_completedValue;
+    }
+
+    auto UploadManager::getWaitInfo() const -> vk::SemaphoreSubmitInfo
+    {
+        // Already signalled by the time the frame is submitted, the acquires only must not overtake it
+        return m_timeline.getWaitInfo(m_acquiredValue, vk::PipelineStageFlagBits2::eAllCommands);
+    }
+
+    void UploadManager::wait(UploadTicket ticket)
+    {
+        ZoneScopedN("Upload wait");
+
+        if (ticket.value > m_timeline.getSubmittedValue())
+        {
+            submit();
+        }
+
+        MC_ASSERT(ticket.value <= m_timeline.getSubmittedValue());
+
+        m_timeline.wait(ticket.value);
+
+        reclaim();
+    }
+
+    auto UploadManager::stage(std::span<std::byte const> data) -> Staging
+    {
+        Staging staging {};
+
+        if (data.size() > m_ringSize)
+        {
+            GPUBuffer& buffer = m_recording.dedicatedStaging.emplace_back(
+                *m_allocator,
+                data.size(),
+                vk::BufferUsageFlagBits::eTransferSrc,
+                VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+            std::memcpy(buffer.getMappedData(), data.data(), data.size());
+
+            staging = { .buffer = buffer, .offset = 0 };
+        }
+        else
+        {
+            // May submit the open batch to make room, so this goes before anything is recorded
+            staging = { .buffer = m_ring, .offset = allocateRing(data.size()) };
+
+            std::memcpy(
+                static_cast<std::byte*>(m_ring.getMappedData()) + staging.offset, data.data(), data.size());
+        }
+
+        if (!*m_recording.commandBuffer)
+        {
+            if (m_freeCommandBuffers.empty())
+            {
+                m_recording.commandBuffer = std::move(
+                    (m_device->get().allocateCommandBuffers(vk::CommandBufferAllocateInfo()
+                                                                .setCommandPool(m_commandPool)
+                                                                .setLevel(vk::CommandBufferLevel::ePrimary)
+                                                                .setCommandBufferCount(1)) >>
+                     ResultChecker())[0]);
+            }
+            else
+            {
+                m_recording.commandBuffer = std::move(m_freeCommandBuffers.back());
+                m_freeCommandBuffers.pop_back();
+            }
+
+            m_recording.commandBuffer.begin(
+                vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        }
+
+        return staging;
+    }
+
+    auto UploadManager::allocateRing(vk::DeviceSize size) -> vk::DeviceSize
+    {
+        while (true)
+        {
+            vk::DeviceSize start  = alignStagingOffset(m_ringHead);
+            vk::DeviceSize offset = start % m_ringSize;
+
+            // Allocations never straddle the end of the ring
+            if (offset + size > m_ringSize)
+            {
+                start += m_ringSize - offset;
+                offset = 0;
+            }
+
+            // Nothing is in use, so the skipped bytes are free as well
+            if (m_ringTail == m_ringHead)
+            {
+                m_ringTail = start;
+            }
+
+            if (start + size - m_ringTail <= m_ringSize)
+            {
+                m_ringHead = start + size;
+
+                return offset;
+            }
+
+            ZoneScopedN("Upload ring stall");
+
+            // The open batch may be what's holding on to the space
+            if (m_inFlight.empty())
+            {
+                submit();
+            }
+
+            wait({ m_inFlight.front().value });
+        }
+    }
+
+    void UploadManager::reclaim()
+    {
+        uint64_t const completedValue = m_timeline.getCompletedValue();
+
+        while (!m_inFlight.empty() && m_inFlight.front().value <= completedValue)
+        {
+            Batch& batch = m_inFlight.front();
+
+            m_ringTail       = std::max(m_ringTail, batch.ringEnd);
+            m_completedValue = batch.value;
+
+            m_completed.buffers.insert(
+                m_completed.buffers.end(), batch.acquires.buffers.begin(), batch.acquires.buffers.end());
+            m_completed.images.insert(
+                m_completed.images.end(), batch.acquires.images.begin(), batch.acquires.images.end());
+            m_completed.mipChains.insert(m_completed.mipChains.end(),
+                                         batch.acquires.mipChains.begin(),
+                                         batch.acquires.mipChains.end());
+
+            m_freeCommandBuffers.push_back(std::move(batch.commandBuffer));
+
+            m_inFlight.pop_front();
+        }
+    }
+
+    auto UploadManager::isOwnershipTransferred() const -> bool
+    {
+        QueueFamilyIndices const& families = m_device->getQueueFamilyIndices();
+
+        return families.transferFamily != families.graphicsFamily;
+    }
+}  // namespace renderer::backend
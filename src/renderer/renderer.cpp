@@ -4,6 +4,9 @@
 #include <mc/renderer/backend/renderer_backend.hpp>
 #include <mc/renderer/renderer.hpp>
 
+#include <filesystem>
+#include <utility>
+
 #include <glm/fwd.hpp>
 #include <glm/trigonometric.hpp>
 #include <tracy/Tracy.hpp>
@@ -56,6 +59,20 @@ namespace renderer
                     m_backend.toggleLightRevolution();
                     break;
                 }
+            case Key::U:
+                {
+                    m_backend.toggleUberMaterialShader();
+                    break;
+                }
+            case Key::One:
+            case Key::Two:
+            case Key::Three:
+            case Key::Four:
+                {
+                    m_backend.setFramesInFlight(
+                        static_cast<uint32_t>(std::to_underlying(event.key) - std::to_underlying(Key::Zero)));
+                    break;
+                }
         }
     }
 
@@ -63,4 +80,9 @@ namespace renderer
     {
         m_backend.scheduleSwapchainUpdate();
     }
+
+    void Renderer::loadScene(std::filesystem::path const& path, backend::VertexFormat vertexFormat)
+    {
+        m_backend.processGltf(path, vertexFormat);
+    }
 }  // namespace renderer
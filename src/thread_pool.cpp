@@ -0,0 +1,73 @@
+#include <mc/thread_pool.hpp>
+
+#include <format>
+
+#include <tracy/Tracy.hpp>
+
+namespace utils
+{
+    ThreadPool::ThreadPool(size_t threadCount)
+    {
+        m_workers.reserve(threadCount);
+
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            m_workers.emplace_back(
+                [this, i](std::stop_token stopToken)
+                {
+                    std::string name = std::format("Worker {}", i);
+
+                    tracy::SetThreadName(name.c_str());
+
+                    workerLoop(stopToken);
+                });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        for (std::jthread& worker : m_workers)
+        {
+            worker.request_stop();
+        }
+
+        m_condition.notify_all();
+
+        // Joined by the jthread destructors; jobs still queued at this point are dropped, which breaks their
+        // promises and lets anyone still holding a future notice
+        m_workers.clear();
+    }
+
+    void ThreadPool::push(std::function<void()> job)
+    {
+        {
+            std::scoped_lock lock(m_mutex);
+
+            m_jobs.push_back(std::move(job));
+        }
+
+        m_condition.notify_one();
+    }
+
+    void ThreadPool::workerLoop(std::stop_token stopToken)
+    {
+        while (true)
+        {
+            std::function<void()> job;
+
+            {
+                std::unique_lock lock(m_mutex);
+
+                if (!m_condition.wait(lock, stopToken, [this] { return !m_jobs.empty(); }))
+                {
+                    return;
+                }
+
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+
+            job();
+        }
+    }
+}  // namespace utils
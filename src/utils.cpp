@@ -1,5 +1,73 @@
 #include <mc/utils.hpp>
 
+#include <bit>
+#include <cstring>
+
+#ifdef __linux__
+#    include <sys/resource.h>
+#elif defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+
+#    include <psapi.h>
+#endif
+
 namespace utils
 {
+    auto getPeakResidentMemory() -> size_t
+    {
+#ifdef __linux__
+        rusage usage {};
+
+        getrusage(RUSAGE_SELF, &usage);
+
+        // ru_maxrss is reported in kilobytes on Linux
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#elif defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters {};
+
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+
+        return counters.PeakWorkingSetSize;
+#else
+        return 0;
+#endif
+    }
+
+    auto hashBytes(std::span<std::byte const> bytes, uint64_t seed) -> uint64_t
+    {
+        constexpr uint64_t kPrime1 = 0x9e3779b185ebca87ull;
+        constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4full;
+
+        uint64_t hash = seed ^ (bytes.size() * kPrime1);
+
+        // Eight bytes at a time, the bytes are only ever read in little-endian order
+        size_t const wordCount = bytes.size() / sizeof(uint64_t);
+
+        for (size_t i = 0; i < wordCount; ++i)
+        {
+            uint64_t word = 0;
+
+            std::memcpy(&word, bytes.data() + i * sizeof(uint64_t), sizeof(uint64_t));
+
+            if constexpr (std::endian::native == std::endian::big)
+            {
+                word = std::byteswap(word);
+            }
+
+            hash = std::rotl(hash ^ (word * kPrime2), 31) * kPrime1;
+        }
+
+        for (std::byte byte : bytes.subspan(wordCount * sizeof(uint64_t)))
+        {
+            hash = std::rotl(hash ^ (static_cast<uint64_t>(byte) * kPrime1), 11) * kPrime2;
+        }
+
+        // Final avalanche so that nearby inputs don't produce nearby hashes
+        hash ^= hash >> 33;
+        hash *= kPrime2;
+        hash ^= hash >> 29;
+
+        return hash;
+    }
 }  // namespace utils